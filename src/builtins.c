@@ -129,6 +129,13 @@ static KrkValue _hex(int argc, KrkValue argv[]) {
 	return OBJECT_VAL(krk_copyString(tmp,len));
 }
 
+static KrkValue _hash(int argc, KrkValue argv[]) {
+	if (argc != 1) return krk_runtimeError(vm.exceptions->argumentError, "hash() takes exactly one argument");
+	uint32_t hashed = krk_hashValue(argv[0]);
+	if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return NONE_VAL();
+	return INTEGER_VAL(hashed);
+}
+
 static KrkValue _any(int argc, KrkValue argv[]) {
 #define unpackArray(counter, indexer) do { \
 	for (size_t i = 0; i < counter; ++i) { \
@@ -441,6 +448,7 @@ void _createAndBind_builtins(void) {
 	BUILTIN_FUNCTION("ord", _ord, "Obtain the ordinal integer value of a codepoint or byte.");
 	BUILTIN_FUNCTION("chr", _chr, "Convert an integer codepoint to its string representation.");
 	BUILTIN_FUNCTION("hex", _hex, "Convert an integer value to a hexadecimal string.");
+	BUILTIN_FUNCTION("hash", _hash, "Obtain the hash value used for an object as a key in dicts and sets.");
 	BUILTIN_FUNCTION("any", _any, "Returns True if at least one element in the given iterable is truthy, False otherwise.");
 	BUILTIN_FUNCTION("all", _all, "Returns True if every element in the given iterable is truthy, False otherwise.");
 }
@@ -10,6 +10,9 @@ void krk_initChunk(KrkChunk * chunk) {
 	chunk->linesCount = 0;
 	chunk->linesCapacity = 0;
 	chunk->lines = NULL;
+	chunk->handlersCount = 0;
+	chunk->handlersCapacity = 0;
+	chunk->handlers = NULL;
 	chunk->filename = NULL;
 	krk_initValueArray(&chunk->constants);
 }
@@ -40,6 +43,7 @@ void krk_writeChunk(KrkChunk * chunk, uint8_t byte, size_t line) {
 void krk_freeChunk(KrkChunk * chunk) {
 	FREE_ARRAY(uint8_t, chunk->code, chunk->capacity);
 	FREE_ARRAY(size_t, chunk->lines, chunk->capacity);
+	FREE_ARRAY(KrkExceptionHandler, chunk->handlers, chunk->handlersCapacity);
 	krk_freeValueArray(&chunk->constants);
 	krk_initChunk(chunk);
 }
@@ -68,3 +72,12 @@ size_t krk_writeConstant(KrkChunk * chunk, KrkValue value, size_t line) {
 	krk_emitConstant(chunk, ind, line);
 	return ind;
 }
+
+void krk_addHandler(KrkChunk * chunk, size_t startOffset, size_t endOffset, size_t target, size_t stackDepth) {
+	if (chunk->handlersCapacity < chunk->handlersCount + 1) {
+		size_t old = chunk->handlersCapacity;
+		chunk->handlersCapacity = GROW_CAPACITY(old);
+		chunk->handlers = GROW_ARRAY(KrkExceptionHandler, chunk->handlers, old, chunk->handlersCapacity);
+	}
+	chunk->handlers[chunk->handlersCount++] = (KrkExceptionHandler){startOffset, endOffset, target, stackDepth};
+}
@@ -48,7 +48,6 @@ typedef enum {
 	OP_IMPORT,
 	OP_INHERIT,
 	OP_GET_SUPER,
-	OP_PUSH_TRY,
 	OP_RAISE,
 	OP_DOCSTRING,
 	OP_CALL_STACK,
@@ -86,6 +85,35 @@ typedef enum {
 	OP_CREATE_PROPERTY,
 	OP_INVOKE_DELSLICE,
 	OP_INVOKE_SETSLICE,
+	OP_FOR_ITER,
+	OP_LIST_APPEND,
+	OP_DICT_SET,
+	OP_SET_ADD,
+	OP_LIST_RESERVE,
+	OP_COMP_ENTER,
+	OP_COMP_EXIT,
+
+	OP_INPLACE_ADD,
+	OP_INPLACE_SUBTRACT,
+	OP_INPLACE_MULTIPLY,
+	OP_INPLACE_DIVIDE,
+	OP_INPLACE_MODULO,
+	OP_INPLACE_POW,
+	OP_INPLACE_BITOR,
+	OP_INPLACE_BITXOR,
+	OP_INPLACE_BITAND,
+	OP_INPLACE_SHIFTLEFT,
+	OP_INPLACE_SHIFTRIGHT,
+
+	OP_YIELD,
+
+	OP_SET_LOCAL_POP,
+	OP_GET_LOCAL_PAIR,
+	OP_GET_LOCAL_CONSTANT,
+	OP_POP_JUMP_IF_FALSE,
+	OP_POP_JUMP_IF_TRUE,
+	OP_CALL_BUILTIN,
+	OP_TAIL_CALL,
 
 	OP_CONSTANT_LONG = 128,
 	OP_DEFINE_GLOBAL_LONG,
@@ -110,6 +138,14 @@ typedef enum {
 	OP_DEL_GLOBAL_LONG,
 	OP_DEL_PROPERTY_LONG,
 	OP_IMPORT_FROM_LONG,
+	OP_LIST_APPEND_LONG,
+	OP_DICT_SET_LONG,
+	OP_SET_ADD_LONG,
+	OP_LIST_RESERVE_LONG,
+	OP_COMP_ENTER_LONG,
+	OP_COMP_EXIT_LONG,
+	OP_SET_LOCAL_POP_LONG,
+	OP_TAIL_CALL_LONG,
 } KrkOpCode;
 
 typedef struct {
@@ -117,6 +153,22 @@ typedef struct {
 	size_t line;
 } KrkLineMap;
 
+/**
+ * Exception handler table entry
+ *
+ * A try block covers the bytes from startOffset up to endOffset. When
+ * an exception is raised there, the stack is cut back to stackDepth
+ * values above the frame's slots, the exception is pushed, and
+ * execution continues at target. Entering a try block runs no code.
+ * Nested blocks finish first, so they appear earlier in the table.
+ */
+typedef struct {
+	size_t startOffset;
+	size_t endOffset;
+	size_t target;
+	size_t stackDepth;
+} KrkExceptionHandler;
+
 /**
  * Bytecode chunks
  */
@@ -129,6 +181,10 @@ typedef struct {
 	size_t linesCapacity;
 	KrkLineMap * lines;
 
+	size_t handlersCount;
+	size_t handlersCapacity;
+	KrkExceptionHandler * handlers;
+
 	KrkString * filename;
 	KrkValueArray constants;
 } KrkChunk;
@@ -139,3 +195,4 @@ extern void krk_freeChunk(KrkChunk * chunk);
 extern size_t krk_addConstant(KrkChunk * chunk, KrkValue value);
 extern void krk_emitConstant(KrkChunk * chunk, size_t ind, size_t line);
 extern size_t krk_writeConstant(KrkChunk * chunk, KrkValue value, size_t line);
+extern void krk_addHandler(KrkChunk * chunk, size_t startOffset, size_t endOffset, size_t target, size_t stackDepth);
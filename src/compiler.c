@@ -66,7 +66,8 @@ typedef enum {
 	PREC_PRIMARY
 } Precedence;
 
-typedef void (*ParseFn)(int);
+struct GlobalState;
+typedef void (*ParseFn)(struct GlobalState *, int);
 
 typedef struct {
 	const char * name;
@@ -86,6 +87,17 @@ typedef struct {
 	int    isLocal;
 } Upvalue;
 
+/**
+ * Entry in a compiler's constant map. Each literal or name used in a
+ * function is only added to its constant pool once; later uses find it
+ * here and reuse its index, which keeps the pool small enough for the
+ * short operand forms for longer.
+ */
+typedef struct {
+	KrkValue value;
+	size_t   index; /* Index in the constant pool, plus one; 0 if unused */
+} ConstantEntry;
+
 typedef enum {
 	TYPE_FUNCTION,
 	TYPE_MODULE,
@@ -116,6 +128,13 @@ typedef struct Compiler {
 	int * continues;
 
 	size_t localNameCapacity;
+
+	size_t constantsCount;
+	size_t constantsSpace;
+	ConstantEntry * constants;
+
+	size_t handlerDepth; /* try and with blocks around the current statement */
+	size_t lastCall;     /* Offset of the last OP_CALL from call(), or -1 */
 } Compiler;
 
 typedef struct ClassCompiler {
@@ -123,25 +142,41 @@ typedef struct ClassCompiler {
 	KrkToken name;
 } ClassCompiler;
 
-static Parser parser;
-static Compiler * current = NULL;
-static ClassCompiler * currentClass = NULL;
-static int inDel = 0;
+/**
+ * Everything one call to krk_compile works on: the scanner, the parser and
+ * the stacks of function and class compilers. It lives on the C stack of
+ * krk_compile and is passed to every function below, so separate threads
+ * can compile at the same time and compiling can be reentered.
+ */
+typedef struct GlobalState {
+	Parser parser;
+	KrkScanner scanner;
+	Compiler * current;
+	ClassCompiler * currentClass;
+	int inDel;
+	struct GlobalState * enclosing; /* Compile this one interrupted on the same thread, for the GC */
+} GlobalState;
+
+static KrkChunk * currentChunk(struct GlobalState * state) {
+	return &state->current->function->chunk;
+}
 
-static KrkChunk * currentChunk() {
-	return &current->function->chunk;
+/* Throw away code emitted since count, such as when reparsing an expression. */
+static void rewindChunk(struct GlobalState * state, size_t count) {
+	currentChunk(state)->count = count;
+	if (state->current->lastCall >= count) state->current->lastCall = (size_t)-1;
 }
 
-#define EMIT_CONSTANT_OP(opc, arg) do { if (arg < 256) { emitBytes(opc, arg); } \
-	else { emitBytes(opc ## _LONG, arg >> 16); emitBytes(arg >> 8, arg); } } while (0)
+#define EMIT_CONSTANT_OP(opc, arg) do { if (arg < 256) { emitBytes(state, opc, arg); } \
+	else { emitBytes(state, opc ## _LONG, arg >> 16); emitBytes(state, arg >> 8, arg); } } while (0)
 
 static int isMethod(int type) {
 	return type == TYPE_METHOD || type == TYPE_INIT || type == TYPE_PROPERTY;
 }
 
-static void initCompiler(Compiler * compiler, FunctionType type) {
-	compiler->enclosing = current;
-	current = compiler;
+static void initCompiler(struct GlobalState * state, Compiler * compiler, FunctionType type) {
+	compiler->enclosing = state->current;
+	state->current = compiler;
 	compiler->function = NULL;
 	compiler->type = type;
 	compiler->scopeDepth = 0;
@@ -160,13 +195,18 @@ static void initCompiler(Compiler * compiler, FunctionType type) {
 	compiler->continues = NULL;
 	compiler->loopLocalCount = 0;
 	compiler->localNameCapacity = 0;
+	compiler->constantsCount = 0;
+	compiler->constantsSpace = 0;
+	compiler->constants = NULL;
+	compiler->handlerDepth = 0;
+	compiler->lastCall = (size_t)-1;
 
 	if (type != TYPE_MODULE) {
-		current->function->name = krk_copyString(parser.previous.start, parser.previous.length);
+		state->current->function->name = krk_copyString(state->parser.previous.start, state->parser.previous.length);
 	}
 
 	if (isMethod(type)) {
-		Local * local = &current->locals[current->localCount++];
+		Local * local = &state->current->locals[state->current->localCount++];
 		local->depth = 0;
 		local->isCaptured = 0;
 		local->name.start = "self";
@@ -174,109 +214,111 @@ static void initCompiler(Compiler * compiler, FunctionType type) {
 	}
 }
 
-static void parsePrecedence(Precedence precedence);
-static ssize_t parseVariable(const char * errorMessage);
-static void variable(int canAssign);
-static void defineVariable(size_t global);
-static ssize_t identifierConstant(KrkToken * name);
-static ssize_t resolveLocal(Compiler * compiler, KrkToken * name);
+static void parsePrecedence(struct GlobalState * state, Precedence precedence);
+static ssize_t parseVariable(struct GlobalState * state, const char * errorMessage);
+static void variable(struct GlobalState * state, int canAssign);
+static void defineVariable(struct GlobalState * state, size_t global);
+static ssize_t identifierConstant(struct GlobalState * state, KrkToken * name);
+static ssize_t resolveLocal(struct GlobalState * state, Compiler * compiler, KrkToken * name);
 static ParseRule * getRule(KrkTokenType type);
-static void defDeclaration();
-static void expression();
-static void statement();
-static void declaration();
-static void or_(int canAssign);
-static void ternary(int canAssign);
-static void and_(int canAssign);
-static KrkToken classDeclaration();
-static void declareVariable();
-static void namedVariable(KrkToken name, int canAssign);
-static void addLocal(KrkToken name);
-static void string(int canAssign);
-static KrkToken decorator(size_t level, FunctionType type);
-static void call(int canAssign);
-
-static void finishError(KrkToken * token) {
+static void defDeclaration(struct GlobalState * state);
+static void expression(struct GlobalState * state);
+static void statement(struct GlobalState * state);
+static void declaration(struct GlobalState * state);
+static void or_(struct GlobalState * state, int canAssign);
+static void ternary(struct GlobalState * state, int canAssign);
+static void and_(struct GlobalState * state, int canAssign);
+static KrkToken classDeclaration(struct GlobalState * state);
+static void declareVariable(struct GlobalState * state);
+static void namedVariable(struct GlobalState * state, KrkToken name, int canAssign);
+static void addLocal(struct GlobalState * state, KrkToken name);
+static void string(struct GlobalState * state, int canAssign);
+static ssize_t stringLiteral(struct GlobalState * state, int type);
+static KrkToken decorator(struct GlobalState * state, size_t level, FunctionType type);
+static void call(struct GlobalState * state, int canAssign);
+static size_t argumentList(struct GlobalState * state);
+
+static void finishError(struct GlobalState * state, KrkToken * token) {
 	size_t i = 0;
 	while (token->linePtr[i] && token->linePtr[i] != '\n') i++;
 
 	krk_attachNamedObject(&AS_INSTANCE(krk_currentThread.currentException)->fields, "line",   (KrkObj*)krk_copyString(token->linePtr, i));
-	krk_attachNamedObject(&AS_INSTANCE(krk_currentThread.currentException)->fields, "file",   (KrkObj*)currentChunk()->filename);
+	krk_attachNamedObject(&AS_INSTANCE(krk_currentThread.currentException)->fields, "file",   (KrkObj*)currentChunk(state)->filename);
 	krk_attachNamedValue (&AS_INSTANCE(krk_currentThread.currentException)->fields, "lineno", INTEGER_VAL(token->line));
 	krk_attachNamedValue (&AS_INSTANCE(krk_currentThread.currentException)->fields, "colno",  INTEGER_VAL(token->col));
 	krk_attachNamedValue (&AS_INSTANCE(krk_currentThread.currentException)->fields, "width",  INTEGER_VAL(token->literalWidth));
 
-	if (current->function->name) {
-		krk_attachNamedObject(&AS_INSTANCE(krk_currentThread.currentException)->fields, "func", (KrkObj*)current->function->name);
+	if (state->current->function->name) {
+		krk_attachNamedObject(&AS_INSTANCE(krk_currentThread.currentException)->fields, "func", (KrkObj*)state->current->function->name);
 	} else {
 		KrkValue name = NONE_VAL();
 		krk_tableGet(&krk_currentThread.module->fields, vm.specialMethodNames[METHOD_NAME], &name);
 		krk_attachNamedValue(&AS_INSTANCE(krk_currentThread.currentException)->fields, "func", name);
 	}
 
-	parser.panicMode = 1;
-	parser.hadError = 1;
+	state->parser.panicMode = 1;
+	state->parser.hadError = 1;
 }
 
-#define error(...) do { if (parser.panicMode) break; krk_runtimeError(vm.exceptions->syntaxError, __VA_ARGS__); finishError(&parser.previous); } while (0)
-#define errorAtCurrent(...) do { if (parser.panicMode) break; krk_runtimeError(vm.exceptions->syntaxError, __VA_ARGS__); finishError(&parser.current); } while (0)
+#define error(...) do { if (state->parser.panicMode) break; krk_runtimeError(vm.exceptions->syntaxError, __VA_ARGS__); finishError(state, &state->parser.previous); } while (0)
+#define errorAtCurrent(...) do { if (state->parser.panicMode) break; krk_runtimeError(vm.exceptions->syntaxError, __VA_ARGS__); finishError(state, &state->parser.current); } while (0)
 
-static void advance() {
-	parser.previous = parser.current;
+static void advance(struct GlobalState * state) {
+	state->parser.previous = state->parser.current;
 
 	for (;;) {
-		parser.current = krk_scanToken();
+		state->parser.current = krk_scanToken(&state->scanner);
 
-		if (parser.eatingWhitespace &&
-			(parser.current.type == TOKEN_INDENTATION || parser.current.type == TOKEN_EOL)) continue;
+		if (state->parser.eatingWhitespace &&
+			(state->parser.current.type == TOKEN_INDENTATION || state->parser.current.type == TOKEN_EOL)) continue;
 
 #ifdef ENABLE_SCAN_TRACING
 		if (krk_currentThread.flags & KRK_ENABLE_SCAN_TRACING) {
 			fprintf(stderr, "[%s<%d> %d:%d '%.*s'] ",
-				getRule(parser.current.type)->name,
-				(int)parser.current.type,
-				(int)parser.current.line,
-				(int)parser.current.col,
-				(int)parser.current.length,
-				parser.current.start);
+				getRule(state->parser.current.type)->name,
+				(int)state->parser.current.type,
+				(int)state->parser.current.line,
+				(int)state->parser.current.col,
+				(int)state->parser.current.length,
+				state->parser.current.start);
 		}
 #endif
 
-		if (parser.current.type == TOKEN_RETRY) continue;
-		if (parser.current.type != TOKEN_ERROR) break;
+		if (state->parser.current.type == TOKEN_RETRY) continue;
+		if (state->parser.current.type != TOKEN_ERROR) break;
 
-		errorAtCurrent(parser.current.start);
+		errorAtCurrent(state->parser.current.start);
 	}
 }
 
-static void startEatingWhitespace() {
-	parser.eatingWhitespace++;
-	if (parser.current.type == TOKEN_INDENTATION || parser.current.type == TOKEN_EOL) advance();
+static void startEatingWhitespace(struct GlobalState * state) {
+	state->parser.eatingWhitespace++;
+	if (state->parser.current.type == TOKEN_INDENTATION || state->parser.current.type == TOKEN_EOL) advance(state);
 }
 
-static void stopEatingWhitespace() {
-	if (parser.eatingWhitespace == 0) {
+static void stopEatingWhitespace(struct GlobalState * state) {
+	if (state->parser.eatingWhitespace == 0) {
 		error("Internal scanner error: Invalid nesting of `startEatingWhitespace`/`stopEatingWhitespace` calls.");
 	}
-	parser.eatingWhitespace--;
+	state->parser.eatingWhitespace--;
 }
 
-static void consume(KrkTokenType type, const char * message) {
-	if (parser.current.type == type) {
-		advance();
+static void consume(struct GlobalState * state, KrkTokenType type, const char * message) {
+	if (state->parser.current.type == type) {
+		advance(state);
 		return;
 	}
 
 	errorAtCurrent(message);
 }
 
-static int check(KrkTokenType type) {
-	return parser.current.type == type;
+static int check(struct GlobalState * state, KrkTokenType type) {
+	return state->parser.current.type == type;
 }
 
-static int match(KrkTokenType type) {
-	if (!check(type)) return 0;
-	advance();
+static int match(struct GlobalState * state, KrkTokenType type) {
+	if (!check(state, type)) return 0;
+	advance(state);
 	return 1;
 }
 
@@ -291,83 +333,87 @@ static KrkToken syntheticToken(const char * text) {
 	return token;
 }
 
-static void emitByte(uint8_t byte) {
-	krk_writeChunk(currentChunk(), byte, parser.previous.line);
+static void emitByte(struct GlobalState * state, uint8_t byte) {
+	krk_writeChunk(currentChunk(state), byte, state->parser.previous.line);
 }
 
-static void emitBytes(uint8_t byte1, uint8_t byte2) {
-	emitByte(byte1);
-	emitByte(byte2);
+static void emitBytes(struct GlobalState * state, uint8_t byte1, uint8_t byte2) {
+	emitByte(state, byte1);
+	emitByte(state, byte2);
 }
 
-static void emitReturn() {
-	if (current->type == TYPE_INIT) {
-		emitBytes(OP_GET_LOCAL, 0);
-	} else if (current->type == TYPE_MODULE) {
+static void emitReturn(struct GlobalState * state) {
+	if (state->current->type == TYPE_INIT) {
+		emitBytes(state, OP_GET_LOCAL, 0);
+	} else if (state->current->type == TYPE_MODULE) {
 		/* Un-pop the last stack value */
-		emitBytes(OP_GET_LOCAL, 0);
-	} else if (current->type != TYPE_LAMBDA) {
-		emitByte(OP_NONE);
+		emitBytes(state, OP_GET_LOCAL, 0);
+	} else if (state->current->type != TYPE_LAMBDA) {
+		emitByte(state, OP_NONE);
 	}
-	emitByte(OP_RETURN);
+	emitByte(state, OP_RETURN);
 }
 
-static KrkFunction * endCompiler() {
-	KrkFunction * function = current->function;
+static KrkFunction * endCompiler(struct GlobalState * state) {
+	KrkFunction * function = state->current->function;
 
-	for (size_t i = 0; i < current->function->localNameCount; i++) {
-		if (current->function->localNames[i].deathday == 0) {
-			current->function->localNames[i].deathday = currentChunk()->count;
+	for (size_t i = 0; i < state->current->function->localNameCount; i++) {
+		if (state->current->function->localNames[i].deathday == 0) {
+			state->current->function->localNames[i].deathday = currentChunk(state)->count;
 		}
 	}
-	current->function->localNames = GROW_ARRAY(KrkLocalEntry, current->function->localNames, \
-		current->localNameCapacity, current->function->localNameCount); /* Shorten this down for runtime */
+	state->current->function->localNames = GROW_ARRAY(KrkLocalEntry, state->current->function->localNames, \
+		state->current->localNameCapacity, state->current->function->localNameCount); /* Shorten this down for runtime */
 
-	emitReturn();
+	emitReturn(state);
 
 	/* Attach contants for arguments */
 	for (int i = 0; i < function->requiredArgs; ++i) {
-		KrkValue value = OBJECT_VAL(krk_copyString(current->locals[i].name.start, current->locals[i].name.length));
+		KrkValue value = OBJECT_VAL(krk_copyString(state->current->locals[i].name.start, state->current->locals[i].name.length));
 		krk_push(value);
 		krk_writeValueArray(&function->requiredArgNames, value);
 		krk_pop();
 	}
 	for (int i = 0; i < function->keywordArgs; ++i) {
-		KrkValue value = OBJECT_VAL(krk_copyString(current->locals[i+function->requiredArgs].name.start,
-			current->locals[i+function->requiredArgs].name.length));
+		KrkValue value = OBJECT_VAL(krk_copyString(state->current->locals[i+function->requiredArgs].name.start,
+			state->current->locals[i+function->requiredArgs].name.length));
 		krk_push(value);
 		krk_writeValueArray(&function->keywordArgNames, value);
 		krk_pop();
 	}
-	size_t args = current->function->requiredArgs + current->function->keywordArgs;
-	if (current->function->collectsArguments) {
-		KrkValue value = OBJECT_VAL(krk_copyString(current->locals[args].name.start,
-			current->locals[args].name.length));
+	size_t args = state->current->function->requiredArgs + state->current->function->keywordArgs;
+	if (state->current->function->collectsArguments) {
+		KrkValue value = OBJECT_VAL(krk_copyString(state->current->locals[args].name.start,
+			state->current->locals[args].name.length));
 		krk_push(value);
 		krk_writeValueArray(&function->keywordArgNames, value);
 		krk_pop();
 		args++;
 	}
-	if (current->function->collectsKeywords) {
-		KrkValue value = OBJECT_VAL(krk_copyString(current->locals[args].name.start,
-			current->locals[args].name.length));
+	if (state->current->function->collectsKeywords) {
+		KrkValue value = OBJECT_VAL(krk_copyString(state->current->locals[args].name.start,
+			state->current->locals[args].name.length));
 		krk_push(value);
 		krk_writeValueArray(&function->keywordArgNames, value);
 		krk_pop();
 		args++;
 	}
 
+	if (!state->parser.hadError) {
+		krk_optimizeFunction(function);
+	}
+
 #ifdef ENABLE_DISASSEMBLY
-	if ((krk_currentThread.flags & KRK_ENABLE_DISASSEMBLY) && !parser.hadError) {
+	if ((krk_currentThread.flags & KRK_ENABLE_DISASSEMBLY) && !state->parser.hadError) {
 		krk_disassembleChunk(stderr, function, function->name ? function->name->chars : "<module>");
 		fprintf(stderr, "Function metadata: requiredArgs=%d keywordArgs=%d upvalueCount=%d\n",
 			function->requiredArgs, function->keywordArgs, (int)function->upvalueCount);
 		fprintf(stderr, "__doc__: \"%s\"\n", function->docstring ? function->docstring->chars : "");
 		fprintf(stderr, "Constants: ");
-		for (size_t i = 0; i < currentChunk()->constants.count; ++i) {
+		for (size_t i = 0; i < currentChunk(state)->constants.count; ++i) {
 			fprintf(stderr, "%d: ", (int)i);
-			krk_printValueSafe(stderr, currentChunk()->constants.values[i]);
-			if (i != currentChunk()->constants.count - 1) {
+			krk_printValueSafe(stderr, currentChunk(state)->constants.values[i]);
+			if (i != currentChunk(state)->constants.count - 1) {
 				fprintf(stderr, ", ");
 			}
 		}
@@ -375,22 +421,22 @@ static KrkFunction * endCompiler() {
 		int i = 0;
 		for (; i < function->requiredArgs; ++i) {
 			fprintf(stderr, "%.*s%s",
-				(int)current->locals[i].name.length,
-				current->locals[i].name.start,
+				(int)state->current->locals[i].name.length,
+				state->current->locals[i].name.start,
 				(i == function->requiredArgs - 1) ? "" : ", ");
 		}
 		fprintf(stderr, "\nKeyword arguments: ");
 		for (; i < function->requiredArgs + function->keywordArgs; ++i) {
 			fprintf(stderr, "%.*s=None%s",
-				(int)current->locals[i].name.length,
-				current->locals[i].name.start,
+				(int)state->current->locals[i].name.length,
+				state->current->locals[i].name.start,
 				(i == function->keywordArgs - 1) ? "" : ", ");
 		}
 		fprintf(stderr, "\n");
 	}
 #endif
 
-	current = current->enclosing;
+	state->current = state->current->enclosing;
 	return function;
 }
 
@@ -399,14 +445,83 @@ static void freeCompiler(Compiler * compiler) {
 	FREE_ARRAY(Upvalue,compiler->upvalues, compiler->upvaluesSpace);
 	FREE_ARRAY(int,compiler->breaks, compiler->breakSpace);
 	FREE_ARRAY(int,compiler->continues, compiler->continueSpace);
+	FREE_ARRAY(ConstantEntry,compiler->constants, compiler->constantsSpace);
+}
+
+/* Values are only the same constant if they have the same type and the same bits,
+ * so 1, 1.0 and True stay apart, as do 0.0 and -0.0. Objects are compared by
+ * identity, which is equality for interned strings. */
+static int sameConstant(KrkValue a, KrkValue b) {
+	if (a.type != b.type) return 0;
+	switch (a.type) {
+		case VAL_NONE: return 1;
+		case VAL_BOOLEAN: return AS_BOOLEAN(a) == AS_BOOLEAN(b);
+		case VAL_INTEGER: return AS_INTEGER(a) == AS_INTEGER(b);
+		case VAL_FLOATING: return !memcmp(&AS_FLOATING(a), &AS_FLOATING(b), sizeof(double));
+		case VAL_OBJECT: return AS_OBJECT(a) == AS_OBJECT(b);
+		default: return 0;
+	}
+}
+
+static uint32_t hashConstant(KrkValue value) {
+	uint64_t bits = 0;
+	switch (value.type) {
+		case VAL_BOOLEAN: bits = AS_BOOLEAN(value); break;
+		case VAL_INTEGER: bits = (uint64_t)AS_INTEGER(value); break;
+		case VAL_FLOATING: memcpy(&bits, &AS_FLOATING(value), sizeof(double)); break;
+		case VAL_OBJECT: bits = (uintptr_t)AS_OBJECT(value); break;
+		default: break;
+	}
+	bits = (bits ^ (bits >> 31) ^ value.type) * 0x9E3779B97F4A7C15ULL;
+	return (uint32_t)(bits >> 32);
+}
+
+static ConstantEntry * findConstant(ConstantEntry * entries, size_t space, KrkValue value) {
+	for (size_t slot = hashConstant(value) & (space - 1);; slot = (slot + 1) & (space - 1)) {
+		if (!entries[slot].index || sameConstant(entries[slot].value, value)) return &entries[slot];
+	}
+}
+
+/**
+ * Add a constant to the current function's pool, or find the index of
+ * one that is already there. Only strings, numbers, booleans and None are
+ * shared; functions and other objects always get their own entry.
+ */
+static size_t addConstant(struct GlobalState * state, KrkValue value) {
+	if (!IS_NONE(value) && !IS_BOOLEAN(value) && !IS_INTEGER(value) && !IS_FLOATING(value) && !IS_STRING(value)) {
+		return krk_addConstant(currentChunk(state), value);
+	}
+	if (state->current->constantsCount + 1 > state->current->constantsSpace * 3 / 4) {
+		size_t old = state->current->constantsSpace;
+		size_t space = old < 8 ? 16 : old * 2;
+		krk_push(value);
+		ConstantEntry * entries = GROW_ARRAY(ConstantEntry, NULL, 0, space);
+		krk_pop();
+		memset(entries, 0, sizeof(ConstantEntry) * space);
+		for (size_t i = 0; i < old; ++i) {
+			if (state->current->constants[i].index) *findConstant(entries, space, state->current->constants[i].value) = state->current->constants[i];
+		}
+		FREE_ARRAY(ConstantEntry, state->current->constants, old);
+		state->current->constants = entries;
+		state->current->constantsSpace = space;
+	}
+	ConstantEntry * entry = findConstant(state->current->constants, state->current->constantsSpace, value);
+	if (!entry->index) {
+		entry->value = value;
+		entry->index = krk_addConstant(currentChunk(state), value) + 1;
+		state->current->constantsCount++;
+	}
+	return entry->index - 1;
 }
 
-static size_t emitConstant(KrkValue value) {
-	return krk_writeConstant(currentChunk(), value, parser.previous.line);
+static size_t emitConstant(struct GlobalState * state, KrkValue value) {
+	size_t ind = addConstant(state, value);
+	krk_emitConstant(currentChunk(state), ind, state->parser.previous.line);
+	return ind;
 }
 
-static void number(int canAssign) {
-	const char * start = parser.previous.start;
+static void number(struct GlobalState * state, int canAssign) {
+	const char * start = state->parser.previous.start;
 	int base = 10;
 
 	/*  These special cases for hexadecimal, binary, octal values. */
@@ -423,10 +538,10 @@ static void number(int canAssign) {
 
 	/* If it wasn't a special base, it may be a floating point value. */
 	if (base == 10) {
-		for (size_t j = 0; j < parser.previous.length; ++j) {
-			if (parser.previous.start[j] == '.') {
+		for (size_t j = 0; j < state->parser.previous.length; ++j) {
+			if (state->parser.previous.start[j] == '.') {
 				double value = strtod(start, NULL);
-				emitConstant(FLOATING_VAL(value));
+				emitConstant(state, FLOATING_VAL(value));
 				return;
 			}
 		}
@@ -434,70 +549,71 @@ static void number(int canAssign) {
 
 	/* If we got here, it's an integer of some sort. */
 	krk_integer_type value = parseStrInt(start, NULL, base);
-	emitConstant(INTEGER_VAL(value));
+	emitConstant(state, INTEGER_VAL(value));
 }
 
-static void binary(int canAssign) {
-	KrkTokenType operatorType = parser.previous.type;
+static void binary(struct GlobalState * state, int canAssign) {
+	KrkTokenType operatorType = state->parser.previous.type;
 	ParseRule * rule = getRule(operatorType);
-	parsePrecedence((Precedence)(rule->precedence + 1));
+	parsePrecedence(state, (Precedence)(rule->precedence + 1));
 
 	switch (operatorType) {
-		case TOKEN_BANG_EQUAL:    emitBytes(OP_EQUAL, OP_NOT); break;
-		case TOKEN_EQUAL_EQUAL:   emitByte(OP_EQUAL); break;
-		case TOKEN_GREATER:       emitByte(OP_GREATER); break;
-		case TOKEN_GREATER_EQUAL: emitBytes(OP_LESS, OP_NOT); break;
-		case TOKEN_LESS:          emitByte(OP_LESS); break;
-		case TOKEN_LESS_EQUAL:    emitBytes(OP_GREATER, OP_NOT); break;
-
-		case TOKEN_PIPE:        emitByte(OP_BITOR); break;
-		case TOKEN_CARET:       emitByte(OP_BITXOR); break;
-		case TOKEN_AMPERSAND:   emitByte(OP_BITAND); break;
-		case TOKEN_LEFT_SHIFT:  emitByte(OP_SHIFTLEFT); break;
-		case TOKEN_RIGHT_SHIFT: emitByte(OP_SHIFTRIGHT); break;
-
-		case TOKEN_PLUS:     emitByte(OP_ADD); break;
-		case TOKEN_MINUS:    emitByte(OP_SUBTRACT); break;
-		case TOKEN_ASTERISK: emitByte(OP_MULTIPLY); break;
-		case TOKEN_POW:      emitByte(OP_POW); break;
-		case TOKEN_SOLIDUS:  emitByte(OP_DIVIDE); break;
-		case TOKEN_MODULO:   emitByte(OP_MODULO); break;
-		case TOKEN_IN:       emitByte(OP_EQUAL); break;
+		case TOKEN_BANG_EQUAL:    emitBytes(state, OP_EQUAL, OP_NOT); break;
+		case TOKEN_EQUAL_EQUAL:   emitByte(state, OP_EQUAL); break;
+		case TOKEN_GREATER:       emitByte(state, OP_GREATER); break;
+		case TOKEN_GREATER_EQUAL: emitBytes(state, OP_LESS, OP_NOT); break;
+		case TOKEN_LESS:          emitByte(state, OP_LESS); break;
+		case TOKEN_LESS_EQUAL:    emitBytes(state, OP_GREATER, OP_NOT); break;
+
+		case TOKEN_PIPE:        emitByte(state, OP_BITOR); break;
+		case TOKEN_CARET:       emitByte(state, OP_BITXOR); break;
+		case TOKEN_AMPERSAND:   emitByte(state, OP_BITAND); break;
+		case TOKEN_LEFT_SHIFT:  emitByte(state, OP_SHIFTLEFT); break;
+		case TOKEN_RIGHT_SHIFT: emitByte(state, OP_SHIFTRIGHT); break;
+
+		case TOKEN_PLUS:     emitByte(state, OP_ADD); break;
+		case TOKEN_MINUS:    emitByte(state, OP_SUBTRACT); break;
+		case TOKEN_ASTERISK: emitByte(state, OP_MULTIPLY); break;
+		case TOKEN_POW:      emitByte(state, OP_POW); break;
+		case TOKEN_SOLIDUS:  emitByte(state, OP_DIVIDE); break;
+		case TOKEN_MODULO:   emitByte(state, OP_MODULO); break;
+		case TOKEN_IN:       emitByte(state, OP_EQUAL); break;
 		default: return;
 	}
 }
 
-static int matchAssignment(void) {
-	return (parser.current.type >= TOKEN_EQUAL && parser.current.type <= TOKEN_MODULO_EQUAL) ? (advance(), 1) : 0;
+static int matchAssignment(struct GlobalState * state) {
+	return (state->parser.current.type >= TOKEN_EQUAL && state->parser.current.type <= TOKEN_MODULO_EQUAL) ? (advance(state), 1) : 0;
 }
 
-static int matchEndOfDel(void) {
-	return check(TOKEN_COMMA) || check(TOKEN_EOL) || check(TOKEN_EOF) || check(TOKEN_SEMICOLON);
+static int matchEndOfDel(struct GlobalState * state) {
+	return check(state, TOKEN_COMMA) || check(state, TOKEN_EOL) || check(state, TOKEN_EOF) || check(state, TOKEN_SEMICOLON);
 }
 
-static void assignmentValue(void) {
-	KrkTokenType type = parser.previous.type;
+static void assignmentValue(struct GlobalState * state) {
+	KrkTokenType type = state->parser.previous.type;
 	if (type == TOKEN_PLUS_PLUS || type == TOKEN_MINUS_MINUS) {
-		emitConstant(INTEGER_VAL(1));
+		emitConstant(state, INTEGER_VAL(1));
 	} else {
-		expression();
+		expression(state);
 	}
 
+	/* Compound assignments let the target update itself in place (__iadd__ etc.) */
 	switch (type) {
-		case TOKEN_PIPE_EQUAL:      emitByte(OP_BITOR); break;
-		case TOKEN_CARET_EQUAL:     emitByte(OP_BITXOR); break;
-		case TOKEN_AMP_EQUAL:       emitByte(OP_BITAND); break;
-		case TOKEN_LSHIFT_EQUAL:    emitByte(OP_SHIFTLEFT); break;
-		case TOKEN_RSHIFT_EQUAL:    emitByte(OP_SHIFTRIGHT); break;
-
-		case TOKEN_PLUS_EQUAL:      emitByte(OP_ADD); break;
-		case TOKEN_PLUS_PLUS:       emitByte(OP_ADD); break;
-		case TOKEN_MINUS_EQUAL:     emitByte(OP_SUBTRACT); break;
-		case TOKEN_MINUS_MINUS:     emitByte(OP_SUBTRACT); break;
-		case TOKEN_ASTERISK_EQUAL:  emitByte(OP_MULTIPLY); break;
-		case TOKEN_POW_EQUAL:       emitByte(OP_POW); break;
-		case TOKEN_SOLIDUS_EQUAL:   emitByte(OP_DIVIDE); break;
-		case TOKEN_MODULO_EQUAL:    emitByte(OP_MODULO); break;
+		case TOKEN_PIPE_EQUAL:      emitByte(state, OP_INPLACE_BITOR); break;
+		case TOKEN_CARET_EQUAL:     emitByte(state, OP_INPLACE_BITXOR); break;
+		case TOKEN_AMP_EQUAL:       emitByte(state, OP_INPLACE_BITAND); break;
+		case TOKEN_LSHIFT_EQUAL:    emitByte(state, OP_INPLACE_SHIFTLEFT); break;
+		case TOKEN_RSHIFT_EQUAL:    emitByte(state, OP_INPLACE_SHIFTRIGHT); break;
+
+		case TOKEN_PLUS_EQUAL:      emitByte(state, OP_INPLACE_ADD); break;
+		case TOKEN_PLUS_PLUS:       emitByte(state, OP_ADD); break;
+		case TOKEN_MINUS_EQUAL:     emitByte(state, OP_INPLACE_SUBTRACT); break;
+		case TOKEN_MINUS_MINUS:     emitByte(state, OP_SUBTRACT); break;
+		case TOKEN_ASTERISK_EQUAL:  emitByte(state, OP_INPLACE_MULTIPLY); break;
+		case TOKEN_POW_EQUAL:       emitByte(state, OP_INPLACE_POW); break;
+		case TOKEN_SOLIDUS_EQUAL:   emitByte(state, OP_INPLACE_DIVIDE); break;
+		case TOKEN_MODULO_EQUAL:    emitByte(state, OP_INPLACE_MODULO); break;
 
 		default:
 			error("Unexpected operand in assignment");
@@ -505,69 +621,69 @@ static void assignmentValue(void) {
 	}
 }
 
-static void get_(int canAssign) {
+static void get_(struct GlobalState * state, int canAssign) {
 	int isSlice = 0;
-	if (match(TOKEN_COLON)) {
-		emitByte(OP_NONE);
+	if (match(state, TOKEN_COLON)) {
+		emitByte(state, OP_NONE);
 		isSlice = 1;
 	} else {
-		expression();
+		expression(state);
 	}
-	if (isSlice || match(TOKEN_COLON)) {
-		if (isSlice && match(TOKEN_COLON)) {
+	if (isSlice || match(state, TOKEN_COLON)) {
+		if (isSlice && match(state, TOKEN_COLON)) {
 			error("Step value not supported in slice.");
 			return;
 		}
-		if (match(TOKEN_RIGHT_SQUARE)) {
-			emitByte(OP_NONE);
+		if (match(state, TOKEN_RIGHT_SQUARE)) {
+			emitByte(state, OP_NONE);
 		} else {
-			expression();
-			consume(TOKEN_RIGHT_SQUARE, "Expected ending square bracket after slice.");
+			expression(state);
+			consume(state, TOKEN_RIGHT_SQUARE, "Expected ending square bracket after slice.");
 		}
-		if (canAssign && match(TOKEN_EQUAL)) {
-			expression();
-			emitByte(OP_INVOKE_SETSLICE);
-		} else if (canAssign && matchAssignment()) {
+		if (canAssign && match(state, TOKEN_EQUAL)) {
+			expression(state);
+			emitByte(state, OP_INVOKE_SETSLICE);
+		} else if (canAssign && matchAssignment(state)) {
 			/* o s e */
-			emitBytes(OP_DUP, 2); /* o s e o */
-			emitBytes(OP_DUP, 2); /* o s e o s */
-			emitBytes(OP_DUP, 2); /* o s e o s e */
-			emitByte(OP_INVOKE_GETSLICE); /* o s e v */
-			assignmentValue();
-			emitByte(OP_INVOKE_SETSLICE);
-		} else if (inDel && matchEndOfDel()) {
-			emitByte(OP_INVOKE_DELSLICE);
-			inDel = 2;
+			emitBytes(state, OP_DUP, 2); /* o s e o */
+			emitBytes(state, OP_DUP, 2); /* o s e o s */
+			emitBytes(state, OP_DUP, 2); /* o s e o s e */
+			emitByte(state, OP_INVOKE_GETSLICE); /* o s e v */
+			assignmentValue(state);
+			emitByte(state, OP_INVOKE_SETSLICE);
+		} else if (state->inDel && matchEndOfDel(state)) {
+			emitByte(state, OP_INVOKE_DELSLICE);
+			state->inDel = 2;
 		} else {
-			emitByte(OP_INVOKE_GETSLICE);
+			emitByte(state, OP_INVOKE_GETSLICE);
 		}
 	} else {
-		consume(TOKEN_RIGHT_SQUARE, "Expected ending square bracket after index.");
-		if (canAssign && match(TOKEN_EQUAL)) {
-			expression();
-			emitByte(OP_INVOKE_SETTER);
-		} else if (canAssign && matchAssignment()) {
-			emitBytes(OP_DUP, 1); /* o e o */
-			emitBytes(OP_DUP, 1); /* o e o e */
-			emitByte(OP_INVOKE_GETTER); /* o e v */
-			assignmentValue(); /* o e v a */
-			emitByte(OP_INVOKE_SETTER); /* r */
-		} else if (inDel && matchEndOfDel()) {
-			if (!canAssign || inDel != 1) {
+		consume(state, TOKEN_RIGHT_SQUARE, "Expected ending square bracket after index.");
+		if (canAssign && match(state, TOKEN_EQUAL)) {
+			expression(state);
+			emitByte(state, OP_INVOKE_SETTER);
+		} else if (canAssign && matchAssignment(state)) {
+			emitBytes(state, OP_DUP, 1); /* o e o */
+			emitBytes(state, OP_DUP, 1); /* o e o e */
+			emitByte(state, OP_INVOKE_GETTER); /* o e v */
+			assignmentValue(state); /* o e v a */
+			emitByte(state, OP_INVOKE_SETTER); /* r */
+		} else if (state->inDel && matchEndOfDel(state)) {
+			if (!canAssign || state->inDel != 1) {
 				error("Invalid del target");
 			} else if (canAssign) {
-				emitByte(OP_INVOKE_DELETE);
-				inDel = 2;
+				emitByte(state, OP_INVOKE_DELETE);
+				state->inDel = 2;
 			}
 		} else {
-			emitByte(OP_INVOKE_GETTER);
+			emitByte(state, OP_INVOKE_GETTER);
 		}
 	}
 }
 
-static void dot(int canAssign) {
-	if (match(TOKEN_LEFT_PAREN)) {
-		startEatingWhitespace();
+static void dot(struct GlobalState * state, int canAssign) {
+	if (match(state, TOKEN_LEFT_PAREN)) {
+		startEatingWhitespace(state);
 		size_t argCount = 0;
 		size_t argSpace = 1;
 		ssize_t * args  = GROW_ARRAY(ssize_t,NULL,0,1);
@@ -578,20 +694,20 @@ static void dot(int canAssign) {
 				argSpace = GROW_CAPACITY(old);
 				args = GROW_ARRAY(ssize_t,args,old,argSpace);
 			}
-			consume(TOKEN_IDENTIFIER, "Expected attribute name");
-			size_t ind = identifierConstant(&parser.previous);
+			consume(state, TOKEN_IDENTIFIER, "Expected attribute name");
+			size_t ind = identifierConstant(state, &state->parser.previous);
 			args[argCount++] = ind;
-		} while (match(TOKEN_COMMA));
+		} while (match(state, TOKEN_COMMA));
 
-		stopEatingWhitespace();
-		consume(TOKEN_RIGHT_PAREN, "Expected ) after attribute list");
+		stopEatingWhitespace(state);
+		consume(state, TOKEN_RIGHT_PAREN, "Expected ) after attribute list");
 
-		if (canAssign && match(TOKEN_EQUAL)) {
+		if (canAssign && match(state, TOKEN_EQUAL)) {
 			size_t expressionCount = 0;
 			do {
 				expressionCount++;
-				expression();
-			} while (match(TOKEN_COMMA));
+				expression(state);
+			} while (match(state, TOKEN_COMMA));
 
 			if (expressionCount == 1 && argCount > 1) {
 				EMIT_CONSTANT_OP(OP_UNPACK, argCount);
@@ -604,86 +720,86 @@ static void dot(int canAssign) {
 
 			for (size_t i = argCount; i > 0; i--) {
 				if (i != 1) {
-					emitBytes(OP_DUP, i);
-					emitByte(OP_SWAP);
+					emitBytes(state, OP_DUP, i);
+					emitByte(state, OP_SWAP);
 				}
 				EMIT_CONSTANT_OP(OP_SET_PROPERTY, args[i-1]);
 				if (i != 1) {
-					emitByte(OP_POP);
+					emitByte(state, OP_POP);
 				}
 			}
 		} else {
 			for (size_t i = 0; i < argCount; i++) {
-				emitBytes(OP_DUP,0);
+				emitBytes(state, OP_DUP,0);
 				EMIT_CONSTANT_OP(OP_GET_PROPERTY,args[i]);
-				emitByte(OP_SWAP);
+				emitByte(state, OP_SWAP);
 			}
-			emitByte(OP_POP);
-			emitBytes(OP_TUPLE,argCount);
+			emitByte(state, OP_POP);
+			emitBytes(state, OP_TUPLE,argCount);
 		}
 
 _dotDone:
 		FREE_ARRAY(ssize_t,args,argSpace);
 		return;
 	}
-	consume(TOKEN_IDENTIFIER, "Expected property name");
-	size_t ind = identifierConstant(&parser.previous);
-	if (canAssign && match(TOKEN_EQUAL)) {
-		expression();
+	consume(state, TOKEN_IDENTIFIER, "Expected property name");
+	size_t ind = identifierConstant(state, &state->parser.previous);
+	if (canAssign && match(state, TOKEN_EQUAL)) {
+		expression(state);
 		EMIT_CONSTANT_OP(OP_SET_PROPERTY, ind);
-	} else if (canAssign && matchAssignment()) {
-		emitBytes(OP_DUP, 0); /* Duplicate the object */
+	} else if (canAssign && matchAssignment(state)) {
+		emitBytes(state, OP_DUP, 0); /* Duplicate the object */
 		EMIT_CONSTANT_OP(OP_GET_PROPERTY, ind);
-		assignmentValue();
+		assignmentValue(state);
 		EMIT_CONSTANT_OP(OP_SET_PROPERTY, ind);
-	} else if (inDel && matchEndOfDel()) {
-		if (!canAssign || inDel != 1) {
+	} else if (state->inDel && matchEndOfDel(state)) {
+		if (!canAssign || state->inDel != 1) {
 			error("Invalid del target");
 		} else {
 			EMIT_CONSTANT_OP(OP_DEL_PROPERTY, ind);
-			inDel = 2;
+			state->inDel = 2;
 		}
 	} else {
 		EMIT_CONSTANT_OP(OP_GET_PROPERTY, ind);
 	}
 }
 
-static void in_(int canAssign) {
-	parsePrecedence(PREC_COMPARISON);
+static void in_(struct GlobalState * state, int canAssign) {
+	parsePrecedence(state, PREC_COMPARISON);
 	KrkToken contains = syntheticToken("__contains__");
-	ssize_t ind = identifierConstant(&contains);
+	ssize_t ind = identifierConstant(state, &contains);
 	EMIT_CONSTANT_OP(OP_GET_PROPERTY, ind);
-	emitByte(OP_SWAP);
-	emitBytes(OP_CALL,1);
+	emitByte(state, OP_SWAP);
+	emitBytes(state, OP_CALL,1);
 }
 
-static void not_(int canAssign) {
-	consume(TOKEN_IN, "infix not must be followed by in\n");
-	in_(canAssign);
-	emitByte(OP_NOT);
+static void not_(struct GlobalState * state, int canAssign) {
+	consume(state, TOKEN_IN, "infix not must be followed by in\n");
+	in_(state, canAssign);
+	emitByte(state, OP_NOT);
 }
 
-static void is_(int canAssign) {
-	int invert = match(TOKEN_NOT);
-	parsePrecedence(PREC_COMPARISON);
-	emitByte(OP_IS);
-	if (invert) emitByte(OP_NOT);
+static void is_(struct GlobalState * state, int canAssign) {
+	int invert = match(state, TOKEN_NOT);
+	parsePrecedence(state, PREC_COMPARISON);
+	emitByte(state, OP_IS);
+	if (invert) emitByte(state, OP_NOT);
 }
 
-static void literal(int canAssign) {
-	switch (parser.previous.type) {
-		case TOKEN_FALSE: emitByte(OP_FALSE); break;
-		case TOKEN_NONE:  emitByte(OP_NONE); break;
-		case TOKEN_TRUE:  emitByte(OP_TRUE); break;
+static void literal(struct GlobalState * state, int canAssign) {
+	switch (state->parser.previous.type) {
+		case TOKEN_FALSE: emitByte(state, OP_FALSE); break;
+		case TOKEN_NONE:  emitByte(state, OP_NONE); break;
+		case TOKEN_TRUE:  emitByte(state, OP_TRUE); break;
 		default: return;
 	}
 }
 
-static void expression() {
-	parsePrecedence(PREC_ASSIGNMENT);
+static void expression(struct GlobalState * state) {
+	parsePrecedence(state, PREC_ASSIGNMENT);
 }
 
-static void letDeclaration(void) {
+static void letDeclaration(struct GlobalState * state) {
 	size_t argCount = 0;
 	size_t argSpace = 1;
 	ssize_t * args  = GROW_ARRAY(ssize_t,NULL,0,1);
@@ -694,21 +810,21 @@ static void letDeclaration(void) {
 			argSpace = GROW_CAPACITY(old);
 			args = GROW_ARRAY(ssize_t,args,old,argSpace);
 		}
-		ssize_t ind = parseVariable("Expected variable name.");
-		if (current->scopeDepth > 0) {
+		ssize_t ind = parseVariable(state, "Expected variable name.");
+		if (state->current->scopeDepth > 0) {
 			/* Need locals space */
-			args[argCount++] = current->localCount - 1;
+			args[argCount++] = state->current->localCount - 1;
 		} else {
 			args[argCount++] = ind;
 		}
-	} while (match(TOKEN_COMMA));
+	} while (match(state, TOKEN_COMMA));
 
-	if (match(TOKEN_EQUAL)) {
+	if (match(state, TOKEN_EQUAL)) {
 		size_t expressionCount = 0;
 		do {
 			expressionCount++;
-			expression();
-		} while (match(TOKEN_COMMA));
+			expression(state);
+		} while (match(state, TOKEN_COMMA));
 		if (expressionCount == 1 && argCount > 1) {
 			EMIT_CONSTANT_OP(OP_UNPACK, argCount);
 		} else if (expressionCount == argCount) {
@@ -722,22 +838,22 @@ static void letDeclaration(void) {
 	} else {
 		/* Need to nil it */
 		for (size_t i = 0; i < argCount; ++i) {
-			emitByte(OP_NONE);
+			emitByte(state, OP_NONE);
 		}
 	}
 
-	if (current->scopeDepth == 0) {
+	if (state->current->scopeDepth == 0) {
 		for (size_t i = argCount; i > 0; i--) {
-			defineVariable(args[i-1]);
+			defineVariable(state, args[i-1]);
 		}
 	} else {
 		for (size_t i = 0; i < argCount; i++) {
-			current->locals[current->localCount - 1 - i].depth = current->scopeDepth;
+			state->current->locals[state->current->localCount - 1 - i].depth = state->current->scopeDepth;
 		}
 	}
 
 _letDone:
-	if (!match(TOKEN_EOL) && !match(TOKEN_EOF)) {
+	if (!match(state, TOKEN_EOL) && !match(state, TOKEN_EOF)) {
 		error("Expected end of line after 'let' statement.");
 	}
 
@@ -745,11 +861,11 @@ _letDone:
 	return;
 }
 
-static void synchronize() {
-	while (parser.current.type != TOKEN_EOF) {
-		if (parser.previous.type == TOKEN_EOL) return;
+static void synchronize(struct GlobalState * state) {
+	while (state->parser.current.type != TOKEN_EOF) {
+		if (state->parser.previous.type == TOKEN_EOL) return;
 
-		switch (parser.current.type) {
+		switch (state->parser.current.type) {
 			case TOKEN_CLASS:
 			case TOKEN_DEF:
 			case TOKEN_LET:
@@ -761,196 +877,199 @@ static void synchronize() {
 			default: break;
 		}
 
-		advance();
+		advance(state);
 	}
 }
 
-static void declaration() {
-	if (check(TOKEN_DEF)) {
-		defDeclaration();
-	} else if (match(TOKEN_LET)) {
-		letDeclaration();
-	} else if (check(TOKEN_CLASS)) {
-		KrkToken className = classDeclaration();
-		size_t classConst = identifierConstant(&className);
-		parser.previous = className;
-		declareVariable();
-		defineVariable(classConst);
-	} else if (check(TOKEN_AT)) {
-		decorator(0, TYPE_FUNCTION);
-	} else if (match(TOKEN_EOL) || match(TOKEN_EOF)) {
+static void declaration(struct GlobalState * state) {
+	if (check(state, TOKEN_DEF)) {
+		defDeclaration(state);
+	} else if (match(state, TOKEN_LET)) {
+		letDeclaration(state);
+	} else if (check(state, TOKEN_CLASS)) {
+		KrkToken className = classDeclaration(state);
+		size_t classConst = identifierConstant(state, &className);
+		state->parser.previous = className;
+		declareVariable(state);
+		defineVariable(state, classConst);
+	} else if (check(state, TOKEN_AT)) {
+		decorator(state, 0, TYPE_FUNCTION);
+	} else if (match(state, TOKEN_EOL) || match(state, TOKEN_EOF)) {
 		return;
-	} else if (check(TOKEN_INDENTATION)) {
+	} else if (check(state, TOKEN_INDENTATION)) {
 		return;
 	} else {
-		statement();
+		statement(state);
 	}
 
-	if (parser.panicMode) synchronize();
+	if (state->parser.panicMode) synchronize(state);
 }
 
-static void expressionStatement() {
-	expression();
-	emitByte(OP_POP);
+static void expressionStatement(struct GlobalState * state) {
+	expression(state);
+	emitByte(state, OP_POP);
 }
 
-static void beginScope() {
-	current->scopeDepth++;
+static void beginScope(struct GlobalState * state) {
+	state->current->scopeDepth++;
 }
 
-static void endScope() {
-	current->scopeDepth--;
-	while (current->localCount > 0 &&
-	       current->locals[current->localCount - 1].depth > (ssize_t)current->scopeDepth) {
-		for (size_t i = 0; i < current->function->localNameCount; i++) {
-			if (current->function->localNames[i].id == current->localCount - 1) {
-				current->function->localNames[i].deathday = (size_t)currentChunk()->count;
+static void endScope(struct GlobalState * state) {
+	state->current->scopeDepth--;
+	while (state->current->localCount > 0 &&
+	       state->current->locals[state->current->localCount - 1].depth > (ssize_t)state->current->scopeDepth) {
+		for (size_t i = 0; i < state->current->function->localNameCount; i++) {
+			if (state->current->function->localNames[i].id == state->current->localCount - 1) {
+				state->current->function->localNames[i].deathday = (size_t)currentChunk(state)->count;
 			}
 		}
-		if (current->locals[current->localCount - 1].isCaptured) {
-			emitByte(OP_CLOSE_UPVALUE);
+		if (state->current->locals[state->current->localCount - 1].isCaptured) {
+			emitByte(state, OP_CLOSE_UPVALUE);
 		} else {
-			emitByte(OP_POP);
+			emitByte(state, OP_POP);
 		}
-		current->localCount--;
+		state->current->localCount--;
 	}
 }
 
-static int emitJump(uint8_t opcode) {
-	emitByte(opcode);
-	emitBytes(0xFF, 0xFF);
-	return currentChunk()->count - 2;
+static int emitJump(struct GlobalState * state, uint8_t opcode) {
+	emitByte(state, opcode);
+	emitBytes(state, 0xFF, 0xFF);
+	return currentChunk(state)->count - 2;
 }
 
-static void patchJump(int offset) {
-	int jump = currentChunk()->count - offset - 2;
+static void patchJump(struct GlobalState * state, int offset) {
+	int jump = currentChunk(state)->count - offset - 2;
 	if (jump > 0xFFFF) {
 		error("Unsupported far jump (we'll get there)");
 	}
 
-	currentChunk()->code[offset] = (jump >> 8) & 0xFF;
-	currentChunk()->code[offset + 1] =  (jump) & 0xFF;
+	currentChunk(state)->code[offset] = (jump >> 8) & 0xFF;
+	currentChunk(state)->code[offset + 1] =  (jump) & 0xFF;
 }
 
-static void block(size_t indentation, const char * blockName) {
-	if (match(TOKEN_EOL)) {
-		if (check(TOKEN_INDENTATION)) {
-			size_t currentIndentation = parser.current.length;
+static void block(struct GlobalState * state, size_t indentation, const char * blockName) {
+	if (match(state, TOKEN_EOL)) {
+		if (check(state, TOKEN_INDENTATION)) {
+			size_t currentIndentation = state->parser.current.length;
 			if (currentIndentation <= indentation) return;
-			advance();
-			if (!strcmp(blockName,"def") && (match(TOKEN_STRING) || match(TOKEN_BIG_STRING))) {
-				size_t before = currentChunk()->count;
-				string(parser.previous.type == TOKEN_BIG_STRING);
+			advance(state);
+			if (!strcmp(blockName,"def") && (match(state, TOKEN_STRING) || match(state, TOKEN_BIG_STRING))) {
+				size_t before = currentChunk(state)->count;
+				ssize_t ind = stringLiteral(state, state->parser.previous.type == TOKEN_BIG_STRING);
 				/* That wrote to the chunk, rewind it; this should only ever go back two bytes
 				 * because this should only happen as the first thing in a function definition,
 				 * and thus this _should_ be the first constant and thus opcode + one-byte operand
 				 * to OP_CONSTANT, but just to be safe we'll actually use the previous offset... */
-				currentChunk()->count = before;
-				/* Retreive the docstring from the constant table */
-				current->function->docstring = AS_STRING(currentChunk()->constants.values[currentChunk()->constants.count-1]);
-				consume(TOKEN_EOL,"Garbage after docstring defintion");
-				if (!check(TOKEN_INDENTATION) || parser.current.length != currentIndentation) {
+				rewindChunk(state, before);
+				/* Retreive the docstring from the constant table; it may share a slot with
+				 * an earlier literal, so it isn't necessarily the last one. */
+				if (ind >= 0 && IS_STRING(currentChunk(state)->constants.values[ind])) {
+					state->current->function->docstring = AS_STRING(currentChunk(state)->constants.values[ind]);
+				}
+				consume(state, TOKEN_EOL,"Garbage after docstring defintion");
+				if (!check(state, TOKEN_INDENTATION) || state->parser.current.length != currentIndentation) {
 					error("Expected at least one statement in function with docstring.");
 				}
-				advance();
+				advance(state);
 			}
-			declaration();
-			while (check(TOKEN_INDENTATION)) {
-				if (parser.current.length < currentIndentation) break;
-				advance();
-				declaration();
-				if (check(TOKEN_EOL)) {
-					advance();
+			declaration(state);
+			while (check(state, TOKEN_INDENTATION)) {
+				if (state->parser.current.length < currentIndentation) break;
+				advance(state);
+				declaration(state);
+				if (check(state, TOKEN_EOL)) {
+					advance(state);
 				}
 			};
 #ifdef ENABLE_SCAN_TRACING
 			if (krk_currentThread.flags & KRK_ENABLE_SCAN_TRACING) {
 				fprintf(stderr, "\n\nfinished with block %s (ind=%d) on line %d, sitting on a %s (len=%d)\n\n",
-					blockName, (int)indentation, (int)parser.current.line,
-					getRule(parser.current.type)->name, (int)parser.current.length);
+					blockName, (int)indentation, (int)state->parser.current.line,
+					getRule(state->parser.current.type)->name, (int)state->parser.current.length);
 			}
 #endif
 		}
 	} else {
-		statement();
+		statement(state);
 	}
 }
 
-static void doUpvalues(Compiler * compiler, KrkFunction * function) {
+static void doUpvalues(struct GlobalState * state, Compiler * compiler, KrkFunction * function) {
 	assert(!!function->upvalueCount == !!compiler->upvalues);
 	for (size_t i = 0; i < function->upvalueCount; ++i) {
-		emitByte(compiler->upvalues[i].isLocal ? 1 : 0);
+		emitByte(state, compiler->upvalues[i].isLocal ? 1 : 0);
 		if (i > 255) {
-			emitByte((compiler->upvalues[i].index >> 16) & 0xFF);
-			emitByte((compiler->upvalues[i].index >> 8) & 0xFF);
+			emitByte(state, (compiler->upvalues[i].index >> 16) & 0xFF);
+			emitByte(state, (compiler->upvalues[i].index >> 8) & 0xFF);
 		}
-		emitByte((compiler->upvalues[i].index) & 0xFF);
+		emitByte(state, (compiler->upvalues[i].index) & 0xFF);
 	}
 }
 
-static void function(FunctionType type, size_t blockWidth) {
+static void function(struct GlobalState * state, FunctionType type, size_t blockWidth) {
 	Compiler compiler;
-	initCompiler(&compiler, type);
+	initCompiler(state, &compiler, type);
 	compiler.function->chunk.filename = compiler.enclosing->function->chunk.filename;
 
-	beginScope();
+	beginScope(state);
 
-	if (isMethod(type)) current->function->requiredArgs = 1;
+	if (isMethod(type)) state->current->function->requiredArgs = 1;
 
 	int hasCollectors = 0;
 
-	consume(TOKEN_LEFT_PAREN, "Expected start of parameter list after function name.");
-	startEatingWhitespace();
-	if (!check(TOKEN_RIGHT_PAREN)) {
+	consume(state, TOKEN_LEFT_PAREN, "Expected start of parameter list after function name.");
+	startEatingWhitespace(state);
+	if (!check(state, TOKEN_RIGHT_PAREN)) {
 		do {
-			if (match(TOKEN_SELF)) {
+			if (match(state, TOKEN_SELF)) {
 				if (!isMethod(type)) {
 					error("Invalid use of `self` as a function paramenter.");
 				}
 				continue;
 			}
-			if (match(TOKEN_ASTERISK) || check(TOKEN_POW)) {
-				if (match(TOKEN_POW)) {
+			if (match(state, TOKEN_ASTERISK) || check(state, TOKEN_POW)) {
+				if (match(state, TOKEN_POW)) {
 					if (hasCollectors == 2) {
 						error("Duplicate ** in parameter list.");
 						return;
 					}
 					hasCollectors = 2;
-					current->function->collectsKeywords = 1;
+					state->current->function->collectsKeywords = 1;
 				} else {
 					if (hasCollectors) {
 						error("Syntax error.");
 						return;
 					}
 					hasCollectors = 1;
-					current->function->collectsArguments = 1;
+					state->current->function->collectsArguments = 1;
 				}
 				/* Collect a name, specifically "args" or "kwargs" are commont */
-				ssize_t paramConstant = parseVariable("Expect parameter name.");
-				defineVariable(paramConstant);
+				ssize_t paramConstant = parseVariable(state, "Expect parameter name.");
+				defineVariable(state, paramConstant);
 				/* Make that a valid local for this function */
-				size_t myLocal = current->localCount - 1;
+				size_t myLocal = state->current->localCount - 1;
 				EMIT_CONSTANT_OP(OP_GET_LOCAL, myLocal);
 				/* Check if it's equal to the unset-kwarg-sentinel value */
-				emitConstant(KWARGS_VAL(0));
-				emitByte(OP_IS);
-				int jumpIndex = emitJump(OP_JUMP_IF_FALSE);
+				emitConstant(state, KWARGS_VAL(0));
+				emitByte(state, OP_IS);
+				int jumpIndex = emitJump(state, OP_JUMP_IF_FALSE);
 				/* And if it is, set it to the appropriate type */
-				beginScope();
+				beginScope(state);
 				KrkToken synth = syntheticToken(hasCollectors == 1 ? "listOf" : "dictOf");
-				namedVariable(synth, 0);
-				emitBytes(OP_CALL, 0);
+				namedVariable(state, synth, 0);
+				emitBytes(state, OP_CALL, 0);
 				EMIT_CONSTANT_OP(OP_SET_LOCAL, myLocal);
-				emitByte(OP_POP); /* local value */
-				endScope();
+				emitByte(state, OP_POP); /* local value */
+				endScope(state);
 				/* Otherwise pop the comparison. */
-				patchJump(jumpIndex);
-				emitByte(OP_POP); /* comparison value */
+				patchJump(state, jumpIndex);
+				emitByte(state, OP_POP); /* comparison value */
 				continue;
 			}
-			ssize_t paramConstant = parseVariable("Expect parameter name.");
-			defineVariable(paramConstant);
-			if (match(TOKEN_EQUAL)) {
+			ssize_t paramConstant = parseVariable(state, "Expect parameter name.");
+			defineVariable(state, paramConstant);
+			if (match(state, TOKEN_EQUAL)) {
 				/*
 				 * We inline default arguments by checking if they are equal
 				 * to a sentinel value and replacing them with the requested
@@ -960,41 +1079,41 @@ static void function(FunctionType type, size_t blockWidth) {
 				 * if param == KWARGS_SENTINEL:
 				 *     param = EXPRESSION
 				 */
-				size_t myLocal = current->localCount - 1;
+				size_t myLocal = state->current->localCount - 1;
 				EMIT_CONSTANT_OP(OP_GET_LOCAL, myLocal);
-				emitConstant(KWARGS_VAL(0));
-				emitByte(OP_EQUAL);
-				int jumpIndex = emitJump(OP_JUMP_IF_FALSE);
-				beginScope();
-				expression(); /* Read expression */
+				emitConstant(state, KWARGS_VAL(0));
+				emitByte(state, OP_EQUAL);
+				int jumpIndex = emitJump(state, OP_JUMP_IF_FALSE);
+				beginScope(state);
+				expression(state); /* Read expression */
 				EMIT_CONSTANT_OP(OP_SET_LOCAL, myLocal);
-				emitByte(OP_POP); /* local value */
-				endScope();
-				patchJump(jumpIndex);
-				emitByte(OP_POP);
-				current->function->keywordArgs++;
+				emitByte(state, OP_POP); /* local value */
+				endScope(state);
+				patchJump(state, jumpIndex);
+				emitByte(state, OP_POP);
+				state->current->function->keywordArgs++;
 			} else {
-				current->function->requiredArgs++;
+				state->current->function->requiredArgs++;
 			}
-		} while (match(TOKEN_COMMA));
+		} while (match(state, TOKEN_COMMA));
 	}
-	stopEatingWhitespace();
-	consume(TOKEN_RIGHT_PAREN, "Expected end of parameter list.");
+	stopEatingWhitespace(state);
+	consume(state, TOKEN_RIGHT_PAREN, "Expected end of parameter list.");
 
-	consume(TOKEN_COLON, "Expected colon after function signature.");
-	block(blockWidth,"def");
+	consume(state, TOKEN_COLON, "Expected colon after function signature.");
+	block(state, blockWidth,"def");
 
-	KrkFunction * function = endCompiler();
-	size_t ind = krk_addConstant(currentChunk(), OBJECT_VAL(function));
+	KrkFunction * function = endCompiler(state);
+	size_t ind = krk_addConstant(currentChunk(state), OBJECT_VAL(function));
 	EMIT_CONSTANT_OP(OP_CLOSURE, ind);
-	doUpvalues(&compiler, function);
+	doUpvalues(state, &compiler, function);
 	freeCompiler(&compiler);
 }
 
-static void method(size_t blockWidth) {
+static void method(struct GlobalState * state, size_t blockWidth) {
 	/* This is actually "inside of a class definition", and that might mean
 	 * arbitrary blank lines we need to accept... Sorry. */
-	if (match(TOKEN_EOL)) {
+	if (match(state, TOKEN_EOL)) {
 		return;
 	}
 
@@ -1002,172 +1121,190 @@ static void method(size_t blockWidth) {
 	 * going to assign `self` because Lox always assigns `this`; it should not
 	 * show up in the initializer list; I may add support for it being there
 	 * as a redundant thing, just to make more Python stuff work with changes. */
-	if (check(TOKEN_AT)) {
-		decorator(0, TYPE_METHOD);
-	} else if (match(TOKEN_IDENTIFIER)) {
-		emitBytes(OP_DUP, 0); /* SET_PROPERTY will pop class */
-		size_t ind = identifierConstant(&parser.previous);
-		consume(TOKEN_EQUAL, "Class field must have value.");
-		expression();
+	if (check(state, TOKEN_AT)) {
+		decorator(state, 0, TYPE_METHOD);
+	} else if (match(state, TOKEN_IDENTIFIER)) {
+		emitBytes(state, OP_DUP, 0); /* SET_PROPERTY will pop class */
+		size_t ind = identifierConstant(state, &state->parser.previous);
+		consume(state, TOKEN_EQUAL, "Class field must have value.");
+		expression(state);
 		EMIT_CONSTANT_OP(OP_SET_PROPERTY, ind);
-		emitByte(OP_POP); /* Value of expression replaces dup of class*/
-		if (!match(TOKEN_EOL) && !match(TOKEN_EOF)) {
+		emitByte(state, OP_POP); /* Value of expression replaces dup of class*/
+		if (!match(state, TOKEN_EOL) && !match(state, TOKEN_EOF)) {
 			errorAtCurrent("Expected end of line after class attribut declaration");
 		}
-	} else if (match(TOKEN_PASS)) {
+	} else if (match(state, TOKEN_PASS)) {
 		/* bah */
-		consume(TOKEN_EOL, "Expected linefeed after 'pass' in class body.");
+		consume(state, TOKEN_EOL, "Expected linefeed after 'pass' in class body.");
 	} else {
-		consume(TOKEN_DEF, "expected a definition, got nothing");
-		consume(TOKEN_IDENTIFIER, "expected method name");
-		size_t ind = identifierConstant(&parser.previous);
+		consume(state, TOKEN_DEF, "expected a definition, got nothing");
+		consume(state, TOKEN_IDENTIFIER, "expected method name");
+		size_t ind = identifierConstant(state, &state->parser.previous);
 		FunctionType type = TYPE_METHOD;
 
-		if (parser.previous.length == 8 && memcmp(parser.previous.start, "__init__", 8) == 0) {
+		if (state->parser.previous.length == 8 && memcmp(state->parser.previous.start, "__init__", 8) == 0) {
 			type = TYPE_INIT;
 		}
 
-		function(type, blockWidth);
+		function(state, type, blockWidth);
 		EMIT_CONSTANT_OP(OP_METHOD, ind);
 	}
 }
 
-static KrkToken classDeclaration() {
-	size_t blockWidth = (parser.previous.type == TOKEN_INDENTATION) ? parser.previous.length : 0;
-	advance(); /* Collect the `class` */
+static KrkToken classDeclaration(struct GlobalState * state) {
+	size_t blockWidth = (state->parser.previous.type == TOKEN_INDENTATION) ? state->parser.previous.length : 0;
+	advance(state); /* Collect the `class` */
 
-	consume(TOKEN_IDENTIFIER, "Expected class name.");
+	consume(state, TOKEN_IDENTIFIER, "Expected class name.");
 	Compiler subcompiler;
-	initCompiler(&subcompiler, TYPE_LAMBDA);
+	initCompiler(state, &subcompiler, TYPE_LAMBDA);
 	subcompiler.function->chunk.filename = subcompiler.enclosing->function->chunk.filename;
 
-	beginScope();
+	beginScope(state);
 
-	KrkToken className = parser.previous;
-	size_t constInd = identifierConstant(&parser.previous);
-	declareVariable();
+	KrkToken className = state->parser.previous;
+	size_t constInd = identifierConstant(state, &state->parser.previous);
+	declareVariable(state);
 
 	EMIT_CONSTANT_OP(OP_CLASS, constInd);
-	defineVariable(constInd);
+	defineVariable(state, constInd);
 
 	ClassCompiler classCompiler;
-	classCompiler.name = parser.previous;
-	classCompiler.enclosing = currentClass;
-	currentClass = &classCompiler;
+	classCompiler.name = state->parser.previous;
+	classCompiler.enclosing = state->currentClass;
+	state->currentClass = &classCompiler;
 	int hasSuperclass = 0;
 
-	if (match(TOKEN_LEFT_PAREN)) {
-		startEatingWhitespace();
-		if (!check(TOKEN_RIGHT_PAREN)) {
-			expression();
+	if (match(state, TOKEN_LEFT_PAREN)) {
+		startEatingWhitespace(state);
+		if (!check(state, TOKEN_RIGHT_PAREN)) {
+			expression(state);
 			hasSuperclass = 1;
 		}
-		stopEatingWhitespace();
-		consume(TOKEN_RIGHT_PAREN, "Expected ) after superclass.");
+		stopEatingWhitespace(state);
+		consume(state, TOKEN_RIGHT_PAREN, "Expected ) after superclass.");
 	}
 
 	if (!hasSuperclass) {
 		KrkToken Object = syntheticToken("object");
-		size_t ind = identifierConstant(&Object);
+		size_t ind = identifierConstant(state, &Object);
 		EMIT_CONSTANT_OP(OP_GET_GLOBAL, ind);
 	}
 
-	beginScope();
-	addLocal(syntheticToken("super"));
-	defineVariable(0);
+	beginScope(state);
+	addLocal(state, syntheticToken("super"));
+	defineVariable(state, 0);
 
 	if (hasSuperclass) {
-		namedVariable(className, 0);
-		emitByte(OP_INHERIT);
+		namedVariable(state, className, 0);
+		emitByte(state, OP_INHERIT);
 	}
 
-	namedVariable(className, 0);
+	namedVariable(state, className, 0);
 
-	consume(TOKEN_COLON, "Expected colon after class");
-	if (match(TOKEN_EOL)) {
-		if (check(TOKEN_INDENTATION)) {
-			size_t currentIndentation = parser.current.length;
+	consume(state, TOKEN_COLON, "Expected colon after class");
+	if (match(state, TOKEN_EOL)) {
+		if (check(state, TOKEN_INDENTATION)) {
+			size_t currentIndentation = state->parser.current.length;
 			if (currentIndentation <= blockWidth) {
 				errorAtCurrent("Unexpected indentation level for class");
 			}
-			advance();
-			if (match(TOKEN_STRING) || match(TOKEN_BIG_STRING)) {
-				string(parser.previous.type == TOKEN_BIG_STRING);
-				emitByte(OP_DOCSTRING);
-				consume(TOKEN_EOL,"Garbage after docstring defintion");
-				if (!check(TOKEN_INDENTATION) || parser.current.length != currentIndentation) {
+			advance(state);
+			if (match(state, TOKEN_STRING) || match(state, TOKEN_BIG_STRING)) {
+				string(state, state->parser.previous.type == TOKEN_BIG_STRING);
+				emitByte(state, OP_DOCSTRING);
+				consume(state, TOKEN_EOL,"Garbage after docstring defintion");
+				if (!check(state, TOKEN_INDENTATION) || state->parser.current.length != currentIndentation) {
 					goto _pop_class;
 				}
-				advance();
+				advance(state);
 			}
-			method(currentIndentation);
-			while (check(TOKEN_INDENTATION)) {
-				if (parser.current.length < currentIndentation) break;
-				advance(); /* Pass the indentation */
-				method(currentIndentation);
+			method(state, currentIndentation);
+			while (check(state, TOKEN_INDENTATION)) {
+				if (state->parser.current.length < currentIndentation) break;
+				advance(state); /* Pass the indentation */
+				method(state, currentIndentation);
 			}
 #ifdef ENABLE_SCAN_TRACING
-			if (krk_currentThread.flags & KRK_ENABLE_SCAN_TRACING) fprintf(stderr, "Exiting from class definition on %s\n", getRule(parser.current.type)->name);
+			if (krk_currentThread.flags & KRK_ENABLE_SCAN_TRACING) fprintf(stderr, "Exiting from class definition on %s\n", getRule(state->parser.current.type)->name);
 #endif
 			/* Exit from block */
 		}
 	} /* else empty class (and at end of file?) we'll allow it for now... */
 _pop_class:
-	emitByte(OP_FINALIZE);
-	currentClass = currentClass->enclosing;
-	KrkFunction * makeclass = endCompiler();
-	size_t indFunc = krk_addConstant(currentChunk(), OBJECT_VAL(makeclass));
+	emitByte(state, OP_FINALIZE);
+	state->currentClass = state->currentClass->enclosing;
+	KrkFunction * makeclass = endCompiler(state);
+	size_t indFunc = krk_addConstant(currentChunk(state), OBJECT_VAL(makeclass));
 	EMIT_CONSTANT_OP(OP_CLOSURE, indFunc);
-	doUpvalues(&subcompiler, makeclass);
+	doUpvalues(state, &subcompiler, makeclass);
 	freeCompiler(&subcompiler);
-	emitBytes(OP_CALL, 0);
+	emitBytes(state, OP_CALL, 0);
 
 	return className;
 }
 
-static void markInitialized() {
-	if (current->scopeDepth == 0) return;
-	current->locals[current->localCount - 1].depth = current->scopeDepth;
+static void markInitialized(struct GlobalState * state) {
+	if (state->current->scopeDepth == 0) return;
+	state->current->locals[state->current->localCount - 1].depth = state->current->scopeDepth;
 }
 
-static void lambda() {
+static void lambda(struct GlobalState * state, int canAssign) {
 	Compiler lambdaCompiler;
-	parser.previous = syntheticToken("<lambda>");
-	initCompiler(&lambdaCompiler, TYPE_LAMBDA);
+	state->parser.previous = syntheticToken("<lambda>");
+	initCompiler(state, &lambdaCompiler, TYPE_LAMBDA);
 	lambdaCompiler.function->chunk.filename = lambdaCompiler.enclosing->function->chunk.filename;
-	beginScope();
+	beginScope(state);
 
-	if (!check(TOKEN_COLON)) {
+	if (!check(state, TOKEN_COLON)) {
 		do {
-			ssize_t paramConstant = parseVariable("Expect parameter name.");
-			defineVariable(paramConstant);
-			current->function->requiredArgs++;
-		} while (match(TOKEN_COMMA));
+			ssize_t paramConstant = parseVariable(state, "Expect parameter name.");
+			defineVariable(state, paramConstant);
+			state->current->function->requiredArgs++;
+		} while (match(state, TOKEN_COMMA));
 	}
 
-	consume(TOKEN_COLON, "expected : after lambda arguments");
-	expression();
+	consume(state, TOKEN_COLON, "expected : after lambda arguments");
+	expression(state);
 
-	KrkFunction * lambda = endCompiler();
-	size_t ind = krk_addConstant(currentChunk(), OBJECT_VAL(lambda));
+	KrkFunction * lambda = endCompiler(state);
+	size_t ind = krk_addConstant(currentChunk(state), OBJECT_VAL(lambda));
 	EMIT_CONSTANT_OP(OP_CLOSURE, ind);
-	doUpvalues(&lambdaCompiler, lambda);
+	doUpvalues(state, &lambdaCompiler, lambda);
 	freeCompiler(&lambdaCompiler);
 }
 
-static void defDeclaration() {
-	size_t blockWidth = (parser.previous.type == TOKEN_INDENTATION) ? parser.previous.length : 0;
-	advance(); /* Collect the `def` */
+static void yield(struct GlobalState * state, int canAssign) {
+	if (state->current->type == TYPE_MODULE || state->current->type == TYPE_LAMBDA) {
+		error("'yield' outside function");
+		return;
+	} else if (state->current->type == TYPE_INIT) {
+		error("Can not yield from __init__");
+		return;
+	}
+	state->current->function->isGenerator = 1;
+	if (check(state, TOKEN_EOL) || check(state, TOKEN_EOF) || check(state, TOKEN_SEMICOLON) || check(state, TOKEN_RIGHT_PAREN)) {
+		emitByte(state, OP_NONE);
+	} else {
+		expression(state);
+	}
+	/* Leaves the value passed to send() on the stack when resumed. */
+	emitByte(state, OP_YIELD);
+}
+
+static void defDeclaration(struct GlobalState * state) {
+	size_t blockWidth = (state->parser.previous.type == TOKEN_INDENTATION) ? state->parser.previous.length : 0;
+	advance(state); /* Collect the `def` */
 
-	ssize_t global = parseVariable("Expected function name.");
-	markInitialized();
-	function(TYPE_FUNCTION, blockWidth);
-	defineVariable(global);
+	ssize_t global = parseVariable(state, "Expected function name.");
+	markInitialized(state);
+	function(state, TYPE_FUNCTION, blockWidth);
+	defineVariable(state, global);
 }
 
-static KrkToken decorator(size_t level, FunctionType type) {
-	size_t blockWidth = (parser.previous.type == TOKEN_INDENTATION) ? parser.previous.length : 0;
-	advance(); /* Collect the `@` */
+static KrkToken decorator(struct GlobalState * state, size_t level, FunctionType type) {
+	size_t blockWidth = (state->parser.previous.type == TOKEN_INDENTATION) ? state->parser.previous.length : 0;
+	advance(state); /* Collect the `@` */
 
 	KrkToken funcName = {0};
 	int haveCallable = 0;
@@ -1175,76 +1312,76 @@ static KrkToken decorator(size_t level, FunctionType type) {
 	/* hol'up, let's special case some stuff */
 	KrkToken at_staticmethod = syntheticToken("staticmethod");
 	KrkToken at_property = syntheticToken("property");
-	if (identifiersEqual(&at_staticmethod, &parser.current)) {
+	if (identifiersEqual(&at_staticmethod, &state->parser.current)) {
 		if (level != 0 || type != TYPE_METHOD) {
 			error("Invalid use of @staticmethod, which must be the top decorator of a class method.");
 			return funcName;
 		}
-		advance();
+		advance(state);
 		type = TYPE_STATIC;
-		emitBytes(OP_DUP, 0); /* SET_PROPERTY will pop class */
-	} else if (identifiersEqual(&at_property, &parser.current)) {
+		emitBytes(state, OP_DUP, 0); /* SET_PROPERTY will pop class */
+	} else if (identifiersEqual(&at_property, &state->parser.current)) {
 		if (level != 0 || type != TYPE_METHOD) {
 			error("Invalid use of @property, which must be the top decorator of a class method.");
 			return funcName;
 		}
-		advance();
+		advance(state);
 		type = TYPE_PROPERTY;
-		emitBytes(OP_DUP, 0);
+		emitBytes(state, OP_DUP, 0);
 	} else {
 		/* Collect an identifier */
-		expression();
+		expression(state);
 		haveCallable = 1;
 	}
 
-	consume(TOKEN_EOL, "Expected line feed after decorator.");
+	consume(state, TOKEN_EOL, "Expected line feed after decorator.");
 	if (blockWidth) {
-		consume(TOKEN_INDENTATION, "Expected next line after decorator to have same indentation.");
-		if (parser.previous.length != blockWidth) error("Expected next line after decorator to have same indentation.");
+		consume(state, TOKEN_INDENTATION, "Expected next line after decorator to have same indentation.");
+		if (state->parser.previous.length != blockWidth) error("Expected next line after decorator to have same indentation.");
 	}
 
-	if (check(TOKEN_DEF)) {
+	if (check(state, TOKEN_DEF)) {
 		/* We already checked for block level */
-		advance();
-		consume(TOKEN_IDENTIFIER, "Expected function name.");
-		funcName = parser.previous;
+		advance(state);
+		consume(state, TOKEN_IDENTIFIER, "Expected function name.");
+		funcName = state->parser.previous;
 		if (type == TYPE_METHOD && funcName.length == 8 && !memcmp(funcName.start,"__init__",8)) {
 			type = TYPE_INIT;
 		}
-		function(type, blockWidth);
-	} else if (check(TOKEN_AT)) {
-		funcName = decorator(level+1, type);
-	} else if (check(TOKEN_CLASS)) {
+		function(state, type, blockWidth);
+	} else if (check(state, TOKEN_AT)) {
+		funcName = decorator(state, level+1, type);
+	} else if (check(state, TOKEN_CLASS)) {
 		if (type != TYPE_FUNCTION) {
 			error("Invalid decorator applied to class");
 			return funcName;
 		}
-		funcName = classDeclaration();
+		funcName = classDeclaration(state);
 	} else {
 		error("Expected a function declaration or another decorator.");
 		return funcName;
 	}
 
 	if (haveCallable)
-		emitBytes(OP_CALL, 1);
+		emitBytes(state, OP_CALL, 1);
 
 	if (level == 0) {
 		if (type == TYPE_FUNCTION) {
-			parser.previous = funcName;
-			declareVariable();
-			size_t ind = (current->scopeDepth > 0) ? 0 : identifierConstant(&funcName);
-			defineVariable(ind);
+			state->parser.previous = funcName;
+			declareVariable(state);
+			size_t ind = (state->current->scopeDepth > 0) ? 0 : identifierConstant(state, &funcName);
+			defineVariable(state, ind);
 		} else if (type == TYPE_STATIC) {
-			size_t ind = identifierConstant(&funcName);
+			size_t ind = identifierConstant(state, &funcName);
 			EMIT_CONSTANT_OP(OP_SET_PROPERTY, ind);
-			emitByte(OP_POP);
+			emitByte(state, OP_POP);
 		} else if (type == TYPE_PROPERTY) {
-			emitByte(OP_CREATE_PROPERTY);
-			size_t ind = identifierConstant(&funcName);
+			emitByte(state, OP_CREATE_PROPERTY);
+			size_t ind = identifierConstant(state, &funcName);
 			EMIT_CONSTANT_OP(OP_SET_PROPERTY, ind);
-			emitByte(OP_POP);
+			emitByte(state, OP_POP);
 		} else {
-			size_t ind = identifierConstant(&funcName);
+			size_t ind = identifierConstant(state, &funcName);
 			EMIT_CONSTANT_OP(OP_METHOD, ind);
 		}
 	}
@@ -1252,390 +1389,415 @@ static KrkToken decorator(size_t level, FunctionType type) {
 	return funcName;
 }
 
-static void emitLoop(int loopStart) {
+static void emitLoop(struct GlobalState * state, int loopStart) {
 
 	/* Patch continue statements to point to here, before the loop operation (yes that's silly) */
-	while (current->continueCount > 0 && current->continues[current->continueCount-1] > loopStart) {
-		patchJump(current->continues[current->continueCount-1]);
-		current->continueCount--;
+	while (state->current->continueCount > 0 && state->current->continues[state->current->continueCount-1] > loopStart) {
+		patchJump(state, state->current->continues[state->current->continueCount-1]);
+		state->current->continueCount--;
 	}
 
-	emitByte(OP_LOOP);
+	emitByte(state, OP_LOOP);
 
-	int offset = currentChunk()->count - loopStart + 2;
+	int offset = currentChunk(state)->count - loopStart + 2;
 	if (offset > 0xFFFF) error("offset too big");
-	emitBytes(offset >> 8, offset);
+	emitBytes(state, offset >> 8, offset);
 
 	/* Patch break statements */
 }
 
-static void withStatement() {
+static void withStatement(struct GlobalState * state) {
 	/* TODO: Multiple items, I'm feeling lazy. */
 
 	/* We only need this for block() */
-	size_t blockWidth = (parser.previous.type == TOKEN_INDENTATION) ? parser.previous.length : 0;
+	size_t blockWidth = (state->parser.previous.type == TOKEN_INDENTATION) ? state->parser.previous.length : 0;
 
 	/* Collect the with token that started this statement */
-	advance();
+	advance(state);
 
-	beginScope();
-	expression();
+	beginScope(state);
+	expression(state);
 
-	if (match(TOKEN_AS)) {
-		consume(TOKEN_IDENTIFIER, "Expected variable name after 'as'");
-		size_t ind = identifierConstant(&parser.previous);
-		declareVariable();
-		defineVariable(ind);
+	if (match(state, TOKEN_AS)) {
+		consume(state, TOKEN_IDENTIFIER, "Expected variable name after 'as'");
+		size_t ind = identifierConstant(state, &state->parser.previous);
+		declareVariable(state);
+		defineVariable(state, ind);
 	} else {
 		/* Otherwise we want an unnamed local; TODO: Wait, can't we do this for iterable counts? */
-		addLocal(syntheticToken(""));
-		markInitialized();
+		addLocal(state, syntheticToken(""));
+		markInitialized(state);
 	}
 
-	consume(TOKEN_COLON, "Expected ':' after with statement");
+	consume(state, TOKEN_COLON, "Expected ':' after with statement");
 
-	addLocal(syntheticToken(""));
-	int withJump = emitJump(OP_PUSH_WITH);
-	markInitialized();
+	addLocal(state, syntheticToken(""));
+	int withJump = emitJump(state, OP_PUSH_WITH);
+	markInitialized(state);
 
-	beginScope();
-	block(blockWidth,"with");
-	endScope();
+	beginScope(state);
+	state->current->handlerDepth++;
+	block(state, blockWidth,"with");
+	state->current->handlerDepth--;
+	endScope(state);
 
-	patchJump(withJump);
-	emitByte(OP_CLEANUP_WITH);
+	patchJump(state, withJump);
+	emitByte(state, OP_CLEANUP_WITH);
 
 	/* Scope exit pops context manager */
-	endScope();
+	endScope(state);
 }
 
-static void ifStatement() {
+static void ifStatement(struct GlobalState * state) {
 	/* Figure out what block level contains us so we can match our partner else */
-	size_t blockWidth = (parser.previous.type == TOKEN_INDENTATION) ? parser.previous.length : 0;
-	KrkToken myPrevious = parser.previous;
+	size_t blockWidth = (state->parser.previous.type == TOKEN_INDENTATION) ? state->parser.previous.length : 0;
+	KrkToken myPrevious = state->parser.previous;
 
 	/* Collect the if token that started this statement */
-	advance();
+	advance(state);
 
 	/* Collect condition expression */
-	expression();
+	expression(state);
 
 	/* if EXPR: */
-	consume(TOKEN_COLON, "Expect ':' after condition.");
+	consume(state, TOKEN_COLON, "Expect ':' after condition.");
 
-	int thenJump = emitJump(OP_JUMP_IF_FALSE);
-	emitByte(OP_POP);
+	int thenJump = emitJump(state, OP_JUMP_IF_FALSE);
+	emitByte(state, OP_POP);
 
 	/* Start a new scope and enter a block */
-	beginScope();
-	block(blockWidth,"if");
-	endScope();
+	beginScope(state);
+	block(state, blockWidth,"if");
+	endScope(state);
 
-	int elseJump = emitJump(OP_JUMP);
-	patchJump(thenJump);
-	emitByte(OP_POP);
+	int elseJump = emitJump(state, OP_JUMP);
+	patchJump(state, thenJump);
+	emitByte(state, OP_POP);
 
 	/* See if we have a matching else block */
-	if (blockWidth == 0 || (check(TOKEN_INDENTATION) && (parser.current.length == blockWidth))) {
+	if (blockWidth == 0 || (check(state, TOKEN_INDENTATION) && (state->parser.current.length == blockWidth))) {
 		/* This is complicated */
 		KrkToken previous;
 		if (blockWidth) {
-			previous = parser.previous;
-			advance();
+			previous = state->parser.previous;
+			advance(state);
 		}
-		if (match(TOKEN_ELSE) || check(TOKEN_ELIF)) {
-			if (parser.current.type == TOKEN_ELIF || check(TOKEN_IF)) {
-				parser.previous = myPrevious;
-				ifStatement(); /* Keep nesting */
+		if (match(state, TOKEN_ELSE) || check(state, TOKEN_ELIF)) {
+			if (state->parser.current.type == TOKEN_ELIF || check(state, TOKEN_IF)) {
+				state->parser.previous = myPrevious;
+				ifStatement(state); /* Keep nesting */
 			} else {
-				consume(TOKEN_COLON, "Expect ':' after else.");
-				beginScope();
-				block(blockWidth,"else");
-				endScope();
+				consume(state, TOKEN_COLON, "Expect ':' after else.");
+				beginScope(state);
+				block(state, blockWidth,"else");
+				endScope(state);
 			}
-		} else if (!check(TOKEN_EOF) && !check(TOKEN_EOL)) {
-			krk_ungetToken(parser.current);
-			parser.current = parser.previous;
+		} else if (!check(state, TOKEN_EOF) && !check(state, TOKEN_EOL)) {
+			krk_ungetToken(&state->scanner, state->parser.current);
+			state->parser.current = state->parser.previous;
 			if (blockWidth) {
-				parser.previous = previous;
+				state->parser.previous = previous;
 			}
 		} else {
-			advance(); /* Ignore this blank indentation line */
+			advance(state); /* Ignore this blank indentation line */
 		}
 	}
 
-	patchJump(elseJump);
+	patchJump(state, elseJump);
 }
 
-static void patchBreaks(int loopStart) {
+static void patchBreaks(struct GlobalState * state, int loopStart) {
 	/* Patch break statements to go here, after the loop operation and operand. */
-	while (current->breakCount > 0 && current->breaks[current->breakCount-1] > loopStart) {
-		patchJump(current->breaks[current->breakCount-1]);
-		current->breakCount--;
+	while (state->current->breakCount > 0 && state->current->breaks[state->current->breakCount-1] > loopStart) {
+		patchJump(state, state->current->breaks[state->current->breakCount-1]);
+		state->current->breakCount--;
 	}
 }
 
-static void breakStatement() {
-	if (current->breakSpace < current->breakCount + 1) {
-		size_t old = current->breakSpace;
-		current->breakSpace = GROW_CAPACITY(old);
-		current->breaks = GROW_ARRAY(int,current->breaks,old,current->breakSpace);
+static void breakStatement(struct GlobalState * state) {
+	if (state->current->breakSpace < state->current->breakCount + 1) {
+		size_t old = state->current->breakSpace;
+		state->current->breakSpace = GROW_CAPACITY(old);
+		state->current->breaks = GROW_ARRAY(int,state->current->breaks,old,state->current->breakSpace);
 	}
 
-	for (size_t i = current->loopLocalCount; i < current->localCount; ++i) {
-		emitByte(OP_POP);
+	for (size_t i = state->current->loopLocalCount; i < state->current->localCount; ++i) {
+		emitByte(state, OP_POP);
 	}
-	current->breaks[current->breakCount++] = emitJump(OP_JUMP);
+	state->current->breaks[state->current->breakCount++] = emitJump(state, OP_JUMP);
 }
 
-static void continueStatement() {
-	if (current->continueSpace < current->continueCount + 1) {
-		size_t old = current->continueSpace;
-		current->continueSpace = GROW_CAPACITY(old);
-		current->continues = GROW_ARRAY(int,current->continues,old,current->continueSpace);
+static void continueStatement(struct GlobalState * state) {
+	if (state->current->continueSpace < state->current->continueCount + 1) {
+		size_t old = state->current->continueSpace;
+		state->current->continueSpace = GROW_CAPACITY(old);
+		state->current->continues = GROW_ARRAY(int,state->current->continues,old,state->current->continueSpace);
 	}
 
-	for (size_t i = current->loopLocalCount; i < current->localCount; ++i) {
-		emitByte(OP_POP);
+	for (size_t i = state->current->loopLocalCount; i < state->current->localCount; ++i) {
+		emitByte(state, OP_POP);
 	}
-	current->continues[current->continueCount++] = emitJump(OP_JUMP);
+	state->current->continues[state->current->continueCount++] = emitJump(state, OP_JUMP);
 }
 
-static void whileStatement() {
-	size_t blockWidth = (parser.previous.type == TOKEN_INDENTATION) ? parser.previous.length : 0;
-	advance();
+static void whileStatement(struct GlobalState * state) {
+	size_t blockWidth = (state->parser.previous.type == TOKEN_INDENTATION) ? state->parser.previous.length : 0;
+	advance(state);
 
-	int loopStart = currentChunk()->count;
+	int loopStart = currentChunk(state)->count;
 
-	expression();
-	consume(TOKEN_COLON, "Expect ':' after condition.");
+	expression(state);
+	consume(state, TOKEN_COLON, "Expect ':' after condition.");
 
-	int exitJump = emitJump(OP_JUMP_IF_FALSE);
-	emitByte(OP_POP);
+	int exitJump = emitJump(state, OP_JUMP_IF_FALSE);
+	emitByte(state, OP_POP);
 
-	int oldLocalCount = current->loopLocalCount;
-	current->loopLocalCount = current->localCount;
-	beginScope();
-	block(blockWidth,"while");
-	endScope();
+	int oldLocalCount = state->current->loopLocalCount;
+	state->current->loopLocalCount = state->current->localCount;
+	beginScope(state);
+	block(state, blockWidth,"while");
+	endScope(state);
 
-	current->loopLocalCount = oldLocalCount;
-	emitLoop(loopStart);
-	patchJump(exitJump);
-	emitByte(OP_POP);
-	patchBreaks(loopStart);
+	state->current->loopLocalCount = oldLocalCount;
+	emitLoop(state, loopStart);
+	patchJump(state, exitJump);
+	emitByte(state, OP_POP);
+	patchBreaks(state, loopStart);
 }
 
-static void forStatement() {
+static void forStatement(struct GlobalState * state) {
 	/* I'm not sure if I want this to be more like Python or C/Lox/etc. */
-	size_t blockWidth = (parser.previous.type == TOKEN_INDENTATION) ? parser.previous.length : 0;
-	advance();
+	size_t blockWidth = (state->parser.previous.type == TOKEN_INDENTATION) ? state->parser.previous.length : 0;
+	advance(state);
 
 	/* For now this is going to be kinda broken */
-	beginScope();
+	beginScope(state);
 
-	ssize_t loopInd = current->localCount;
+	ssize_t loopInd = state->current->localCount;
 	ssize_t varCount = 0;
 	int matchedEquals = 0;
 	do {
-		ssize_t ind = parseVariable("Expected name for loop iterator.");
-		if (match(TOKEN_EQUAL)) {
+		ssize_t ind = parseVariable(state, "Expected name for loop iterator.");
+		if (match(state, TOKEN_EQUAL)) {
 			matchedEquals = 1;
-			expression();
+			expression(state);
 		} else {
-			emitByte(OP_NONE);
+			emitByte(state, OP_NONE);
 		}
-		defineVariable(ind);
+		defineVariable(state, ind);
 		varCount++;
-	} while (match(TOKEN_COMMA));
+	} while (match(state, TOKEN_COMMA));
 
 	int loopStart;
 	int exitJump;
+	int sawIn = 0;
 
-	if (!matchedEquals && match(TOKEN_IN)) {
+	if (!matchedEquals && match(state, TOKEN_IN)) {
+		sawIn = 1;
 
 		/* ITERABLE.__iter__() */
-		beginScope();
-		expression();
-		endScope();
+		beginScope(state);
+		expression(state);
+		endScope(state);
 
 		KrkToken _it = syntheticToken("");
-		size_t indLoopIter = current->localCount;
-		addLocal(_it);
-		defineVariable(indLoopIter);
+		size_t indLoopIter = state->current->localCount;
+		addLocal(state, _it);
+		defineVariable(state, indLoopIter);
 
 		KrkToken _iter = syntheticToken("__iter__");
-		ssize_t ind = identifierConstant(&_iter);
+		ssize_t ind = identifierConstant(state, &_iter);
 		EMIT_CONSTANT_OP(OP_GET_PROPERTY, ind);
-		emitBytes(OP_CALL, 0);
+		emitBytes(state, OP_CALL, 0);
 
 		/* assign */
 		EMIT_CONSTANT_OP(OP_SET_LOCAL, indLoopIter);
 
 		/* LOOP STARTS HERE */
-		loopStart = currentChunk()->count;
+		loopStart = currentChunk(state)->count;
 
-		/* Call the iterator */
+		/* Advance the iterator; when it is exhausted, this pops it and exits */
 		EMIT_CONSTANT_OP(OP_GET_LOCAL, indLoopIter);
-		emitBytes(OP_CALL, 0);
+		exitJump = emitJump(state, OP_FOR_ITER);
 
 		/* Assign the result to our loop index */
 		EMIT_CONSTANT_OP(OP_SET_LOCAL, loopInd);
-
-		/* Get the loop iterator again */
-		EMIT_CONSTANT_OP(OP_GET_LOCAL, indLoopIter);
-		emitByte(OP_EQUAL);
-		exitJump = emitJump(OP_JUMP_IF_TRUE);
-		emitByte(OP_POP);
+		emitByte(state, OP_POP);
 
 		if (varCount > 1) {
 			EMIT_CONSTANT_OP(OP_GET_LOCAL, loopInd);
 			EMIT_CONSTANT_OP(OP_UNPACK, varCount);
 			for (ssize_t i = loopInd + varCount - 1; i >= loopInd; i--) {
 				EMIT_CONSTANT_OP(OP_SET_LOCAL, i);
-				emitByte(OP_POP);
+				emitByte(state, OP_POP);
 			}
 		}
 
 	} else {
-		consume(TOKEN_SEMICOLON,"expect ; after var declaration in for loop");
-		loopStart = currentChunk()->count;
+		consume(state, TOKEN_SEMICOLON,"expect ; after var declaration in for loop");
+		loopStart = currentChunk(state)->count;
 
-		beginScope();
+		beginScope(state);
 		do {
-			expression(); /* condition */
-		} while (match(TOKEN_COMMA));
-		endScope();
-		exitJump = emitJump(OP_JUMP_IF_FALSE);
-		emitByte(OP_POP);
-
-		if (check(TOKEN_SEMICOLON)) {
-			advance();
-			int bodyJump = emitJump(OP_JUMP);
-			int incrementStart = currentChunk()->count;
-			beginScope();
+			expression(state); /* condition */
+		} while (match(state, TOKEN_COMMA));
+		endScope(state);
+		exitJump = emitJump(state, OP_JUMP_IF_FALSE);
+		emitByte(state, OP_POP);
+
+		if (check(state, TOKEN_SEMICOLON)) {
+			advance(state);
+			int bodyJump = emitJump(state, OP_JUMP);
+			int incrementStart = currentChunk(state)->count;
+			beginScope(state);
 			do {
-				expression();
-			} while (match(TOKEN_COMMA));
-			endScope();
-			emitByte(OP_POP);
+				expression(state);
+			} while (match(state, TOKEN_COMMA));
+			endScope(state);
+			emitByte(state, OP_POP);
 
-			emitLoop(loopStart);
+			emitLoop(state, loopStart);
 			loopStart = incrementStart;
-			patchJump(bodyJump);
+			patchJump(state, bodyJump);
 		}
 	}
 
-	consume(TOKEN_COLON,"expect :");
+	consume(state, TOKEN_COLON,"expect :");
 
-	int oldLocalCount = current->loopLocalCount;
-	current->loopLocalCount = current->localCount;
-	beginScope();
-	block(blockWidth,"for");
-	endScope();
+	int oldLocalCount = state->current->loopLocalCount;
+	state->current->loopLocalCount = state->current->localCount;
+	beginScope(state);
+	block(state, blockWidth,"for");
+	endScope(state);
 
-	current->loopLocalCount = oldLocalCount;
-	emitLoop(loopStart);
-	patchJump(exitJump);
-	emitByte(OP_POP);
-	patchBreaks(loopStart);
+	state->current->loopLocalCount = oldLocalCount;
+	emitLoop(state, loopStart);
+	patchJump(state, exitJump);
+	/* OP_FOR_ITER has already popped the iterator; the C-style loop still has its condition */
+	if (!sawIn) emitByte(state, OP_POP);
+	patchBreaks(state, loopStart);
 
-	endScope();
+	endScope(state);
 }
 
-static void returnStatement() {
-	if (check(TOKEN_EOL) || check(TOKEN_EOF)) {
-		emitReturn();
+/*
+ * If the return value was just computed by a call, make it a tail call. The
+ * VM reuses this frame for the callee when it can, and otherwise does a normal
+ * call and carries on to the OP_RETURN. Calls inside try and with blocks have
+ * to come back here for their handlers, and module code keeps its frame.
+ */
+static void markTailCall(struct GlobalState * state) {
+	KrkChunk * chunk = currentChunk(state);
+	size_t offset = state->current->lastCall;
+	if (state->current->type == TYPE_MODULE || state->current->handlerDepth) return;
+	if (offset == (size_t)-1) return;
+	if (chunk->code[offset] == OP_CALL && offset + 2 == chunk->count) {
+		chunk->code[offset] = OP_TAIL_CALL;
+	} else if (chunk->code[offset] == OP_CALL_LONG && offset + 4 == chunk->count) {
+		chunk->code[offset] = OP_TAIL_CALL_LONG;
+	}
+}
+
+static void returnStatement(struct GlobalState * state) {
+	if (check(state, TOKEN_EOL) || check(state, TOKEN_EOF)) {
+		emitReturn(state);
 	} else {
-		if (current->type == TYPE_INIT) {
+		if (state->current->type == TYPE_INIT) {
 			error("Can not return values from __init__");
 		}
-		expression();
-		emitByte(OP_RETURN);
+		expression(state);
+		markTailCall(state);
+		emitByte(state, OP_RETURN);
 	}
 }
 
-static void tryStatement() {
-	size_t blockWidth = (parser.previous.type == TOKEN_INDENTATION) ? parser.previous.length : 0;
-	advance();
-	consume(TOKEN_COLON, "Expect ':' after try.");
+static void tryStatement(struct GlobalState * state) {
+	size_t blockWidth = (state->parser.previous.type == TOKEN_INDENTATION) ? state->parser.previous.length : 0;
+	advance(state);
+	consume(state, TOKEN_COLON, "Expect ':' after try.");
+
+	/* Nothing is emitted on the way in; the handler table records what the block covers. */
+	size_t tryStart = currentChunk(state)->count;
+	size_t stackDepth = state->current->localCount;
 
-	/* Make sure we are in a local scope so this ends up on the stack */
-	beginScope();
-	int tryJump = emitJump(OP_PUSH_TRY);
-	addLocal(syntheticToken("exception"));
-	defineVariable(0);
+	beginScope(state);
+	state->current->handlerDepth++;
+	block(state, blockWidth,"try");
+	state->current->handlerDepth--;
+	endScope(state);
 
-	beginScope();
-	block(blockWidth,"try");
-	endScope();
+	size_t tryEnd = currentChunk(state)->count;
+	int successJump = emitJump(state, OP_JUMP);
+	krk_addHandler(currentChunk(state), tryStart, tryEnd, currentChunk(state)->count, stackDepth);
 
-	int successJump = emitJump(OP_JUMP);
-	patchJump(tryJump);
+	/* The VM resumes here with the exception where the stack stood at the start of the block. */
+	beginScope(state);
+	addLocal(state, syntheticToken("exception"));
+	defineVariable(state, 0);
 
-	if (blockWidth == 0 || (check(TOKEN_INDENTATION) && (parser.current.length == blockWidth))) {
+	if (blockWidth == 0 || (check(state, TOKEN_INDENTATION) && (state->parser.current.length == blockWidth))) {
 		KrkToken previous;
 		if (blockWidth) {
-			previous = parser.previous;
-			advance();
+			previous = state->parser.previous;
+			advance(state);
 		}
-		if (match(TOKEN_EXCEPT)) {
-			consume(TOKEN_COLON, "Expect ':' after except.");
-			beginScope();
-			block(blockWidth,"except");
-			endScope();
-		} else if (!check(TOKEN_EOL) && !check(TOKEN_EOF)) {
-			krk_ungetToken(parser.current);
-			parser.current = parser.previous;
+		if (match(state, TOKEN_EXCEPT)) {
+			consume(state, TOKEN_COLON, "Expect ':' after except.");
+			beginScope(state);
+			block(state, blockWidth,"except");
+			endScope(state);
+		} else if (!check(state, TOKEN_EOL) && !check(state, TOKEN_EOF)) {
+			krk_ungetToken(&state->scanner, state->parser.current);
+			state->parser.current = state->parser.previous;
 			if (blockWidth) {
-				parser.previous = previous;
+				state->parser.previous = previous;
 			}
 		} else {
-			advance(); /* Ignore this blank indentation line */
+			advance(state); /* Ignore this blank indentation line */
 		}
 	}
 
-	patchJump(successJump);
-	endScope(); /* will pop the exception handler */
+	endScope(state); /* will pop the exception */
+	patchJump(state, successJump);
 }
 
-static void raiseStatement() {
-	expression();
-	emitByte(OP_RAISE);
+static void raiseStatement(struct GlobalState * state) {
+	expression(state);
+	emitByte(state, OP_RAISE);
 }
 
 
-static size_t importModule(KrkToken * startOfName) {
-	consume(TOKEN_IDENTIFIER, "Expected module name");
-	*startOfName = parser.previous;
-	while (match(TOKEN_DOT)) {
-		if (startOfName->start + startOfName->literalWidth != parser.previous.start) {
+static size_t importModule(struct GlobalState * state, KrkToken * startOfName) {
+	consume(state, TOKEN_IDENTIFIER, "Expected module name");
+	*startOfName = state->parser.previous;
+	while (match(state, TOKEN_DOT)) {
+		if (startOfName->start + startOfName->literalWidth != state->parser.previous.start) {
 			error("Unexpected whitespace after module path element");
 			return 0;
 		}
-		startOfName->literalWidth += parser.previous.literalWidth;
-		startOfName->length += parser.previous.length;
-		consume(TOKEN_IDENTIFIER, "Expected module path element after '.'");
-		if (startOfName->start + startOfName->literalWidth != parser.previous.start) {
+		startOfName->literalWidth += state->parser.previous.literalWidth;
+		startOfName->length += state->parser.previous.length;
+		consume(state, TOKEN_IDENTIFIER, "Expected module path element after '.'");
+		if (startOfName->start + startOfName->literalWidth != state->parser.previous.start) {
 			error("Unexpected whitespace after '.'");
 			return 0;
 		}
-		startOfName->literalWidth += parser.previous.literalWidth;
-		startOfName->length += parser.previous.length;
+		startOfName->literalWidth += state->parser.previous.literalWidth;
+		startOfName->length += state->parser.previous.length;
 	}
-	size_t ind = identifierConstant(startOfName);
+	size_t ind = identifierConstant(state, startOfName);
 	EMIT_CONSTANT_OP(OP_IMPORT, ind);
 	return ind;
 }
 
-static void importStatement() {
+static void importStatement(struct GlobalState * state) {
 	do {
-		KrkToken firstName = parser.current;
+		KrkToken firstName = state->parser.current;
 		KrkToken startOfName;
-		size_t ind = importModule(&startOfName);
-		if (match(TOKEN_AS)) {
-			consume(TOKEN_IDENTIFIER, "Expected identifier after `as`");
-			ind = identifierConstant(&parser.previous);
+		size_t ind = importModule(state, &startOfName);
+		if (match(state, TOKEN_AS)) {
+			consume(state, TOKEN_IDENTIFIER, "Expected identifier after `as`");
+			ind = identifierConstant(state, &state->parser.previous);
 		} else if (startOfName.length != firstName.length) {
 			/**
 			 * We imported foo.bar.baz and 'baz' is now on the stack with no name.
@@ -1644,104 +1806,104 @@ static void importStatement() {
 			 * have 'foo.bar.baz' be this new object, so remove 'baz', reimport
 			 * 'foo' directly, and put 'foo' into the appropriate namespace.
 			 */
-			emitByte(OP_POP);
-			parser.previous = firstName;
-			ind = identifierConstant(&firstName);
+			emitByte(state, OP_POP);
+			state->parser.previous = firstName;
+			ind = identifierConstant(state, &firstName);
 			EMIT_CONSTANT_OP(OP_IMPORT, ind);
 		}
-		declareVariable();
-		defineVariable(ind);
-	} while (match(TOKEN_COMMA));
+		declareVariable(state);
+		defineVariable(state, ind);
+	} while (match(state, TOKEN_COMMA));
 }
 
-static void fromImportStatement() {
+static void fromImportStatement(struct GlobalState * state) {
 	KrkToken startOfName;
-	importModule(&startOfName);
-	consume(TOKEN_IMPORT, "Expected 'import' after module name");
+	importModule(state, &startOfName);
+	consume(state, TOKEN_IMPORT, "Expected 'import' after module name");
 	do {
-		consume(TOKEN_IDENTIFIER, "Expected member name");
-		size_t member = identifierConstant(&parser.previous);
-		emitBytes(OP_DUP, 0); /* Duplicate the package object so we can GET_PROPERTY on it? */
+		consume(state, TOKEN_IDENTIFIER, "Expected member name");
+		size_t member = identifierConstant(state, &state->parser.previous);
+		emitBytes(state, OP_DUP, 0); /* Duplicate the package object so we can GET_PROPERTY on it? */
 		EMIT_CONSTANT_OP(OP_IMPORT_FROM, member);
-		if (match(TOKEN_AS)) {
-			consume(TOKEN_IDENTIFIER, "Expected identifier after `as`");
-			member = identifierConstant(&parser.previous);
+		if (match(state, TOKEN_AS)) {
+			consume(state, TOKEN_IDENTIFIER, "Expected identifier after `as`");
+			member = identifierConstant(state, &state->parser.previous);
 		}
-		if (current->scopeDepth) {
+		if (state->current->scopeDepth) {
 			/* Swaps the original module and the new possible local so it can be in the right place */
-			emitByte(OP_SWAP);
+			emitByte(state, OP_SWAP);
 		}
-		declareVariable();
-		defineVariable(member);
-	} while (match(TOKEN_COMMA));
-	emitByte(OP_POP); /* Pop the remaining copy of the module. */
+		declareVariable(state);
+		defineVariable(state, member);
+	} while (match(state, TOKEN_COMMA));
+	emitByte(state, OP_POP); /* Pop the remaining copy of the module. */
 }
 
-static void delStatement() {
+static void delStatement(struct GlobalState * state) {
 	do {
-		inDel = 1;
-		expression();
-	} while (match(TOKEN_COMMA));
-	inDel = 0;
+		state->inDel = 1;
+		expression(state);
+	} while (match(state, TOKEN_COMMA));
+	state->inDel = 0;
 }
 
-static void statement() {
-	if (match(TOKEN_EOL) || match(TOKEN_EOF)) {
+static void statement(struct GlobalState * state) {
+	if (match(state, TOKEN_EOL) || match(state, TOKEN_EOF)) {
 		return; /* Meaningless blank line */
 	}
 
-	if (check(TOKEN_IF)) {
-		ifStatement();
-	} else if (check(TOKEN_WHILE)) {
-		whileStatement();
-	} else if (check(TOKEN_FOR)) {
-		forStatement();
-	} else if (check(TOKEN_TRY)) {
-		tryStatement();
-	} else if (check(TOKEN_WITH)) {
-		withStatement();
+	if (check(state, TOKEN_IF)) {
+		ifStatement(state);
+	} else if (check(state, TOKEN_WHILE)) {
+		whileStatement(state);
+	} else if (check(state, TOKEN_FOR)) {
+		forStatement(state);
+	} else if (check(state, TOKEN_TRY)) {
+		tryStatement(state);
+	} else if (check(state, TOKEN_WITH)) {
+		withStatement(state);
 	} else {
 		/* These statements don't eat line feeds, so we need expect to see another one. */
 _anotherSimpleStatement:
-		if (match(TOKEN_RAISE)) {
-			raiseStatement();
-		} else if (match(TOKEN_RETURN)) {
-			returnStatement();
-		} else if (match(TOKEN_IMPORT)) {
-			importStatement();
-		} else if (match(TOKEN_FROM)) {
-			fromImportStatement();
-		} else if (match(TOKEN_BREAK)) {
-			breakStatement();
-		} else if (match(TOKEN_CONTINUE)) {
-			continueStatement();
-		} else if (match(TOKEN_DEL)) {
-			delStatement();
-		} else if (match(TOKEN_PASS)) {
+		if (match(state, TOKEN_RAISE)) {
+			raiseStatement(state);
+		} else if (match(state, TOKEN_RETURN)) {
+			returnStatement(state);
+		} else if (match(state, TOKEN_IMPORT)) {
+			importStatement(state);
+		} else if (match(state, TOKEN_FROM)) {
+			fromImportStatement(state);
+		} else if (match(state, TOKEN_BREAK)) {
+			breakStatement(state);
+		} else if (match(state, TOKEN_CONTINUE)) {
+			continueStatement(state);
+		} else if (match(state, TOKEN_DEL)) {
+			delStatement(state);
+		} else if (match(state, TOKEN_PASS)) {
 			/* Do nothing. */
 		} else {
-			expressionStatement();
+			expressionStatement(state);
 		}
-		if (match(TOKEN_SEMICOLON)) goto _anotherSimpleStatement;
-		if (!match(TOKEN_EOL) && !match(TOKEN_EOF)) {
+		if (match(state, TOKEN_SEMICOLON)) goto _anotherSimpleStatement;
+		if (!match(state, TOKEN_EOL) && !match(state, TOKEN_EOF)) {
 			errorAtCurrent("Unexpected token after statement.");
 		}
 	}
 }
 
-static void unary(int canAssign) {
-	KrkTokenType operatorType = parser.previous.type;
+static void unary(struct GlobalState * state, int canAssign) {
+	KrkTokenType operatorType = state->parser.previous.type;
 
-	parsePrecedence(PREC_UNARY);
+	parsePrecedence(state, PREC_UNARY);
 
 	switch (operatorType) {
-		case TOKEN_MINUS: emitByte(OP_NEGATE); break;
-		case TOKEN_TILDE: emitByte(OP_BITNEGATE); break;
+		case TOKEN_MINUS: emitByte(state, OP_NEGATE); break;
+		case TOKEN_TILDE: emitByte(state, OP_BITNEGATE); break;
 
 		/* These are equivalent */
 		case TOKEN_BANG:
 		case TOKEN_NOT:
-			emitByte(OP_NOT);
+			emitByte(state, OP_NOT);
 			break;
 
 		default: return;
@@ -1752,7 +1914,12 @@ static int isHex(int c) {
 	return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
 }
 
-static void string(int type) {
+/**
+ * Compile a string literal, returning the index of the last constant
+ * it emitted, or -1 if there was an error.
+ */
+static ssize_t stringLiteral(struct GlobalState * state, int type) {
+	ssize_t ind = -1;
 	/* We'll just build with a flexible array like everything else. */
 	size_t stringCapacity = 0;
 	size_t stringLength   = 0;
@@ -1767,7 +1934,7 @@ static void string(int type) {
 	for (size_t i = 0; i < n; ++i) { \
 		if (c + i + 2 == end || !isHex(c[i+2])) { \
 			error("truncated \\%c escape", type); \
-			return; \
+			return -1; \
 		} \
 		tmpbuf[i] = c[i+2]; \
 	} \
@@ -1784,22 +1951,22 @@ static void string(int type) {
 	for (size_t i = 0; i < len; i++) PUSH_CHAR(bytes[i]); \
 } while (0)
 
-	int isBytes = (parser.previous.type == TOKEN_PREFIX_B);
-	int isFormat = (parser.previous.type == TOKEN_PREFIX_F);
+	int isBytes = (state->parser.previous.type == TOKEN_PREFIX_B);
+	int isFormat = (state->parser.previous.type == TOKEN_PREFIX_F);
 
 	int atLeastOne = 0;
-	const char * lineBefore = krk_tellScanner().linePtr;
-	size_t lineNo = krk_tellScanner().line;
+	const char * lineBefore = krk_tellScanner(&state->scanner).linePtr;
+	size_t lineNo = krk_tellScanner(&state->scanner).line;
 
-	if ((isBytes || isFormat) && !(match(TOKEN_STRING) || match(TOKEN_BIG_STRING))) {
+	if ((isBytes || isFormat) && !(match(state, TOKEN_STRING) || match(state, TOKEN_BIG_STRING))) {
 		error("Expected string after prefix? (Internal error - scanner should not have produced this.)");
 	}
 
 	/* This should capture everything but the quotes. */
 	do {
-		int type = parser.previous.type == TOKEN_BIG_STRING ? 3 : 1;
-		const char * c = parser.previous.start + type;
-		const char * end = parser.previous.start + parser.previous.length - type;
+		int type = state->parser.previous.type == TOKEN_BIG_STRING ? 3 : 1;
+		const char * c = state->parser.previous.start + type;
+		const char * end = state->parser.previous.start + state->parser.previous.length - type;
 		while (c < end) {
 			if (*c == '\\') {
 				switch (c[1]) {
@@ -1846,24 +2013,24 @@ static void string(int type) {
 				c += 2;
 			} else if (isFormat && *c == '{') {
 				if (!atLeastOne || stringLength) { /* Make sure there's a string for coersion reasons */
-					emitConstant(OBJECT_VAL(krk_copyString(stringBytes,stringLength)));
-					if (atLeastOne) emitByte(OP_ADD);
+					ind = emitConstant(state, OBJECT_VAL(krk_copyString(stringBytes,stringLength)));
+					if (atLeastOne) emitByte(state, OP_ADD);
 					atLeastOne = 1;
 				}
 				stringLength = 0;
-				KrkScanner beforeExpression = krk_tellScanner();
-				Parser  parserBefore = parser;
+				KrkScanner beforeExpression = krk_tellScanner(&state->scanner);
+				Parser  parserBefore = state->parser;
 				KrkScanner inner = (KrkScanner){.start=c+1, .cur=c+1, .linePtr=lineBefore, .line=lineNo, .startOfLine = 0, .hasUnget = 0};
-				krk_rewindScanner(inner);
-				advance();
-				expression();
-				if (parser.hadError) {
+				krk_rewindScanner(&state->scanner, inner);
+				advance(state);
+				expression(state);
+				if (state->parser.hadError) {
 					FREE_ARRAY(char,stringBytes,stringCapacity);
-					return;
+					return -1;
 				}
-				inner = krk_tellScanner(); /* To figure out how far to advance c */
-				krk_rewindScanner(beforeExpression); /* To get us back to where we were with a string token */
-				parser = parserBefore;
+				inner = krk_tellScanner(&state->scanner); /* To figure out how far to advance c */
+				krk_rewindScanner(&state->scanner, beforeExpression); /* To get us back to where we were with a string token */
+				state->parser = parserBefore;
 				c = inner.start;
 				if (*c == '!') {
 					c++;
@@ -1877,10 +2044,10 @@ static void string(int type) {
 						error("Unsupported conversion flag for f-string expression");
 						goto _cleanupError;
 					}
-					size_t ind = identifierConstant(&which);
+					size_t ind = identifierConstant(state, &which);
 					EMIT_CONSTANT_OP(OP_GET_GLOBAL, ind);
-					emitByte(OP_SWAP);
-					emitBytes(OP_CALL, 1);
+					emitByte(state, OP_SWAP);
+					emitBytes(state, OP_CALL, 1);
 					c++;
 				}
 				if (*c == ':') {
@@ -1892,7 +2059,7 @@ static void string(int type) {
 					error("Expected closing } after expression in f-string");
 					goto _cleanupError;
 				}
-				if (atLeastOne) emitByte(OP_ADD);
+				if (atLeastOne) emitByte(state, OP_ADD);
 				atLeastOne = 1;
 				c++;
 			} else {
@@ -1904,8 +2071,8 @@ static void string(int type) {
 				c++;
 			}
 		}
-	} while ((!isBytes || match(TOKEN_PREFIX_B)) && (match(TOKEN_STRING) || match(TOKEN_BIG_STRING)));
-	if (isBytes && (match(TOKEN_STRING) || match(TOKEN_BIG_STRING))) {
+	} while ((!isBytes || match(state, TOKEN_PREFIX_B)) && (match(state, TOKEN_STRING) || match(state, TOKEN_BIG_STRING)));
+	if (isBytes && (match(state, TOKEN_STRING) || match(state, TOKEN_BIG_STRING))) {
 		error("can not mix bytes and string literals");
 		goto _cleanupError;
 	}
@@ -1914,21 +2081,25 @@ static void string(int type) {
 		bytes->bytes = (uint8_t*)stringBytes;
 		bytes->length = stringLength;
 		krk_bytesUpdateHash(bytes);
-		emitConstant(OBJECT_VAL(bytes));
-		return;
+		return emitConstant(state, OBJECT_VAL(bytes));
 	}
 	if (!isFormat || stringLength || !atLeastOne) {
-		emitConstant(OBJECT_VAL(krk_copyString(stringBytes,stringLength)));
-		if (atLeastOne) emitByte(OP_ADD);
+		ind = emitConstant(state, OBJECT_VAL(krk_copyString(stringBytes,stringLength)));
+		if (atLeastOne) emitByte(state, OP_ADD);
 	}
 	FREE_ARRAY(char,stringBytes,stringCapacity);
 #undef PUSH_CHAR
-	return;
+	return ind;
 _cleanupError:
 	FREE_ARRAY(char,stringBytes,stringCapacity);
+	return -1;
 }
 
-static size_t addUpvalue(Compiler * compiler, ssize_t index, int isLocal) {
+static void string(struct GlobalState * state, int type) {
+	stringLiteral(state, type);
+}
+
+static size_t addUpvalue(struct GlobalState * state, Compiler * compiler, ssize_t index, int isLocal) {
 	size_t upvalueCount = compiler->function->upvalueCount;
 	for (size_t i = 0; i < upvalueCount; ++i) {
 		Upvalue * upvalue = &compiler->upvalues[i];
@@ -1946,138 +2117,196 @@ static size_t addUpvalue(Compiler * compiler, ssize_t index, int isLocal) {
 	return compiler->function->upvalueCount++;
 }
 
-static ssize_t resolveUpvalue(Compiler * compiler, KrkToken * name) {
+static ssize_t resolveUpvalue(struct GlobalState * state, Compiler * compiler, KrkToken * name) {
 	if (compiler->enclosing == NULL) return -1;
-	ssize_t local = resolveLocal(compiler->enclosing, name);
+	ssize_t local = resolveLocal(state, compiler->enclosing, name);
 	if (local != -1) {
 		compiler->enclosing->locals[local].isCaptured = 1;
-		return addUpvalue(compiler, local, 1);
+		return addUpvalue(state, compiler, local, 1);
 	}
-	ssize_t upvalue = resolveUpvalue(compiler->enclosing, name);
+	ssize_t upvalue = resolveUpvalue(state, compiler->enclosing, name);
 	if (upvalue != -1) {
-		return addUpvalue(compiler, upvalue, 0);
+		return addUpvalue(state, compiler, upvalue, 0);
 	}
 	return -1;
 }
 
 #define OP_NONE_LONG -1
 #define DO_VARIABLE(opset,opget,opdel) do { \
-	if (canAssign && match(TOKEN_EQUAL)) { \
-		expression(); \
+	if (canAssign && match(state, TOKEN_EQUAL)) { \
+		expression(state); \
 		EMIT_CONSTANT_OP(opset, arg); \
-	} else if (canAssign && matchAssignment()) { \
+	} else if (canAssign && matchAssignment(state)) { \
 		EMIT_CONSTANT_OP(opget, arg); \
-		assignmentValue(); \
+		assignmentValue(state); \
 		EMIT_CONSTANT_OP(opset, arg); \
-	} else if (inDel && matchEndOfDel()) {\
-		if (opdel == OP_NONE || !canAssign || inDel != 1) { error("Invalid del target"); } else { \
-		EMIT_CONSTANT_OP(opdel, arg); inDel = 2; } \
+	} else if (state->inDel && matchEndOfDel(state)) {\
+		if (opdel == OP_NONE || !canAssign || state->inDel != 1) { error("Invalid del target"); } else { \
+		EMIT_CONSTANT_OP(opdel, arg); state->inDel = 2; } \
 	} else { \
 		EMIT_CONSTANT_OP(opget, arg); \
 	} } while (0)
 
-static void namedVariable(KrkToken name, int canAssign) {
-	ssize_t arg = resolveLocal(current, &name);
+/* Calls to these builtins get OP_CALL_BUILTIN; returns the builtin's index, or -1. */
+static int inlineBuiltin(KrkToken * name) {
+	for (int i = 0; i < BUILTIN__MAX; ++i) {
+		const char * builtin = krk_inlineBuiltinNames[i];
+		if (name->length == strlen(builtin) && !memcmp(name->start, builtin, name->length)) return i;
+	}
+	return -1;
+}
+
+static void namedVariable(struct GlobalState * state, KrkToken name, int canAssign) {
+	ssize_t arg = resolveLocal(state, state->current, &name);
 	if (arg != -1) {
 		DO_VARIABLE(OP_SET_LOCAL, OP_GET_LOCAL, OP_NONE);
-	} else if ((arg = resolveUpvalue(current, &name)) != -1) {
+	} else if ((arg = resolveUpvalue(state, state->current, &name)) != -1) {
 		DO_VARIABLE(OP_SET_UPVALUE, OP_GET_UPVALUE, OP_NONE);
 	} else {
-		arg = identifierConstant(&name);
+		arg = identifierConstant(state, &name);
+		if (!state->inDel && arg < 256 && check(state, TOKEN_LEFT_PAREN)) {
+			int which = inlineBuiltin(&name);
+			if (which != -1) {
+				size_t chunkBefore = currentChunk(state)->count;
+				KrkScanner scannerBefore = krk_tellScanner(&state->scanner);
+				Parser parserBefore = state->parser;
+				advance(state);
+				size_t argCount = argumentList(state);
+				if (argCount < 256) {
+					emitBytes(state, OP_CALL_BUILTIN, which);
+					emitBytes(state, arg, argCount);
+					return;
+				}
+				/* Too many arguments for the operand; reparse as an ordinary call. */
+				krk_rewindScanner(&state->scanner, scannerBefore);
+				state->parser = parserBefore;
+				rewindChunk(state, chunkBefore);
+			}
+		}
 		DO_VARIABLE(OP_SET_GLOBAL, OP_GET_GLOBAL, OP_DEL_GLOBAL);
 	}
 }
 #undef DO_VARIABLE
 
-static void variable(int canAssign) {
-	namedVariable(parser.previous, canAssign);
+static void variable(struct GlobalState * state, int canAssign) {
+	namedVariable(state, state->parser.previous, canAssign);
 }
 
-static void self(int canAssign) {
-	if (currentClass == NULL) {
+static void self(struct GlobalState * state, int canAssign) {
+	if (state->currentClass == NULL) {
 		error("Invalid reference to `self` outside of a class method.");
 		return;
 	}
-	variable(0);
+	variable(state, 0);
 }
 
-static void super_(int canAssign) {
-	if (currentClass == NULL) {
+static void super_(struct GlobalState * state, int canAssign) {
+	if (state->currentClass == NULL) {
 		error("Invalid reference to `super` outside of a class.");
 	}
-	consume(TOKEN_LEFT_PAREN, "Expected `super` to be called.");
-	consume(TOKEN_RIGHT_PAREN, "`super` can not take arguments.");
-	consume(TOKEN_DOT, "Expected a field of `super()` to be referenced.");
-	consume(TOKEN_IDENTIFIER, "Expected a field name.");
-	size_t ind = identifierConstant(&parser.previous);
-	namedVariable(syntheticToken("self"), 0);
-	namedVariable(syntheticToken("super"), 0);
+	consume(state, TOKEN_LEFT_PAREN, "Expected `super` to be called.");
+	consume(state, TOKEN_RIGHT_PAREN, "`super` can not take arguments.");
+	consume(state, TOKEN_DOT, "Expected a field of `super()` to be referenced.");
+	consume(state, TOKEN_IDENTIFIER, "Expected a field name.");
+	size_t ind = identifierConstant(state, &state->parser.previous);
+	namedVariable(state, syntheticToken("self"), 0);
+	namedVariable(state, syntheticToken("super"), 0);
 	EMIT_CONSTANT_OP(OP_GET_SUPER, ind);
 }
 
-static void comprehension(KrkScanner scannerBefore, Parser parserBefore, const char buildFunc[], void (*inner)(ssize_t loopCounter)) {
-	/* Compile list comprehension as a function */
-	Compiler subcompiler;
-	initCompiler(&subcompiler, TYPE_FUNCTION);
-	subcompiler.function->chunk.filename = subcompiler.enclosing->function->chunk.filename;
+static void listInner(struct GlobalState * state, ssize_t indResult) {
+	expression(state);
+	EMIT_CONSTANT_OP(OP_LIST_APPEND, indResult);
+}
 
-	beginScope();
+static void setInner(struct GlobalState * state, ssize_t indResult) {
+	expression(state);
+	EMIT_CONSTANT_OP(OP_SET_ADD, indResult);
+}
 
-	/* for i=0, */
-	emitConstant(INTEGER_VAL(0));
-	size_t indLoopCounter = current->localCount;
-	addLocal(syntheticToken(""));
-	defineVariable(indLoopCounter);
+static void dictInner(struct GlobalState * state, ssize_t indResult) {
+	expression(state);
+	consume(state, TOKEN_COLON, "Expect colon after dict key.");
+	expression(state);
+	EMIT_CONSTANT_OP(OP_DICT_SET, indResult);
+}
+
+static void comprehension(struct GlobalState * state, KrkScanner scannerBefore, Parser parserBefore, const char buildFunc[], void (*inner)(struct GlobalState *, ssize_t indResult)) {
+	/* Comprehensions are compiled inline in the current function; the loop
+	 * variables, the result collection and the iterator are hidden locals
+	 * that OP_COMP_ENTER makes room for, and `inner` stores each produced
+	 * value directly into the result. */
+	beginScope(state);
+	size_t indBase = state->current->localCount;
 
 	/* x in... */
-	ssize_t loopInd = current->localCount;
+	ssize_t loopInd = state->current->localCount;
 	ssize_t varCount = 0;
 	do {
-		defineVariable(parseVariable("Expected name for iteration variable."));
-		emitByte(OP_NONE);
-		defineVariable(loopInd);
+		defineVariable(state, parseVariable(state, "Expected name for iteration variable."));
 		varCount++;
-	} while (match(TOKEN_COMMA));
+	} while (match(state, TOKEN_COMMA));
 
-	consume(TOKEN_IN, "Only iterator loops (for ... in ...) are allowed in comprehensions.");
+	size_t indResult = state->current->localCount;
+	addLocal(state, syntheticToken(""));
+	defineVariable(state, indResult);
 
-	beginScope();
-	parsePrecedence(PREC_OR); /* Otherwise we can get trapped on a ternary */
-	endScope();
+	size_t indLoopIter = state->current->localCount;
+	addLocal(state, syntheticToken(""));
+	defineVariable(state, indLoopIter);
 
-	/* iterable... */
-	size_t indLoopIter = current->localCount;
-	addLocal(syntheticToken(""));
-	defineVariable(indLoopIter);
+	/* The last slot holds the stack height to restore on exit */
+	addLocal(state, syntheticToken(""));
+	defineVariable(state, state->current->localCount - 1);
+
+	size_t reserved = state->current->localCount - indBase;
+	if (reserved > 255) {
+		error("Too many iteration variables in comprehension.");
+		return;
+	}
+	EMIT_CONSTANT_OP(OP_COMP_ENTER, indBase);
+	emitByte(state, reserved);
+
+	/* Start with an empty collection from listOf(), setOf() or dictOf() */
+	KrkToken collectionBuilder = syntheticToken(buildFunc);
+	size_t indBuilder = identifierConstant(state, &collectionBuilder);
+	EMIT_CONSTANT_OP(OP_GET_GLOBAL, indBuilder);
+	emitBytes(state, OP_CALL, 0);
+	EMIT_CONSTANT_OP(OP_SET_LOCAL, indResult);
+	emitByte(state, OP_POP);
 
-	/* Now try to call .__iter__ on the result to produce our iterator */
+	consume(state, TOKEN_IN, "Only iterator loops (for ... in ...) are allowed in comprehensions.");
+
+	beginScope(state);
+	parsePrecedence(state, PREC_OR); /* Otherwise we can get trapped on a ternary */
+	endScope(state);
+
+	/* If every value will be kept, size the list from the iterable up front */
+	if (inner == listInner && !check(state, TOKEN_IF)) {
+		EMIT_CONSTANT_OP(OP_LIST_RESERVE, indResult);
+	}
+
+	/* Now try to call .__iter__ on the iterable to produce our iterator */
 	KrkToken _iter = syntheticToken("__iter__");
-	ssize_t ind = identifierConstant(&_iter);
+	ssize_t ind = identifierConstant(state, &_iter);
 	EMIT_CONSTANT_OP(OP_GET_PROPERTY, ind);
-	emitBytes(OP_CALL, 0);
-
-	/* Assign the resulting iterator to indLoopIter */
+	emitBytes(state, OP_CALL, 0);
 	EMIT_CONSTANT_OP(OP_SET_LOCAL, indLoopIter);
+	emitByte(state, OP_POP);
 
 	/* Mark the start of the loop */
-	int loopStart = currentChunk()->count;
+	int loopStart = currentChunk(state)->count;
 
-	/* Call the iterator to get a value for our list */
+	/* Advance the iterator to get a value for our collection; our iterators
+	 * return themselves to say they are done, which OP_FOR_ITER checks
+	 * by identity, so they can still return None (or anything else
+	 * that happens to compare equal to them) without any issue. */
 	EMIT_CONSTANT_OP(OP_GET_LOCAL, indLoopIter);
-	emitBytes(OP_CALL, 0);
+	int exitJump = emitJump(state, OP_FOR_ITER);
 
 	/* Assign the result to our loop index */
 	EMIT_CONSTANT_OP(OP_SET_LOCAL, loopInd);
-
-	/* Compare the iterator to the loop index;
-	 * our iterators return themselves to say they are done;
-	 * this allows them to return None without any issue,
-	 * and there's no feasible way they can return themselves without
-	 * our intended sentinel meaning, right? Surely? */
-	EMIT_CONSTANT_OP(OP_GET_LOCAL, indLoopIter);
-	emitByte(OP_EQUAL);
-	int exitJump = emitJump(OP_JUMP_IF_TRUE);
-	emitByte(OP_POP);
+	emitByte(state, OP_POP);
 
 	/* Unpack tuple */
 	if (varCount > 1) {
@@ -2085,119 +2314,108 @@ static void comprehension(KrkScanner scannerBefore, Parser parserBefore, const c
 		EMIT_CONSTANT_OP(OP_UNPACK, varCount);
 		for (ssize_t i = loopInd + varCount - 1; i >= loopInd; i--) {
 			EMIT_CONSTANT_OP(OP_SET_LOCAL, i);
-			emitByte(OP_POP);
+			emitByte(state, OP_POP);
 		}
 	}
 
-	if (match(TOKEN_IF)) {
-		parsePrecedence(PREC_OR);
-		int acceptJump = emitJump(OP_JUMP_IF_TRUE);
-		emitByte(OP_POP); /* Pop condition */
-		emitLoop(loopStart);
-		patchJump(acceptJump);
-		emitByte(OP_POP); /* Pop condition */
+	if (match(state, TOKEN_IF)) {
+		parsePrecedence(state, PREC_OR);
+		int acceptJump = emitJump(state, OP_JUMP_IF_TRUE);
+		emitByte(state, OP_POP); /* Pop condition */
+		emitLoop(state, loopStart);
+		patchJump(state, acceptJump);
+		emitByte(state, OP_POP); /* Pop condition */
 	}
 
 	/* Now we can rewind the scanner to have it parse the original
 	 * expression that uses our iterated values! */
-	KrkScanner scannerAfter = krk_tellScanner();
-	Parser  parserAfter = parser;
-	krk_rewindScanner(scannerBefore);
-	parser = parserBefore;
+	KrkScanner scannerAfter = krk_tellScanner(&state->scanner);
+	Parser  parserAfter = state->parser;
+	krk_rewindScanner(&state->scanner, scannerBefore);
+	state->parser = parserBefore;
 
-	beginScope();
-	inner(indLoopCounter);
-	endScope();
+	beginScope(state);
+	inner(state, indResult);
+	endScope(state);
 
 	/* Then we can put the parser back to where it was at the end of
 	 * the iterator expression and continue. */
-	krk_rewindScanner(scannerAfter);
-	parser = parserAfter;
-
-	/* We keep a counter so we can keep track of how many arguments
-	 * are on the stack, which we need in order to find the listOf()
-	 * method above; having run the expression and generated an
-	 * item which is now on the stack, increment the counter */
-	EMIT_CONSTANT_OP(OP_INC, indLoopCounter);
+	krk_rewindScanner(&state->scanner, scannerAfter);
+	state->parser = parserAfter;
+
 	/* ... and loop back to the iterator call. */
-	emitLoop(loopStart);
+	emitLoop(state, loopStart);
 
 	/* Finally, at this point, we've seen the iterator produce itself
 	 * and we're done receiving objects, so mark this instruction
-	 * offset as the exit target for the OP_JUMP_IF_FALSE above */
-	patchJump(exitJump);
-	/* Pop the last loop expression result which was already stored */
-	emitByte(OP_POP);
-	/* Pull in listOf from the global namespace */
-	KrkToken collectionBuilder = syntheticToken(buildFunc);
-	size_t indList = identifierConstant(&collectionBuilder);
-	EMIT_CONSTANT_OP(OP_GET_GLOBAL, indList);
-	/* And move it into where we were storing the loop iterator */
-	EMIT_CONSTANT_OP(OP_SET_LOCAL, indLoopIter);
-	/* (And pop it from the top of the stack) */
-	emitByte(OP_POP);
-	/* Then get the counter for our arg count */
-	EMIT_CONSTANT_OP(OP_GET_LOCAL, indLoopCounter);
-	/* And then call the native method which should be ^ that many items down */
-	emitByte(OP_CALL_STACK);
-	/* And return the result back to the original scope */
-	emitByte(OP_RETURN);
-	/* Now because we made a function we need to fill out its upvalues
-	 * and write the closure call for it. */
-	KrkFunction *subfunction = endCompiler();
-	size_t indFunc = krk_addConstant(currentChunk(), OBJECT_VAL(subfunction));
-	EMIT_CONSTANT_OP(OP_CLOSURE, indFunc);
-	doUpvalues(&subcompiler, subfunction);
-	freeCompiler(&subcompiler);
-
-	/* And finally we can call the subfunction and get the result. */
-	emitBytes(OP_CALL, 0);
-}
-
-static void singleInner(ssize_t indLoopCounter) {
-	expression();
+	 * offset as the exit target for the OP_FOR_ITER above, which
+	 * has already popped the iterator value it was given. */
+	patchJump(state, exitJump);
+
+	/* Put the stack back the way we found it, with the result on top */
+	EMIT_CONSTANT_OP(OP_GET_LOCAL, indResult);
+	EMIT_CONSTANT_OP(OP_COMP_EXIT, indBase);
+	emitByte(state, reserved);
+
+	/* OP_COMP_EXIT already discarded our locals, so drop them without emitting pops */
+	for (size_t i = 0; i < state->current->function->localNameCount; i++) {
+		if (state->current->function->localNames[i].id >= indBase && state->current->function->localNames[i].deathday == 0) {
+			state->current->function->localNames[i].deathday = (size_t)currentChunk(state)->count;
+		}
+	}
+	state->current->localCount = indBase;
+	state->current->scopeDepth--;
 }
 
-static void grouping(int canAssign) {
-	startEatingWhitespace();
-	if (check(TOKEN_RIGHT_PAREN)) {
-		emitBytes(OP_TUPLE,0);
+static void grouping(struct GlobalState * state, int canAssign) {
+	startEatingWhitespace(state);
+	if (check(state, TOKEN_RIGHT_PAREN)) {
+		emitBytes(state, OP_TUPLE,0);
 	} else {
-		size_t chunkBefore = currentChunk()->count;
-		KrkScanner scannerBefore = krk_tellScanner();
-		Parser  parserBefore = parser;
-		expression();
-		if (match(TOKEN_FOR)) {
-			currentChunk()->count = chunkBefore;
-			comprehension(scannerBefore, parserBefore, "tupleOf", singleInner);
-		} else if (match(TOKEN_COMMA)) {
+		size_t chunkBefore = currentChunk(state)->count;
+		KrkScanner scannerBefore = krk_tellScanner(&state->scanner);
+		Parser  parserBefore = state->parser;
+		expression(state);
+		if (match(state, TOKEN_FOR)) {
+			rewindChunk(state, chunkBefore);
+			/* Collect into a list, then build the tuple as tupleOf(*l) */
+			comprehension(state, scannerBefore, parserBefore, "listOf", listInner);
+			KrkToken tupleOf = syntheticToken("tupleOf");
+			size_t ind = identifierConstant(state, &tupleOf);
+			EMIT_CONSTANT_OP(OP_GET_GLOBAL, ind); /* l t */
+			emitByte(state, OP_SWAP);                    /* t l */
+			emitBytes(state, OP_EXPAND_ARGS, 1);         /* t l * */
+			emitByte(state, OP_SWAP);                    /* t * l */
+			EMIT_CONSTANT_OP(OP_KWARGS, 1);
+			emitBytes(state, OP_CALL, 3);
+		} else if (match(state, TOKEN_COMMA)) {
 			size_t argCount = 1;
-			if (!check(TOKEN_RIGHT_PAREN)) {
+			if (!check(state, TOKEN_RIGHT_PAREN)) {
 				do {
-					expression();
+					expression(state);
 					argCount++;
-				} while (match(TOKEN_COMMA) && !check(TOKEN_RIGHT_PAREN));
+				} while (match(state, TOKEN_COMMA) && !check(state, TOKEN_RIGHT_PAREN));
 			}
 			EMIT_CONSTANT_OP(OP_TUPLE, argCount);
 		}
 	}
-	stopEatingWhitespace();
-	consume(TOKEN_RIGHT_PAREN, "Expect ')' after expression.");
+	stopEatingWhitespace(state);
+	consume(state, TOKEN_RIGHT_PAREN, "Expect ')' after expression.");
 }
 
-static void list(int canAssign) {
-	size_t     chunkBefore = currentChunk()->count;
+static void list(struct GlobalState * state, int canAssign) {
+	size_t     chunkBefore = currentChunk(state)->count;
 
-	startEatingWhitespace();
+	startEatingWhitespace(state);
 
 	KrkToken listOf = syntheticToken("listOf");
-	size_t ind = identifierConstant(&listOf);
+	size_t ind = identifierConstant(state, &listOf);
 	EMIT_CONSTANT_OP(OP_GET_GLOBAL, ind);
 
-	if (!check(TOKEN_RIGHT_SQUARE)) {
-		KrkScanner scannerBefore = krk_tellScanner();
-		Parser  parserBefore = parser;
-		expression();
+	if (!check(state, TOKEN_RIGHT_SQUARE)) {
+		KrkScanner scannerBefore = krk_tellScanner(&state->scanner);
+		Parser  parserBefore = state->parser;
+		expression(state);
 
 		/* This is a bit complicated and the Pratt parser does not handle it
 		 * well; if we read an expression and then saw a `for`, we need to back
@@ -2206,89 +2424,82 @@ static void list(int canAssign) {
 		 * reading the first expression of a list constant. If it _is_ a real
 		 * list constant, we'll see a comma next and we can begin the normal
 		 * loop of counting arguments. */
-		if (match(TOKEN_FOR)) {
+		if (match(state, TOKEN_FOR)) {
 			/* Roll back the earlier compiler */
-			currentChunk()->count = chunkBefore;
+			rewindChunk(state, chunkBefore);
 
-			comprehension(scannerBefore, parserBefore, "listOf", singleInner);
+			comprehension(state, scannerBefore, parserBefore, "listOf", listInner);
 		} else {
 			size_t argCount = 1;
-			while (match(TOKEN_COMMA) && !check(TOKEN_RIGHT_SQUARE)) {
-				expression();
+			while (match(state, TOKEN_COMMA) && !check(state, TOKEN_RIGHT_SQUARE)) {
+				expression(state);
 				argCount++;
 			}
 			EMIT_CONSTANT_OP(OP_CALL, argCount);
 		}
 	} else {
 		/* Empty list expression */
-		emitBytes(OP_CALL, 0);
+		emitBytes(state, OP_CALL, 0);
 	}
-	stopEatingWhitespace();
-	consume(TOKEN_RIGHT_SQUARE,"Expected ] at end of list expression.");
-}
-
-static void dictInner(ssize_t indLoopCounter) {
-	expression();
-	consume(TOKEN_COLON, "Expect colon after dict key.");
-	expression();
-	EMIT_CONSTANT_OP(OP_INC, indLoopCounter);
+	stopEatingWhitespace(state);
+	consume(state, TOKEN_RIGHT_SQUARE,"Expected ] at end of list expression.");
 }
 
-static void dict(int canAssign) {
-	size_t     chunkBefore = currentChunk()->count;
+static void dict(struct GlobalState * state, int canAssign) {
+	size_t     chunkBefore = currentChunk(state)->count;
 
-	startEatingWhitespace();
+	startEatingWhitespace(state);
 
 	KrkToken dictOf = syntheticToken("dictOf");
-	size_t ind = identifierConstant(&dictOf);
+	size_t ind = identifierConstant(state, &dictOf);
 	EMIT_CONSTANT_OP(OP_GET_GLOBAL, ind);
 
-	if (!check(TOKEN_RIGHT_BRACE)) {
-		KrkScanner scannerBefore = krk_tellScanner();
-		Parser  parserBefore = parser;
+	if (!check(state, TOKEN_RIGHT_BRACE)) {
+		KrkScanner scannerBefore = krk_tellScanner(&state->scanner);
+		Parser  parserBefore = state->parser;
 
-		expression();
-		if (match(TOKEN_COMMA) || match(TOKEN_RIGHT_BRACE)) {
-			krk_rewindScanner(scannerBefore);
-			parser = parserBefore;
-			currentChunk()->count = chunkBefore;
+		expression(state);
+		if (match(state, TOKEN_COMMA) || match(state, TOKEN_RIGHT_BRACE)) {
+			krk_rewindScanner(&state->scanner, scannerBefore);
+			state->parser = parserBefore;
+			rewindChunk(state, chunkBefore);
 			KrkToken setOf = syntheticToken("setOf");
-			size_t ind = identifierConstant(&setOf);
+			size_t ind = identifierConstant(state, &setOf);
 			EMIT_CONSTANT_OP(OP_GET_GLOBAL, ind);
 			size_t argCount = 0;
 			do {
-				expression();
+				expression(state);
 				argCount++;
-			} while (match(TOKEN_COMMA));
+			} while (match(state, TOKEN_COMMA));
 			EMIT_CONSTANT_OP(OP_CALL, argCount);
-		} else if (match(TOKEN_FOR)) {
-			currentChunk()->count = chunkBefore;
-			comprehension(scannerBefore, parserBefore, "setOf", singleInner);
+		} else if (match(state, TOKEN_FOR)) {
+			rewindChunk(state, chunkBefore);
+			comprehension(state, scannerBefore, parserBefore, "setOf", setInner);
 		} else {
-			consume(TOKEN_COLON, "Expect colon after dict key.");
-			expression();
+			consume(state, TOKEN_COLON, "Expect colon after dict key.");
+			expression(state);
 
-			if (match(TOKEN_FOR)) {
+			if (match(state, TOKEN_FOR)) {
 				/* Roll back the earlier compiler */
-				currentChunk()->count = chunkBefore;
+				rewindChunk(state, chunkBefore);
 
-				comprehension(scannerBefore, parserBefore, "dictOf", dictInner);
+				comprehension(state, scannerBefore, parserBefore, "dictOf", dictInner);
 			} else {
 				size_t argCount = 2;
-				while (match(TOKEN_COMMA) && !check(TOKEN_RIGHT_BRACE)) {
-					expression();
-					consume(TOKEN_COLON, "Expect colon after dict key.");
-					expression();
+				while (match(state, TOKEN_COMMA) && !check(state, TOKEN_RIGHT_BRACE)) {
+					expression(state);
+					consume(state, TOKEN_COLON, "Expect colon after dict key.");
+					expression(state);
 					argCount += 2;
 				}
 				EMIT_CONSTANT_OP(OP_CALL, argCount);
 			}
 		}
 	} else {
-		emitBytes(OP_CALL, 0);
+		emitBytes(state, OP_CALL, 0);
 	}
-	stopEatingWhitespace();
-	consume(TOKEN_RIGHT_BRACE,"Expected } at end of dict expression.");
+	stopEatingWhitespace(state);
+	consume(state, TOKEN_RIGHT_BRACE,"Expected } at end of dict expression.");
 }
 
 #define RULE(token, a, b, c) [token] = {# token, a, b, c}
@@ -2371,6 +2582,7 @@ ParseRule krk_parseRules[] = {
 	RULE(TOKEN_MODULO_EQUAL,  NULL,     NULL,   PREC_NONE),
 
 	RULE(TOKEN_LAMBDA,        lambda,   NULL,   PREC_NONE),
+	RULE(TOKEN_YIELD,         yield,    NULL,   PREC_NONE),
 
 	/* This is going to get interesting */
 	RULE(TOKEN_INDENTATION,   NULL,     NULL,   PREC_NONE),
@@ -2380,69 +2592,69 @@ ParseRule krk_parseRules[] = {
 	RULE(TOKEN_RETRY,         NULL,     NULL,   PREC_NONE),
 };
 
-static void actualTernary(size_t count, KrkScanner oldScanner, Parser oldParser) {
-	currentChunk()->count = count;
+static void actualTernary(struct GlobalState * state, size_t count, KrkScanner oldScanner, Parser oldParser) {
+	rewindChunk(state, count);
 
-	parsePrecedence(PREC_OR);
+	parsePrecedence(state, PREC_OR);
 
-	int thenJump = emitJump(OP_JUMP_IF_TRUE);
-	emitByte(OP_POP); /* Pop the condition */
-	consume(TOKEN_ELSE, "Expected 'else' after ternary condition");
+	int thenJump = emitJump(state, OP_JUMP_IF_TRUE);
+	emitByte(state, OP_POP); /* Pop the condition */
+	consume(state, TOKEN_ELSE, "Expected 'else' after ternary condition");
 
-	parsePrecedence(PREC_OR);
+	parsePrecedence(state, PREC_OR);
 
-	KrkScanner outScanner = krk_tellScanner();
-	Parser outParser = parser;
+	KrkScanner outScanner = krk_tellScanner(&state->scanner);
+	Parser outParser = state->parser;
 
-	int elseJump = emitJump(OP_JUMP);
-	patchJump(thenJump);
-	emitByte(OP_POP);
+	int elseJump = emitJump(state, OP_JUMP);
+	patchJump(state, thenJump);
+	emitByte(state, OP_POP);
 
-	krk_rewindScanner(oldScanner);
-	parser = oldParser;
-	parsePrecedence(PREC_OR);
-	patchJump(elseJump);
+	krk_rewindScanner(&state->scanner, oldScanner);
+	state->parser = oldParser;
+	parsePrecedence(state, PREC_OR);
+	patchJump(state, elseJump);
 
-	krk_rewindScanner(outScanner);
-	parser = outParser;
+	krk_rewindScanner(&state->scanner, outScanner);
+	state->parser = outParser;
 }
 
-static void parsePrecedence(Precedence precedence) {
-	size_t count = currentChunk()->count;
-	KrkScanner oldScanner = krk_tellScanner();
-	Parser oldParser = parser;
+static void parsePrecedence(struct GlobalState * state, Precedence precedence) {
+	size_t count = currentChunk(state)->count;
+	KrkScanner oldScanner = krk_tellScanner(&state->scanner);
+	Parser oldParser = state->parser;
 
-	advance();
-	ParseFn prefixRule = getRule(parser.previous.type)->prefix;
+	advance(state);
+	ParseFn prefixRule = getRule(state->parser.previous.type)->prefix;
 	if (prefixRule == NULL) {
 		errorAtCurrent("Unexpected token.");
 		return;
 	}
 	int canAssign = precedence <= PREC_ASSIGNMENT;
-	prefixRule(canAssign);
-	while (precedence <= getRule(parser.current.type)->precedence) {
-		advance();
-		ParseFn infixRule = getRule(parser.previous.type)->infix;
+	prefixRule(state, canAssign);
+	while (precedence <= getRule(state->parser.current.type)->precedence) {
+		advance(state);
+		ParseFn infixRule = getRule(state->parser.previous.type)->infix;
 		if (infixRule == ternary) {
-			actualTernary(count, oldScanner, oldParser);
+			actualTernary(state, count, oldScanner, oldParser);
 		} else {
-			infixRule(canAssign);
+			infixRule(state, canAssign);
 		}
 	}
 
-	if (canAssign && matchAssignment()) {
+	if (canAssign && matchAssignment(state)) {
 		error("invalid assignment target");
 	}
-	if (inDel == 1 && matchEndOfDel()) {
+	if (state->inDel == 1 && matchEndOfDel(state)) {
 		error("invalid del target");
 	}
 }
 
-static ssize_t identifierConstant(KrkToken * name) {
-	return krk_addConstant(currentChunk(), OBJECT_VAL(krk_copyString(name->start, name->length)));
+static ssize_t identifierConstant(struct GlobalState * state, KrkToken * name) {
+	return addConstant(state, OBJECT_VAL(krk_copyString(name->start, name->length)));
 }
 
-static ssize_t resolveLocal(Compiler * compiler, KrkToken * name) {
+static ssize_t resolveLocal(struct GlobalState * state, Compiler * compiler, KrkToken * name) {
 	for (ssize_t i = compiler->localCount - 1; i >= 0; i--) {
 		Local * local = &compiler->locals[i];
 		if (identifiersEqual(name, &local->name)) {
@@ -2455,92 +2667,96 @@ static ssize_t resolveLocal(Compiler * compiler, KrkToken * name) {
 	return -1;
 }
 
-static void addLocal(KrkToken name) {
-	if (current->localCount + 1 > current->localsSpace) {
-		size_t old = current->localsSpace;
-		current->localsSpace = GROW_CAPACITY(old);
-		current->locals = GROW_ARRAY(Local,current->locals,old,current->localsSpace);
+static void addLocal(struct GlobalState * state, KrkToken name) {
+	if (state->current->localCount + 1 > state->current->localsSpace) {
+		size_t old = state->current->localsSpace;
+		state->current->localsSpace = GROW_CAPACITY(old);
+		state->current->locals = GROW_ARRAY(Local,state->current->locals,old,state->current->localsSpace);
 	}
-	Local * local = &current->locals[current->localCount++];
+	Local * local = &state->current->locals[state->current->localCount++];
 	local->name = name;
 	local->depth = -1;
 	local->isCaptured = 0;
 
-	if (current->function->localNameCount + 1 > current->localNameCapacity) {
-		size_t old = current->localNameCapacity;
-		current->localNameCapacity = GROW_CAPACITY(old);
-		current->function->localNames = GROW_ARRAY(KrkLocalEntry, current->function->localNames, old, current->localNameCapacity);
+	if (state->current->function->localNameCount + 1 > state->current->localNameCapacity) {
+		size_t old = state->current->localNameCapacity;
+		state->current->localNameCapacity = GROW_CAPACITY(old);
+		state->current->function->localNames = GROW_ARRAY(KrkLocalEntry, state->current->function->localNames, old, state->current->localNameCapacity);
 	}
-	current->function->localNames[current->function->localNameCount].id = current->localCount-1;
-	current->function->localNames[current->function->localNameCount].birthday = currentChunk()->count;
-	current->function->localNames[current->function->localNameCount].deathday = 0;
-	current->function->localNames[current->function->localNameCount].name = krk_copyString(name.start, name.length);
-	current->function->localNameCount++;
+	state->current->function->localNames[state->current->function->localNameCount].id = state->current->localCount-1;
+	state->current->function->localNames[state->current->function->localNameCount].birthday = currentChunk(state)->count;
+	state->current->function->localNames[state->current->function->localNameCount].deathday = 0;
+	state->current->function->localNames[state->current->function->localNameCount].name = krk_copyString(name.start, name.length);
+	state->current->function->localNameCount++;
 }
 
-static void declareVariable() {
-	if (current->scopeDepth == 0) return;
-	KrkToken * name = &parser.previous;
+static void declareVariable(struct GlobalState * state) {
+	if (state->current->scopeDepth == 0) return;
+	KrkToken * name = &state->parser.previous;
 	/* Detect duplicate definition */
-	for (ssize_t i = current->localCount - 1; i >= 0; i--) {
-		Local * local = &current->locals[i];
-		if (local->depth != -1 && local->depth < (ssize_t)current->scopeDepth) break;
+	for (ssize_t i = state->current->localCount - 1; i >= 0; i--) {
+		Local * local = &state->current->locals[i];
+		if (local->depth != -1 && local->depth < (ssize_t)state->current->scopeDepth) break;
 		if (identifiersEqual(name, &local->name)) {
 			error("Duplicate definition for local '%.*s' in this scope.", (int)name->literalWidth, name->start);
 		}
 	}
-	addLocal(*name);
+	addLocal(state, *name);
 }
 
-static ssize_t parseVariable(const char * errorMessage) {
-	consume(TOKEN_IDENTIFIER, errorMessage);
+static ssize_t parseVariable(struct GlobalState * state, const char * errorMessage) {
+	consume(state, TOKEN_IDENTIFIER, errorMessage);
 
-	declareVariable();
-	if (current->scopeDepth > 0) return 0;
+	declareVariable(state);
+	if (state->current->scopeDepth > 0) return 0;
 
-	return identifierConstant(&parser.previous);
+	return identifierConstant(state, &state->parser.previous);
 }
 
-static void defineVariable(size_t global) {
-	if (current->scopeDepth > 0) {
-		markInitialized();
+static void defineVariable(struct GlobalState * state, size_t global) {
+	if (state->current->scopeDepth > 0) {
+		markInitialized(state);
 		return;
 	}
 
 	EMIT_CONSTANT_OP(OP_DEFINE_GLOBAL, global);
 }
 
-static void call(int canAssign) {
-	startEatingWhitespace();
+/**
+ * Compile the arguments of a call, after the opening parenthesis, and
+ * return the argument count for the CALL instruction.
+ */
+static size_t argumentList(struct GlobalState * state) {
+	startEatingWhitespace(state);
 	size_t argCount = 0, specialArgs = 0, keywordArgs = 0, seenKeywordUnpacking = 0;
-	if (!check(TOKEN_RIGHT_PAREN)) {
+	if (!check(state, TOKEN_RIGHT_PAREN)) {
 		do {
-			if (match(TOKEN_ASTERISK) || check(TOKEN_POW)) {
+			if (match(state, TOKEN_ASTERISK) || check(state, TOKEN_POW)) {
 				specialArgs++;
-				if (match(TOKEN_POW)) {
+				if (match(state, TOKEN_POW)) {
 					seenKeywordUnpacking = 1;
-					emitBytes(OP_EXPAND_ARGS, 2); /* Outputs something special */
-					expression(); /* Expect dict */
+					emitBytes(state, OP_EXPAND_ARGS, 2); /* Outputs something special */
+					expression(state); /* Expect dict */
 					continue;
 				} else {
 					if (seenKeywordUnpacking) {
 						error("Iterable expansion follows keyword argument unpacking.");
-						return;
+						return 0;
 					}
-					emitBytes(OP_EXPAND_ARGS, 1); /* outputs something special */
-					expression();
+					emitBytes(state, OP_EXPAND_ARGS, 1); /* outputs something special */
+					expression(state);
 					continue;
 				}
 			}
-			if (match(TOKEN_IDENTIFIER)) {
-				KrkToken argName = parser.previous;
-				if (check(TOKEN_EQUAL)) {
+			if (match(state, TOKEN_IDENTIFIER)) {
+				KrkToken argName = state->parser.previous;
+				if (check(state, TOKEN_EQUAL)) {
 					/* This is a keyword argument. */
-					advance();
+					advance(state);
 					/* Output the name */
-					size_t ind = identifierConstant(&argName);
+					size_t ind = identifierConstant(state, &argName);
 					EMIT_CONSTANT_OP(OP_CONSTANT, ind);
-					expression();
+					expression(state);
 					keywordArgs++;
 					specialArgs++;
 					continue;
@@ -2549,27 +2765,27 @@ static void call(int canAssign) {
 					 * This is a regular argument that happened to start with an identifier,
 					 * roll it back so we can process it that way.
 					 */
-					krk_ungetToken(parser.current);
-					parser.current = argName;
+					krk_ungetToken(&state->scanner, state->parser.current);
+					state->parser.current = argName;
 				}
 			} else if (seenKeywordUnpacking) {
 				error("positional argument follows keyword argument unpacking");
-				return;
+				return 0;
 			} else if (keywordArgs) {
 				error("Positional argument follows keyword argument");
-				return;
+				return 0;
 			} else if (specialArgs) {
-				emitBytes(OP_EXPAND_ARGS, 0);
-				expression();
+				emitBytes(state, OP_EXPAND_ARGS, 0);
+				expression(state);
 				specialArgs++;
 				continue;
 			}
-			expression();
+			expression(state);
 			argCount++;
-		} while (match(TOKEN_COMMA));
+		} while (match(state, TOKEN_COMMA));
 	}
-	stopEatingWhitespace();
-	consume(TOKEN_RIGHT_PAREN, "Expected ')' after arguments.");
+	stopEatingWhitespace(state);
+	consume(state, TOKEN_RIGHT_PAREN, "Expected ')' after arguments.");
 	if (specialArgs) {
 		/*
 		 * Creates a sentinel at the top of the stack to tell the CALL instruction
@@ -2586,85 +2802,95 @@ static void call(int canAssign) {
 		 */
 		argCount += 1 /* for the sentinel */ + 2 * specialArgs;
 	}
+	return argCount;
+}
+
+static void call(struct GlobalState * state, int canAssign) {
+	size_t argCount = argumentList(state);
+	state->current->lastCall = currentChunk(state)->count;
 	EMIT_CONSTANT_OP(OP_CALL, argCount);
 }
 
-static void and_(int canAssign) {
-	int endJump = emitJump(OP_JUMP_IF_FALSE);
-	emitByte(OP_POP);
-	parsePrecedence(PREC_AND);
-	patchJump(endJump);
+static void and_(struct GlobalState * state, int canAssign) {
+	int endJump = emitJump(state, OP_JUMP_IF_FALSE);
+	emitByte(state, OP_POP);
+	parsePrecedence(state, PREC_AND);
+	patchJump(state, endJump);
 }
 
-static void ternary(int canAssign) {
+static void ternary(struct GlobalState * state, int canAssign) {
 	error("This function should not run.");
 }
 
-static void or_(int canAssign) {
-	int endJump = emitJump(OP_JUMP_IF_TRUE);
-	emitByte(OP_POP);
-	parsePrecedence(PREC_OR);
-	patchJump(endJump);
+static void or_(struct GlobalState * state, int canAssign) {
+	int endJump = emitJump(state, OP_JUMP_IF_TRUE);
+	emitByte(state, OP_POP);
+	parsePrecedence(state, PREC_OR);
+	patchJump(state, endJump);
 }
 
 static ParseRule * getRule(KrkTokenType type) {
 	return &krk_parseRules[type];
 }
 
-#ifdef ENABLE_THREADING
-static volatile int _compilerLock = 0;
-#endif
-
 KrkFunction * krk_compile(const char * src, int newScope, char * fileName) {
-	_obtain_lock(_compilerLock);
+	GlobalState _state = {0};
+	GlobalState * state = &_state;
+	state->scanner = krk_initScanner(src);
+	state->enclosing = krk_currentThread.compilerState;
+	krk_currentThread.compilerState = state;
 
-	krk_initScanner(src);
 	Compiler compiler;
-	initCompiler(&compiler, TYPE_MODULE);
+	initCompiler(state, &compiler, TYPE_MODULE);
 	compiler.function->chunk.filename = krk_copyString(fileName, strlen(fileName));
 
-	if (newScope) beginScope();
+	if (newScope) beginScope(state);
 
-	parser.hadError = 0;
-	parser.panicMode = 0;
+	state->parser.hadError = 0;
+	state->parser.panicMode = 0;
 
-	advance();
+	advance(state);
 
 	if (krk_currentThread.module) {
 		KrkValue doc;
 		if (!krk_tableGet(&krk_currentThread.module->fields, OBJECT_VAL(krk_copyString("__doc__", 7)), &doc)) {
-			if (match(TOKEN_STRING) || match(TOKEN_BIG_STRING)) {
-				string(parser.previous.type == TOKEN_BIG_STRING);
-				krk_attachNamedObject(&krk_currentThread.module->fields, "__doc__",
-					(KrkObj*)AS_STRING(currentChunk()->constants.values[currentChunk()->constants.count-1]));
-				emitByte(OP_POP); /* string() actually put an instruction for that, pop its result */
-				consume(TOKEN_EOL,"Garbage after docstring");
+			if (match(state, TOKEN_STRING) || match(state, TOKEN_BIG_STRING)) {
+				ssize_t ind = stringLiteral(state, state->parser.previous.type == TOKEN_BIG_STRING);
+				if (ind >= 0 && IS_STRING(currentChunk(state)->constants.values[ind])) {
+					krk_attachNamedValue(&krk_currentThread.module->fields, "__doc__", currentChunk(state)->constants.values[ind]);
+				} else {
+					krk_attachNamedValue(&krk_currentThread.module->fields, "__doc__", NONE_VAL());
+				}
+				emitByte(state, OP_POP); /* string() actually put an instruction for that, pop its result */
+				consume(state, TOKEN_EOL,"Garbage after docstring");
 			} else {
 				krk_attachNamedValue(&krk_currentThread.module->fields, "__doc__", NONE_VAL());
 			}
 		}
 	}
 
-	while (!match(TOKEN_EOF)) {
-		declaration();
-		if (check(TOKEN_EOL) || check(TOKEN_INDENTATION) || check(TOKEN_EOF)) {
+	while (!match(state, TOKEN_EOF)) {
+		declaration(state);
+		if (check(state, TOKEN_EOL) || check(state, TOKEN_INDENTATION) || check(state, TOKEN_EOF)) {
 			/* There's probably already and error... */
-			advance();
+			advance(state);
 		}
 	}
 
-	KrkFunction * function = endCompiler();
+	KrkFunction * function = endCompiler(state);
 	freeCompiler(&compiler);
-	if (parser.hadError) function = NULL;
+	if (state->parser.hadError) function = NULL;
 
-	_release_lock(_compilerLock);
+	krk_currentThread.compilerState = state->enclosing;
 	return function;
 }
 
 void krk_markCompilerRoots() {
-	Compiler * compiler = current;
-	while (compiler != NULL) {
-		krk_markObject((KrkObj*)compiler->function);
-		compiler = compiler->enclosing;
+	for (KrkThreadState * thread = vm.threads; thread; thread = thread->next) {
+		for (GlobalState * state = thread->compilerState; state; state = state->enclosing) {
+			for (Compiler * compiler = state->current; compiler; compiler = compiler->enclosing) {
+				krk_markObject((KrkObj*)compiler->function);
+			}
+		}
 	}
 }
@@ -4,3 +4,6 @@
 
 extern KrkFunction * krk_compile(const char * src, int newScope, char * fileName);
 extern void krk_markCompilerRoots(void);
+
+/* optimizer.c */
+extern void krk_optimizeFunction(KrkFunction * function);
@@ -9,6 +9,11 @@ void krk_disassembleChunk(FILE * f, KrkFunction * func, const char * name) {
 	for (size_t offset = 0; offset < chunk->count;) {
 		offset = krk_disassembleInstruction(f, func, offset);
 	}
+	for (size_t i = 0; i < chunk->handlersCount; ++i) {
+		KrkExceptionHandler * handler = &chunk->handlers[i];
+		fprintf(f, "     try %d to %d -> %d (depth %d)\n", (int)handler->startOffset,
+			(int)handler->endOffset, (int)handler->target, (int)handler->stackDepth);
+	}
 }
 
 static inline const char * opcodeClean(const char * opc) {
@@ -42,6 +47,14 @@ static inline const char * opcodeClean(const char * opc) {
 	fprintf(f, "%-16s %4d -> %d", opcodeClean(#opc), (int)offset, (int)(offset + 3 sign jump)); \
 	size = 3; break; }
 
+#define COMPREHENSION(opc) case opc: { uint32_t operand = chunk->code[offset + 1]; \
+	fprintf(f, "%-16s %4d (%d slots)", opcodeClean(#opc), (int)operand, (int)chunk->code[offset + 2]); \
+	size = 3; break; } \
+	case opc ## _LONG: { uint32_t operand = (chunk->code[offset + 1] << 16) | \
+	(chunk->code[offset + 2] << 8) | (chunk->code[offset + 3]); \
+	fprintf(f, "%-16s %4d (%d slots)", opcodeClean(#opc "_LONG"), (int)operand, (int)chunk->code[offset + 4]); \
+	size = 5; break; }
+
 #define CLOSURE_MORE \
 	KrkFunction * function = AS_FUNCTION(chunk->constants.values[constant]); \
 	for (size_t j = 0; j < function->upvalueCount; ++j) { \
@@ -125,6 +138,18 @@ size_t krk_disassembleInstruction(FILE * f, KrkFunction * func, size_t offset) {
 		SIMPLE(OP_IS)
 		SIMPLE(OP_POW)
 		SIMPLE(OP_CREATE_PROPERTY)
+		SIMPLE(OP_INPLACE_ADD)
+		SIMPLE(OP_INPLACE_SUBTRACT)
+		SIMPLE(OP_INPLACE_MULTIPLY)
+		SIMPLE(OP_INPLACE_DIVIDE)
+		SIMPLE(OP_INPLACE_MODULO)
+		SIMPLE(OP_INPLACE_POW)
+		SIMPLE(OP_INPLACE_BITOR)
+		SIMPLE(OP_INPLACE_BITXOR)
+		SIMPLE(OP_INPLACE_BITAND)
+		SIMPLE(OP_INPLACE_SHIFTLEFT)
+		SIMPLE(OP_INPLACE_SHIFTRIGHT)
+		SIMPLE(OP_YIELD)
 		OPERANDB(OP_DUP,(void)0)
 		OPERANDB(OP_EXPAND_ARGS,EXPAND_ARGS_MORE)
 		CONSTANT(OP_DEFINE_GLOBAL,(void)0)
@@ -144,18 +169,41 @@ size_t krk_disassembleInstruction(FILE * f, KrkFunction * func, size_t offset) {
 		OPERAND(OP_KWARGS, (void)0)
 		OPERAND(OP_SET_LOCAL, LOCAL_MORE)
 		OPERAND(OP_GET_LOCAL, LOCAL_MORE)
+		OPERAND(OP_SET_LOCAL_POP, LOCAL_MORE)
 		OPERAND(OP_SET_UPVALUE, (void)0)
 		OPERAND(OP_GET_UPVALUE, (void)0)
 		OPERAND(OP_CALL, (void)0)
+		OPERAND(OP_TAIL_CALL, (void)0)
 		OPERAND(OP_INC, (void)0)
 		OPERAND(OP_TUPLE, (void)0)
 		OPERAND(OP_UNPACK, (void)0)
+		OPERAND(OP_LIST_APPEND, (void)0)
+		OPERAND(OP_DICT_SET, (void)0)
+		OPERAND(OP_SET_ADD, (void)0)
+		OPERAND(OP_LIST_RESERVE, (void)0)
+		case OP_GET_LOCAL_PAIR: {
+			fprintf(f, "%-16s %4d %4d", opcodeClean("OP_GET_LOCAL_PAIR"), (int)chunk->code[offset + 1], (int)chunk->code[offset + 2]);
+			size = 3; break; }
+		case OP_CALL_BUILTIN: {
+			size_t constant = chunk->code[offset + 2];
+			fprintf(f, "%-16s %4d ", opcodeClean("OP_CALL_BUILTIN"), (int)chunk->code[offset + 3]);
+			krk_printValueSafe(f, chunk->constants.values[constant]);
+			size = 4; break; }
+		case OP_GET_LOCAL_CONSTANT: {
+			size_t constant = chunk->code[offset + 2];
+			fprintf(f, "%-16s %4d %4d ", opcodeClean("OP_GET_LOCAL_CONSTANT"), (int)chunk->code[offset + 1], (int)constant);
+			krk_printValueSafe(f, chunk->constants.values[constant]);
+			size = 3; break; }
+		COMPREHENSION(OP_COMP_ENTER)
+		COMPREHENSION(OP_COMP_EXIT)
 		JUMP(OP_JUMP,+)
 		JUMP(OP_JUMP_IF_FALSE,+)
 		JUMP(OP_JUMP_IF_TRUE,+)
 		JUMP(OP_LOOP,-)
-		JUMP(OP_PUSH_TRY,+)
 		JUMP(OP_PUSH_WITH,+)
+		JUMP(OP_FOR_ITER,+)
+		JUMP(OP_POP_JUMP_IF_FALSE,+)
+		JUMP(OP_POP_JUMP_IF_TRUE,+)
 		SIMPLE(OP_CLEANUP_WITH)
 		default:
 			fprintf(f, "Unknown opcode: %02x", opcode);
@@ -180,3 +228,216 @@ size_t krk_disassembleInstruction(FILE * f, KrkFunction * func, size_t offset) {
 	return offset + size;
 }
 
+#ifdef ENABLE_OPCODE_STATS
+/**
+ * Opcode sequence counting, for choosing superinstructions.
+ *
+ * Built with KRK_ENABLE_OPCODE_STATS=1, the VM reports every opcode it
+ * executes here. At exit, the most common pairs and triples are printed to
+ * stderr, or every count is appended to the file named by $KUROKO_OPCODE_STATS
+ * so that several runs can be added up.
+ */
+static const char * opcodeNames[256] = {
+	[OP_CONSTANT] = "CONSTANT",
+	[OP_NEGATE] = "NEGATE",
+	[OP_RETURN] = "RETURN",
+	[OP_ADD] = "ADD",
+	[OP_SUBTRACT] = "SUBTRACT",
+	[OP_MULTIPLY] = "MULTIPLY",
+	[OP_DIVIDE] = "DIVIDE",
+	[OP_MODULO] = "MODULO",
+	[OP_NONE] = "NONE",
+	[OP_TRUE] = "TRUE",
+	[OP_FALSE] = "FALSE",
+	[OP_NOT] = "NOT",
+	[OP_POP] = "POP",
+	[OP_EQUAL] = "EQUAL",
+	[OP_GREATER] = "GREATER",
+	[OP_LESS] = "LESS",
+	[OP_DEFINE_GLOBAL] = "DEFINE_GLOBAL",
+	[OP_GET_GLOBAL] = "GET_GLOBAL",
+	[OP_SET_GLOBAL] = "SET_GLOBAL",
+	[OP_SET_LOCAL] = "SET_LOCAL",
+	[OP_GET_LOCAL] = "GET_LOCAL",
+	[OP_JUMP_IF_FALSE] = "JUMP_IF_FALSE",
+	[OP_JUMP_IF_TRUE] = "JUMP_IF_TRUE",
+	[OP_JUMP] = "JUMP",
+	[OP_LOOP] = "LOOP",
+	[OP_CALL] = "CALL",
+	[OP_CLOSURE] = "CLOSURE",
+	[OP_GET_UPVALUE] = "GET_UPVALUE",
+	[OP_SET_UPVALUE] = "SET_UPVALUE",
+	[OP_CLOSE_UPVALUE] = "CLOSE_UPVALUE",
+	[OP_CLASS] = "CLASS",
+	[OP_SET_PROPERTY] = "SET_PROPERTY",
+	[OP_GET_PROPERTY] = "GET_PROPERTY",
+	[OP_METHOD] = "METHOD",
+	[OP_IMPORT] = "IMPORT",
+	[OP_INHERIT] = "INHERIT",
+	[OP_GET_SUPER] = "GET_SUPER",
+	[OP_RAISE] = "RAISE",
+	[OP_DOCSTRING] = "DOCSTRING",
+	[OP_CALL_STACK] = "CALL_STACK",
+	[OP_INC] = "INC",
+	[OP_DUP] = "DUP",
+	[OP_SWAP] = "SWAP",
+	[OP_KWARGS] = "KWARGS",
+	[OP_POW] = "POW",
+	[OP_BITOR] = "BITOR",
+	[OP_BITXOR] = "BITXOR",
+	[OP_BITAND] = "BITAND",
+	[OP_SHIFTLEFT] = "SHIFTLEFT",
+	[OP_SHIFTRIGHT] = "SHIFTRIGHT",
+	[OP_BITNEGATE] = "BITNEGATE",
+	[OP_INVOKE_GETTER] = "INVOKE_GETTER",
+	[OP_INVOKE_SETTER] = "INVOKE_SETTER",
+	[OP_INVOKE_GETSLICE] = "INVOKE_GETSLICE",
+	[OP_EXPAND_ARGS] = "EXPAND_ARGS",
+	[OP_FINALIZE] = "FINALIZE",
+	[OP_TUPLE] = "TUPLE",
+	[OP_UNPACK] = "UNPACK",
+	[OP_PUSH_WITH] = "PUSH_WITH",
+	[OP_CLEANUP_WITH] = "CLEANUP_WITH",
+	[OP_IS] = "IS",
+	[OP_DEL_GLOBAL] = "DEL_GLOBAL",
+	[OP_DEL_PROPERTY] = "DEL_PROPERTY",
+	[OP_INVOKE_DELETE] = "INVOKE_DELETE",
+	[OP_IMPORT_FROM] = "IMPORT_FROM",
+	[OP_CREATE_PROPERTY] = "CREATE_PROPERTY",
+	[OP_INVOKE_DELSLICE] = "INVOKE_DELSLICE",
+	[OP_INVOKE_SETSLICE] = "INVOKE_SETSLICE",
+	[OP_FOR_ITER] = "FOR_ITER",
+	[OP_LIST_APPEND] = "LIST_APPEND",
+	[OP_DICT_SET] = "DICT_SET",
+	[OP_SET_ADD] = "SET_ADD",
+	[OP_LIST_RESERVE] = "LIST_RESERVE",
+	[OP_COMP_ENTER] = "COMP_ENTER",
+	[OP_COMP_EXIT] = "COMP_EXIT",
+	[OP_INPLACE_ADD] = "INPLACE_ADD",
+	[OP_INPLACE_SUBTRACT] = "INPLACE_SUBTRACT",
+	[OP_INPLACE_MULTIPLY] = "INPLACE_MULTIPLY",
+	[OP_INPLACE_DIVIDE] = "INPLACE_DIVIDE",
+	[OP_INPLACE_MODULO] = "INPLACE_MODULO",
+	[OP_INPLACE_POW] = "INPLACE_POW",
+	[OP_INPLACE_BITOR] = "INPLACE_BITOR",
+	[OP_INPLACE_BITXOR] = "INPLACE_BITXOR",
+	[OP_INPLACE_BITAND] = "INPLACE_BITAND",
+	[OP_INPLACE_SHIFTLEFT] = "INPLACE_SHIFTLEFT",
+	[OP_INPLACE_SHIFTRIGHT] = "INPLACE_SHIFTRIGHT",
+	[OP_YIELD] = "YIELD",
+	[OP_SET_LOCAL_POP] = "SET_LOCAL_POP",
+	[OP_GET_LOCAL_PAIR] = "GET_LOCAL_PAIR",
+	[OP_GET_LOCAL_CONSTANT] = "GET_LOCAL_CONSTANT",
+	[OP_POP_JUMP_IF_FALSE] = "POP_JUMP_IF_FALSE",
+	[OP_POP_JUMP_IF_TRUE] = "POP_JUMP_IF_TRUE",
+	[OP_CALL_BUILTIN] = "CALL_BUILTIN",
+	[OP_TAIL_CALL] = "TAIL_CALL",
+	[OP_CONSTANT_LONG] = "CONSTANT_LONG",
+	[OP_DEFINE_GLOBAL_LONG] = "DEFINE_GLOBAL_LONG",
+	[OP_GET_GLOBAL_LONG] = "GET_GLOBAL_LONG",
+	[OP_SET_GLOBAL_LONG] = "SET_GLOBAL_LONG",
+	[OP_SET_LOCAL_LONG] = "SET_LOCAL_LONG",
+	[OP_GET_LOCAL_LONG] = "GET_LOCAL_LONG",
+	[OP_CALL_LONG] = "CALL_LONG",
+	[OP_CLOSURE_LONG] = "CLOSURE_LONG",
+	[OP_GET_UPVALUE_LONG] = "GET_UPVALUE_LONG",
+	[OP_SET_UPVALUE_LONG] = "SET_UPVALUE_LONG",
+	[OP_CLASS_LONG] = "CLASS_LONG",
+	[OP_SET_PROPERTY_LONG] = "SET_PROPERTY_LONG",
+	[OP_GET_PROPERTY_LONG] = "GET_PROPERTY_LONG",
+	[OP_METHOD_LONG] = "METHOD_LONG",
+	[OP_IMPORT_LONG] = "IMPORT_LONG",
+	[OP_GET_SUPER_LONG] = "GET_SUPER_LONG",
+	[OP_INC_LONG] = "INC_LONG",
+	[OP_KWARGS_LONG] = "KWARGS_LONG",
+	[OP_TUPLE_LONG] = "TUPLE_LONG",
+	[OP_UNPACK_LONG] = "UNPACK_LONG",
+	[OP_DEL_GLOBAL_LONG] = "DEL_GLOBAL_LONG",
+	[OP_DEL_PROPERTY_LONG] = "DEL_PROPERTY_LONG",
+	[OP_IMPORT_FROM_LONG] = "IMPORT_FROM_LONG",
+	[OP_LIST_APPEND_LONG] = "LIST_APPEND_LONG",
+	[OP_DICT_SET_LONG] = "DICT_SET_LONG",
+	[OP_SET_ADD_LONG] = "SET_ADD_LONG",
+	[OP_LIST_RESERVE_LONG] = "LIST_RESERVE_LONG",
+	[OP_COMP_ENTER_LONG] = "COMP_ENTER_LONG",
+	[OP_COMP_EXIT_LONG] = "COMP_EXIT_LONG",
+	[OP_SET_LOCAL_POP_LONG] = "SET_LOCAL_POP_LONG",
+	[OP_TAIL_CALL_LONG] = "TAIL_CALL_LONG",
+};
+
+#define TRIPLE_SLOTS (1 << 16)
+
+static size_t pairCounts[256][256];
+static struct {
+	uint32_t key; /* 1 + (a << 16 | b << 8 | c), 0 if unused */
+	size_t count;
+} tripleCounts[TRIPLE_SLOTS];
+static uint8_t lastOpcodes[2];
+
+void krk_countOpcode(uint8_t opcode) {
+	pairCounts[lastOpcodes[1]][opcode]++;
+	uint32_t key = 1 + ((lastOpcodes[0] << 16) | (lastOpcodes[1] << 8) | opcode);
+	for (uint32_t slot = (key * 2654435761U) & (TRIPLE_SLOTS - 1);; slot = (slot + 1) & (TRIPLE_SLOTS - 1)) {
+		if (tripleCounts[slot].key == key || !tripleCounts[slot].key) {
+			tripleCounts[slot].key = key;
+			tripleCounts[slot].count++;
+			break;
+		}
+	}
+	lastOpcodes[0] = lastOpcodes[1];
+	lastOpcodes[1] = opcode;
+}
+
+static const char * opcodeName(uint8_t opcode) {
+	return opcodeNames[opcode] ? opcodeNames[opcode] : "(start)";
+}
+
+typedef struct {
+	size_t count;
+	uint32_t key;
+} Sequence;
+
+static int compareSequences(const void * a, const void * b) {
+	size_t x = ((const Sequence*)a)->count;
+	size_t y = ((const Sequence*)b)->count;
+	return (x < y) - (x > y);
+}
+
+static void printSequences(FILE * f, const char * title, Sequence * sequences, size_t count, size_t total, size_t limit, int width) {
+	qsort(sequences, count, sizeof(Sequence), compareSequences);
+	if (title) fprintf(f, "%s\n", title);
+	for (size_t i = 0; i < count && i < limit; ++i) {
+		uint32_t key = sequences[i].key;
+		if (title) fprintf(f, "%12zu %5.2f%%  ", sequences[i].count, 100.0 * sequences[i].count / total);
+		else fprintf(f, "%zu ", sequences[i].count);
+		if (width == 3) fprintf(f, "%s ", opcodeName(key >> 16));
+		fprintf(f, "%s %s\n", opcodeName((key >> 8) & 0xFF), opcodeName(key & 0xFF));
+	}
+}
+
+void krk_dumpOpcodeStats(void) {
+	Sequence * sequences = malloc(sizeof(Sequence) * TRIPLE_SLOTS);
+	size_t count = 0, total = 0;
+	for (int a = 0; a < 256; ++a) {
+		for (int b = 0; b < 256; ++b) {
+			if (!pairCounts[a][b] || count == TRIPLE_SLOTS) continue;
+			sequences[count++] = (Sequence){pairCounts[a][b], (a << 8) | b};
+			total += pairCounts[a][b];
+		}
+	}
+
+	char * path = getenv("KUROKO_OPCODE_STATS");
+	FILE * f = path ? fopen(path, "a") : NULL;
+	printSequences(f ? f : stderr, f ? NULL : "Most common opcode pairs:", sequences, count, total, f ? count : 30, 2);
+
+	count = 0;
+	for (size_t i = 0; i < TRIPLE_SLOTS; ++i) {
+		if (!tripleCounts[i].key) continue;
+		sequences[count++] = (Sequence){tripleCounts[i].count, tripleCounts[i].key - 1};
+	}
+	printSequences(f ? f : stderr, f ? NULL : "Most common opcode triples:", sequences, count, total, f ? count : 30, 3);
+
+	if (f) fclose(f);
+	free(sequences);
+}
+#endif
@@ -7,3 +7,8 @@
 extern void krk_disassembleChunk(FILE * f, KrkFunction * func, const char * name);
 extern size_t krk_disassembleInstruction(FILE * f, KrkFunction * func, size_t offset);
 extern size_t krk_lineNumber(KrkChunk * chunk, size_t offset);
+
+#ifdef ENABLE_OPCODE_STATS
+extern void krk_countOpcode(uint8_t opcode);
+extern void krk_dumpOpcodeStats(void);
+#endif
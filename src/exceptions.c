@@ -10,13 +10,110 @@
 	krk_finalizeClass(obj); \
 } while (0)
 
+/**
+ * Exceptions raised from C don't build their message up front. They keep
+ * either the C string krk_runtimeError formatted or the value whose repr
+ * is the message, and only turn it into the `arg` attribute the first time
+ * something asks for it. Most exceptions raised inside the VM are caught
+ * and discarded without anyone looking at their message.
+ */
+struct Exception {
+	KrkInstance inst;
+	char * message;  /* Owned copy of the formatted message, or NULL */
+	size_t length;
+	KrkValue reprOf; /* Otherwise, the message is repr() of this */
+	int hasReprOf;
+};
+
+static void _exception_gcscan(KrkInstance * _self) {
+	struct Exception * self = (struct Exception*)_self;
+	if (self->hasReprOf) krk_markValue(self->reprOf);
+}
+
+static void _exception_gcsweep(KrkInstance * _self) {
+	struct Exception * self = (struct Exception*)_self;
+	free(self->message);
+}
+
+/* Classes made with krk_newClass or `class` inherit the allocation size and these hooks. */
+static int isLazyException(KrkInstance * self) {
+	return self->_class->_ongcsweep == _exception_gcsweep;
+}
+
+/*
+ * Build the pending message, if there is one, and store it as `arg`.
+ * Returns 0 if the key's repr raised, leaving that exception to propagate
+ * like it would from str() on any other object.
+ */
+static int resolveMessage(struct Exception * self) {
+	if (self->message) {
+		KrkString * arg = krk_copyString(self->message, self->length);
+		free(self->message);
+		self->message = NULL;
+		krk_attachNamedObject(&self->inst.fields, "arg", (KrkObj*)arg);
+	} else if (self->hasReprOf) {
+		/* We may be asked while this exception is still being raised, such as for a traceback. */
+		int raising = krk_currentThread.flags & KRK_HAS_EXCEPTION;
+		KrkValue pending = krk_currentThread.currentException;
+		krk_currentThread.flags &= ~KRK_HAS_EXCEPTION;
+		krk_push(self->reprOf);
+		KrkValue arg = krk_callSimple(OBJECT_VAL(krk_getType(self->reprOf)->_reprer), 1, 0);
+		if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return 0;
+		krk_push(arg);
+		self->hasReprOf = 0;
+		self->reprOf = NONE_VAL();
+		krk_attachNamedValue(&self->inst.fields, "arg", arg);
+		krk_pop();
+		krk_currentThread.currentException = pending;
+		krk_currentThread.flags |= raising;
+	}
+	return 1;
+}
+
+static int exceptionArg(KrkInstance * self, KrkValue * out) {
+	if (krk_tableGet(&self->fields, OBJECT_VAL(S("arg")), out)) return 1;
+	if (!isLazyException(self) || !resolveMessage((struct Exception*)self)) return 0;
+	return krk_tableGet(&self->fields, OBJECT_VAL(S("arg")), out);
+}
+
+_noexport
+void _exception_setMessage(KrkInstance * self, const char * message, size_t length) {
+	if (!isLazyException(self)) {
+		krk_attachNamedObject(&self->fields, "arg", (KrkObj*)krk_copyString(message, length));
+		return;
+	}
+	struct Exception * exception = (struct Exception*)self;
+	exception->message = malloc(length + 1);
+	memcpy(exception->message, message, length);
+	exception->message[length] = '\0';
+	exception->length = length;
+}
+
+/**
+ * Raise a KeyError for a missing key. The message is the key's repr,
+ * which can mean calling managed code, so it is left until it's needed.
+ * If hashing the key already raised, that exception is kept instead.
+ */
+KrkValue krk_keyError(KrkValue key) {
+	if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return NONE_VAL();
+	krk_push(key);
+	KrkInstance * exceptionObject = krk_newInstance(vm.exceptions->keyError);
+	struct Exception * self = (struct Exception*)exceptionObject;
+	self->reprOf = key;
+	self->hasReprOf = 1;
+	krk_pop();
+	krk_currentThread.currentException = OBJECT_VAL(exceptionObject);
+	krk_currentThread.flags |= KRK_HAS_EXCEPTION;
+	return NONE_VAL();
+}
+
 /**
  * Exception.__init__(arg)
  */
 static KrkValue krk_initException(int argc, KrkValue argv[]) {
 	KrkInstance * self = AS_INSTANCE(argv[0]);
 
-	if (argc > 0) {
+	if (argc > 1) {
 		krk_attachNamedValue(&self->fields, "arg", argv[1]);
 	} else {
 		krk_attachNamedValue(&self->fields, "arg", NONE_VAL());
@@ -25,11 +122,18 @@ static KrkValue krk_initException(int argc, KrkValue argv[]) {
 	return argv[0];
 }
 
+/* Exception.arg, for exceptions that haven't made theirs yet */
+static KrkValue _exception_arg(int argc, KrkValue argv[]) {
+	KrkValue arg;
+	if (!exceptionArg(AS_INSTANCE(argv[0]), &arg)) return NONE_VAL();
+	return arg;
+}
+
 static KrkValue _exception_repr(int argc, KrkValue argv[]) {
 	KrkInstance * self = AS_INSTANCE(argv[0]);
 	/* .arg */
 	KrkValue arg;
-	if (!krk_tableGet(&self->fields, OBJECT_VAL(S("arg")), &arg) || IS_NONE(arg)) {
+	if (!exceptionArg(self, &arg) || IS_NONE(arg)) {
 		return OBJECT_VAL(self->_class->name);
 	} else {
 		krk_push(OBJECT_VAL(self->_class->name));
@@ -49,7 +153,7 @@ static KrkValue _syntaxerror_repr(int argc, KrkValue argv[]) {
 	if (!krk_tableGet(&self->fields, OBJECT_VAL(S("line")), &line) || !IS_STRING(line)) goto _badSyntaxError;
 	if (!krk_tableGet(&self->fields, OBJECT_VAL(S("lineno")), &lineno) || !IS_INTEGER(lineno)) goto _badSyntaxError;
 	if (!krk_tableGet(&self->fields, OBJECT_VAL(S("colno")), &colno) || !IS_INTEGER(colno)) goto _badSyntaxError;
-	if (!krk_tableGet(&self->fields, OBJECT_VAL(S("arg")), &arg) || !IS_STRING(arg)) goto _badSyntaxError;
+	if (!exceptionArg(self, &arg) || !IS_STRING(arg)) goto _badSyntaxError;
 	if (!krk_tableGet(&self->fields, OBJECT_VAL(S("func")), &func)) goto _badSyntaxError;
 
 	if (AS_INTEGER(colno) <= 0) colno = INTEGER_VAL(1);
@@ -84,9 +188,13 @@ _noexport
 void _createAndBind_exceptions(void) {
 	/* Add exception classes */
 	ADD_EXCEPTION_CLASS(vm.exceptions->baseException, "Exception", vm.baseClasses->objectClass);
+	vm.exceptions->baseException->allocSize = sizeof(struct Exception);
+	vm.exceptions->baseException->_ongcscan = _exception_gcscan;
+	vm.exceptions->baseException->_ongcsweep = _exception_gcsweep;
 	/* base exception class gets an init that takes an optional string */
 	krk_defineNative(&vm.exceptions->baseException->methods, ".__init__", krk_initException);
 	krk_defineNative(&vm.exceptions->baseException->methods, ".__repr__", _exception_repr);
+	krk_defineNative(&vm.exceptions->baseException->methods, ":arg", _exception_arg);
 	krk_finalizeClass(vm.exceptions->baseException);
 	ADD_EXCEPTION_CLASS(vm.exceptions->typeError, "TypeError", vm.exceptions->baseException);
 	ADD_EXCEPTION_CLASS(vm.exceptions->argumentError, "ArgumentError", vm.exceptions->baseException);
@@ -101,6 +209,7 @@ void _createAndBind_exceptions(void) {
 	ADD_EXCEPTION_CLASS(vm.exceptions->zeroDivisionError, "ZeroDivisionError", vm.exceptions->baseException);
 	ADD_EXCEPTION_CLASS(vm.exceptions->notImplementedError, "NotImplementedError", vm.exceptions->baseException);
 	ADD_EXCEPTION_CLASS(vm.exceptions->syntaxError, "SyntaxError", vm.exceptions->baseException);
+	ADD_EXCEPTION_CLASS(vm.exceptions->memoryError, "MemoryError", vm.exceptions->baseException);
 	krk_defineNative(&vm.exceptions->syntaxError->methods, ".__repr__", _syntaxerror_repr);
 	krk_finalizeClass(vm.exceptions->syntaxError);
 }
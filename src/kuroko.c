@@ -85,12 +85,12 @@ static void tab_complete_func(rline_context_t * c) {
 		memcpy(tmp, c->buffer, c->offset);
 		tmp[c->offset] = '\0';
 		/* and pass it to the scanner... */
-		krk_initScanner(tmp);
+		KrkScanner scanner = krk_initScanner(tmp);
 		/* Logically, there can be at most (offset) tokens, plus some wiggle room. */
 		KrkToken * space = malloc(sizeof(KrkToken) * (c->offset + 2));
 		int count = 0;
 		do {
-			space[count++] = krk_scanToken();
+			space[count++] = krk_scanToken(&scanner);
 		} while (space[count-1].type != TOKEN_EOF && space[count-1].type != TOKEN_ERROR);
 
 		/* If count == 1, it was EOF or an error and we have nothing to complete. */
@@ -105,7 +105,7 @@ static void tab_complete_func(rline_context_t * c) {
 			/* Dots we need to look back at the previous tokens for */
 			n--;
 			base--;
-		} else if (space[count-base].type >= TOKEN_IDENTIFIER && space[count-base].type <= TOKEN_WITH) {
+		} else if (space[count-base].type >= TOKEN_IDENTIFIER && space[count-base].type <= TOKEN_YIELD) {
 			/* Something alphanumeric; only for the last element */
 		} else {
 			/* Some other symbol */
@@ -315,9 +315,9 @@ static void findInterpreter(char * argv[]) {
 #endif
 }
 
-static int runString(char * argv[], char * string) {
+static int runString(char * argv[], int flags, char * string) {
 	findInterpreter(argv);
-	krk_initVM(0);
+	krk_initVM(flags);
 	krk_interpret(string, 1, "<stdin>","<stdin>");
 	krk_freeVM();
 	return 0;
@@ -337,10 +337,10 @@ int main(int argc, char * argv[]) {
 	int flags = 0;
 	int moduleAsMain = 0;
 	int opt;
-	while ((opt = getopt(argc, argv, "c:dgm:rstMV-:")) != -1) {
+	while ((opt = getopt(argc, argv, "c:dgm:rstMOV-:")) != -1) {
 		switch (opt) {
 			case 'c':
-				return runString(argv, optarg);
+				return runString(argv, flags, optarg);
 			case 'd':
 				/* Disassemble code blocks after compilation. */
 				flags |= KRK_ENABLE_DISASSEMBLY;
@@ -349,6 +349,10 @@ int main(int argc, char * argv[]) {
 				/* Always garbage collect during an allocation. */
 				flags |= KRK_ENABLE_STRESS_GC;
 				break;
+			case 'O':
+				/* Run the bytecode optimizer on compiled functions. */
+				flags |= KRK_ENABLE_OPTIMIZER;
+				break;
 			case 's':
 				/* Print debug information during compilation. */
 				flags |= KRK_ENABLE_SCAN_TRACING;
@@ -365,12 +369,12 @@ int main(int argc, char * argv[]) {
 				enableRline = 0;
 				break;
 			case 'M':
-				return runString(argv,"import kuroko; print(kuroko.module_paths)\n");
+				return runString(argv,0,"import kuroko; print(kuroko.module_paths)\n");
 			case 'V':
-				return runString(argv,"import kuroko; print('Kuroko',kuroko.version)\n");
+				return runString(argv,0,"import kuroko; print('Kuroko',kuroko.version)\n");
 			case '-':
 				if (!strcmp(optarg,"version")) {
-					return runString(argv,"import kuroko; print('Kuroko',kuroko.version)\n");
+					return runString(argv,0,"import kuroko; print('Kuroko',kuroko.version)\n");
 				} else if (!strcmp(optarg,"help")) {
 					fprintf(stderr,"usage: %s [flags] [FILE...]\n"
 						"\n"
@@ -378,6 +382,7 @@ int main(int argc, char * argv[]) {
 						" -d          Debug output from the bytecode compiler.\n"
 						" -g          Collect garbage on every allocation.\n"
 						" -m mod      Run a module as a script.\n"
+						" -O          Optimize bytecode after compilation.\n"
 						" -r          Disable complex line editing in the REPL.\n"
 						" -s          Debug output from the scanner/tokenizer.\n"
 						" -t          Disassemble instructions as they are exceuted.\n"
@@ -422,6 +427,12 @@ _finishArgs:
 	BUNDLED(os);
 	BUNDLED(time);
 	BUNDLED(math);
+	BUNDLED(_collections);
+	BUNDLED(array);
+	BUNDLED(heapq);
+	BUNDLED(bisect);
+	BUNDLED(itertools);
+	BUNDLED(tokenize);
 #endif
 
 	KrkValue result = INTEGER_VAL(0);
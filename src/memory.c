@@ -282,6 +282,11 @@ static void markRoots() {
 			krk_markValue(vm.specialMethodNames[i]);
 		}
 	}
+
+	/* Keep these alive even if they are deleted from builtins, so their addresses can't be reused. */
+	for (int i = 0; i < BUILTIN__MAX; ++i) {
+		if (vm.inlineBuiltins[i]) krk_markObject(vm.inlineBuiltins[i]);
+	}
 }
 
 size_t krk_collectGarbage(void) {
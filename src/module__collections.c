@@ -0,0 +1,1172 @@
+/**
+ * Native implementations of container types for the collections module.
+ *
+ * collections.krk imports these and re-exports them, so this module is
+ * not normally imported directly.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "vm.h"
+#include "value.h"
+#include "object.h"
+#include "memory.h"
+#include "util.h"
+
+/**
+ * deque is a ring buffer: values[(head + i) & (capacity - 1)] is element i.
+ * The capacity is always zero or a power of two so wrapping is just a mask,
+ * and both ends can grow or shrink in constant time.
+ */
+static KrkClass * deque = NULL;
+struct Deque {
+	KrkInstance inst;
+	KrkValue * values;
+	size_t capacity;
+	size_t head;
+	size_t count;
+	int bounded; /* zeroed instances are unbounded */
+	krk_integer_type maxlen;
+};
+
+#define IS_deque(o) (krk_isInstanceOf(o,deque))
+#define AS_deque(o) ((struct Deque*)AS_OBJECT(o))
+
+static KrkClass * dequeiterator = NULL;
+struct DequeIterator {
+	KrkInstance inst;
+	KrkValue d;
+	size_t i;
+};
+
+#define IS_dequeiterator(o) (krk_isInstanceOf(o,dequeiterator))
+#define AS_dequeiterator(o) ((struct DequeIterator*)AS_OBJECT(o))
+
+#define DEQUE_AT(self,i) ((self)->values[((self)->head + (i)) & ((self)->capacity - 1)])
+
+static void _deque_gcscan(KrkInstance * _self) {
+	struct Deque * self = (struct Deque*)_self;
+	for (size_t i = 0; i < self->count; ++i) {
+		krk_markValue(DEQUE_AT(self,i));
+	}
+}
+
+static void _deque_gcsweep(KrkInstance * _self) {
+	struct Deque * self = (struct Deque*)_self;
+	FREE_ARRAY(KrkValue, self->values, self->capacity);
+}
+
+static void _dequeiterator_gcscan(KrkInstance * self) {
+	krk_markValue(((struct DequeIterator*)self)->d);
+}
+
+/* Make room for at least one more element, unwrapping into the new buffer. */
+static void dequeGrow(struct Deque * self) {
+	if (self->count < self->capacity) return;
+	size_t old = self->capacity;
+	size_t capacity = GROW_CAPACITY(old);
+	KrkValue * values = GROW_ARRAY(KrkValue, NULL, 0, capacity);
+	for (size_t i = 0; i < self->count; ++i) {
+		values[i] = DEQUE_AT(self,i);
+	}
+	FREE_ARRAY(KrkValue, self->values, old);
+	self->values = values;
+	self->capacity = capacity;
+	self->head = 0;
+}
+
+static void dequePushBack(struct Deque * self, KrkValue value) {
+	dequeGrow(self);
+	DEQUE_AT(self,self->count) = value;
+	self->count++;
+}
+
+static void dequePushFront(struct Deque * self, KrkValue value) {
+	dequeGrow(self);
+	self->head = (self->head - 1) & (self->capacity - 1);
+	self->values[self->head] = value;
+	self->count++;
+}
+
+static KrkValue dequePopBack(struct Deque * self) {
+	self->count--;
+	return DEQUE_AT(self,self->count);
+}
+
+static KrkValue dequePopFront(struct Deque * self) {
+	KrkValue out = self->values[self->head];
+	self->head = (self->head + 1) & (self->capacity - 1);
+	self->count--;
+	return out;
+}
+
+static void dequeAppend(struct Deque * self, KrkValue value) {
+	if (self->bounded) {
+		if (self->maxlen == 0) return;
+		if ((krk_integer_type)self->count == self->maxlen) dequePopFront(self);
+	}
+	dequePushBack(self, value);
+}
+
+static void dequeAppendLeft(struct Deque * self, KrkValue value) {
+	if (self->bounded) {
+		if (self->maxlen == 0) return;
+		if ((krk_integer_type)self->count == self->maxlen) dequePopBack(self);
+	}
+	dequePushFront(self, value);
+}
+
+/* Remove element i, shifting whichever side of it is shorter. */
+static void dequeDelete(struct Deque * self, size_t index) {
+	if (index < self->count / 2) {
+		for (size_t i = index; i > 0; --i) {
+			DEQUE_AT(self,i) = DEQUE_AT(self,i-1);
+		}
+		dequePopFront(self);
+	} else {
+		for (size_t i = index; i + 1 < self->count; ++i) {
+			DEQUE_AT(self,i) = DEQUE_AT(self,i+1);
+		}
+		dequePopBack(self);
+	}
+}
+
+static int dequeExtendCallback(void * context, const KrkValue * values, size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		dequeAppend(context, values[i]);
+	}
+	return 0;
+}
+
+static int dequeExtendLeftCallback(void * context, const KrkValue * values, size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		dequeAppendLeft(context, values[i]);
+	}
+	return 0;
+}
+
+/*
+ * Extending a deque by itself would keep reading what it just appended,
+ * so take a snapshot of the current contents first. The snapshot is a
+ * tuple on the stack so anything popped off a bounded deque stays alive.
+ */
+static int dequeExtend(struct Deque * self, KrkValue iterable, int (*callback)(void *, const KrkValue *, size_t)) {
+	if (IS_OBJECT(iterable) && AS_OBJECT(iterable) == (KrkObj*)self) {
+		KrkTuple * snapshot = krk_newTuple(self->count);
+		krk_push(OBJECT_VAL(snapshot));
+		for (size_t i = 0; i < self->count; ++i) {
+			snapshot->values.values[snapshot->values.count++] = DEQUE_AT(self,i);
+		}
+		callback(self, snapshot->values.values, snapshot->values.count);
+		krk_pop();
+		return 0;
+	}
+	return krk_unpackIterable(iterable, self, callback);
+}
+
+#define CURRENT_CTYPE struct Deque *
+#define CURRENT_NAME  self
+
+#define DEQUE_WRAP_INDEX() \
+	if (index < 0) index += self->count; \
+	if (index < 0 || index >= (krk_integer_type)self->count) return krk_runtimeError(vm.exceptions->indexError, "deque index out of range")
+
+KRK_METHOD(deque,__init__,{
+	METHOD_TAKES_AT_MOST(2);
+	KrkValue iterable = argc > 1 ? argv[1] : NONE_VAL();
+	KrkValue maxlen = argc > 2 ? argv[2] : NONE_VAL();
+	if (hasKw) {
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("iterable")), &iterable);
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("maxlen")), &maxlen);
+	}
+	if (IS_NONE(maxlen)) {
+		self->bounded = 0;
+		self->maxlen = 0;
+	} else if (IS_INTEGER(maxlen)) {
+		if (AS_INTEGER(maxlen) < 0) return krk_runtimeError(vm.exceptions->valueError, "maxlen must be non-negative");
+		self->bounded = 1;
+		self->maxlen = AS_INTEGER(maxlen);
+	} else {
+		return krk_runtimeError(vm.exceptions->typeError, "maxlen must be int, not '%s'", krk_typeName(maxlen));
+	}
+	self->count = 0;
+	self->head = 0;
+	if (!IS_NONE(iterable) && krk_unpackIterable(iterable, self, dequeExtendCallback)) return NONE_VAL();
+	return argv[0];
+})
+
+KRK_METHOD(deque,maxlen,{
+	METHOD_TAKES_NONE();
+	return self->bounded ? INTEGER_VAL(self->maxlen) : NONE_VAL();
+})
+
+KRK_METHOD(deque,__len__,{
+	METHOD_TAKES_NONE();
+	return INTEGER_VAL(self->count);
+})
+
+KRK_METHOD(deque,append,{
+	METHOD_TAKES_EXACTLY(1);
+	dequeAppend(self, argv[1]);
+})
+
+KRK_METHOD(deque,appendleft,{
+	METHOD_TAKES_EXACTLY(1);
+	dequeAppendLeft(self, argv[1]);
+})
+
+KRK_METHOD(deque,extend,{
+	METHOD_TAKES_EXACTLY(1);
+	dequeExtend(self, argv[1], dequeExtendCallback);
+})
+
+KRK_METHOD(deque,__iadd__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (dequeExtend(self, argv[1], dequeExtendCallback)) return NONE_VAL();
+	return argv[0];
+})
+
+KRK_METHOD(deque,extendleft,{
+	METHOD_TAKES_EXACTLY(1);
+	dequeExtend(self, argv[1], dequeExtendLeftCallback);
+})
+
+KRK_METHOD(deque,pop,{
+	METHOD_TAKES_NONE();
+	if (!self->count) return krk_runtimeError(vm.exceptions->indexError, "pop from empty deque");
+	return dequePopBack(self);
+})
+
+KRK_METHOD(deque,popleft,{
+	METHOD_TAKES_NONE();
+	if (!self->count) return krk_runtimeError(vm.exceptions->indexError, "pop from empty deque");
+	return dequePopFront(self);
+})
+
+KRK_METHOD(deque,clear,{
+	METHOD_TAKES_NONE();
+	self->count = 0;
+	self->head = 0;
+})
+
+KRK_METHOD(deque,copy,{
+	METHOD_TAKES_NONE();
+	struct Deque * out = (struct Deque*)krk_newInstance(krk_getType(argv[0]));
+	krk_push(OBJECT_VAL(out));
+	out->bounded = self->bounded;
+	out->maxlen = self->maxlen;
+	out->capacity = self->capacity;
+	out->values = GROW_ARRAY(KrkValue, NULL, 0, out->capacity);
+	for (size_t i = 0; i < self->count; ++i) {
+		out->values[i] = DEQUE_AT(self,i);
+	}
+	out->count = self->count;
+	return krk_pop();
+})
+
+KRK_METHOD(deque,count,{
+	METHOD_TAKES_EXACTLY(1);
+	krk_integer_type count = 0;
+	for (size_t i = 0; i < self->count; ++i) {
+		if (krk_valuesEqual(DEQUE_AT(self,i), argv[1])) count++;
+	}
+	return INTEGER_VAL(count);
+})
+
+KRK_METHOD(deque,index,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(3);
+	krk_integer_type start = 0;
+	krk_integer_type stop = self->count;
+	if (argc > 2 && !IS_NONE(argv[2])) {
+		if (!IS_INTEGER(argv[2])) return TYPE_ERROR(int,argv[2]);
+		start = AS_INTEGER(argv[2]);
+		if (start < 0) start += self->count;
+		if (start < 0) start = 0;
+	}
+	if (argc > 3 && !IS_NONE(argv[3])) {
+		if (!IS_INTEGER(argv[3])) return TYPE_ERROR(int,argv[3]);
+		stop = AS_INTEGER(argv[3]);
+		if (stop < 0) stop += self->count;
+		if (stop > (krk_integer_type)self->count) stop = self->count;
+	}
+	for (krk_integer_type i = start; i < stop; ++i) {
+		if (krk_valuesEqual(DEQUE_AT(self,i), argv[1])) return INTEGER_VAL(i);
+	}
+	return krk_runtimeError(vm.exceptions->valueError, "value not found");
+})
+
+KRK_METHOD(deque,insert,{
+	METHOD_TAKES_EXACTLY(2);
+	CHECK_ARG(1,int,krk_integer_type,index);
+	if (self->bounded && (krk_integer_type)self->count == self->maxlen) return krk_runtimeError(vm.exceptions->indexError, "attempt to grow bounded deque beyond bound");
+	if (index < 0) index += self->count;
+	if (index < 0) index = 0;
+	if (index > (krk_integer_type)self->count) index = self->count;
+	if (index < (krk_integer_type)self->count / 2) {
+		dequePushFront(self, NONE_VAL());
+		for (krk_integer_type i = 0; i < index; ++i) {
+			DEQUE_AT(self,i) = DEQUE_AT(self,i+1);
+		}
+	} else {
+		dequePushBack(self, NONE_VAL());
+		for (krk_integer_type i = self->count - 1; i > index; --i) {
+			DEQUE_AT(self,i) = DEQUE_AT(self,i-1);
+		}
+	}
+	DEQUE_AT(self,index) = argv[2];
+})
+
+KRK_METHOD(deque,remove,{
+	METHOD_TAKES_EXACTLY(1);
+	for (size_t i = 0; i < self->count; ++i) {
+		if (krk_valuesEqual(DEQUE_AT(self,i), argv[1])) {
+			dequeDelete(self, i);
+			return NONE_VAL();
+		}
+	}
+	return krk_runtimeError(vm.exceptions->valueError, "value not found");
+})
+
+KRK_METHOD(deque,rotate,{
+	METHOD_TAKES_AT_MOST(1);
+	krk_integer_type n = 1;
+	if (argc > 1) {
+		CHECK_ARG(1,int,krk_integer_type,_n);
+		n = _n;
+	}
+	if (self->count < 2) return NONE_VAL();
+	krk_integer_type count = self->count;
+	n %= count;
+	if (n < 0) n += count;
+	if (n == 0) return NONE_VAL();
+	if (self->count == self->capacity) {
+		/* A full ring rotates by moving the head */
+		self->head = (self->head - n) & (self->capacity - 1);
+	} else if (n <= count / 2) {
+		for (krk_integer_type i = 0; i < n; ++i) {
+			dequePushFront(self, dequePopBack(self));
+		}
+	} else {
+		for (krk_integer_type i = 0; i < count - n; ++i) {
+			dequePushBack(self, dequePopFront(self));
+		}
+	}
+})
+
+KRK_METHOD(deque,reverse,{
+	METHOD_TAKES_NONE();
+	for (size_t i = 0; i < self->count / 2; ++i) {
+		KrkValue tmp = DEQUE_AT(self,i);
+		DEQUE_AT(self,i) = DEQUE_AT(self,self->count-i-1);
+		DEQUE_AT(self,self->count-i-1) = tmp;
+	}
+})
+
+KRK_METHOD(deque,__get__,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_ARG(1,int,krk_integer_type,index);
+	DEQUE_WRAP_INDEX();
+	return DEQUE_AT(self,index);
+})
+
+KRK_METHOD(deque,__set__,{
+	METHOD_TAKES_EXACTLY(2);
+	CHECK_ARG(1,int,krk_integer_type,index);
+	DEQUE_WRAP_INDEX();
+	return (DEQUE_AT(self,index) = argv[2]);
+})
+
+KRK_METHOD(deque,__delitem__,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_ARG(1,int,krk_integer_type,index);
+	DEQUE_WRAP_INDEX();
+	dequeDelete(self, index);
+})
+
+KRK_METHOD(deque,__contains__,{
+	METHOD_TAKES_EXACTLY(1);
+	for (size_t i = 0; i < self->count; ++i) {
+		if (krk_valuesEqual(argv[1], DEQUE_AT(self,i))) return BOOLEAN_VAL(1);
+	}
+	return BOOLEAN_VAL(0);
+})
+
+KRK_METHOD(deque,__repr__,{
+	METHOD_TAKES_NONE();
+	if (((KrkObj*)self)->inRepr) return OBJECT_VAL(S("deque(...)"));
+	((KrkObj*)self)->inRepr = 1;
+	struct StringBuilder sb = {0};
+	pushStringBuilderStr(&sb, "deque([", 7);
+	for (size_t i = 0; i < self->count; ++i) {
+		KrkValue value = DEQUE_AT(self,i);
+		krk_push(value);
+		KrkValue result = krk_callSimple(OBJECT_VAL(krk_getType(value)->_reprer), 1, 0);
+		if (IS_STRING(result)) {
+			pushStringBuilderStr(&sb, AS_STRING(result)->chars, AS_STRING(result)->length);
+		}
+		if (i + 1 < self->count) {
+			pushStringBuilderStr(&sb, ", ", 2);
+		}
+	}
+	pushStringBuilder(&sb, ']');
+	if (self->bounded) {
+		char tmp[50];
+		size_t len = snprintf(tmp, 50, ", maxlen=" PRIkrk_int, self->maxlen);
+		pushStringBuilderStr(&sb, tmp, len);
+	}
+	pushStringBuilder(&sb, ')');
+	((KrkObj*)self)->inRepr = 0;
+	return finishStringBuilder(&sb);
+})
+
+KRK_METHOD(deque,__iter__,{
+	METHOD_TAKES_NONE();
+	struct DequeIterator * output = (struct DequeIterator*)krk_newInstance(dequeiterator);
+	output->d = argv[0];
+	output->i = 0;
+	return OBJECT_VAL(output);
+})
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct DequeIterator *
+
+KRK_METHOD(dequeiterator,__call__,{
+	struct Deque * d = AS_deque(self->d);
+	if (self->i >= d->count) return argv[0];
+	return DEQUE_AT(d,self->i++);
+})
+
+
+/* Append repr(value) to a string builder. */
+static void pushRepr(struct StringBuilder * sb, KrkValue value) {
+	krk_push(value);
+	KrkValue result = krk_callSimple(OBJECT_VAL(krk_getType(value)->_reprer), 1, 0);
+	if (IS_STRING(result)) {
+		pushStringBuilderStr(sb, AS_STRING(result)->chars, AS_STRING(result)->length);
+	}
+}
+
+/**
+ * defaultdict is a dict whose __missing__ calls default_factory and stores
+ * the result; dict.__get__ only reaches it on a miss, so hits cost a single
+ * table lookup with no managed code involved.
+ */
+static KrkClass * defaultdict = NULL;
+struct DefaultDict {
+	KrkDict dict;
+	KrkValue factory;
+};
+
+#define IS_defaultdict(o) (krk_isInstanceOf(o,defaultdict))
+#define AS_defaultdict(o) ((struct DefaultDict*)AS_OBJECT(o))
+
+static void _defaultdict_gcscan(KrkInstance * self) {
+	krk_markTable(&((struct DefaultDict*)self)->dict.entries);
+	krk_markValue(((struct DefaultDict*)self)->factory);
+}
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct DefaultDict *
+
+KRK_METHOD(defaultdict,__init__,{
+	METHOD_TAKES_AT_MOST(2);
+	krk_initTable(&self->dict.entries);
+	self->factory = argc > 1 ? argv[1] : NONE_VAL();
+	if (argc > 2) {
+		if (!krk_isInstanceOf(argv[2], vm.baseClasses->dictClass)) return TYPE_ERROR(dict,argv[2]);
+		krk_tableAddAll(AS_DICT(argv[2]), &self->dict.entries);
+	}
+	if (hasKw) {
+		krk_tableAddAll(AS_DICT(argv[argc]), &self->dict.entries);
+	}
+	return argv[0];
+})
+
+KRK_METHOD(defaultdict,default_factory,{
+	METHOD_TAKES_NONE();
+	return self->factory;
+})
+
+KRK_METHOD(defaultdict,__missing__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (IS_NONE(self->factory)) return krk_keyError(argv[1]);
+	krk_push(self->factory);
+	KrkValue result = krk_callSimple(self->factory, 0, 1);
+	if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return NONE_VAL();
+	krk_push(result);
+	krk_tableSet(&self->dict.entries, argv[1], result);
+	return krk_pop();
+})
+
+KRK_METHOD(defaultdict,__repr__,{
+	METHOD_TAKES_NONE();
+	if (((KrkObj*)self)->inRepr) return OBJECT_VAL(S("defaultdict(...)"));
+	((KrkObj*)self)->inRepr = 1;
+	struct StringBuilder sb = {0};
+	pushStringBuilderStr(&sb, "defaultdict(", 12);
+	pushRepr(&sb, self->factory);
+	pushStringBuilderStr(&sb, ", ", 2);
+	/* dict's repr sets the marker again for the entries */
+	((KrkObj*)self)->inRepr = 0;
+	krk_push(argv[0]);
+	KrkValue asDict = krk_callSimple(OBJECT_VAL(vm.baseClasses->dictClass->_reprer), 1, 0);
+	if (IS_STRING(asDict)) {
+		pushStringBuilderStr(&sb, AS_STRING(asDict)->chars, AS_STRING(asDict)->length);
+	}
+	pushStringBuilder(&sb, ')');
+	return finishStringBuilder(&sb);
+})
+
+/**
+ * Counter maps keys to counts; missing keys count as zero without being
+ * inserted. Counting an iterable updates the table directly rather than
+ * going through __get__/__set__ for each element.
+ */
+static KrkClass * Counter = NULL;
+
+#define IS_Counter(o) (krk_isInstanceOf(o,Counter))
+#define AS_Counter(o) ((KrkDict*)AS_OBJECT(o))
+
+struct CounterUpdate {
+	KrkTable * table;
+	int sign;
+};
+
+static int counterAdd(KrkTable * table, KrkValue key, KrkValue delta) {
+	KrkValue count = INTEGER_VAL(0);
+	krk_tableGet(table, key, &count);
+	if (IS_INTEGER(count) && IS_INTEGER(delta)) {
+		count = INTEGER_VAL(AS_INTEGER(count) + AS_INTEGER(delta));
+	} else {
+		count = krk_operator_add(count, delta);
+		if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return 1;
+	}
+	krk_push(count);
+	krk_tableSet(table, key, count);
+	krk_pop();
+	return 0;
+}
+
+static int counterUpdateCallback(void * context, const KrkValue * values, size_t count) {
+	struct CounterUpdate * update = context;
+	for (size_t i = 0; i < count; ++i) {
+		if (counterAdd(update->table, values[i], INTEGER_VAL(update->sign))) return 1;
+		if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return 1;
+	}
+	return 0;
+}
+
+/* Add (or subtract) counts from a mapping, or one per element of an iterable. */
+static int counterUpdate(KrkDict * self, KrkValue source, int sign) {
+	if (krk_isInstanceOf(source, vm.baseClasses->dictClass)) {
+		KrkTable * from = AS_DICT(source);
+		for (size_t i = 0; i < from->capacity; ++i) {
+			KrkTableEntry * entry = &from->entries[i];
+			if (IS_KWARGS(entry->key)) continue;
+			KrkValue delta = entry->value;
+			if (sign < 0) {
+				delta = krk_operator_sub(INTEGER_VAL(0), delta);
+				if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return 1;
+			}
+			if (counterAdd(&self->entries, entry->key, delta)) return 1;
+		}
+		return 0;
+	}
+	struct CounterUpdate update = {&self->entries, sign};
+	return krk_unpackIterable(source, &update, counterUpdateCallback);
+}
+
+static KrkValue counterUpdateMethod(int argc, KrkValue argv[], int hasKw, int sign) {
+	if (argc > 1 && counterUpdate(AS_Counter(argv[0]), argv[1], sign)) return NONE_VAL();
+	if (hasKw && counterUpdate(AS_Counter(argv[0]), argv[argc], sign)) return NONE_VAL();
+	return NONE_VAL();
+}
+
+struct CountEntry {
+	KrkValue key;
+	KrkValue value;
+	double count;
+	size_t order;
+};
+
+/* Higher counts first; ties keep table order so results are deterministic. */
+static int countEntryBefore(const struct CountEntry * a, const struct CountEntry * b) {
+	if (a->count != b->count) return a->count > b->count;
+	return a->order < b->order;
+}
+
+static int countEntryCompare(const void * _a, const void * _b) {
+	const struct CountEntry * a = _a;
+	const struct CountEntry * b = _b;
+	return countEntryBefore(a,b) ? -1 : (countEntryBefore(b,a) ? 1 : 0);
+}
+
+static void countHeapSift(struct CountEntry * heap, size_t size, size_t i) {
+	/* Min-heap on countEntryBefore: the root is the weakest entry kept so far */
+	for (;;) {
+		size_t weakest = i;
+		size_t l = 2 * i + 1, r = 2 * i + 2;
+		if (l < size && countEntryBefore(&heap[weakest], &heap[l])) weakest = l;
+		if (r < size && countEntryBefore(&heap[weakest], &heap[r])) weakest = r;
+		if (weakest == i) return;
+		struct CountEntry tmp = heap[i];
+		heap[i] = heap[weakest];
+		heap[weakest] = tmp;
+		i = weakest;
+	}
+}
+
+/**
+ * Collect the n most common entries, in order. When n is smaller than the
+ * table, keep a heap of the n best seen so far instead of sorting everything.
+ * Returns the number of entries written to *out, or -1 on error.
+ */
+static ssize_t counterMostCommon(KrkDict * self, size_t n, struct CountEntry ** out) {
+	KrkTable * table = &self->entries;
+	struct CountEntry * entries = malloc(sizeof(struct CountEntry) * (table->count ? table->count : 1));
+	size_t count = 0;
+	for (size_t i = 0; i < table->capacity; ++i) {
+		KrkTableEntry * entry = &table->entries[i];
+		if (IS_KWARGS(entry->key)) continue;
+		double value;
+		if (IS_INTEGER(entry->value)) value = AS_INTEGER(entry->value);
+		else if (IS_FLOATING(entry->value)) value = AS_FLOATING(entry->value);
+		else {
+			free(entries);
+			krk_runtimeError(vm.exceptions->typeError, "counts must be int or float, not '%s'", krk_typeName(entry->value));
+			return -1;
+		}
+		entries[count] = (struct CountEntry){entry->key, entry->value, value, count};
+		count++;
+	}
+
+	if (n < count) {
+		if (n) {
+			for (size_t i = n / 2; i-- > 0;) countHeapSift(entries, n, i);
+			for (size_t i = n; i < count; ++i) {
+				if (countEntryBefore(&entries[i], &entries[0])) {
+					entries[0] = entries[i];
+					countHeapSift(entries, n, 0);
+				}
+			}
+		}
+		count = n;
+	}
+
+	qsort(entries, count, sizeof(struct CountEntry), countEntryCompare);
+	*out = entries;
+	return count;
+}
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE KrkDict *
+
+KRK_METHOD(Counter,__init__,{
+	METHOD_TAKES_AT_MOST(1);
+	krk_initTable(&self->entries);
+	counterUpdateMethod(argc, argv, hasKw, 1);
+	return argv[0];
+})
+
+KRK_METHOD(Counter,__missing__,{
+	METHOD_TAKES_EXACTLY(1);
+	return INTEGER_VAL(0);
+})
+
+KRK_METHOD(Counter,update,{
+	METHOD_TAKES_AT_MOST(1);
+	return counterUpdateMethod(argc, argv, hasKw, 1);
+})
+
+KRK_METHOD(Counter,subtract,{
+	METHOD_TAKES_AT_MOST(1);
+	return counterUpdateMethod(argc, argv, hasKw, -1);
+})
+
+KRK_METHOD(Counter,total,{
+	METHOD_TAKES_NONE();
+	KrkValue total = INTEGER_VAL(0);
+	for (size_t i = 0; i < self->entries.capacity; ++i) {
+		KrkTableEntry * entry = &self->entries.entries[i];
+		if (IS_KWARGS(entry->key)) continue;
+		total = krk_operator_add(total, entry->value);
+		if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return NONE_VAL();
+	}
+	return total;
+})
+
+KRK_METHOD(Counter,most_common,{
+	METHOD_TAKES_AT_MOST(1);
+	size_t n = self->entries.count;
+	if (argc > 1 && !IS_NONE(argv[1])) {
+		CHECK_ARG(1,int,krk_integer_type,_n);
+		n = _n < 0 ? 0 : _n;
+	}
+	struct CountEntry * entries;
+	ssize_t count = counterMostCommon(self, n, &entries);
+	if (count < 0) return NONE_VAL();
+
+	KrkValue out = krk_list_of(0, NULL);
+	krk_push(out);
+	for (ssize_t i = 0; i < count; ++i) {
+		KrkTuple * pair = krk_newTuple(2);
+		krk_push(OBJECT_VAL(pair));
+		pair->values.values[pair->values.count++] = entries[i].key;
+		pair->values.values[pair->values.count++] = entries[i].value;
+		krk_writeValueArray(AS_LIST(out), OBJECT_VAL(pair));
+		krk_pop();
+	}
+	free(entries);
+	return krk_pop();
+})
+
+KRK_METHOD(Counter,elements,{
+	METHOD_TAKES_NONE();
+	KrkValue out = krk_list_of(0, NULL);
+	krk_push(out);
+	for (size_t i = 0; i < self->entries.capacity; ++i) {
+		KrkTableEntry * entry = &self->entries.entries[i];
+		if (IS_KWARGS(entry->key) || !IS_INTEGER(entry->value)) continue;
+		for (krk_integer_type j = 0; j < AS_INTEGER(entry->value); ++j) {
+			krk_writeValueArray(AS_LIST(out), entry->key);
+		}
+	}
+	return krk_pop();
+})
+
+KRK_METHOD(Counter,__repr__,{
+	METHOD_TAKES_NONE();
+	if (((KrkObj*)self)->inRepr) return OBJECT_VAL(S("Counter(...)"));
+	struct CountEntry * entries;
+	ssize_t count = counterMostCommon(self, self->entries.count, &entries);
+	if (count < 0) return NONE_VAL();
+	((KrkObj*)self)->inRepr = 1;
+	struct StringBuilder sb = {0};
+	pushStringBuilderStr(&sb, "Counter({", 9);
+	for (ssize_t i = 0; i < count; ++i) {
+		if (i) pushStringBuilderStr(&sb, ", ", 2);
+		pushRepr(&sb, entries[i].key);
+		pushStringBuilderStr(&sb, ": ", 2);
+		pushRepr(&sb, entries[i].value);
+	}
+	pushStringBuilderStr(&sb, "})", 2);
+	free(entries);
+	((KrkObj*)self)->inRepr = 0;
+	return finishStringBuilder(&sb);
+})
+
+/**
+ * OrderedDict remembers insertion order in an array of keys alongside the
+ * table. Deleted keys leave a hole in the array that is skipped when
+ * iterating; a second table maps each key to its slot so deletion doesn't
+ * have to search, and the array is compacted once half of it is holes.
+ */
+static KrkClass * OrderedDict = NULL;
+struct OrderedDict {
+	KrkDict dict;
+	KrkValueArray order;
+	KrkTable positions;
+	size_t removed;
+};
+
+#define IS_OrderedDict(o) (krk_isInstanceOf(o,OrderedDict))
+#define AS_OrderedDict(o) ((struct OrderedDict*)AS_OBJECT(o))
+
+static KrkClass * odictiterator = NULL;
+struct OrderedDictIterator {
+	KrkInstance inst;
+	KrkValue od;
+	size_t i;
+	int kind; /* 0: keys, 1: values, 2: items */
+};
+
+#define IS_odictiterator(o) (krk_isInstanceOf(o,odictiterator))
+#define AS_odictiterator(o) ((struct OrderedDictIterator*)AS_OBJECT(o))
+
+static void _OrderedDict_gcscan(KrkInstance * _self) {
+	struct OrderedDict * self = (struct OrderedDict*)_self;
+	krk_markTable(&self->dict.entries);
+	krk_markTable(&self->positions);
+	for (size_t i = 0; i < self->order.count; ++i) {
+		krk_markValue(self->order.values[i]);
+	}
+}
+
+static void _OrderedDict_gcsweep(KrkInstance * _self) {
+	struct OrderedDict * self = (struct OrderedDict*)_self;
+	krk_freeTable(&self->dict.entries);
+	krk_freeTable(&self->positions);
+	krk_freeValueArray(&self->order);
+}
+
+static void _odictiterator_gcscan(KrkInstance * self) {
+	krk_markValue(((struct OrderedDictIterator*)self)->od);
+}
+
+/* Close the holes left by deleted keys and renumber every slot. */
+static void odictCompact(struct OrderedDict * self) {
+	size_t j = 0;
+	for (size_t i = 0; i < self->order.count; ++i) {
+		if (IS_KWARGS(self->order.values[i])) continue;
+		self->order.values[j] = self->order.values[i];
+		krk_tableSet(&self->positions, self->order.values[j], INTEGER_VAL(j));
+		j++;
+	}
+	self->order.count = j;
+	self->removed = 0;
+}
+
+static void odictForget(struct OrderedDict * self, KrkValue key) {
+	KrkValue position;
+	if (!krk_tableGet(&self->positions, key, &position)) return;
+	krk_tableDelete(&self->positions, key);
+	self->order.values[AS_INTEGER(position)] = KWARGS_VAL(0);
+	self->removed++;
+	if (self->removed > 8 && self->removed * 2 > self->order.count) odictCompact(self);
+}
+
+static void odictSet(struct OrderedDict * self, KrkValue key, KrkValue value) {
+	if (krk_tableSet(&self->dict.entries, key, value)) {
+		krk_tableSet(&self->positions, key, INTEGER_VAL(self->order.count));
+		krk_writeValueArray(&self->order, key);
+	}
+}
+
+static int odictUpdateCallback(void * context, const KrkValue * values, size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		if (!IS_TUPLE(values[i]) || AS_TUPLE(values[i])->values.count != 2) {
+			krk_runtimeError(vm.exceptions->typeError, "expected (key, value) pair, not '%s'", krk_typeName(values[i]));
+			return 1;
+		}
+		odictSet(context, AS_TUPLE(values[i])->values.values[0], AS_TUPLE(values[i])->values.values[1]);
+		if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return 1;
+	}
+	return 0;
+}
+
+static int odictUpdate(struct OrderedDict * self, KrkValue source) {
+	if (IS_OrderedDict(source)) {
+		struct OrderedDict * other = AS_OrderedDict(source);
+		for (size_t i = 0; i < other->order.count; ++i) {
+			KrkValue key = other->order.values[i], value;
+			if (IS_KWARGS(key)) continue;
+			krk_tableGet(&other->dict.entries, key, &value);
+			odictSet(self, key, value);
+		}
+		return 0;
+	} else if (krk_isInstanceOf(source, vm.baseClasses->dictClass)) {
+		KrkTable * from = AS_DICT(source);
+		for (size_t i = 0; i < from->capacity; ++i) {
+			if (IS_KWARGS(from->entries[i].key)) continue;
+			odictSet(self, from->entries[i].key, from->entries[i].value);
+		}
+		return 0;
+	}
+	return krk_unpackIterable(source, self, odictUpdateCallback);
+}
+
+static KrkValue odictIterator(KrkValue od, int kind) {
+	struct OrderedDictIterator * output = (struct OrderedDictIterator*)krk_newInstance(odictiterator);
+	output->od = od;
+	output->i = 0;
+	output->kind = kind;
+	return OBJECT_VAL(output);
+}
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct OrderedDict *
+
+KRK_METHOD(OrderedDict,__init__,{
+	METHOD_TAKES_AT_MOST(1);
+	if (argc > 1 && odictUpdate(self, argv[1])) return NONE_VAL();
+	if (hasKw && odictUpdate(self, argv[argc])) return NONE_VAL();
+	return argv[0];
+})
+
+KRK_METHOD(OrderedDict,update,{
+	METHOD_TAKES_AT_MOST(1);
+	if (argc > 1 && odictUpdate(self, argv[1])) return NONE_VAL();
+	if (hasKw) odictUpdate(self, argv[argc]);
+})
+
+/* dict's version would skip the order, so updates have to come through here. */
+KRK_METHOD(OrderedDict,__ior__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!krk_isInstanceOf(argv[1], vm.baseClasses->dictClass)) return TYPE_ERROR(dict,argv[1]);
+	if (odictUpdate(self, argv[1])) return NONE_VAL();
+	return argv[0];
+})
+
+KRK_METHOD(OrderedDict,__set__,{
+	METHOD_TAKES_EXACTLY(2);
+	odictSet(self, argv[1], argv[2]);
+})
+
+KRK_METHOD(OrderedDict,__delitem__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!krk_tableDelete(&self->dict.entries, argv[1])) return krk_keyError(argv[1]);
+	odictForget(self, argv[1]);
+})
+
+KRK_METHOD(OrderedDict,__len__,{
+	METHOD_TAKES_NONE();
+	return INTEGER_VAL(self->order.count - self->removed);
+})
+
+KRK_METHOD(OrderedDict,setdefault,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(2);
+	KrkValue out = argc > 2 ? argv[2] : NONE_VAL();
+	if (!krk_tableGet(&self->dict.entries, argv[1], &out)) {
+		odictSet(self, argv[1], out);
+	}
+	return out;
+})
+
+KRK_METHOD(OrderedDict,pop,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(2);
+	KrkValue out;
+	if (!krk_tableGet(&self->dict.entries, argv[1], &out)) {
+		if (argc > 2) return argv[2];
+		return krk_keyError(argv[1]);
+	}
+	krk_push(out);
+	krk_tableDelete(&self->dict.entries, argv[1]);
+	odictForget(self, argv[1]);
+	return krk_pop();
+})
+
+KRK_METHOD(OrderedDict,popitem,{
+	METHOD_TAKES_AT_MOST(1);
+	int last = argc > 1 ? !krk_isFalsey(argv[1]) : 1;
+	if (hasKw) {
+		KrkValue tmp;
+		if (krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("last")), &tmp)) last = !krk_isFalsey(tmp);
+	}
+	if (self->order.count == self->removed) return krk_runtimeError(vm.exceptions->keyError, "dictionary is empty");
+	size_t i = last ? self->order.count - 1 : 0;
+	while (IS_KWARGS(self->order.values[i])) i += last ? -1 : 1;
+
+	KrkTuple * pair = krk_newTuple(2);
+	krk_push(OBJECT_VAL(pair));
+	KrkValue key = self->order.values[i];
+	pair->values.values[pair->values.count++] = key;
+	krk_tableGet(&self->dict.entries, key, &pair->values.values[pair->values.count++]);
+	krk_tableDelete(&self->dict.entries, key);
+	odictForget(self, key);
+	return krk_pop();
+})
+
+KRK_METHOD(OrderedDict,move_to_end,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(2);
+	int last = argc > 2 ? !krk_isFalsey(argv[2]) : 1;
+	if (hasKw) {
+		KrkValue tmp;
+		if (krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("last")), &tmp)) last = !krk_isFalsey(tmp);
+	}
+	KrkValue key = argv[1];
+	KrkValue position;
+	if (!krk_tableGet(&self->positions, key, &position)) return krk_keyError(key);
+	if (last) {
+		self->order.values[AS_INTEGER(position)] = KWARGS_VAL(0);
+		self->removed++;
+		krk_tableSet(&self->positions, key, INTEGER_VAL(self->order.count));
+		krk_writeValueArray(&self->order, key);
+		if (self->removed > 8 && self->removed * 2 > self->order.count) odictCompact(self);
+	} else {
+		/* Moving to the front shifts everything, so renumber as we compact */
+		self->order.values[AS_INTEGER(position)] = KWARGS_VAL(0);
+		krk_writeValueArray(&self->order, KWARGS_VAL(0));
+		memmove(&self->order.values[1], &self->order.values[0], sizeof(KrkValue) * (self->order.count - 1));
+		self->order.values[0] = key;
+		odictCompact(self);
+	}
+})
+
+KRK_METHOD(OrderedDict,clear,{
+	METHOD_TAKES_NONE();
+	krk_freeTable(&self->dict.entries);
+	krk_freeTable(&self->positions);
+	krk_freeValueArray(&self->order);
+	self->removed = 0;
+})
+
+KRK_METHOD(OrderedDict,copy,{
+	METHOD_TAKES_NONE();
+	struct OrderedDict * out = (struct OrderedDict*)krk_newInstance(krk_getType(argv[0]));
+	krk_push(OBJECT_VAL(out));
+	odictUpdate(out, argv[0]);
+	return krk_pop();
+})
+
+KRK_METHOD(OrderedDict,keys,{
+	METHOD_TAKES_NONE();
+	return odictIterator(argv[0], 0);
+})
+
+KRK_METHOD(OrderedDict,values,{
+	METHOD_TAKES_NONE();
+	return odictIterator(argv[0], 1);
+})
+
+KRK_METHOD(OrderedDict,items,{
+	METHOD_TAKES_NONE();
+	return odictIterator(argv[0], 2);
+})
+
+KRK_METHOD(OrderedDict,__repr__,{
+	METHOD_TAKES_NONE();
+	if (((KrkObj*)self)->inRepr) return OBJECT_VAL(S("OrderedDict(...)"));
+	((KrkObj*)self)->inRepr = 1;
+	struct StringBuilder sb = {0};
+	pushStringBuilderStr(&sb, "OrderedDict({", 13);
+	size_t c = 0;
+	for (size_t i = 0; i < self->order.count; ++i) {
+		KrkValue key = self->order.values[i];
+		KrkValue value;
+		if (IS_KWARGS(key)) continue;
+		if (c++) pushStringBuilderStr(&sb, ", ", 2);
+		krk_tableGet(&self->dict.entries, key, &value);
+		pushRepr(&sb, key);
+		pushStringBuilderStr(&sb, ": ", 2);
+		pushRepr(&sb, value);
+	}
+	pushStringBuilderStr(&sb, "})", 2);
+	((KrkObj*)self)->inRepr = 0;
+	return finishStringBuilder(&sb);
+})
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct OrderedDictIterator *
+
+KRK_METHOD(odictiterator,__iter__,{
+	METHOD_TAKES_NONE();
+	return argv[0];
+})
+
+KRK_METHOD(odictiterator,__call__,{
+	struct OrderedDict * od = AS_OrderedDict(self->od);
+	while (self->i < od->order.count) {
+		KrkValue key = od->order.values[self->i++];
+		KrkValue value;
+		if (IS_KWARGS(key)) continue;
+		if (self->kind == 0) return key;
+		krk_tableGet(&od->dict.entries, key, &value);
+		if (self->kind == 1) return value;
+		KrkTuple * pair = krk_newTuple(2);
+		pair->values.values[pair->values.count++] = key;
+		pair->values.values[pair->values.count++] = value;
+		return OBJECT_VAL(pair);
+	}
+	return argv[0];
+})
+
+KrkValue krk_module_onload__collections(void) {
+	KrkInstance * module = krk_newInstance(vm.baseClasses->moduleClass);
+	/* Store it on the stack for now so we can do stuff that may trip GC
+	 * and not lose it to garbage colletion... */
+	krk_push(OBJECT_VAL(module));
+
+	krk_makeClass(module, &deque, "deque", vm.baseClasses->objectClass);
+	deque->allocSize = sizeof(struct Deque);
+	deque->_ongcscan = _deque_gcscan;
+	deque->_ongcsweep = _deque_gcsweep;
+	BIND_METHOD(deque,__init__);
+	BIND_METHOD(deque,__len__);
+	BIND_METHOD(deque,__get__);
+	BIND_METHOD(deque,__set__);
+	BIND_METHOD(deque,__delitem__);
+	BIND_METHOD(deque,__contains__);
+	BIND_METHOD(deque,__repr__);
+	BIND_METHOD(deque,__iter__);
+	BIND_METHOD(deque,append);
+	BIND_METHOD(deque,appendleft);
+	BIND_METHOD(deque,extend);
+	BIND_METHOD(deque,extendleft);
+	BIND_METHOD(deque,__iadd__);
+	BIND_METHOD(deque,pop);
+	BIND_METHOD(deque,popleft);
+	BIND_METHOD(deque,clear);
+	BIND_METHOD(deque,copy);
+	BIND_METHOD(deque,count);
+	BIND_METHOD(deque,index);
+	BIND_METHOD(deque,insert);
+	BIND_METHOD(deque,remove);
+	BIND_METHOD(deque,rotate);
+	BIND_METHOD(deque,reverse);
+	BIND_FIELD(deque,maxlen);
+	krk_defineNative(&deque->methods, ".__str__", FUNC_NAME(deque,__repr__));
+	krk_finalizeClass(deque);
+	deque->docstring = S("Double-ended queue with fast appends and pops at both ends.");
+
+	krk_makeClass(module, &dequeiterator, "dequeiterator", vm.baseClasses->objectClass);
+	dequeiterator->allocSize = sizeof(struct DequeIterator);
+	dequeiterator->_ongcscan = _dequeiterator_gcscan;
+	BIND_METHOD(dequeiterator,__call__);
+	krk_finalizeClass(dequeiterator);
+
+	krk_makeClass(module, &defaultdict, "defaultdict", vm.baseClasses->dictClass);
+	defaultdict->allocSize = sizeof(struct DefaultDict);
+	defaultdict->_ongcscan = _defaultdict_gcscan;
+	BIND_METHOD(defaultdict,__init__);
+	BIND_METHOD(defaultdict,__missing__);
+	BIND_METHOD(defaultdict,__repr__);
+	BIND_FIELD(defaultdict,default_factory);
+	krk_defineNative(&defaultdict->methods, ".__str__", FUNC_NAME(defaultdict,__repr__));
+	krk_finalizeClass(defaultdict);
+	defaultdict->docstring = S("Dictionary that calls a factory to supply values for missing keys.");
+
+	krk_makeClass(module, &Counter, "Counter", vm.baseClasses->dictClass);
+	BIND_METHOD(Counter,__init__);
+	BIND_METHOD(Counter,__missing__);
+	BIND_METHOD(Counter,__repr__);
+	BIND_METHOD(Counter,update);
+	BIND_METHOD(Counter,subtract);
+	BIND_METHOD(Counter,total);
+	BIND_METHOD(Counter,most_common);
+	BIND_METHOD(Counter,elements);
+	krk_defineNative(&Counter->methods, ".__str__", FUNC_NAME(Counter,__repr__));
+	krk_finalizeClass(Counter);
+	Counter->docstring = S("Dictionary of counts of hashable values.");
+
+	krk_makeClass(module, &OrderedDict, "OrderedDict", vm.baseClasses->dictClass);
+	OrderedDict->allocSize = sizeof(struct OrderedDict);
+	OrderedDict->_ongcscan = _OrderedDict_gcscan;
+	OrderedDict->_ongcsweep = _OrderedDict_gcsweep;
+	BIND_METHOD(OrderedDict,__init__);
+	BIND_METHOD(OrderedDict,__set__);
+	BIND_METHOD(OrderedDict,__ior__);
+	BIND_METHOD(OrderedDict,__delitem__);
+	BIND_METHOD(OrderedDict,__len__);
+	BIND_METHOD(OrderedDict,__repr__);
+	BIND_METHOD(OrderedDict,update);
+	BIND_METHOD(OrderedDict,setdefault);
+	BIND_METHOD(OrderedDict,pop);
+	BIND_METHOD(OrderedDict,popitem);
+	BIND_METHOD(OrderedDict,move_to_end);
+	BIND_METHOD(OrderedDict,clear);
+	BIND_METHOD(OrderedDict,copy);
+	BIND_METHOD(OrderedDict,keys);
+	BIND_METHOD(OrderedDict,values);
+	BIND_METHOD(OrderedDict,items);
+	krk_defineNative(&OrderedDict->methods, ".__str__", FUNC_NAME(OrderedDict,__repr__));
+	krk_defineNative(&OrderedDict->methods, ".__iter__", FUNC_NAME(OrderedDict,keys));
+	krk_finalizeClass(OrderedDict);
+	OrderedDict->docstring = S("Dictionary that remembers the order keys were inserted in.");
+
+	krk_makeClass(module, &odictiterator, "odictiterator", vm.baseClasses->objectClass);
+	odictiterator->allocSize = sizeof(struct OrderedDictIterator);
+	odictiterator->_ongcscan = _odictiterator_gcscan;
+	BIND_METHOD(odictiterator,__iter__);
+	BIND_METHOD(odictiterator,__call__);
+	krk_finalizeClass(odictiterator);
+
+	/* Pop the module object before returning; it'll get pushed again
+	 * by the VM before the GC has a chance to run, so it's safe. */
+	assert(AS_INSTANCE(krk_pop()) == module);
+	return OBJECT_VAL(module);
+}
@@ -0,0 +1,533 @@
+/**
+ * array module; compact arrays of C numeric types.
+ *
+ * Values are stored unboxed in a contiguous buffer, so an array of a million
+ * floats is eight megabytes rather than sixteen, and the reductions below
+ * are plain loops over a C array that the compiler is free to vectorize.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "vm.h"
+#include "value.h"
+#include "object.h"
+#include "memory.h"
+#include "util.h"
+
+static KrkClass * array = NULL;
+struct Array {
+	KrkInstance inst;
+	char typecode;
+	size_t itemsize;
+	size_t length;
+	size_t capacity;
+	void * data;
+};
+
+#define IS_array(o) (krk_isInstanceOf(o,array))
+#define AS_array(o) ((struct Array*)AS_OBJECT(o))
+
+static KrkClass * arrayiterator = NULL;
+struct ArrayIterator {
+	KrkInstance inst;
+	KrkValue a;
+	size_t i;
+};
+
+#define IS_arrayiterator(o) (krk_isInstanceOf(o,arrayiterator))
+#define AS_arrayiterator(o) ((struct ArrayIterator*)AS_OBJECT(o))
+
+/**
+ * Run the body with T defined as the element type of `self`, and
+ * IS_FLOAT_TYPE set if it is a floating point type.
+ */
+#define ARRAY_DISPATCH(self, ...) switch ((self)->typecode) { \
+	case 'b': { typedef int8_t   T; enum { IS_FLOAT_TYPE = 0 }; __VA_ARGS__; break; } \
+	case 'B': { typedef uint8_t  T; enum { IS_FLOAT_TYPE = 0 }; __VA_ARGS__; break; } \
+	case 'h': { typedef int16_t  T; enum { IS_FLOAT_TYPE = 0 }; __VA_ARGS__; break; } \
+	case 'H': { typedef uint16_t T; enum { IS_FLOAT_TYPE = 0 }; __VA_ARGS__; break; } \
+	case 'i': { typedef int32_t  T; enum { IS_FLOAT_TYPE = 0 }; __VA_ARGS__; break; } \
+	case 'I': { typedef uint32_t T; enum { IS_FLOAT_TYPE = 0 }; __VA_ARGS__; break; } \
+	case 'l': \
+	case 'q': { typedef int64_t  T; enum { IS_FLOAT_TYPE = 0 }; __VA_ARGS__; break; } \
+	case 'L': \
+	case 'Q': { typedef uint64_t T; enum { IS_FLOAT_TYPE = 0 }; __VA_ARGS__; break; } \
+	case 'f': { typedef float    T; enum { IS_FLOAT_TYPE = 1 }; __VA_ARGS__; break; } \
+	case 'd': { typedef double   T; enum { IS_FLOAT_TYPE = 1 }; __VA_ARGS__; break; } \
+}
+
+static size_t typecodeSize(char typecode) {
+	switch (typecode) {
+		case 'b': case 'B': return 1;
+		case 'h': case 'H': return 2;
+		case 'i': case 'I': case 'f': return 4;
+		case 'l': case 'L': case 'q': case 'Q': case 'd': return 8;
+		default: return 0;
+	}
+}
+
+static int isFloatType(char typecode) {
+	return typecode == 'f' || typecode == 'd';
+}
+
+static void _array_gcsweep(KrkInstance * self) {
+	struct Array * a = (struct Array*)self;
+	krk_reallocate(a->data, a->capacity * a->itemsize, 0);
+}
+
+static void _arrayiterator_gcscan(KrkInstance * self) {
+	krk_markValue(((struct ArrayIterator*)self)->a);
+}
+
+static void arrayReserve(struct Array * self, size_t count) {
+	if (count <= self->capacity) return;
+	size_t old = self->capacity;
+	size_t capacity = GROW_CAPACITY(old);
+	if (capacity < count) capacity = count;
+	self->data = krk_reallocate(self->data, old * self->itemsize, capacity * self->itemsize);
+	self->capacity = capacity;
+}
+
+static KrkValue arrayGet(struct Array * self, size_t index) {
+	ARRAY_DISPATCH(self, {
+		T value = ((T*)self->data)[index];
+		if (IS_FLOAT_TYPE) return FLOATING_VAL(value);
+		return INTEGER_VAL(value);
+	});
+	return NONE_VAL();
+}
+
+/* Store a value, checking its type and that it fits; returns 1 on error. */
+static int arraySet(struct Array * self, size_t index, KrkValue value) {
+	if (isFloatType(self->typecode)) {
+		double d;
+		if (IS_FLOATING(value)) d = AS_FLOATING(value);
+		else if (IS_INTEGER(value)) d = AS_INTEGER(value);
+		else goto _typeError;
+		if (self->typecode == 'f') ((float*)self->data)[index] = d;
+		else ((double*)self->data)[index] = d;
+		return 0;
+	}
+
+	if (!IS_INTEGER(value)) goto _typeError;
+	krk_integer_type i = AS_INTEGER(value);
+	int inRange = 1;
+	switch (self->typecode) {
+		case 'b': inRange = i >= INT8_MIN && i <= INT8_MAX; break;
+		case 'B': inRange = i >= 0 && i <= UINT8_MAX; break;
+		case 'h': inRange = i >= INT16_MIN && i <= INT16_MAX; break;
+		case 'H': inRange = i >= 0 && i <= UINT16_MAX; break;
+		case 'i': inRange = i >= INT32_MIN && i <= INT32_MAX; break;
+		case 'I': inRange = i >= 0 && i <= (krk_integer_type)UINT32_MAX; break;
+		case 'L': case 'Q': inRange = i >= 0; break;
+	}
+	if (!inRange) {
+		krk_runtimeError(vm.exceptions->valueError, "value " PRIkrk_int " out of range for array of type '%c'", i, self->typecode);
+		return 1;
+	}
+	ARRAY_DISPATCH(self, {
+		((T*)self->data)[index] = (T)i;
+	});
+	return 0;
+
+_typeError:
+	krk_runtimeError(vm.exceptions->typeError, "array of type '%c' can not hold '%s'", self->typecode, krk_typeName(value));
+	return 1;
+}
+
+static int arrayAppend(struct Array * self, KrkValue value) {
+	arrayReserve(self, self->length + 1);
+	if (arraySet(self, self->length, value)) return 1;
+	self->length++;
+	return 0;
+}
+
+static int arrayExtendCallback(void * context, const KrkValue * values, size_t count) {
+	struct Array * self = context;
+	arrayReserve(self, self->length + count);
+	for (size_t i = 0; i < count; ++i) {
+		if (arrayAppend(self, values[i])) return 1;
+	}
+	return 0;
+}
+
+/* Arrays of the same type are copied directly; `strict` rejects other array types. */
+static int arrayExtend(struct Array * self, KrkValue iterable, int strict) {
+	if (IS_array(iterable) && (strict || AS_array(iterable)->typecode == self->typecode)) {
+		struct Array * other = AS_array(iterable);
+		if (other->typecode != self->typecode) {
+			krk_runtimeError(vm.exceptions->typeError, "can not extend array of type '%c' with array of type '%c'", self->typecode, other->typecode);
+			return 1;
+		}
+		size_t count = other->length;
+		arrayReserve(self, self->length + count);
+		memcpy((char*)self->data + self->length * self->itemsize, other->data, count * self->itemsize);
+		self->length += count;
+		return 0;
+	}
+	return krk_unpackIterable(iterable, self, arrayExtendCallback);
+}
+
+static int arrayFromBytes(struct Array * self, KrkBytes * bytes) {
+	if (bytes->length % self->itemsize) {
+		krk_runtimeError(vm.exceptions->valueError, "bytes length not a multiple of item size");
+		return 1;
+	}
+	size_t count = bytes->length / self->itemsize;
+	arrayReserve(self, self->length + count);
+	memcpy((char*)self->data + self->length * self->itemsize, bytes->bytes, bytes->length);
+	self->length += count;
+	return 0;
+}
+
+static struct Array * newArray(char typecode) {
+	struct Array * out = (struct Array*)krk_newInstance(array);
+	out->typecode = typecode;
+	out->itemsize = typecodeSize(typecode);
+	return out;
+}
+
+#define CURRENT_CTYPE struct Array *
+#define CURRENT_NAME  self
+
+#define ARRAY_WRAP_INDEX() \
+	if (index < 0) index += self->length; \
+	if (index < 0 || index >= (krk_integer_type)self->length) return krk_runtimeError(vm.exceptions->indexError, "array index out of range")
+
+#define ARRAY_WRAP_SOFT(val) \
+	if (val < 0) val += self->length; \
+	if (val < 0) val = 0; \
+	if (val > (krk_integer_type)self->length) val = self->length
+
+KRK_METHOD(array,__init__,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(2);
+	CHECK_ARG(1,str,KrkString*,typecode);
+	if (typecode->length != 1 || !typecodeSize(typecode->chars[0])) {
+		return krk_runtimeError(vm.exceptions->valueError, "bad typecode (must be b, B, h, H, i, I, l, L, q, Q, f or d)");
+	}
+	/* Calling __init__ again starts over with an empty buffer for the new type. */
+	if (self->data) {
+		krk_reallocate(self->data, self->capacity * self->itemsize, 0);
+		self->data = NULL;
+		self->length = 0;
+		self->capacity = 0;
+	}
+	self->typecode = typecode->chars[0];
+	self->itemsize = typecodeSize(self->typecode);
+	if (argc > 2) {
+		if (IS_BYTES(argv[2])) {
+			if (arrayFromBytes(self, AS_BYTES(argv[2]))) return NONE_VAL();
+		} else if (arrayExtend(self, argv[2], 0)) {
+			return NONE_VAL();
+		}
+	}
+	return argv[0];
+})
+
+KRK_METHOD(array,typecode,{
+	METHOD_TAKES_NONE();
+	return OBJECT_VAL(krk_copyString(&self->typecode, 1));
+})
+
+KRK_METHOD(array,itemsize,{
+	METHOD_TAKES_NONE();
+	return INTEGER_VAL(self->itemsize);
+})
+
+KRK_METHOD(array,__len__,{
+	METHOD_TAKES_NONE();
+	return INTEGER_VAL(self->length);
+})
+
+KRK_METHOD(array,__get__,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_ARG(1,int,krk_integer_type,index);
+	ARRAY_WRAP_INDEX();
+	return arrayGet(self, index);
+})
+
+KRK_METHOD(array,__set__,{
+	METHOD_TAKES_EXACTLY(2);
+	CHECK_ARG(1,int,krk_integer_type,index);
+	ARRAY_WRAP_INDEX();
+	if (arraySet(self, index, argv[2])) return NONE_VAL();
+	return argv[2];
+})
+
+KRK_METHOD(array,__getslice__,{
+	METHOD_TAKES_EXACTLY(2);
+	if (!(IS_INTEGER(argv[1]) || IS_NONE(argv[1]))) return TYPE_ERROR(int or None, argv[1]);
+	if (!(IS_INTEGER(argv[2]) || IS_NONE(argv[2]))) return TYPE_ERROR(int or None, argv[2]);
+	krk_integer_type start = IS_NONE(argv[1]) ? 0 : AS_INTEGER(argv[1]);
+	krk_integer_type end   = IS_NONE(argv[2]) ? (krk_integer_type)self->length : AS_INTEGER(argv[2]);
+	ARRAY_WRAP_SOFT(start);
+	ARRAY_WRAP_SOFT(end);
+	if (end < start) end = start;
+
+	struct Array * out = newArray(self->typecode);
+	krk_push(OBJECT_VAL(out));
+	arrayReserve(out, end - start);
+	memcpy(out->data, (char*)self->data + start * self->itemsize, (end - start) * self->itemsize);
+	out->length = end - start;
+	return krk_pop();
+})
+
+KRK_METHOD(array,append,{
+	METHOD_TAKES_EXACTLY(1);
+	arrayAppend(self, argv[1]);
+})
+
+KRK_METHOD(array,extend,{
+	METHOD_TAKES_EXACTLY(1);
+	arrayExtend(self, argv[1], 1);
+})
+
+KRK_METHOD(array,__iadd__,{
+	METHOD_TAKES_EXACTLY(1);
+	if (arrayExtend(self, argv[1], 1)) return NONE_VAL();
+	return argv[0];
+})
+
+KRK_METHOD(array,frombytes,{
+	METHOD_TAKES_EXACTLY(1);
+	if (!IS_BYTES(argv[1])) return TYPE_ERROR(bytes,argv[1]);
+	arrayFromBytes(self, AS_BYTES(argv[1]));
+})
+
+KRK_METHOD(array,tobytes,{
+	METHOD_TAKES_NONE();
+	return OBJECT_VAL(krk_newBytes(self->length * self->itemsize, self->data));
+})
+
+KRK_METHOD(array,tolist,{
+	METHOD_TAKES_NONE();
+	KrkValue out = krk_list_of(0, NULL);
+	krk_push(out);
+	for (size_t i = 0; i < self->length; ++i) {
+		krk_writeValueArray(AS_LIST(out), arrayGet(self, i));
+	}
+	return krk_pop();
+})
+
+KRK_METHOD(array,pop,{
+	METHOD_TAKES_AT_MOST(1);
+	krk_integer_type index = -1;
+	if (argc > 1) {
+		CHECK_ARG(1,int,krk_integer_type,_index);
+		index = _index;
+	}
+	if (!self->length) return krk_runtimeError(vm.exceptions->indexError, "pop from empty array");
+	ARRAY_WRAP_INDEX();
+	KrkValue out = arrayGet(self, index);
+	memmove((char*)self->data + index * self->itemsize, (char*)self->data + (index + 1) * self->itemsize,
+		(self->length - index - 1) * self->itemsize);
+	self->length--;
+	return out;
+})
+
+KRK_METHOD(array,__repr__,{
+	METHOD_TAKES_NONE();
+	struct StringBuilder sb = {0};
+	char tmp[64];
+	size_t len = snprintf(tmp, 64, "array('%c'", self->typecode);
+	pushStringBuilderStr(&sb, tmp, len);
+	if (self->length) {
+		pushStringBuilderStr(&sb, ", [", 3);
+		for (size_t i = 0; i < self->length; ++i) {
+			KrkValue value = arrayGet(self, i);
+			krk_push(value);
+			KrkValue result = krk_callSimple(OBJECT_VAL(krk_getType(value)->_reprer), 1, 0);
+			if (IS_STRING(result)) {
+				pushStringBuilderStr(&sb, AS_STRING(result)->chars, AS_STRING(result)->length);
+			}
+			if (i + 1 < self->length) pushStringBuilderStr(&sb, ", ", 2);
+		}
+		pushStringBuilder(&sb, ']');
+	}
+	pushStringBuilder(&sb, ')');
+	return finishStringBuilder(&sb);
+})
+
+KRK_METHOD(array,__iter__,{
+	METHOD_TAKES_NONE();
+	struct ArrayIterator * output = (struct ArrayIterator*)krk_newInstance(arrayiterator);
+	output->a = argv[0];
+	output->i = 0;
+	return OBJECT_VAL(output);
+})
+
+/*
+ * The reductions keep several independent accumulators so the loop bodies
+ * don't form one long dependency chain; for floating point types that is
+ * also what lets the compiler use vector instructions without -ffast-math.
+ * Integer results wrap at 64 bits, as the integer type does.
+ */
+static KrkValue arraySum(struct Array * self) {
+	ARRAY_DISPATCH(self, {
+		const T * restrict d = self->data;
+		size_t n = self->length;
+		if (IS_FLOAT_TYPE) {
+			double a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {
+				a0 += d[i]; a1 += d[i+1]; a2 += d[i+2]; a3 += d[i+3];
+			}
+			for (; i < n; ++i) a0 += d[i];
+			return FLOATING_VAL((a0 + a1) + (a2 + a3));
+		} else {
+			uint64_t total = 0;
+			for (size_t i = 0; i < n; ++i) total += (uint64_t)(int64_t)d[i];
+			return INTEGER_VAL((krk_integer_type)total);
+		}
+	});
+	return NONE_VAL();
+}
+
+static KrkValue arrayMinMax(struct Array * self, int wantMax) {
+	if (!self->length) return krk_runtimeError(vm.exceptions->valueError, "%s() of empty array", wantMax ? "max" : "min");
+	ARRAY_DISPATCH(self, {
+		const T * restrict d = self->data;
+		T best = d[0];
+		if (wantMax) {
+			for (size_t i = 1; i < self->length; ++i) best = d[i] > best ? d[i] : best;
+		} else {
+			for (size_t i = 1; i < self->length; ++i) best = d[i] < best ? d[i] : best;
+		}
+		if (IS_FLOAT_TYPE) return FLOATING_VAL(best);
+		return INTEGER_VAL(best);
+	});
+	return NONE_VAL();
+}
+
+static KrkValue arrayDot(struct Array * self, struct Array * other) {
+	ARRAY_DISPATCH(self, {
+		const T * restrict a = self->data;
+		const T * restrict b = other->data;
+		size_t n = self->length;
+		if (IS_FLOAT_TYPE) {
+			double a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {
+				a0 += (double)a[i] * b[i];
+				a1 += (double)a[i+1] * b[i+1];
+				a2 += (double)a[i+2] * b[i+2];
+				a3 += (double)a[i+3] * b[i+3];
+			}
+			for (; i < n; ++i) a0 += (double)a[i] * b[i];
+			return FLOATING_VAL((a0 + a1) + (a2 + a3));
+		} else {
+			uint64_t total = 0;
+			for (size_t i = 0; i < n; ++i) total += (uint64_t)(int64_t)a[i] * (uint64_t)(int64_t)b[i];
+			return INTEGER_VAL((krk_integer_type)total);
+		}
+	});
+	return NONE_VAL();
+}
+
+KRK_METHOD(array,sum,{
+	METHOD_TAKES_NONE();
+	return arraySum(self);
+})
+
+KRK_METHOD(array,min,{
+	METHOD_TAKES_NONE();
+	return arrayMinMax(self, 0);
+})
+
+KRK_METHOD(array,max,{
+	METHOD_TAKES_NONE();
+	return arrayMinMax(self, 1);
+})
+
+KRK_METHOD(array,dot,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_ARG(1,array,struct Array*,other);
+	if (other->typecode != self->typecode) return krk_runtimeError(vm.exceptions->typeError, "dot() of arrays of different types '%c' and '%c'", self->typecode, other->typecode);
+	if (other->length != self->length) return krk_runtimeError(vm.exceptions->valueError, "dot() of arrays of different lengths");
+	return arrayDot(self, other);
+})
+
+KRK_METHOD(array,scale,{
+	METHOD_TAKES_EXACTLY(1);
+	if (isFloatType(self->typecode)) {
+		double factor;
+		if (IS_FLOATING(argv[1])) factor = AS_FLOATING(argv[1]);
+		else if (IS_INTEGER(argv[1])) factor = AS_INTEGER(argv[1]);
+		else return TYPE_ERROR(float,argv[1]);
+		if (self->typecode == 'f') {
+			float * restrict d = self->data;
+			float f = factor;
+			for (size_t i = 0; i < self->length; ++i) d[i] *= f;
+		} else {
+			double * restrict d = self->data;
+			for (size_t i = 0; i < self->length; ++i) d[i] *= factor;
+		}
+	} else {
+		CHECK_ARG(1,int,krk_integer_type,factor);
+		/* Results wrap around to the element type. The multiply is done in
+		 * uint64_t, where overflow is defined, and the low bits kept. */
+		ARRAY_DISPATCH(self, {
+			T * restrict d = self->data;
+			uint64_t f = (uint64_t)factor;
+			for (size_t i = 0; i < self->length; ++i) d[i] = (T)((uint64_t)d[i] * f);
+		});
+	}
+})
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct ArrayIterator *
+
+KRK_METHOD(arrayiterator,__call__,{
+	struct Array * a = AS_array(self->a);
+	if (self->i >= a->length) return argv[0];
+	return arrayGet(a, self->i++);
+})
+
+KrkValue krk_module_onload_array(void) {
+	KrkInstance * module = krk_newInstance(vm.baseClasses->moduleClass);
+	/* Store it on the stack for now so we can do stuff that may trip GC
+	 * and not lose it to garbage colletion... */
+	krk_push(OBJECT_VAL(module));
+
+	krk_makeClass(module, &array, "array", vm.baseClasses->objectClass);
+	array->allocSize = sizeof(struct Array);
+	array->_ongcsweep = _array_gcsweep;
+	BIND_METHOD(array,__init__);
+	BIND_METHOD(array,__len__);
+	BIND_METHOD(array,__get__);
+	BIND_METHOD(array,__set__);
+	BIND_METHOD(array,__getslice__);
+	BIND_METHOD(array,__repr__);
+	BIND_METHOD(array,__iter__);
+	BIND_METHOD(array,append);
+	BIND_METHOD(array,extend);
+	BIND_METHOD(array,__iadd__);
+	BIND_METHOD(array,frombytes);
+	BIND_METHOD(array,tobytes);
+	BIND_METHOD(array,tolist);
+	BIND_METHOD(array,pop);
+	BIND_METHOD(array,sum);
+	BIND_METHOD(array,min);
+	BIND_METHOD(array,max);
+	BIND_METHOD(array,dot);
+	BIND_METHOD(array,scale);
+	BIND_FIELD(array,typecode);
+	BIND_FIELD(array,itemsize);
+	krk_defineNative(&array->methods, ".__str__", FUNC_NAME(array,__repr__));
+	krk_finalizeClass(array);
+	array->docstring = S("Compact array of numeric values of a single C type.");
+
+	krk_makeClass(module, &arrayiterator, "arrayiterator", vm.baseClasses->objectClass);
+	arrayiterator->allocSize = sizeof(struct ArrayIterator);
+	arrayiterator->_ongcscan = _arrayiterator_gcscan;
+	BIND_METHOD(arrayiterator,__call__);
+	krk_finalizeClass(arrayiterator);
+
+	/* Pop the module object before returning; it'll get pushed again
+	 * by the VM before the GC has a chance to run, so it's safe. */
+	assert(AS_INSTANCE(krk_pop()) == module);
+	return OBJECT_VAL(module);
+}
@@ -0,0 +1,168 @@
+/**
+ * bisect module; binary search and insertion on sorted lists.
+ *
+ * Searches read the list's storage directly under its lock, which is only
+ * released while a key function or a comparison runs managed code.
+ */
+#include <assert.h>
+#include <string.h>
+
+#include "vm.h"
+#include "value.h"
+#include "object.h"
+#include "memory.h"
+#include "util.h"
+
+/* Compare an item from the list against x with the lock released; -1 on exception. */
+static int slowLessThan(KrkList * list, KrkValue a, KrkValue b) {
+	pthread_rwlock_unlock(&list->rwlock);
+	krk_push(a);
+	krk_push(b);
+	KrkValue result = krk_operator_lt(a,b);
+	krk_pop();
+	krk_pop();
+	pthread_rwlock_rdlock(&list->rwlock);
+	if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return -1;
+	return !krk_isFalsey(result);
+}
+
+/*
+ * Find where x belongs in list[lo:hi]: before any equal items, or after
+ * them if `right` is set. With a key function, x is compared against
+ * key(item) and should already be a key. Returns -1 on exception.
+ */
+static krk_integer_type bisectList(KrkList * list, KrkValue x, krk_integer_type lo, krk_integer_type hi, KrkValue key, int right) {
+	pthread_rwlock_rdlock(&list->rwlock);
+	while (lo < hi) {
+		krk_integer_type mid = lo + (hi - lo) / 2;
+		if ((size_t)mid >= list->values.count) {
+			pthread_rwlock_unlock(&list->rwlock);
+			krk_runtimeError(vm.exceptions->indexError, "list index out of range: " PRIkrk_int, mid);
+			return -1;
+		}
+		KrkValue item = list->values.values[mid];
+		if (!IS_NONE(key)) {
+			pthread_rwlock_unlock(&list->rwlock);
+			krk_push(key);
+			krk_push(item);
+			item = krk_callSimple(key, 1, 1);
+			pthread_rwlock_rdlock(&list->rwlock);
+			if (krk_currentThread.flags & KRK_HAS_EXCEPTION) goto _error;
+		}
+		KrkValue a = right ? x : item;
+		KrkValue b = right ? item : x;
+		int lt = fastLessThan(a, b);
+		if (lt < 0 && (lt = slowLessThan(list, a, b)) < 0) goto _error;
+		if (right) {
+			if (lt) hi = mid;
+			else lo = mid + 1;
+		} else {
+			if (lt) lo = mid + 1;
+			else hi = mid;
+		}
+	}
+	pthread_rwlock_unlock(&list->rwlock);
+	return lo;
+
+_error:
+	pthread_rwlock_unlock(&list->rwlock);
+	return -1;
+}
+
+/* Parse (a, x, lo=0, hi=len(a), *, key=None) and run the search. */
+static krk_integer_type bisectArgs(const char * name, int argc, KrkValue argv[], int hasKw, int right, int applyKey) {
+	if (argc < 2 || argc > 4) {
+		krk_runtimeError(vm.exceptions->argumentError, "%s() takes from 2 to 4 positional arguments (%d given)", name, argc);
+		return -1;
+	}
+	if (!IS_list(argv[0])) {
+		krk_runtimeError(vm.exceptions->typeError, "%s() expects list, not '%s'", name, krk_typeName(argv[0]));
+		return -1;
+	}
+	KrkList * list = AS_list(argv[0]);
+	KrkValue lo = argc > 2 ? argv[2] : INTEGER_VAL(0);
+	KrkValue hi = argc > 3 ? argv[3] : NONE_VAL();
+	KrkValue key = NONE_VAL();
+	if (hasKw) {
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("lo")), &lo);
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("hi")), &hi);
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("key")), &key);
+	}
+	if (!IS_INTEGER(lo) || !(IS_INTEGER(hi) || IS_NONE(hi))) {
+		krk_runtimeError(vm.exceptions->typeError, "%s() expects int bounds", name);
+		return -1;
+	}
+	if (AS_INTEGER(lo) < 0) {
+		krk_runtimeError(vm.exceptions->valueError, "lo must be non-negative");
+		return -1;
+	}
+	if (IS_NONE(hi)) hi = INTEGER_VAL(list->values.count);
+
+	KrkValue x = argv[1];
+	if (applyKey && !IS_NONE(key)) {
+		krk_push(key);
+		krk_push(x);
+		x = krk_callSimple(key, 1, 1);
+		if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return -1;
+	}
+	krk_push(x);
+	krk_integer_type index = bisectList(list, x, AS_INTEGER(lo), AS_INTEGER(hi), key, right);
+	krk_pop();
+	return index;
+}
+
+static KrkValue insort(const char * name, int argc, KrkValue argv[], int hasKw, int right) {
+	krk_integer_type index = bisectArgs(name, argc, argv, hasKw, right, 1);
+	if (index < 0) return NONE_VAL();
+	KrkList * list = AS_list(argv[0]);
+	pthread_rwlock_wrlock(&list->rwlock);
+	if ((size_t)index > list->values.count) index = list->values.count;
+	krk_writeValueArray(&list->values, NONE_VAL());
+	memmove(
+		&list->values.values[index+1],
+		&list->values.values[index],
+		sizeof(KrkValue) * (list->values.count - index - 1)
+	);
+	list->values.values[index] = argv[1];
+	pthread_rwlock_unlock(&list->rwlock);
+	return NONE_VAL();
+}
+
+KRK_FUNC(bisect_left,{
+	krk_integer_type index = bisectArgs("bisect_left", argc, argv, hasKw, 0, 0);
+	if (index < 0) return NONE_VAL();
+	return INTEGER_VAL(index);
+})
+
+KRK_FUNC(bisect_right,{
+	krk_integer_type index = bisectArgs("bisect_right", argc, argv, hasKw, 1, 0);
+	if (index < 0) return NONE_VAL();
+	return INTEGER_VAL(index);
+})
+
+KRK_FUNC(insort_left,{
+	return insort("insort_left", argc, argv, hasKw, 0);
+})
+
+KRK_FUNC(insort_right,{
+	return insort("insort_right", argc, argv, hasKw, 1);
+})
+
+KrkValue krk_module_onload_bisect(void) {
+	KrkInstance * module = krk_newInstance(vm.baseClasses->moduleClass);
+	/* Store it on the stack for now so we can do stuff that may trip GC
+	 * and not lose it to garbage colletion... */
+	krk_push(OBJECT_VAL(module));
+
+	BIND_FUNC(module,bisect_left);
+	BIND_FUNC(module,bisect_right);
+	BIND_FUNC(module,insort_left);
+	BIND_FUNC(module,insort_right);
+	krk_defineNative(&module->fields, "bisect", _krk_bisect_right);
+	krk_defineNative(&module->fields, "insort", _krk_insort_right);
+
+	/* Pop the module object before returning; it'll get pushed again
+	 * by the VM before the GC has a chance to run, so it's safe. */
+	assert(AS_INSTANCE(krk_pop()) == module);
+	return OBJECT_VAL(module);
+}
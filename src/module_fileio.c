@@ -135,7 +135,7 @@ _finish_line: (void)0;
 	}
 
 	/* Make a new string to fit our output. */
-	KrkString * out = krk_copyString(buffer,sizeRead);
+	KrkString * out = krk_copyStringUninterned(buffer,sizeRead);
 	free(buffer);
 	return OBJECT_VAL(out);
 })
@@ -206,7 +206,7 @@ KRK_METHOD(File,read,{
 	}
 
 	/* Make a new string to fit our output. */
-	KrkString * out = krk_copyString(buffer,sizeRead);
+	KrkString * out = krk_copyStringUninterned(buffer,sizeRead);
 	free(buffer);
 	return OBJECT_VAL(out);
 })
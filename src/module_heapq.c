@@ -0,0 +1,440 @@
+/**
+ * heapq module; heap queue operations on lists.
+ *
+ * The heap functions work directly on a list's storage while holding its
+ * lock, dropping the lock only when a comparison has to call into managed
+ * code. Ints, floats and strings compare without leaving C.
+ */
+#include <assert.h>
+#include <string.h>
+
+#include "vm.h"
+#include "value.h"
+#include "object.h"
+#include "memory.h"
+#include "util.h"
+
+/* Full comparison; returns -1 if it raised an exception. */
+static int lessThan(KrkValue a, KrkValue b) {
+	int fast = fastLessThan(a,b);
+	if (fast >= 0) return fast;
+	krk_push(a);
+	krk_push(b);
+	KrkValue result = krk_operator_lt(a,b);
+	krk_pop();
+	krk_pop();
+	if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return -1;
+	return !krk_isFalsey(result);
+}
+
+/*
+ * Compare two values from a heap list, which is write-locked by the caller.
+ * If the comparison calls managed code the lock is released around it, and
+ * the heap must be the same size when we come back.
+ */
+static int heapLessThan(KrkList * heap, size_t size, KrkValue a, KrkValue b) {
+	int fast = fastLessThan(a,b);
+	if (fast >= 0) return fast;
+	pthread_rwlock_unlock(&heap->rwlock);
+	int result = lessThan(a,b);
+	pthread_rwlock_wrlock(&heap->rwlock);
+	if (result >= 0 && heap->values.count != size) {
+		krk_runtimeError(vm.exceptions->valueError, "heap changed size during comparison");
+		return -1;
+	}
+	return result;
+}
+
+#define HEAP_SWAP(i,j) do { \
+	KrkValue _tmp = heap->values.values[i]; \
+	heap->values.values[i] = heap->values.values[j]; \
+	heap->values.values[j] = _tmp; } while (0)
+
+/*
+ * Move the item at `pos` towards the root until its parent is not larger.
+ * Items are swapped rather than shifted so the list always holds the same
+ * values, even if a comparison raises part way through.
+ */
+static int siftDown(KrkList * heap, size_t start, size_t pos) {
+	size_t size = heap->values.count;
+	while (pos > start) {
+		size_t parent = (pos - 1) >> 1;
+		int lt = heapLessThan(heap, size, heap->values.values[pos], heap->values.values[parent]);
+		if (lt < 0) return 1;
+		if (!lt) break;
+		HEAP_SWAP(pos, parent);
+		pos = parent;
+	}
+	return 0;
+}
+
+/*
+ * Move the item at `pos` down to a leaf along the path of smaller children,
+ * then back up into place; this takes fewer comparisons than stopping as
+ * soon as the item is in order, since popped items usually belong near the bottom.
+ */
+static int siftUp(KrkList * heap, size_t pos) {
+	size_t size = heap->values.count;
+	size_t start = pos;
+	size_t child = 2 * pos + 1;
+	while (child < size) {
+		size_t right = child + 1;
+		if (right < size) {
+			int lt = heapLessThan(heap, size, heap->values.values[child], heap->values.values[right]);
+			if (lt < 0) return 1;
+			if (!lt) child = right;
+		}
+		HEAP_SWAP(pos, child);
+		pos = child;
+		child = 2 * pos + 1;
+	}
+	return siftDown(heap, start, pos);
+}
+
+KRK_FUNC(heappush,{
+	FUNCTION_TAKES_EXACTLY(2);
+	CHECK_ARG(0,list,KrkList*,heap);
+	pthread_rwlock_wrlock(&heap->rwlock);
+	krk_writeValueArray(&heap->values, argv[1]);
+	siftDown(heap, 0, heap->values.count - 1);
+	pthread_rwlock_unlock(&heap->rwlock);
+})
+
+KRK_FUNC(heappop,{
+	FUNCTION_TAKES_EXACTLY(1);
+	CHECK_ARG(0,list,KrkList*,heap);
+	pthread_rwlock_wrlock(&heap->rwlock);
+	if (!heap->values.count) {
+		pthread_rwlock_unlock(&heap->rwlock);
+		return krk_runtimeError(vm.exceptions->indexError, "pop from empty heap");
+	}
+	KrkValue result = heap->values.values[--heap->values.count];
+	if (heap->values.count) {
+		KrkValue last = result;
+		result = heap->values.values[0];
+		heap->values.values[0] = last;
+		krk_push(result);
+		siftUp(heap, 0);
+		krk_pop();
+	}
+	pthread_rwlock_unlock(&heap->rwlock);
+	return result;
+})
+
+KRK_FUNC(heapreplace,{
+	FUNCTION_TAKES_EXACTLY(2);
+	CHECK_ARG(0,list,KrkList*,heap);
+	pthread_rwlock_wrlock(&heap->rwlock);
+	if (!heap->values.count) {
+		pthread_rwlock_unlock(&heap->rwlock);
+		return krk_runtimeError(vm.exceptions->indexError, "pop from empty heap");
+	}
+	KrkValue result = heap->values.values[0];
+	heap->values.values[0] = argv[1];
+	krk_push(result);
+	siftUp(heap, 0);
+	krk_pop();
+	pthread_rwlock_unlock(&heap->rwlock);
+	return result;
+})
+
+KRK_FUNC(heappushpop,{
+	FUNCTION_TAKES_EXACTLY(2);
+	CHECK_ARG(0,list,KrkList*,heap);
+	KrkValue result = argv[1];
+	pthread_rwlock_wrlock(&heap->rwlock);
+	if (heap->values.count) {
+		int lt = heapLessThan(heap, heap->values.count, heap->values.values[0], result);
+		if (lt > 0) {
+			result = heap->values.values[0];
+			heap->values.values[0] = argv[1];
+			krk_push(result);
+			siftUp(heap, 0);
+			krk_pop();
+		}
+	}
+	pthread_rwlock_unlock(&heap->rwlock);
+	return result;
+})
+
+KRK_FUNC(heapify,{
+	FUNCTION_TAKES_EXACTLY(1);
+	CHECK_ARG(0,list,KrkList*,heap);
+	pthread_rwlock_wrlock(&heap->rwlock);
+	for (size_t i = heap->values.count / 2; i > 0; --i) {
+		if (siftUp(heap, i - 1)) break;
+	}
+	pthread_rwlock_unlock(&heap->rwlock);
+})
+
+/*
+ * nsmallest, nlargest and merge keep heaps of (key, order, value) triples
+ * in a value array. The entry that sorts first is at the root: with equal
+ * keys the lower order comes first, otherwise the lower key comes first,
+ * or the higher key for a descending heap.
+ */
+#define ENTRY_KEY(i)   (entries->values[(i)*3])
+#define ENTRY_ORDER(i) (AS_INTEGER(entries->values[(i)*3+1]))
+
+static int entryFirst(KrkValueArray * entries, size_t i, size_t j, int descending) {
+	int lt = descending ? lessThan(ENTRY_KEY(j), ENTRY_KEY(i)) : lessThan(ENTRY_KEY(i), ENTRY_KEY(j));
+	if (lt) return lt;
+	lt = descending ? lessThan(ENTRY_KEY(i), ENTRY_KEY(j)) : lessThan(ENTRY_KEY(j), ENTRY_KEY(i));
+	if (lt) return lt < 0 ? -1 : 0;
+	return ENTRY_ORDER(i) < ENTRY_ORDER(j);
+}
+
+static void entrySwap(KrkValueArray * entries, size_t i, size_t j) {
+	for (size_t k = 0; k < 3; ++k) {
+		KrkValue tmp = entries->values[i*3+k];
+		entries->values[i*3+k] = entries->values[j*3+k];
+		entries->values[j*3+k] = tmp;
+	}
+}
+
+static int entrySiftDown(KrkValueArray * entries, size_t pos, int descending) {
+	while (pos > 0) {
+		size_t parent = (pos - 1) >> 1;
+		int first = entryFirst(entries, pos, parent, descending);
+		if (first < 0) return 1;
+		if (!first) break;
+		entrySwap(entries, pos, parent);
+		pos = parent;
+	}
+	return 0;
+}
+
+static int entrySiftUp(KrkValueArray * entries, size_t pos, int descending) {
+	size_t size = entries->count / 3;
+	while (1) {
+		size_t best = pos;
+		size_t child = 2 * pos + 1;
+		for (size_t c = child; c < child + 2 && c < size; ++c) {
+			int first = entryFirst(entries, c, best, descending);
+			if (first < 0) return 1;
+			if (first) best = c;
+		}
+		if (best == pos) return 0;
+		entrySwap(entries, pos, best);
+		pos = best;
+	}
+}
+
+static int entryPush(KrkValueArray * entries, KrkValue key, KrkValue order, KrkValue value, int descending) {
+	krk_writeValueArray(entries, key);
+	krk_writeValueArray(entries, order);
+	krk_writeValueArray(entries, value);
+	return entrySiftDown(entries, entries->count / 3 - 1, descending);
+}
+
+/* Remove the root entry, whose value should already be somewhere safe from the GC. */
+static int entryPop(KrkValueArray * entries, int descending) {
+	entries->count -= 3;
+	if (!entries->count) return 0;
+	memcpy(&entries->values[0], &entries->values[entries->count], sizeof(KrkValue) * 3);
+	return entrySiftUp(entries, 0, descending);
+}
+
+static KrkValue callKey(KrkValue key, KrkValue value) {
+	if (IS_NONE(key)) return value;
+	krk_push(key);
+	krk_push(value);
+	return krk_callSimple(key, 1, 1);
+}
+
+struct Selection {
+	KrkValueArray * entries;
+	KrkValue key;
+	size_t n;
+	krk_integer_type seen;
+	int largest;
+};
+
+/*
+ * nsmallest keeps the n smallest items seen so far in a heap with the
+ * largest at the root, and nlargest the reverse. Later items sort ahead of
+ * earlier ones with equal keys, so they are the first to be replaced and
+ * the result is stable.
+ */
+static int selectCallback(void * context, const KrkValue * values, size_t count) {
+	struct Selection * sel = context;
+	KrkValueArray * entries = sel->entries;
+	int descending = !sel->largest;
+	for (size_t i = 0; i < count; ++i) {
+		KrkValue value = values[i];
+		krk_push(value);
+		KrkValue key = callKey(sel->key, value);
+		if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return 1;
+		krk_push(key);
+		KrkValue order = INTEGER_VAL(-(sel->seen++));
+		int status = 0;
+		if (entries->count < sel->n * 3) {
+			status = entryPush(entries, key, order, value, descending);
+		} else {
+			int better = sel->largest ? lessThan(ENTRY_KEY(0), key) : lessThan(key, ENTRY_KEY(0));
+			if (better < 0) status = 1;
+			else if (better) {
+				entries->values[0] = key;
+				entries->values[1] = order;
+				entries->values[2] = value;
+				status = entrySiftUp(entries, 0, descending);
+			}
+		}
+		krk_pop(); /* key */
+		krk_pop(); /* value */
+		if (status) return 1;
+	}
+	return 0;
+}
+
+static KrkValue selectN(int argc, KrkValue argv[], int hasKw, int largest) {
+	CHECK_ARG(0,int,krk_integer_type,n);
+	if (argc < 2) return NOT_ENOUGH_ARGS();
+	if (argc > 2) return krk_runtimeError(vm.exceptions->argumentError, "%s() takes at most 2 positional arguments", largest ? "nlargest" : "nsmallest");
+	struct Selection sel = {NULL, NONE_VAL(), n > 0 ? n : 0, 0, largest};
+	if (hasKw) krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("key")), &sel.key);
+
+	KrkValue storage = krk_list_of(0, NULL);
+	krk_push(storage);
+	sel.entries = AS_LIST(storage);
+	if (sel.n && krk_unpackIterable(argv[1], &sel, selectCallback)) return NONE_VAL();
+
+	/* Popping the heap produces the results from last to first */
+	KrkValueArray * entries = sel.entries;
+	size_t count = entries->count / 3;
+	KrkValue result = krk_list_of(0, NULL);
+	krk_push(result);
+	for (size_t i = 0; i < count; ++i) krk_writeValueArray(AS_LIST(result), NONE_VAL());
+	for (size_t i = count; i > 0; --i) {
+		AS_LIST(result)->values[i-1] = entries->values[2];
+		if (entryPop(entries, !largest)) return NONE_VAL();
+	}
+	result = krk_pop();
+	krk_pop(); /* storage */
+	return result;
+}
+
+KRK_FUNC(nsmallest,{
+	return selectN(argc, argv, hasKw, 0);
+})
+
+KRK_FUNC(nlargest,{
+	return selectN(argc, argv, hasKw, 1);
+})
+
+static KrkClass * merge = NULL;
+struct Merge {
+	KrkInstance inst;
+	KrkValueArray iterators;
+	KrkValueArray entries;
+	KrkValue key;
+	int reverse;
+	int started;
+};
+
+#define IS_merge(o) (krk_isInstanceOf(o,merge))
+#define AS_merge(o) ((struct Merge*)AS_OBJECT(o))
+
+static void _merge_gcscan(KrkInstance * self) {
+	struct Merge * m = (struct Merge*)self;
+	for (size_t i = 0; i < m->iterators.count; ++i) krk_markValue(m->iterators.values[i]);
+	for (size_t i = 0; i < m->entries.count; ++i) krk_markValue(m->entries.values[i]);
+	krk_markValue(m->key);
+}
+
+static void _merge_gcsweep(KrkInstance * self) {
+	struct Merge * m = (struct Merge*)self;
+	krk_freeValueArray(&m->iterators);
+	krk_freeValueArray(&m->entries);
+}
+
+#define CURRENT_CTYPE struct Merge *
+#define CURRENT_NAME  self
+
+KRK_METHOD(merge,__init__,{
+	self->key = NONE_VAL();
+	if (hasKw) {
+		KrkValue reverse = BOOLEAN_VAL(0);
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("key")), &self->key);
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("reverse")), &reverse);
+		self->reverse = !krk_isFalsey(reverse);
+	}
+	for (int i = 1; i < argc; ++i) {
+		KrkValue iterator = krk_getIterator(argv[i]);
+		if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return NONE_VAL();
+		krk_push(iterator);
+		krk_writeValueArray(&self->iterators, iterator);
+		krk_pop();
+	}
+	return argv[0];
+})
+
+KRK_METHOD(merge,__iter__,{
+	return argv[0];
+})
+
+/* Pull the next value from an input and add it to the heap, or replace the root with it. */
+static int mergeAdvance(struct Merge * self, size_t source, int replaceRoot) {
+	KrkValue value;
+	int status = krk_iterNext(self->iterators.values[source], &value);
+	if (status < 0) return 1;
+	if (status == 0) return replaceRoot ? entryPop(&self->entries, self->reverse) : 0;
+	krk_push(value);
+	KrkValue key = callKey(self->key, value);
+	if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return 1;
+	krk_push(key);
+	if (replaceRoot) {
+		self->entries.values[0] = key;
+		self->entries.values[2] = value;
+		status = entrySiftUp(&self->entries, 0, self->reverse);
+	} else {
+		status = entryPush(&self->entries, key, INTEGER_VAL(source), value, self->reverse);
+	}
+	krk_pop();
+	krk_pop();
+	return status;
+}
+
+KRK_METHOD(merge,__call__,{
+	if (!self->started) {
+		self->started = 1;
+		for (size_t i = 0; i < self->iterators.count; ++i) {
+			if (mergeAdvance(self, i, 0)) return NONE_VAL();
+		}
+	}
+	if (!self->entries.count) return argv[0];
+	KrkValue result = self->entries.values[2];
+	krk_push(result);
+	if (mergeAdvance(self, AS_INTEGER(self->entries.values[1]), 1)) return NONE_VAL();
+	return krk_pop();
+})
+
+KrkValue krk_module_onload_heapq(void) {
+	KrkInstance * module = krk_newInstance(vm.baseClasses->moduleClass);
+	/* Store it on the stack for now so we can do stuff that may trip GC
+	 * and not lose it to garbage colletion... */
+	krk_push(OBJECT_VAL(module));
+
+	BIND_FUNC(module,heappush);
+	BIND_FUNC(module,heappop);
+	BIND_FUNC(module,heapreplace);
+	BIND_FUNC(module,heappushpop);
+	BIND_FUNC(module,heapify);
+	BIND_FUNC(module,nsmallest);
+	BIND_FUNC(module,nlargest);
+
+	krk_makeClass(module, &merge, "merge", vm.baseClasses->objectClass);
+	merge->allocSize = sizeof(struct Merge);
+	merge->_ongcscan = _merge_gcscan;
+	merge->_ongcsweep = _merge_gcsweep;
+	BIND_METHOD(merge,__init__);
+	BIND_METHOD(merge,__iter__);
+	BIND_METHOD(merge,__call__);
+	krk_finalizeClass(merge);
+	merge->docstring = S("Iterate over the merged contents of sorted inputs, smallest first.");
+
+	/* Pop the module object before returning; it'll get pushed again
+	 * by the VM before the GC has a chance to run, so it's safe. */
+	assert(AS_INSTANCE(krk_pop()) == module);
+	return OBJECT_VAL(module);
+}
@@ -0,0 +1,571 @@
+/**
+ * itertools module; lazy iterator building blocks.
+ *
+ * Each of these is a native iterator class: calling it returns the next
+ * value, or the iterator itself once exhausted, and inputs are stepped
+ * with krk_iterNext so the built-in iterators don't go through a call.
+ */
+#include <assert.h>
+#include <string.h>
+
+#include "vm.h"
+#include "value.h"
+#include "object.h"
+#include "memory.h"
+#include "util.h"
+
+static KrkClass * chain = NULL;
+struct Chain {
+	KrkInstance inst;
+	KrkValue sources; /* iterator over the iterables to chain */
+	KrkValue current; /* iterator for the current iterable, or None */
+};
+
+#define IS_chain(o) (krk_isInstanceOf(o,chain))
+#define AS_chain(o) ((struct Chain*)AS_OBJECT(o))
+
+static KrkClass * islice = NULL;
+struct ISlice {
+	KrkInstance inst;
+	KrkValue iterator;
+	krk_integer_type next; /* index of the next item to produce */
+	krk_integer_type stop; /* -1 for no limit */
+	krk_integer_type step;
+	krk_integer_type pos;  /* index of the next item from the iterator */
+};
+
+#define IS_islice(o) (krk_isInstanceOf(o,islice))
+#define AS_islice(o) ((struct ISlice*)AS_OBJECT(o))
+
+static KrkClass * count = NULL;
+struct Count {
+	KrkInstance inst;
+	KrkValue value;
+	KrkValue step;
+};
+
+#define IS_count(o) (krk_isInstanceOf(o,count))
+#define AS_count(o) ((struct Count*)AS_OBJECT(o))
+
+static KrkClass * repeat = NULL;
+struct Repeat {
+	KrkInstance inst;
+	KrkValue value;
+	krk_integer_type times; /* -1 for forever */
+};
+
+#define IS_repeat(o) (krk_isInstanceOf(o,repeat))
+#define AS_repeat(o) ((struct Repeat*)AS_OBJECT(o))
+
+static KrkClass * groupby = NULL;
+struct GroupBy {
+	KrkInstance inst;
+	KrkValue iterator;
+	KrkValue key;
+	KrkValue pendingValue; /* first item of the next group */
+	KrkValue pendingKey;
+	int havePending;
+	int done;
+};
+
+#define IS_groupby(o) (krk_isInstanceOf(o,groupby))
+#define AS_groupby(o) ((struct GroupBy*)AS_OBJECT(o))
+
+static KrkClass * product = NULL;
+struct Product {
+	KrkInstance inst;
+	KrkValueArray pools; /* lists of each input's items */
+	size_t * indices;
+	int started;
+	int done;
+};
+
+#define IS_product(o) (krk_isInstanceOf(o,product))
+#define AS_product(o) ((struct Product*)AS_OBJECT(o))
+
+static KrkClass * accumulate = NULL;
+struct Accumulate {
+	KrkInstance inst;
+	KrkValue iterator;
+	KrkValue func;
+	KrkValue total;
+	int haveTotal;
+};
+
+#define IS_accumulate(o) (krk_isInstanceOf(o,accumulate))
+#define AS_accumulate(o) ((struct Accumulate*)AS_OBJECT(o))
+
+static void _chain_gcscan(KrkInstance * self) {
+	krk_markValue(((struct Chain*)self)->sources);
+	krk_markValue(((struct Chain*)self)->current);
+}
+
+static void _islice_gcscan(KrkInstance * self) {
+	krk_markValue(((struct ISlice*)self)->iterator);
+}
+
+static void _count_gcscan(KrkInstance * self) {
+	krk_markValue(((struct Count*)self)->value);
+	krk_markValue(((struct Count*)self)->step);
+}
+
+static void _repeat_gcscan(KrkInstance * self) {
+	krk_markValue(((struct Repeat*)self)->value);
+}
+
+static void _groupby_gcscan(KrkInstance * self) {
+	struct GroupBy * g = (struct GroupBy*)self;
+	krk_markValue(g->iterator);
+	krk_markValue(g->key);
+	krk_markValue(g->pendingValue);
+	krk_markValue(g->pendingKey);
+}
+
+static void _product_gcscan(KrkInstance * self) {
+	struct Product * p = (struct Product*)self;
+	for (size_t i = 0; i < p->pools.count; ++i) krk_markValue(p->pools.values[i]);
+}
+
+static void _product_gcsweep(KrkInstance * self) {
+	struct Product * p = (struct Product*)self;
+	FREE_ARRAY(size_t, p->indices, p->pools.count);
+	krk_freeValueArray(&p->pools);
+}
+
+static void _accumulate_gcscan(KrkInstance * self) {
+	struct Accumulate * a = (struct Accumulate*)self;
+	krk_markValue(a->iterator);
+	krk_markValue(a->func);
+	krk_markValue(a->total);
+}
+
+/* Call func(a, b), or add the values if func is None. */
+static KrkValue combine(KrkValue func, KrkValue a, KrkValue b) {
+	if (IS_NONE(func)) {
+		if (IS_INTEGER(a) && IS_INTEGER(b)) return INTEGER_VAL(AS_INTEGER(a) + AS_INTEGER(b));
+		if (IS_FLOATING(a) && IS_FLOATING(b)) return FLOATING_VAL(AS_FLOATING(a) + AS_FLOATING(b));
+		return krk_operator_add(a, b);
+	}
+	krk_push(func);
+	krk_push(a);
+	krk_push(b);
+	return krk_callSimple(func, 2, 1);
+}
+
+static KrkValue callKey(KrkValue key, KrkValue value) {
+	if (IS_NONE(key)) return value;
+	krk_push(key);
+	krk_push(value);
+	return krk_callSimple(key, 1, 1);
+}
+
+#define CURRENT_NAME  self
+#define CURRENT_CTYPE struct Chain *
+
+KRK_METHOD(chain,__init__,{
+	KrkTuple * sources = krk_newTuple(argc - 1);
+	krk_push(OBJECT_VAL(sources));
+	for (int i = 1; i < argc; ++i) sources->values.values[sources->values.count++] = argv[i];
+	self->current = NONE_VAL();
+	self->sources = krk_getIterator(OBJECT_VAL(sources));
+	krk_pop();
+	return argv[0];
+})
+
+KRK_METHOD(chain,__iter__,{
+	return argv[0];
+})
+
+KRK_METHOD(chain,__call__,{
+	while (1) {
+		if (IS_NONE(self->current)) {
+			KrkValue source;
+			int status = krk_iterNext(self->sources, &source);
+			if (status < 0) return NONE_VAL();
+			if (status == 0) return argv[0];
+			self->current = krk_getIterator(source);
+			if (krk_currentThread.flags & KRK_HAS_EXCEPTION) {
+				self->current = NONE_VAL();
+				return NONE_VAL();
+			}
+		}
+		KrkValue value;
+		int status = krk_iterNext(self->current, &value);
+		if (status < 0) return NONE_VAL();
+		if (status == 1) return value;
+		self->current = NONE_VAL();
+	}
+})
+
+/* chain.from_iterable(iterables) chains the iterables produced lazily by its argument. */
+static KrkValue _chain_from_iterable(int argc, KrkValue argv[], int hasKw) {
+	FUNCTION_TAKES_EXACTLY(1);
+	KrkValue sources = krk_getIterator(argv[0]);
+	if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return NONE_VAL();
+	krk_push(sources);
+	struct Chain * out = (struct Chain*)krk_newInstance(chain);
+	out->sources = krk_pop();
+	out->current = NONE_VAL();
+	return OBJECT_VAL(out);
+}
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct ISlice *
+
+static int sliceArg(KrkValue value, krk_integer_type * out, krk_integer_type ifNone) {
+	if (IS_NONE(value)) {
+		*out = ifNone;
+		return 0;
+	}
+	if (!IS_INTEGER(value) || AS_INTEGER(value) < 0) {
+		krk_runtimeError(vm.exceptions->valueError, "indices for islice() must be None or non-negative integers");
+		return 1;
+	}
+	*out = AS_INTEGER(value);
+	return 0;
+}
+
+KRK_METHOD(islice,__init__,{
+	METHOD_TAKES_AT_LEAST(2);
+	METHOD_TAKES_AT_MOST(4);
+	KrkValue start = NONE_VAL();
+	KrkValue stop = argv[2];
+	KrkValue step = NONE_VAL();
+	if (argc > 3) {
+		start = argv[2];
+		stop = argv[3];
+	}
+	if (argc > 4) step = argv[4];
+	if (sliceArg(start, &self->next, 0)) return NONE_VAL();
+	if (sliceArg(stop, &self->stop, -1)) return NONE_VAL();
+	if (sliceArg(step, &self->step, 1)) return NONE_VAL();
+	if (self->step == 0) return krk_runtimeError(vm.exceptions->valueError, "step for islice() must be a positive integer");
+	self->pos = 0;
+	self->iterator = krk_getIterator(argv[1]);
+	return argv[0];
+})
+
+KRK_METHOD(islice,__iter__,{
+	return argv[0];
+})
+
+KRK_METHOD(islice,__call__,{
+	if (self->stop >= 0 && self->next >= self->stop) return argv[0];
+	KrkValue value;
+	while (1) {
+		int status = krk_iterNext(self->iterator, &value);
+		if (status < 0) return NONE_VAL();
+		if (status == 0) {
+			self->stop = 0;
+			return argv[0];
+		}
+		if (self->pos++ == self->next) break;
+	}
+	self->next += self->step;
+	return value;
+})
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct Count *
+
+KRK_METHOD(count,__init__,{
+	METHOD_TAKES_AT_MOST(2);
+	self->value = argc > 1 ? argv[1] : INTEGER_VAL(0);
+	self->step  = argc > 2 ? argv[2] : INTEGER_VAL(1);
+	if (hasKw) {
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("start")), &self->value);
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("step")), &self->step);
+	}
+	return argv[0];
+})
+
+KRK_METHOD(count,__iter__,{
+	return argv[0];
+})
+
+KRK_METHOD(count,__call__,{
+	KrkValue out = self->value;
+	krk_push(out);
+	self->value = combine(NONE_VAL(), out, self->step);
+	return krk_pop();
+})
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct Repeat *
+
+KRK_METHOD(repeat,__init__,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(2);
+	KrkValue times = argc > 2 ? argv[2] : NONE_VAL();
+	if (hasKw) krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("times")), &times);
+	if (!IS_NONE(times) && !IS_INTEGER(times)) return TYPE_ERROR(int,times);
+	self->value = argv[1];
+	self->times = IS_NONE(times) ? -1 : (AS_INTEGER(times) < 0 ? 0 : AS_INTEGER(times));
+	return argv[0];
+})
+
+KRK_METHOD(repeat,__iter__,{
+	return argv[0];
+})
+
+KRK_METHOD(repeat,__call__,{
+	if (self->times == 0) return argv[0];
+	if (self->times > 0) self->times--;
+	return self->value;
+})
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct GroupBy *
+
+KRK_METHOD(groupby,__init__,{
+	METHOD_TAKES_EXACTLY(1);
+	self->key = NONE_VAL();
+	if (hasKw) krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("key")), &self->key);
+	self->pendingValue = NONE_VAL();
+	self->pendingKey = NONE_VAL();
+	self->iterator = krk_getIterator(argv[1]);
+	return argv[0];
+})
+
+KRK_METHOD(groupby,__iter__,{
+	return argv[0];
+})
+
+/* Read the next item and its key into the pending slots; returns the iterator status. */
+static int groupbyAdvance(struct GroupBy * self) {
+	KrkValue value;
+	int status = krk_iterNext(self->iterator, &value);
+	if (status != 1) {
+		self->havePending = 0;
+		if (status == 0) self->done = 1;
+		return status;
+	}
+	self->pendingValue = value;
+	self->pendingKey = callKey(self->key, value);
+	if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return -1;
+	self->havePending = 1;
+	return 1;
+}
+
+/*
+ * Each group is collected into a list when it is produced, so only the
+ * items of one group are held at a time.
+ */
+KRK_METHOD(groupby,__call__,{
+	if (!self->havePending) {
+		if (self->done) return argv[0];
+		int status = groupbyAdvance(self);
+		if (status < 0) return NONE_VAL();
+		if (status == 0) return argv[0];
+	}
+	KrkValue groupKey = self->pendingKey;
+	krk_push(groupKey);
+	KrkValue group = krk_list_of(1, &self->pendingValue);
+	krk_push(group);
+	while (1) {
+		int status = groupbyAdvance(self);
+		if (status < 0) return NONE_VAL();
+		if (status == 0) break;
+		int same = krk_valuesEqual(self->pendingKey, groupKey);
+		if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return NONE_VAL();
+		if (!same) break;
+		krk_writeValueArray(AS_LIST(group), self->pendingValue);
+		self->havePending = 0;
+	}
+	KrkTuple * tuple = krk_newTuple(2);
+	tuple->values.values[tuple->values.count++] = groupKey;
+	tuple->values.values[tuple->values.count++] = group;
+	krk_pop();
+	krk_pop();
+	return OBJECT_VAL(tuple);
+})
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct Product *
+
+static int productCollect(void * context, const KrkValue * values, size_t count) {
+	for (size_t i = 0; i < count; ++i) krk_writeValueArray(context, values[i]);
+	return 0;
+}
+
+KRK_METHOD(product,__init__,{
+	krk_integer_type times = 1;
+	if (hasKw) {
+		KrkValue value = INTEGER_VAL(1);
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("repeat")), &value);
+		if (!IS_INTEGER(value)) return TYPE_ERROR(int,value);
+		times = AS_INTEGER(value) < 0 ? 0 : AS_INTEGER(value);
+	}
+	/* Drop anything left from an earlier __init__ */
+	FREE_ARRAY(size_t, self->indices, self->pools.count);
+	self->indices = NULL;
+	krk_freeValueArray(&self->pools);
+	self->started = 0;
+	self->done = 0;
+	size_t inputs = argc - 1;
+	for (size_t i = 0; i < inputs; ++i) {
+		KrkValue pool = krk_list_of(0, NULL);
+		krk_push(pool);
+		krk_writeValueArray(&self->pools, pool);
+		krk_pop();
+		if (krk_unpackIterable(argv[i+1], AS_LIST(pool), productCollect)) {
+			/* No indices yet, so there should be no pools for the sweep to match them to. */
+			krk_freeValueArray(&self->pools);
+			return NONE_VAL();
+		}
+	}
+	/* product(a, b, repeat=2) is product(a, b, a, b) */
+	for (krk_integer_type r = 1; r < times; ++r) {
+		for (size_t i = 0; i < inputs; ++i) krk_writeValueArray(&self->pools, self->pools.values[i]);
+	}
+	if (times == 0) self->pools.count = 0;
+	self->indices = GROW_ARRAY(size_t, NULL, 0, self->pools.count);
+	memset(self->indices, 0, sizeof(size_t) * self->pools.count);
+	return argv[0];
+})
+
+KRK_METHOD(product,__iter__,{
+	return argv[0];
+})
+
+KRK_METHOD(product,__call__,{
+	if (self->done) return argv[0];
+	size_t n = self->pools.count;
+	if (!self->started) {
+		self->started = 1;
+		for (size_t i = 0; i < n; ++i) {
+			if (!AS_LIST(self->pools.values[i])->count) {
+				self->done = 1;
+				return argv[0];
+			}
+		}
+	} else {
+		/* Advance the rightmost index, carrying to the left */
+		size_t i = n;
+		while (i > 0) {
+			--i;
+			if (++self->indices[i] < AS_LIST(self->pools.values[i])->count) break;
+			self->indices[i] = 0;
+			if (i == 0) {
+				self->done = 1;
+				return argv[0];
+			}
+		}
+		if (n == 0) {
+			self->done = 1;
+			return argv[0];
+		}
+	}
+	KrkTuple * tuple = krk_newTuple(n);
+	for (size_t i = 0; i < n; ++i) {
+		tuple->values.values[tuple->values.count++] = AS_LIST(self->pools.values[i])->values[self->indices[i]];
+	}
+	return OBJECT_VAL(tuple);
+})
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct Accumulate *
+
+KRK_METHOD(accumulate,__init__,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(2);
+	self->func = argc > 2 ? argv[2] : NONE_VAL();
+	self->total = NONE_VAL();
+	if (hasKw) {
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("func")), &self->func);
+		if (krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("initial")), &self->total) && !IS_NONE(self->total)) {
+			self->haveTotal = -1; /* produce the initial value first */
+		}
+	}
+	self->iterator = krk_getIterator(argv[1]);
+	return argv[0];
+})
+
+KRK_METHOD(accumulate,__iter__,{
+	return argv[0];
+})
+
+KRK_METHOD(accumulate,__call__,{
+	if (self->haveTotal < 0) {
+		self->haveTotal = 1;
+		return self->total;
+	}
+	KrkValue value;
+	int status = krk_iterNext(self->iterator, &value);
+	if (status < 0) return NONE_VAL();
+	if (status == 0) return argv[0];
+	if (!self->haveTotal) {
+		self->haveTotal = 1;
+		self->total = value;
+		return value;
+	}
+	krk_push(value);
+	KrkValue total = combine(self->func, self->total, value);
+	krk_pop();
+	if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return NONE_VAL();
+	self->total = total;
+	return total;
+})
+
+#define BIND_ITERATOR(klass) do { \
+	BIND_METHOD(klass,__init__); \
+	BIND_METHOD(klass,__iter__); \
+	BIND_METHOD(klass,__call__); \
+	krk_finalizeClass(klass); \
+} while (0)
+
+KrkValue krk_module_onload_itertools(void) {
+	KrkInstance * module = krk_newInstance(vm.baseClasses->moduleClass);
+	/* Store it on the stack for now so we can do stuff that may trip GC
+	 * and not lose it to garbage colletion... */
+	krk_push(OBJECT_VAL(module));
+
+	krk_makeClass(module, &chain, "chain", vm.baseClasses->objectClass);
+	chain->allocSize = sizeof(struct Chain);
+	chain->_ongcscan = _chain_gcscan;
+	krk_defineNative(&chain->fields, "from_iterable", _chain_from_iterable);
+	BIND_ITERATOR(chain);
+	chain->docstring = S("Iterate over each of the given iterables in turn.");
+
+	krk_makeClass(module, &islice, "islice", vm.baseClasses->objectClass);
+	islice->allocSize = sizeof(struct ISlice);
+	islice->_ongcscan = _islice_gcscan;
+	BIND_ITERATOR(islice);
+	islice->docstring = S("Iterate over selected items of an iterable, as with slicing.");
+
+	krk_makeClass(module, &count, "count", vm.baseClasses->objectClass);
+	count->allocSize = sizeof(struct Count);
+	count->_ongcscan = _count_gcscan;
+	BIND_ITERATOR(count);
+	count->docstring = S("Count up from start by step, forever.");
+
+	krk_makeClass(module, &repeat, "repeat", vm.baseClasses->objectClass);
+	repeat->allocSize = sizeof(struct Repeat);
+	repeat->_ongcscan = _repeat_gcscan;
+	BIND_ITERATOR(repeat);
+	repeat->docstring = S("Produce the same value forever, or the given number of times.");
+
+	krk_makeClass(module, &groupby, "groupby", vm.baseClasses->objectClass);
+	groupby->allocSize = sizeof(struct GroupBy);
+	groupby->_ongcscan = _groupby_gcscan;
+	BIND_ITERATOR(groupby);
+	groupby->docstring = S("Iterate over (key, items) for runs of consecutive items with equal keys.");
+
+	krk_makeClass(module, &product, "product", vm.baseClasses->objectClass);
+	product->allocSize = sizeof(struct Product);
+	product->_ongcscan = _product_gcscan;
+	product->_ongcsweep = _product_gcsweep;
+	BIND_ITERATOR(product);
+	product->docstring = S("Iterate over tuples from the cartesian product of the given iterables.");
+
+	krk_makeClass(module, &accumulate, "accumulate", vm.baseClasses->objectClass);
+	accumulate->allocSize = sizeof(struct Accumulate);
+	accumulate->_ongcscan = _accumulate_gcscan;
+	BIND_ITERATOR(accumulate);
+	accumulate->docstring = S("Iterate over running totals, or running results of a two-argument function.");
+
+	/* Pop the module object before returning; it'll get pushed again
+	 * by the VM before the GC has a chance to run, so it's safe. */
+	assert(AS_INSTANCE(krk_pop()) == module);
+	return OBJECT_VAL(module);
+}
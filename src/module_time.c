@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <time.h>
+#include <sys/time.h>
 
 #include "vm.h"
 #include "value.h"
@@ -34,8 +35,9 @@ static KrkValue _time_sleep(int argc, KrkValue argv[]) {
 }
 
 static KrkValue _time_time(int argc, KrkValue argv[]) {
-	time_t out = time(NULL);
-	return FLOATING_VAL(out); /* TODO actually support subsecond values */
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return FLOATING_VAL((double)tv.tv_sec + (double)tv.tv_usec / 1000000.0);
 }
 
 KrkValue krk_module_onload_time(void) {
@@ -0,0 +1,287 @@
+/**
+ * tokenize module; the compiler's scanner, for scripts.
+ *
+ * tokenize(source) iterates over the tokens of a string as tuples of
+ * (type, text, line, column), where type is the token's name, such as
+ * "IDENTIFIER", "DEF" or "LEFT_PAREN". tokenize_file(path) does the same
+ * for a file while reading it a line at a time, so only the current line,
+ * or the lines of a multi-line string, are held in memory.
+ *
+ * Comments and blank lines produce no tokens, as in the compiler. The
+ * last token is EOF, or ERROR, with the scanner's message as its text.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "vm.h"
+#include "value.h"
+#include "object.h"
+#include "memory.h"
+#include "scanner.h"
+#include "util.h"
+
+static const char * tokenNames[] = {
+	[TOKEN_LEFT_PAREN] = "LEFT_PAREN",
+	[TOKEN_RIGHT_PAREN] = "RIGHT_PAREN",
+	[TOKEN_LEFT_BRACE] = "LEFT_BRACE",
+	[TOKEN_RIGHT_BRACE] = "RIGHT_BRACE",
+	[TOKEN_LEFT_SQUARE] = "LEFT_SQUARE",
+	[TOKEN_RIGHT_SQUARE] = "RIGHT_SQUARE",
+	[TOKEN_COLON] = "COLON",
+	[TOKEN_COMMA] = "COMMA",
+	[TOKEN_DOT] = "DOT",
+	[TOKEN_MINUS] = "MINUS",
+	[TOKEN_PLUS] = "PLUS",
+	[TOKEN_SEMICOLON] = "SEMICOLON",
+	[TOKEN_SOLIDUS] = "SOLIDUS",
+	[TOKEN_ASTERISK] = "ASTERISK",
+	[TOKEN_POW] = "POW",
+	[TOKEN_MODULO] = "MODULO",
+	[TOKEN_AT] = "AT",
+	[TOKEN_CARET] = "CARET",
+	[TOKEN_AMPERSAND] = "AMPERSAND",
+	[TOKEN_PIPE] = "PIPE",
+	[TOKEN_TILDE] = "TILDE",
+	[TOKEN_LEFT_SHIFT] = "LEFT_SHIFT",
+	[TOKEN_RIGHT_SHIFT] = "RIGHT_SHIFT",
+	[TOKEN_BANG] = "BANG",
+	[TOKEN_GREATER] = "GREATER",
+	[TOKEN_LESS] = "LESS",
+	[TOKEN_GREATER_EQUAL] = "GREATER_EQUAL",
+	[TOKEN_LESS_EQUAL] = "LESS_EQUAL",
+	[TOKEN_BANG_EQUAL] = "BANG_EQUAL",
+	[TOKEN_EQUAL_EQUAL] = "EQUAL_EQUAL",
+	[TOKEN_EQUAL] = "EQUAL",
+	[TOKEN_LSHIFT_EQUAL] = "LSHIFT_EQUAL",
+	[TOKEN_RSHIFT_EQUAL] = "RSHIFT_EQUAL",
+	[TOKEN_PLUS_EQUAL] = "PLUS_EQUAL",
+	[TOKEN_MINUS_EQUAL] = "MINUS_EQUAL",
+	[TOKEN_PLUS_PLUS] = "PLUS_PLUS",
+	[TOKEN_MINUS_MINUS] = "MINUS_MINUS",
+	[TOKEN_CARET_EQUAL] = "CARET_EQUAL",
+	[TOKEN_PIPE_EQUAL] = "PIPE_EQUAL",
+	[TOKEN_AMP_EQUAL] = "AMP_EQUAL",
+	[TOKEN_SOLIDUS_EQUAL] = "SOLIDUS_EQUAL",
+	[TOKEN_ASTERISK_EQUAL] = "ASTERISK_EQUAL",
+	[TOKEN_POW_EQUAL] = "POW_EQUAL",
+	[TOKEN_MODULO_EQUAL] = "MODULO_EQUAL",
+	[TOKEN_STRING] = "STRING",
+	[TOKEN_BIG_STRING] = "BIG_STRING",
+	[TOKEN_NUMBER] = "NUMBER",
+	[TOKEN_IDENTIFIER] = "IDENTIFIER",
+	[TOKEN_AND] = "AND",
+	[TOKEN_CLASS] = "CLASS",
+	[TOKEN_DEF] = "DEF",
+	[TOKEN_DEL] = "DEL",
+	[TOKEN_ELSE] = "ELSE",
+	[TOKEN_FALSE] = "FALSE",
+	[TOKEN_FOR] = "FOR",
+	[TOKEN_IF] = "IF",
+	[TOKEN_IMPORT] = "IMPORT",
+	[TOKEN_IN] = "IN",
+	[TOKEN_IS] = "IS",
+	[TOKEN_LET] = "LET",
+	[TOKEN_NONE] = "NONE",
+	[TOKEN_NOT] = "NOT",
+	[TOKEN_OR] = "OR",
+	[TOKEN_ELIF] = "ELIF",
+	[TOKEN_PASS] = "PASS",
+	[TOKEN_RETURN] = "RETURN",
+	[TOKEN_SELF] = "SELF",
+	[TOKEN_SUPER] = "SUPER",
+	[TOKEN_TRUE] = "TRUE",
+	[TOKEN_WHILE] = "WHILE",
+	[TOKEN_TRY] = "TRY",
+	[TOKEN_EXCEPT] = "EXCEPT",
+	[TOKEN_RAISE] = "RAISE",
+	[TOKEN_BREAK] = "BREAK",
+	[TOKEN_CONTINUE] = "CONTINUE",
+	[TOKEN_AS] = "AS",
+	[TOKEN_FROM] = "FROM",
+	[TOKEN_LAMBDA] = "LAMBDA",
+	[TOKEN_WITH] = "WITH",
+	[TOKEN_YIELD] = "YIELD",
+	[TOKEN_PREFIX_B] = "PREFIX_B",
+	[TOKEN_PREFIX_F] = "PREFIX_F",
+	[TOKEN_INDENTATION] = "INDENTATION",
+	[TOKEN_EOL] = "EOL",
+	[TOKEN_RETRY] = "RETRY",
+	[TOKEN_ERROR] = "ERROR",
+	[TOKEN_EOF] = "EOF",
+};
+
+static KrkClass * tokenizer = NULL;
+struct Tokenizer {
+	KrkInstance inst;
+	KrkScanner scanner;
+	KrkValue source; /* string being scanned, or None when reading a file */
+	FILE * file;     /* file still being read, or NULL */
+	char * buffer;   /* lines read from the file that haven't been scanned */
+	size_t length;
+	size_t space;
+	int done;
+};
+
+#define IS_tokenizer(o) (krk_isInstanceOf(o,tokenizer))
+#define AS_tokenizer(o) ((struct Tokenizer*)AS_OBJECT(o))
+
+static void _tokenizer_gcscan(KrkInstance * self) {
+	krk_markValue(((struct Tokenizer*)self)->source);
+}
+
+static void _tokenizer_gcsweep(KrkInstance * self) {
+	struct Tokenizer * t = (struct Tokenizer*)self;
+	if (t->file) fclose(t->file);
+	FREE_ARRAY(char, t->buffer, t->space);
+}
+
+/* Point a scanner that was reading from one buffer at the same place in another. */
+static void moveScanner(KrkScanner * scanner, const char * from, const char * to) {
+	scanner->start = to + (scanner->start - from);
+	scanner->cur = to + (scanner->cur - from);
+	scanner->linePtr = to + (scanner->linePtr - from);
+}
+
+/*
+ * Append the next line of the file to the buffer, moving the scanner
+ * along with the buffer if it grows. Returns 0 at the end of the file.
+ */
+static int readLine(struct Tokenizer * self, KrkScanner * scanner) {
+	if (!self->file) return 0;
+	size_t before = self->length;
+	do {
+		if (self->space < self->length + 256) {
+			size_t old = self->space;
+			char * oldBuffer = self->buffer;
+			self->space = GROW_CAPACITY(old);
+			self->buffer = GROW_ARRAY(char, self->buffer, old, self->space);
+			moveScanner(scanner, oldBuffer, self->buffer);
+		}
+		if (!fgets(self->buffer + self->length, self->space - self->length, self->file)) break;
+		self->length += strlen(self->buffer + self->length);
+	} while (self->buffer[self->length - 1] != '\n');
+	if (self->length == before) {
+		fclose(self->file);
+		self->file = NULL;
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * Scan the next token. When reading a file, running out of buffer means
+ * either the line is finished, so the next one replaces it, or a string
+ * continues onto the next line, so the token is scanned again with that
+ * line added.
+ */
+static KrkToken nextToken(struct Tokenizer * self) {
+	while (1) {
+		KrkScanner before = self->scanner;
+		KrkToken token = krk_scanToken(&self->scanner);
+		if (token.type == TOKEN_RETRY) continue;
+		if (token.type != TOKEN_ERROR && token.line != before.line) {
+			/* Multi-line strings are reported where they end; we want where they start. */
+			token.line = before.line;
+			token.col = (token.start - before.linePtr) + 1;
+		}
+		if (!self->file) return token;
+		if (token.type == TOKEN_EOF) {
+			/* Everything so far has been scanned, so start the buffer over. */
+			self->length = 0;
+			self->buffer[0] = '\0';
+			self->scanner.start = self->scanner.cur = self->scanner.linePtr = self->buffer;
+			if (readLine(self, &self->scanner)) continue;
+			return token;
+		}
+		if (token.type == TOKEN_ERROR && *self->scanner.cur == '\0') {
+			self->scanner = before;
+			if (readLine(self, &self->scanner)) continue;
+			return krk_scanToken(&self->scanner);
+		}
+		return token;
+	}
+}
+
+#define CURRENT_NAME  self
+#define CURRENT_CTYPE struct Tokenizer *
+
+KRK_METHOD(tokenizer,__iter__,{
+	return argv[0];
+})
+
+KRK_METHOD(tokenizer,__call__,{
+	if (self->done) return argv[0];
+	KrkToken token = nextToken(self);
+	if (token.type == TOKEN_EOF || token.type == TOKEN_ERROR) self->done = 1;
+
+	KrkTuple * out = krk_newTuple(4);
+	krk_push(OBJECT_VAL(out));
+	/* Strings are made before the slot is counted, so a collection while
+	 * making one never sees an unset value in the tuple. */
+	const char * name = tokenNames[token.type];
+	KrkValue value = OBJECT_VAL(krk_copyString(name, strlen(name)));
+	out->values.values[out->values.count++] = value;
+	size_t width = (token.type == TOKEN_ERROR) ? token.length : token.literalWidth;
+	value = OBJECT_VAL(krk_copyString(token.start, width));
+	out->values.values[out->values.count++] = value;
+	out->values.values[out->values.count++] = INTEGER_VAL(token.line);
+	out->values.values[out->values.count++] = INTEGER_VAL(token.col);
+	return krk_pop();
+})
+
+static struct Tokenizer * newTokenizer(void) {
+	struct Tokenizer * self = (struct Tokenizer*)krk_newInstance(tokenizer);
+	self->source = NONE_VAL();
+	return self;
+}
+
+KRK_FUNC(tokenize,{
+	FUNCTION_TAKES_EXACTLY(1);
+	CHECK_ARG(0,str,KrkString*,source);
+	struct Tokenizer * self = newTokenizer();
+	self->source = argv[0];
+	self->scanner = krk_initScanner(source->chars);
+	return OBJECT_VAL(self);
+})
+
+KRK_FUNC(tokenize_file,{
+	FUNCTION_TAKES_EXACTLY(1);
+	CHECK_ARG(0,str,KrkString*,path);
+	FILE * file = fopen(path->chars, "r");
+	if (!file) return krk_runtimeError(vm.exceptions->ioError, "tokenize_file: failed to open file; system returned: %s", strerror(errno));
+	struct Tokenizer * self = newTokenizer();
+	krk_push(OBJECT_VAL(self));
+	self->file = file;
+	self->space = 256;
+	self->buffer = GROW_ARRAY(char, NULL, 0, self->space);
+	self->buffer[0] = '\0';
+	self->scanner = krk_initScanner(self->buffer);
+	readLine(self, &self->scanner);
+	return krk_pop();
+})
+
+KrkValue krk_module_onload_tokenize(void) {
+	KrkInstance * module = krk_newInstance(vm.baseClasses->moduleClass);
+	/* Store it on the stack for now so we can do stuff that may trip GC
+	 * and not lose it to garbage colletion... */
+	krk_push(OBJECT_VAL(module));
+
+	krk_makeClass(module, &tokenizer, "tokenizer", vm.baseClasses->objectClass);
+	tokenizer->allocSize = sizeof(struct Tokenizer);
+	tokenizer->_ongcscan = _tokenizer_gcscan;
+	tokenizer->_ongcsweep = _tokenizer_gcsweep;
+	BIND_METHOD(tokenizer,__iter__);
+	BIND_METHOD(tokenizer,__call__);
+	krk_finalizeClass(tokenizer);
+	tokenizer->docstring = S("Iterator over (type, text, line, column) for each token of some source.");
+
+	BIND_FUNC(module,tokenize);
+	BIND_FUNC(module,tokenize_file);
+
+	/* Pop the module object before returning; it'll get pushed again
+	 * by the VM before the GC has a chance to run, so it's safe. */
+	assert(AS_INSTANCE(krk_pop()) == module);
+	return OBJECT_VAL(module);
+}
@@ -109,9 +109,20 @@ static KrkValue _bytes_contains(int argc, KrkValue argv[]) {
 	return krk_runtimeError(vm.exceptions->notImplementedError, "not implemented");
 }
 
+static KrkValue _bytes_add(int argc, KrkValue argv[]) {
+	if (argc != 2 || !IS_BYTES(argv[1])) return krk_runtimeError(vm.exceptions->typeError, "can't concat bytes to '%s'", krk_typeName(argv[argc > 1]));
+	KrkBytes * self = AS_BYTES(argv[0]);
+	KrkBytes * them = AS_BYTES(argv[1]);
+	KrkBytes * out = krk_newBytes(self->length + them->length, NULL);
+	memcpy(out->bytes, self->bytes, self->length);
+	memcpy(out->bytes + self->length, them->bytes, them->length);
+	krk_bytesUpdateHash(out);
+	return OBJECT_VAL(out);
+}
+
 static KrkValue _bytes_decode(int argc, KrkValue argv[]) {
 	/* TODO: Actually bother checking if this explodes, or support other encodings... */
-	return OBJECT_VAL(krk_copyString((char*)AS_BYTES(argv[0])->bytes, AS_BYTES(argv[0])->length));
+	return OBJECT_VAL(krk_copyStringUninterned((char*)AS_BYTES(argv[0])->bytes, AS_BYTES(argv[0])->length));
 }
 
 #undef PUSH_CHAR
@@ -127,5 +138,6 @@ void _createAndBind_bytesClass(void) {
 	krk_defineNative(&vm.baseClasses->bytesClass->methods, ".__contains__", _bytes_contains);
 	krk_defineNative(&vm.baseClasses->bytesClass->methods, ".__get__", _bytes_get);
 	krk_defineNative(&vm.baseClasses->bytesClass->methods, ".__eq__", _bytes_eq);
+	krk_defineNative(&vm.baseClasses->bytesClass->methods, ".__add__", _bytes_add);
 	krk_finalizeClass(vm.baseClasses->bytesClass);
 }
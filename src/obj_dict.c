@@ -4,13 +4,6 @@
 #include "memory.h"
 #include "util.h"
 
-#define KEY_ERROR(value) {\
-	KrkClass * type = krk_getType(value); \
-	krk_push(value); \
-	KrkValue asString = krk_callSimple(OBJECT_VAL(type->_reprer), 1, 0); \
-	if (IS_STRING(asString)) return krk_runtimeError(vm.exceptions->keyError, "%s", AS_CSTRING(asString)); \
-	return krk_runtimeError(vm.exceptions->keyError, "key error"); }
-
 /**
  * Exposed method called to produce dictionaries from {expr: expr, ...} sequences in managed code.
  * Presented in the global namespace as dictOf(...). Expects arguments as key,value,key,value...
@@ -46,8 +39,17 @@ KRK_METHOD(dict,__init__,{
 KRK_METHOD(dict,__get__,{
 	METHOD_TAKES_EXACTLY(1);
 	KrkValue out;
-	if (!krk_tableGet(&self->entries, argv[1], &out))
-		KEY_ERROR(argv[1]);
+	if (!krk_tableGet(&self->entries, argv[1], &out)) {
+		if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return NONE_VAL();
+		/* Subclasses can provide a value for missing keys */
+		KrkClass * type = self->inst._class;
+		if (type->_missing) {
+			krk_push(argv[0]);
+			krk_push(argv[1]);
+			return krk_callSimple(OBJECT_VAL(type->_missing), 2, 0);
+		}
+		return krk_keyError(argv[1]);
+	}
 	return out;
 })
 
@@ -66,10 +68,17 @@ KRK_METHOD(dict,__or__,{
 	return krk_pop();
 })
 
+KRK_METHOD(dict,__ior__,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_ARG(1,dict,KrkDict*,them);
+	krk_tableAddAll(&them->entries, &self->entries);
+	return argv[0];
+})
+
 KRK_METHOD(dict,__delitem__,{
 	METHOD_TAKES_EXACTLY(1);
 	if (!krk_tableDelete(&self->entries, argv[1])) {
-		KEY_ERROR(argv[1]);
+		return krk_keyError(argv[1]);
 	}
 })
 
@@ -162,6 +171,7 @@ KRK_METHOD(dict,setdefault,{
 
 	/* TODO this is slow; use findEntry instead! */
 	if (!krk_tableGet(&self->entries, argv[1], &out)) {
+		if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return NONE_VAL();
 		krk_tableSet(&self->entries, argv[1], out);
 	}
 
@@ -373,6 +383,7 @@ void _createAndBind_dictClass(void) {
 	BIND_METHOD(dict,__get__);
 	BIND_METHOD(dict,__set__);
 	BIND_METHOD(dict,__or__);
+	BIND_METHOD(dict,__ior__);
 	BIND_METHOD(dict,__delitem__);
 	BIND_METHOD(dict,__len__);
 	BIND_METHOD(dict,__contains__);
@@ -385,6 +396,7 @@ void _createAndBind_dictClass(void) {
 	BIND_METHOD(dict,setdefault);
 	BIND_METHOD(dict,update);
 	krk_defineNative(&dict->methods, ".__str__", FUNC_NAME(dict,__repr__));
+	krk_defineNative(&dict->methods, ".__iter__", FUNC_NAME(dict,keys));
 	krk_finalizeClass(dict);
 	dict->docstring = S("Mapping of arbitrary keys to values.");
 
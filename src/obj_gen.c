@@ -0,0 +1,235 @@
+/**
+ * Generator objects.
+ *
+ * Calling a function that contains `yield` doesn't run it; instead its
+ * arguments are captured into a generator. Each time the generator is called
+ * it pushes its saved stack segment back onto the VM stack, sets up a call
+ * frame at the saved instruction pointer, and runs until OP_YIELD or
+ * OP_RETURN. On a yield the frame is popped again and everything above the
+ * frame's base, including any exception or `with` handlers, is copied back
+ * out. Handler targets are chunk offsets and local slots are relative to the
+ * frame, so the segment can be resumed anywhere on the stack.
+ *
+ * Locals captured by closures inside the generator are closed on each yield
+ * and reopened on the next resume, so the closures and the generator keep
+ * seeing the same variable while it is suspended.
+ */
+#include <string.h>
+#include "vm.h"
+#include "value.h"
+#include "memory.h"
+#include "util.h"
+
+static KrkClass * generator;
+struct generator {
+	KrkInstance inst;
+	KrkClosure * closure;
+	uint8_t * ip;
+	KrkValueArray stack;
+	size_t upvalueCount;
+	size_t upvalueSpace;
+	KrkUpvalue ** upvalues;
+	size_t * upvalueSlots;
+	int started;
+	int running;
+	int finished;
+};
+
+#define IS_generator(o) krk_isInstanceOf(o,generator)
+#define AS_generator(o) ((struct generator*)AS_OBJECT(o))
+
+static void _generator_gcscan(KrkInstance * _self) {
+	struct generator * self = (struct generator*)_self;
+	krk_markObject((KrkObj*)self->closure);
+	for (size_t i = 0; i < self->stack.count; ++i) {
+		krk_markValue(self->stack.values[i]);
+	}
+	for (size_t i = 0; i < self->upvalueCount; ++i) {
+		krk_markObject((KrkObj*)self->upvalues[i]);
+	}
+}
+
+static void _generator_gcsweep(KrkInstance * _self) {
+	struct generator * self = (struct generator*)_self;
+	krk_freeValueArray(&self->stack);
+	FREE_ARRAY(KrkUpvalue*, self->upvalues, self->upvalueSpace);
+	FREE_ARRAY(size_t, self->upvalueSlots, self->upvalueSpace);
+}
+
+/**
+ * Build a generator for a call to a generator function. The arguments
+ * are the top argc values on the stack and have already been processed
+ * by call(), so they are exactly what the function's frame would have
+ * started with. The caller is responsible for popping them.
+ */
+KrkInstance * krk_buildGenerator(KrkClosure * closure, size_t argc) {
+	krk_push(OBJECT_VAL(closure));
+	struct generator * self = (struct generator*)krk_newInstance(generator);
+	krk_push(OBJECT_VAL(self));
+	self->closure = closure;
+	self->ip = closure->function->chunk.code;
+	for (size_t i = 0; i < argc; ++i) {
+		krk_writeValueArray(&self->stack, krk_currentThread.stackTop[-(int)argc - 2 + (int)i]);
+	}
+	krk_pop();
+	krk_pop();
+	return (KrkInstance*)self;
+}
+
+/* Drop the saved state of a generator that can no longer be resumed. */
+static void finishGenerator(struct generator * self) {
+	self->finished = 1;
+	self->stack.count = 0;
+	self->upvalueCount = 0;
+}
+
+/* Close the frame's captured locals, remembering their slots for the next resume. */
+static void suspendUpvalues(struct generator * self, size_t slots) {
+	while (krk_currentThread.openUpvalues && (size_t)krk_currentThread.openUpvalues->location >= slots) {
+		KrkUpvalue * upvalue = krk_currentThread.openUpvalues;
+		if (self->upvalueSpace < self->upvalueCount + 1) {
+			size_t old = self->upvalueSpace;
+			self->upvalueSpace = GROW_CAPACITY(old);
+			self->upvalues = GROW_ARRAY(KrkUpvalue*, self->upvalues, old, self->upvalueSpace);
+			self->upvalueSlots = GROW_ARRAY(size_t, self->upvalueSlots, old, self->upvalueSpace);
+		}
+		self->upvalues[self->upvalueCount] = upvalue;
+		self->upvalueSlots[self->upvalueCount] = upvalue->location - slots;
+		self->upvalueCount++;
+		upvalue->closed = krk_currentThread.stack[upvalue->location];
+		upvalue->location = -1;
+		krk_currentThread.openUpvalues = upvalue->next;
+	}
+}
+
+/*
+ * Reopen captured locals on the restored stack segment. They were saved
+ * highest slot first and the frame is at the top of the stack, so pushing
+ * them back in reverse keeps the open upvalue list sorted.
+ */
+static void resumeUpvalues(struct generator * self, size_t slots) {
+	while (self->upvalueCount) {
+		self->upvalueCount--;
+		KrkUpvalue * upvalue = self->upvalues[self->upvalueCount];
+		upvalue->location = slots + self->upvalueSlots[self->upvalueCount];
+		krk_currentThread.stack[upvalue->location] = upvalue->closed;
+		upvalue->next = krk_currentThread.openUpvalues;
+		krk_currentThread.openUpvalues = upvalue;
+	}
+}
+
+/**
+ * Run the generator until it yields or returns. Returns the yielded value,
+ * or the generator itself once it has finished, which is how iterators
+ * signal exhaustion.
+ */
+static KrkValue resumeGenerator(struct generator * self, KrkValue sent) {
+	if (self->running) {
+		return krk_runtimeError(vm.exceptions->valueError, "generator already executing");
+	}
+	if (self->finished) return OBJECT_VAL(self);
+	if (!self->started && !IS_NONE(sent)) {
+		return krk_runtimeError(vm.exceptions->typeError, "can't send non-None value to a just-started generator");
+	}
+	if (krk_currentThread.frameCount == FRAMES_MAX) {
+		return krk_runtimeError(vm.exceptions->baseException, "Too many call frames.");
+	}
+
+	/* The generator itself sits in the callee slot below the frame's locals. */
+	size_t base = krk_currentThread.stackTop - krk_currentThread.stack;
+	krk_push(OBJECT_VAL(self));
+	for (size_t i = 0; i < self->stack.count; ++i) {
+		krk_push(self->stack.values[i]);
+	}
+	self->stack.count = 0;
+	resumeUpvalues(self, base + 1);
+
+	/* The first resume starts at the top of the function; later ones finish a yield expression. */
+	if (self->started) krk_push(sent);
+	self->started = 1;
+
+	size_t frameIndex = krk_currentThread.frameCount++;
+	CallFrame * frame = &krk_currentThread.frames[frameIndex];
+	frame->closure = self->closure;
+	frame->ip = self->ip;
+	frame->slots = base + 1;
+	frame->outSlots = base;
+	frame->globals = &self->closure->function->globalsContext->fields;
+
+	self->running = 1;
+	KrkValue result = krk_runNext();
+	self->running = 0;
+
+	if (krk_currentThread.flags & KRK_HAS_EXCEPTION) {
+		/* The caller's handler will unwind the frame we left behind. */
+		finishGenerator(self);
+		return NONE_VAL();
+	}
+
+	if (krk_currentThread.frameCount == frameIndex) {
+		/* OP_RETURN already popped the frame and reset the stack. */
+		finishGenerator(self);
+		return OBJECT_VAL(self);
+	}
+
+	/* OP_YIELD left the frame in place with the yielded value on top. */
+	frame = &krk_currentThread.frames[frameIndex];
+	krk_currentThread.frameCount = frameIndex;
+	self->ip = frame->ip;
+	suspendUpvalues(self, frame->slots);
+	KrkValue * start = &krk_currentThread.stack[frame->slots];
+	KrkValue * end = krk_currentThread.stackTop - 1;
+	for (KrkValue * slot = start; slot < end; ++slot) {
+		krk_writeValueArray(&self->stack, *slot);
+	}
+	krk_currentThread.stackTop = &krk_currentThread.stack[base];
+	return result;
+}
+
+#define CURRENT_CTYPE struct generator *
+#define CURRENT_NAME  self
+
+KRK_METHOD(generator,__iter__,{
+	return argv[0];
+})
+
+KRK_METHOD(generator,__call__,{
+	METHOD_TAKES_NONE();
+	return resumeGenerator(self, NONE_VAL());
+})
+
+KRK_METHOD(generator,send,{
+	METHOD_TAKES_EXACTLY(1);
+	return resumeGenerator(self, argv[1]);
+})
+
+KRK_METHOD(generator,__repr__,{
+	KrkString * name = self->closure->function->name;
+	const char * chars = name ? name->chars : "<unnamed>";
+	size_t len = strlen(chars) + sizeof("<generator object >");
+	char * tmp = malloc(len);
+	snprintf(tmp, len, "<generator object %s>", chars);
+	KrkValue out = OBJECT_VAL(krk_copyString(tmp, len - 1));
+	free(tmp);
+	return out;
+})
+
+KRK_METHOD(generator,gi_running,{
+	return BOOLEAN_VAL(self->running);
+})
+
+_noexport
+void _createAndBind_generatorClass(void) {
+	ADD_BASE_CLASS(generator, "generator", vm.baseClasses->objectClass);
+	generator->allocSize = sizeof(struct generator);
+	generator->_ongcscan = _generator_gcscan;
+	generator->_ongcsweep = _generator_gcsweep;
+	BIND_METHOD(generator,__iter__);
+	BIND_METHOD(generator,__call__);
+	BIND_METHOD(generator,send);
+	BIND_METHOD(generator,__repr__);
+	BIND_FIELD(generator,gi_running);
+	krk_defineNative(&generator->methods, ".__str__", FUNC_NAME(generator,__repr__));
+	krk_finalizeClass(generator);
+	generator->docstring = S("Iterator over the values yielded by a call to a generator function.");
+}
@@ -0,0 +1,445 @@
+/**
+ * Lazy iterator builtins: map, filter, zip, enumerate, reversed,
+ * and the sum, min and max reductions.
+ *
+ * The iterator classes implement the usual protocol of returning the next
+ * value from __call__ and themselves once exhausted. Their __call__ methods
+ * are native, so OP_FOR_ITER steps them without setting up a call frame, and
+ * they step their own inputs the same way through krk_iterNext.
+ */
+#include <string.h>
+#include "vm.h"
+#include "value.h"
+#include "memory.h"
+#include "util.h"
+
+static KrkClass * map;
+struct Map {
+	KrkInstance inst;
+	KrkValue func;
+	KrkValueArray iterators;
+};
+
+#define IS_map(o) krk_isInstanceOf(o,map)
+#define AS_map(o) ((struct Map*)AS_OBJECT(o))
+
+static KrkClass * filter;
+struct Filter {
+	KrkInstance inst;
+	KrkValue func;
+	KrkValue iterator;
+};
+
+#define IS_filter(o) krk_isInstanceOf(o,filter)
+#define AS_filter(o) ((struct Filter*)AS_OBJECT(o))
+
+static KrkClass * zip;
+struct Zip {
+	KrkInstance inst;
+	KrkValueArray iterators;
+};
+
+#define IS_zip(o) krk_isInstanceOf(o,zip)
+#define AS_zip(o) ((struct Zip*)AS_OBJECT(o))
+
+static KrkClass * enumerate;
+struct Enumerate {
+	KrkInstance inst;
+	KrkValue iterator;
+	krk_integer_type i;
+};
+
+#define IS_enumerate(o) krk_isInstanceOf(o,enumerate)
+#define AS_enumerate(o) ((struct Enumerate*)AS_OBJECT(o))
+
+static KrkClass * reversed;
+struct Reversed {
+	KrkInstance inst;
+	KrkValue seq;
+	krk_integer_type i;
+};
+
+#define IS_reversed(o) krk_isInstanceOf(o,reversed)
+#define AS_reversed(o) ((struct Reversed*)AS_OBJECT(o))
+
+static void _map_gcscan(KrkInstance * self) {
+	krk_markValue(((struct Map*)self)->func);
+	for (size_t i = 0; i < ((struct Map*)self)->iterators.count; ++i) {
+		krk_markValue(((struct Map*)self)->iterators.values[i]);
+	}
+}
+
+static void _map_gcsweep(KrkInstance * self) {
+	krk_freeValueArray(&((struct Map*)self)->iterators);
+}
+
+static void _filter_gcscan(KrkInstance * self) {
+	krk_markValue(((struct Filter*)self)->func);
+	krk_markValue(((struct Filter*)self)->iterator);
+}
+
+static void _zip_gcscan(KrkInstance * self) {
+	for (size_t i = 0; i < ((struct Zip*)self)->iterators.count; ++i) {
+		krk_markValue(((struct Zip*)self)->iterators.values[i]);
+	}
+}
+
+static void _zip_gcsweep(KrkInstance * self) {
+	krk_freeValueArray(&((struct Zip*)self)->iterators);
+}
+
+static void _enumerate_gcscan(KrkInstance * self) {
+	krk_markValue(((struct Enumerate*)self)->iterator);
+}
+
+static void _reversed_gcscan(KrkInstance * self) {
+	krk_markValue(((struct Reversed*)self)->seq);
+}
+
+/* Collect an iterator for each argument, replacing any from an earlier
+ * __init__; returns nonzero on exception. */
+static int collectIterators(KrkValueArray * out, int argc, KrkValue argv[]) {
+	krk_freeValueArray(out);
+	for (int i = 0; i < argc; ++i) {
+		KrkValue iterator = krk_getIterator(argv[i]);
+		if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return 1;
+		krk_push(iterator);
+		krk_writeValueArray(out, iterator);
+		krk_pop();
+	}
+	return 0;
+}
+
+/**
+ * Step every iterator in turn, leaving the values on the stack.
+ * Returns 1 if all of them produced a value; otherwise pops whatever
+ * was pushed and returns 0 on exhaustion or -1 on exception.
+ */
+static int stepAll(KrkValueArray * iterators) {
+	for (size_t i = 0; i < iterators->count; ++i) {
+		KrkValue value;
+		int status = krk_iterNext(iterators->values[i], &value);
+		if (status != 1) {
+			for (size_t j = 0; j < i; ++j) krk_pop();
+			return status;
+		}
+		krk_push(value);
+	}
+	return 1;
+}
+
+#define CURRENT_CTYPE struct Map *
+#define CURRENT_NAME  self
+
+KRK_METHOD(map,__init__,{
+	METHOD_TAKES_AT_LEAST(2);
+	self->func = argv[1];
+	if (collectIterators(&self->iterators, argc - 2, &argv[2])) return NONE_VAL();
+	return argv[0];
+})
+
+KRK_METHOD(map,__iter__,{
+	return argv[0];
+})
+
+KRK_METHOD(map,__call__,{
+	krk_push(self->func);
+	int status = stepAll(&self->iterators);
+	if (status != 1) {
+		krk_pop();
+		return status < 0 ? NONE_VAL() : argv[0];
+	}
+	return krk_callSimple(self->func, self->iterators.count, 1);
+})
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct Filter *
+
+KRK_METHOD(filter,__init__,{
+	METHOD_TAKES_EXACTLY(2);
+	self->func = argv[1];
+	self->iterator = krk_getIterator(argv[2]);
+	if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return NONE_VAL();
+	return argv[0];
+})
+
+KRK_METHOD(filter,__iter__,{
+	return argv[0];
+})
+
+KRK_METHOD(filter,__call__,{
+	KrkValue value;
+	int status;
+	while ((status = krk_iterNext(self->iterator, &value)) == 1) {
+		if (IS_NONE(self->func)) {
+			if (!krk_isFalsey(value)) return value;
+			continue;
+		}
+		krk_push(value);
+		krk_push(self->func);
+		krk_push(value);
+		KrkValue result = krk_callSimple(self->func, 1, 1);
+		if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return NONE_VAL();
+		value = krk_pop();
+		if (!krk_isFalsey(result)) return value;
+	}
+	return status < 0 ? NONE_VAL() : argv[0];
+})
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct Zip *
+
+KRK_METHOD(zip,__init__,{
+	if (collectIterators(&self->iterators, argc - 1, &argv[1])) return NONE_VAL();
+	return argv[0];
+})
+
+KRK_METHOD(zip,__iter__,{
+	return argv[0];
+})
+
+KRK_METHOD(zip,__call__,{
+	size_t count = self->iterators.count;
+	if (!count) return argv[0];
+	int status = stepAll(&self->iterators);
+	if (status != 1) return status < 0 ? NONE_VAL() : argv[0];
+	KrkTuple * tuple = krk_newTuple(count);
+	memcpy(tuple->values.values, krk_currentThread.stackTop - count, sizeof(KrkValue) * count);
+	tuple->values.count = count;
+	for (size_t i = 0; i < count; ++i) krk_pop();
+	return OBJECT_VAL(tuple);
+})
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct Enumerate *
+
+KRK_METHOD(enumerate,__init__,{
+	METHOD_TAKES_AT_LEAST(1);
+	METHOD_TAKES_AT_MOST(2);
+	KrkValue start = argc > 2 ? argv[2] : INTEGER_VAL(0);
+	if (hasKw) krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("start")), &start);
+	if (!IS_INTEGER(start)) return TYPE_ERROR(int,start);
+	self->i = AS_INTEGER(start);
+	self->iterator = krk_getIterator(argv[1]);
+	if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return NONE_VAL();
+	return argv[0];
+})
+
+KRK_METHOD(enumerate,__iter__,{
+	return argv[0];
+})
+
+KRK_METHOD(enumerate,__call__,{
+	KrkValue value;
+	int status = krk_iterNext(self->iterator, &value);
+	if (status != 1) return status < 0 ? NONE_VAL() : argv[0];
+	krk_push(value);
+	KrkTuple * tuple = krk_newTuple(2);
+	tuple->values.values[tuple->values.count++] = INTEGER_VAL(self->i++);
+	tuple->values.values[tuple->values.count++] = krk_pop();
+	return OBJECT_VAL(tuple);
+})
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct Reversed *
+
+KRK_METHOD(reversed,__init__,{
+	METHOD_TAKES_EXACTLY(1);
+	KrkValue seq = argv[1];
+	KrkClass * type = krk_getType(seq);
+	self->seq = seq;
+	if (IS_TUPLE(seq)) {
+		self->i = AS_TUPLE(seq)->values.count;
+	} else if (IS_list(seq)) {
+		self->i = AS_LIST(seq)->count;
+	} else if (type->_len && type->_getter) {
+		krk_push(seq);
+		KrkValue length = krk_callSimple(OBJECT_VAL(type->_len), 1, 0);
+		if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return NONE_VAL();
+		if (!IS_INTEGER(length)) return krk_runtimeError(vm.exceptions->typeError, "__len__ returned '%s'", krk_typeName(length));
+		self->i = AS_INTEGER(length);
+	} else {
+		return krk_runtimeError(vm.exceptions->typeError, "'%s' object is not reversible", krk_typeName(seq));
+	}
+	return argv[0];
+})
+
+KRK_METHOD(reversed,__iter__,{
+	return argv[0];
+})
+
+KRK_METHOD(reversed,__call__,{
+	if (self->i <= 0) return argv[0];
+	krk_integer_type index = --self->i;
+	if (IS_TUPLE(self->seq)) return AS_TUPLE(self->seq)->values.values[index];
+	if (IS_list(self->seq)) {
+		/* Stop early if the list shrank underneath us */
+		if ((size_t)index >= AS_LIST(self->seq)->count) {
+			self->i = 0;
+			return argv[0];
+		}
+		return AS_LIST(self->seq)->values[index];
+	}
+	krk_push(self->seq);
+	krk_push(INTEGER_VAL(index));
+	return krk_callSimple(OBJECT_VAL(krk_getType(self->seq)->_getter), 2, 0);
+})
+
+/*
+ * The reductions below keep their running values in stack slots so the
+ * garbage collector can see them while the iterable calls managed code.
+ * The slots are tracked by index, as the stack may be reallocated.
+ */
+#define STACK_SLOT(i) (krk_currentThread.stack[(i)])
+
+static int sumCallback(void * context, const KrkValue * values, size_t count) {
+	size_t slot = *(size_t*)context;
+	for (size_t i = 0; i < count; ++i) {
+		KrkValue total = STACK_SLOT(slot);
+		KrkValue value = values[i];
+		if (IS_INTEGER(total) && IS_INTEGER(value)) {
+			STACK_SLOT(slot) = INTEGER_VAL(AS_INTEGER(total) + AS_INTEGER(value));
+		} else if (IS_FLOATING(total) && IS_FLOATING(value)) {
+			STACK_SLOT(slot) = FLOATING_VAL(AS_FLOATING(total) + AS_FLOATING(value));
+		} else {
+			KrkValue result = krk_operator_add(total, value);
+			if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return 1;
+			STACK_SLOT(slot) = result;
+		}
+	}
+	return 0;
+}
+
+static KrkValue _sum(int argc, KrkValue argv[], int hasKw) {
+	if (argc < 1 || argc > 2) return krk_runtimeError(vm.exceptions->argumentError, "sum() takes 1 or 2 arguments (%d given)", argc);
+	KrkValue start = argc > 1 ? argv[1] : INTEGER_VAL(0);
+	if (hasKw) krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("start")), &start);
+	krk_push(start);
+	size_t slot = krk_currentThread.stackTop - krk_currentThread.stack - 1;
+	if (krk_unpackIterable(argv[0], &slot, sumCallback)) return NONE_VAL();
+	return krk_pop();
+}
+
+struct MinMax {
+	KrkValue key;
+	size_t slot; /* best value, then its key */
+	int wantMax;
+	int found;
+};
+
+static int minMaxCallback(void * context, const KrkValue * values, size_t count) {
+	struct MinMax * state = context;
+	for (size_t i = 0; i < count; ++i) {
+		KrkValue value = values[i];
+		KrkValue key = value;
+		if (!IS_NONE(state->key)) {
+			krk_push(value);
+			krk_push(state->key);
+			krk_push(value);
+			key = krk_callSimple(state->key, 1, 1);
+			krk_pop();
+			if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return 1;
+		}
+		if (!state->found) {
+			state->found = 1;
+			STACK_SLOT(state->slot) = value;
+			STACK_SLOT(state->slot + 1) = key;
+			continue;
+		}
+		/* Ties keep the first value seen */
+		KrkValue best = STACK_SLOT(state->slot + 1);
+		KrkValue a = state->wantMax ? best : key;
+		KrkValue b = state->wantMax ? key : best;
+		int lt = fastLessThan(a, b);
+		if (lt < 0) {
+			krk_push(key);
+			KrkValue result = krk_operator_lt(a, b);
+			krk_pop();
+			if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return 1;
+			lt = !krk_isFalsey(result);
+		}
+		if (lt) {
+			STACK_SLOT(state->slot) = value;
+			STACK_SLOT(state->slot + 1) = key;
+		}
+	}
+	return 0;
+}
+
+static KrkValue minMax(const char * name, int argc, KrkValue argv[], int hasKw, int wantMax) {
+	if (argc < 1) return krk_runtimeError(vm.exceptions->argumentError, "%s() expects at least 1 argument", name);
+	KrkValue defaultValue = KWARGS_VAL(0);
+	struct MinMax state = {NONE_VAL(), 0, wantMax, 0};
+	if (hasKw) {
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("key")), &state.key);
+		krk_tableGet(AS_DICT(argv[argc]), OBJECT_VAL(S("default")), &defaultValue);
+	}
+	krk_push(NONE_VAL());
+	krk_push(NONE_VAL());
+	state.slot = krk_currentThread.stackTop - krk_currentThread.stack - 2;
+	int status = argc == 1
+		? krk_unpackIterable(argv[0], &state, minMaxCallback)
+		: minMaxCallback(&state, argv, argc);
+	if (status) return NONE_VAL();
+	krk_pop();
+	KrkValue best = krk_pop();
+	if (!state.found) {
+		if (!IS_KWARGS(defaultValue)) return defaultValue;
+		return krk_runtimeError(vm.exceptions->valueError, "%s() arg is an empty sequence", name);
+	}
+	return best;
+}
+
+static KrkValue _min(int argc, KrkValue argv[], int hasKw) {
+	return minMax("min", argc, argv, hasKw, 0);
+}
+
+static KrkValue _max(int argc, KrkValue argv[], int hasKw) {
+	return minMax("max", argc, argv, hasKw, 1);
+}
+
+#define BIND_ITERATOR(klass) do { \
+	BIND_METHOD(klass,__init__); \
+	BIND_METHOD(klass,__iter__); \
+	BIND_METHOD(klass,__call__); \
+	krk_finalizeClass(klass); \
+} while (0)
+
+_noexport
+void _createAndBind_iterClasses(void) {
+	krk_makeClass(vm.builtins, &map, "map", vm.baseClasses->objectClass);
+	map->allocSize = sizeof(struct Map);
+	map->_ongcscan = _map_gcscan;
+	map->_ongcsweep = _map_gcsweep;
+	BIND_ITERATOR(map);
+	map->docstring = S("Return an iterator that applies a function to the items of the given iterables.");
+
+	krk_makeClass(vm.builtins, &filter, "filter", vm.baseClasses->objectClass);
+	filter->allocSize = sizeof(struct Filter);
+	filter->_ongcscan = _filter_gcscan;
+	BIND_ITERATOR(filter);
+	filter->docstring = S("Return an iterator over the items of an iterable for which a function returns true.");
+
+	krk_makeClass(vm.builtins, &zip, "zip", vm.baseClasses->objectClass);
+	zip->allocSize = sizeof(struct Zip);
+	zip->_ongcscan = _zip_gcscan;
+	zip->_ongcsweep = _zip_gcsweep;
+	BIND_ITERATOR(zip);
+	zip->docstring = S("Return an iterator over tuples of items taken from each of the given iterables in turn.");
+
+	krk_makeClass(vm.builtins, &enumerate, "enumerate", vm.baseClasses->objectClass);
+	enumerate->allocSize = sizeof(struct Enumerate);
+	enumerate->_ongcscan = _enumerate_gcscan;
+	BIND_ITERATOR(enumerate);
+	enumerate->docstring = S("Return an iterator over (index, item) pairs from an iterable.");
+
+	krk_makeClass(vm.builtins, &reversed, "reversed", vm.baseClasses->objectClass);
+	reversed->allocSize = sizeof(struct Reversed);
+	reversed->_ongcscan = _reversed_gcscan;
+	BIND_ITERATOR(reversed);
+	reversed->docstring = S("Return an iterator over the items of a sequence in reverse order.");
+
+	BUILTIN_FUNCTION("sum", _sum, "Add up the items of an iterable, starting from 0 or the given start value.");
+	BUILTIN_FUNCTION("min", _min, "Return the smallest item of an iterable or of the arguments.");
+	BUILTIN_FUNCTION("max", _max, "Return the largest item of an iterable or of the arguments.");
+}
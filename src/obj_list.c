@@ -115,13 +115,17 @@ KRK_METHOD(list,__repr__,{
 	return finishStringBuilder(&sb);
 })
 
+/* Capacity grows geometrically so repeated extends (and +=) are amortized
+ * linear, and the count is read once so a list can be extended by itself. */
 #define unpackArray(counter, indexer) do { \
-			if (positionals->count + counter > positionals->capacity) { \
+			size_t _count = counter; \
+			if (positionals->count + _count > positionals->capacity) { \
 				size_t old = positionals->capacity; \
-				positionals->capacity = positionals->count + counter; \
+				positionals->capacity = GROW_CAPACITY(old); \
+				if (positionals->capacity < positionals->count + _count) positionals->capacity = positionals->count + _count; \
 				positionals->values = GROW_ARRAY(KrkValue,positionals->values,old,positionals->capacity); \
 			} \
-			for (size_t i = 0; i < counter; ++i) { \
+			for (size_t i = 0; i < _count; ++i) { \
 				positionals->values[positionals->count] = indexer; \
 				positionals->count++; \
 			} \
@@ -157,7 +161,7 @@ KRK_METHOD(list,extend,{
 					krk_pop(); /* The iterator */
 					break;
 				}
-				FUNC_NAME(list,append)(2, (KrkValue[]){argv[0], krk_peek(0)}, 0);
+				krk_writeValueArray(positionals, krk_peek(0));
 				krk_pop();
 			} while (1);
 		} else {
@@ -395,23 +399,535 @@ KRK_METHOD(list,reverse,{
 	return NONE_VAL();
 })
 
-static int _list_sorter(const void * _a, const void * _b) {
-	KrkValue a = *(KrkValue*)_a;
-	KrkValue b = *(KrkValue*)_b;
+/**
+ * list.sort() is a Timsort: natural runs are found (descending runs are
+ * reversed in place), short runs are extended with a binary insertion sort,
+ * and runs are merged with galloping once one side keeps winning. Only `<`
+ * is ever used to compare, and equal elements keep their original order.
+ *
+ * We sort (key, value) pairs in a separate buffer so key= functions are
+ * only called once per element; when all of the keys share a simple type
+ * the comparison skips the generic operator dispatch entirely.
+ */
+struct SortItem {
+	KrkValue key;
+	KrkValue value;
+};
+
+typedef int (*SortLessThan)(KrkValue a, KrkValue b);
+
+#define SORT_MIN_GALLOP 7
+#define SORT_MAX_RUNS   85
+
+struct SortState {
+	SortLessThan lt;
+	struct SortItem * tmp;
+	ssize_t tmpSize;
+	ssize_t minGallop;
+	int runCount;
+	struct { ssize_t base; ssize_t len; } runs[SORT_MAX_RUNS];
+};
+
+static int _sort_lt_int(KrkValue a, KrkValue b) {
+	return AS_INTEGER(a) < AS_INTEGER(b);
+}
+
+static int _sort_lt_float(KrkValue a, KrkValue b) {
+	return AS_FLOATING(a) < AS_FLOATING(b);
+}
+
+static int _sort_lt_str(KrkValue a, KrkValue b) {
+	size_t aLen = AS_STRING(a)->length;
+	size_t bLen = AS_STRING(b)->length;
+	int cmp = memcmp(AS_CSTRING(a), AS_CSTRING(b), aLen < bLen ? aLen : bLen);
+	return cmp < 0 || (cmp == 0 && aLen < bLen);
+}
+
+static int _sort_lt_generic(KrkValue a, KrkValue b) {
+	KrkValue result = krk_operator_lt(a,b);
+	if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return -1;
+	return !krk_isFalsey(result);
+}
+
+static SortLessThan _sort_pick_lt(struct SortItem * items, size_t count) {
+	KrkValue first = items[0].key;
+	if (IS_INTEGER(first) || IS_FLOATING(first) || IS_STRING(first)) {
+		size_t i;
+		for (i = 1; i < count; ++i) {
+			if (items[i].key.type != first.type) break;
+			if (IS_OBJECT(first) && !IS_STRING(items[i].key)) break;
+		}
+		if (i == count) {
+			if (IS_INTEGER(first)) return _sort_lt_int;
+			if (IS_FLOATING(first)) return _sort_lt_float;
+			return _sort_lt_str;
+		}
+	}
+	return _sort_lt_generic;
+}
+
+#define ISLT(a,b) (state->lt((a).key,(b).key))
+#define IFLT(a,b) if ((k = ISLT(a,b)) < 0) goto _fail; if (k)
+
+static void _sort_reverse(struct SortItem * lo, struct SortItem * hi) {
+	for (--hi; lo < hi; ++lo, --hi) {
+		struct SortItem tmp = *lo;
+		*lo = *hi;
+		*hi = tmp;
+	}
+}
+
+/* Extend the sorted range [lo,start) to [lo,hi) by binary insertion. */
+static int _sort_binary(struct SortState * state, struct SortItem * lo, struct SortItem * hi, struct SortItem * start) {
+	int k;
+	for (; start < hi; ++start) {
+		struct SortItem pivot = *start;
+		struct SortItem * l = lo;
+		struct SortItem * r = start;
+		while (l < r) {
+			struct SortItem * p = l + ((r - l) >> 1);
+			IFLT(pivot, *p) r = p;
+			else l = p + 1;
+		}
+		memmove(l + 1, l, (start - l) * sizeof(struct SortItem));
+		*l = pivot;
+	}
+	return 0;
+_fail:
+	return -1;
+}
+
+/* Length of the run starting at lo; strictly descending runs are reversed. */
+static ssize_t _sort_count_run(struct SortState * state, struct SortItem * lo, struct SortItem * hi) {
+	int k;
+	ssize_t n = 1;
+	if (lo + 1 == hi) return 1;
+	IFLT(lo[1], lo[0]) {
+		for (n = 2; lo + n < hi; ++n) {
+			IFLT(lo[n], lo[n-1]) continue;
+			break;
+		}
+		_sort_reverse(lo, lo + n);
+	} else {
+		for (n = 2; lo + n < hi; ++n) {
+			IFLT(lo[n], lo[n-1]) break;
+		}
+	}
+	return n;
+_fail:
+	return -1;
+}
+
+/* Find where key belongs in a[0:n], left of any equal elements, starting near a[hint]. */
+static ssize_t _sort_gallop_left(struct SortState * state, struct SortItem key, struct SortItem * a, ssize_t n, ssize_t hint) {
+	int k;
+	ssize_t ofs = 1, lastofs = 0;
+	a += hint;
+	IFLT(*a, key) {
+		ssize_t maxofs = n - hint;
+		while (ofs < maxofs) {
+			IFLT(a[ofs], key) {
+				lastofs = ofs;
+				ofs = (ofs << 1) + 1;
+			} else break;
+		}
+		if (ofs > maxofs) ofs = maxofs;
+		lastofs += hint;
+		ofs += hint;
+	} else {
+		ssize_t maxofs = hint + 1;
+		while (ofs < maxofs) {
+			IFLT(*(a - ofs), key) break;
+			lastofs = ofs;
+			ofs = (ofs << 1) + 1;
+		}
+		if (ofs > maxofs) ofs = maxofs;
+		ssize_t tmp = lastofs;
+		lastofs = hint - ofs;
+		ofs = hint - tmp;
+	}
+	a -= hint;
+	++lastofs;
+	while (lastofs < ofs) {
+		ssize_t m = lastofs + ((ofs - lastofs) >> 1);
+		IFLT(a[m], key) lastofs = m + 1;
+		else ofs = m;
+	}
+	return ofs;
+_fail:
+	return -1;
+}
+
+/* As above, but to the right of any equal elements. */
+static ssize_t _sort_gallop_right(struct SortState * state, struct SortItem key, struct SortItem * a, ssize_t n, ssize_t hint) {
+	int k;
+	ssize_t ofs = 1, lastofs = 0;
+	a += hint;
+	IFLT(key, *a) {
+		ssize_t maxofs = hint + 1;
+		while (ofs < maxofs) {
+			IFLT(key, *(a - ofs)) {
+				lastofs = ofs;
+				ofs = (ofs << 1) + 1;
+			} else break;
+		}
+		if (ofs > maxofs) ofs = maxofs;
+		ssize_t tmp = lastofs;
+		lastofs = hint - ofs;
+		ofs = hint - tmp;
+	} else {
+		ssize_t maxofs = n - hint;
+		while (ofs < maxofs) {
+			IFLT(key, a[ofs]) break;
+			lastofs = ofs;
+			ofs = (ofs << 1) + 1;
+		}
+		if (ofs > maxofs) ofs = maxofs;
+		lastofs += hint;
+		ofs += hint;
+	}
+	a -= hint;
+	++lastofs;
+	while (lastofs < ofs) {
+		ssize_t m = lastofs + ((ofs - lastofs) >> 1);
+		IFLT(key, a[m]) ofs = m;
+		else lastofs = m + 1;
+	}
+	return ofs;
+_fail:
+	return -1;
+}
 
-	KrkValue ltComp = krk_operator_lt(a,b);
-	if (IS_NONE(ltComp) || (IS_BOOLEAN(ltComp) && AS_BOOLEAN(ltComp))) return -1;
-	KrkValue gtComp = krk_operator_gt(a,b);
-	if (IS_NONE(gtComp) || (IS_BOOLEAN(gtComp) && AS_BOOLEAN(gtComp))) return 1;
+static void _sort_reserve(struct SortState * state, ssize_t need) {
+	if (state->tmpSize >= need) return;
+	state->tmp = realloc(state->tmp, need * sizeof(struct SortItem));
+	state->tmpSize = need;
+}
+
+/* Merge adjacent runs a[0:na] and b[0:nb] where na <= nb, copying a out. */
+static int _sort_merge_lo(struct SortState * state, struct SortItem * a, ssize_t na, struct SortItem * b, ssize_t nb) {
+	int k;
+	ssize_t acount, bcount;
+	_sort_reserve(state, na);
+	memcpy(state->tmp, a, na * sizeof(struct SortItem));
+	struct SortItem * dest = a;
+	a = state->tmp;
+
+	*dest++ = *b++;
+	if (--nb == 0) goto _done;
+	if (na == 1) goto _copyB;
+
+	ssize_t minGallop = state->minGallop;
+	for (;;) {
+		acount = bcount = 0;
+		/* One at a time until one side wins consistently */
+		for (;;) {
+			IFLT(*b, *a) {
+				*dest++ = *b++;
+				++bcount; acount = 0;
+				if (--nb == 0) goto _done;
+				if (bcount >= minGallop) break;
+			} else {
+				*dest++ = *a++;
+				++acount; bcount = 0;
+				if (--na == 1) goto _copyB;
+				if (acount >= minGallop) break;
+			}
+		}
+		/* Then gallop until that stops paying off */
+		++minGallop;
+		do {
+			minGallop -= minGallop > 1;
+			state->minGallop = minGallop;
+			ssize_t n = _sort_gallop_right(state, *b, a, na, 0);
+			if (n < 0) goto _fail;
+			acount = n;
+			if (n) {
+				memcpy(dest, a, n * sizeof(struct SortItem));
+				dest += n; a += n; na -= n;
+				if (na == 1) goto _copyB;
+				if (na == 0) goto _done;
+			}
+			*dest++ = *b++;
+			if (--nb == 0) goto _done;
+
+			n = _sort_gallop_left(state, *a, b, nb, 0);
+			if (n < 0) goto _fail;
+			bcount = n;
+			if (n) {
+				memmove(dest, b, n * sizeof(struct SortItem));
+				dest += n; b += n; nb -= n;
+				if (nb == 0) goto _done;
+			}
+			*dest++ = *a++;
+			if (--na == 1) goto _copyB;
+		} while (acount >= SORT_MIN_GALLOP || bcount >= SORT_MIN_GALLOP);
+		++minGallop;
+		state->minGallop = minGallop;
+	}
+
+_done:
+	if (na) memcpy(dest, a, na * sizeof(struct SortItem));
+	return 0;
+_fail:
+	if (na) memcpy(dest, a, na * sizeof(struct SortItem));
+	return -1;
+_copyB:
+	memmove(dest, b, nb * sizeof(struct SortItem));
+	dest[nb] = *a;
+	return 0;
+}
+
+/* Merge adjacent runs a[0:na] and b[0:nb] where na >= nb, copying b out. */
+static int _sort_merge_hi(struct SortState * state, struct SortItem * a, ssize_t na, struct SortItem * b, ssize_t nb) {
+	int k;
+	ssize_t acount, bcount;
+	_sort_reserve(state, nb);
+	memcpy(state->tmp, b, nb * sizeof(struct SortItem));
+	struct SortItem * dest = b + nb - 1;
+	struct SortItem * basea = a;
+	struct SortItem * baseb = state->tmp;
+	b = state->tmp + nb - 1;
+	a += na - 1;
+
+	*dest-- = *a--;
+	if (--na == 0) goto _done;
+	if (nb == 1) goto _copyA;
+
+	ssize_t minGallop = state->minGallop;
+	for (;;) {
+		acount = bcount = 0;
+		for (;;) {
+			IFLT(*b, *a) {
+				*dest-- = *a--;
+				++acount; bcount = 0;
+				if (--na == 0) goto _done;
+				if (acount >= minGallop) break;
+			} else {
+				*dest-- = *b--;
+				++bcount; acount = 0;
+				if (--nb == 1) goto _copyA;
+				if (bcount >= minGallop) break;
+			}
+		}
+		++minGallop;
+		do {
+			minGallop -= minGallop > 1;
+			state->minGallop = minGallop;
+			ssize_t n = _sort_gallop_right(state, *b, basea, na, na - 1);
+			if (n < 0) goto _fail;
+			n = na - n;
+			acount = n;
+			if (n) {
+				dest -= n; a -= n;
+				memmove(dest + 1, a + 1, n * sizeof(struct SortItem));
+				na -= n;
+				if (na == 0) goto _done;
+			}
+			*dest-- = *b--;
+			if (--nb == 1) goto _copyA;
+
+			n = _sort_gallop_left(state, *a, baseb, nb, nb - 1);
+			if (n < 0) goto _fail;
+			n = nb - n;
+			bcount = n;
+			if (n) {
+				dest -= n; b -= n;
+				memcpy(dest + 1, b + 1, n * sizeof(struct SortItem));
+				nb -= n;
+				if (nb == 1) goto _copyA;
+				if (nb == 0) goto _done;
+			}
+			*dest-- = *a--;
+			if (--na == 0) goto _done;
+		} while (acount >= SORT_MIN_GALLOP || bcount >= SORT_MIN_GALLOP);
+		++minGallop;
+		state->minGallop = minGallop;
+	}
+
+_done:
+	if (nb) memcpy(dest - (nb - 1), baseb, nb * sizeof(struct SortItem));
 	return 0;
+_fail:
+	if (nb) memcpy(dest - (nb - 1), baseb, nb * sizeof(struct SortItem));
+	return -1;
+_copyA:
+	dest -= na; a -= na;
+	memmove(dest + 1, a + 1, na * sizeof(struct SortItem));
+	*dest = *b;
+	return 0;
+}
+
+/* Merge the runs at i and i+1 on the run stack. */
+static int _sort_merge_at(struct SortState * state, struct SortItem * items, int i) {
+	struct SortItem * a = items + state->runs[i].base;
+	ssize_t na = state->runs[i].len;
+	struct SortItem * b = items + state->runs[i+1].base;
+	ssize_t nb = state->runs[i+1].len;
+
+	state->runs[i].len = na + nb;
+	if (i == state->runCount - 3) state->runs[i+1] = state->runs[i+2];
+	state->runCount--;
+
+	/* Elements of a before b[0], and of b after a[-1], are already in place */
+	ssize_t k = _sort_gallop_right(state, *b, a, na, 0);
+	if (k < 0) return -1;
+	a += k;
+	na -= k;
+	if (na == 0) return 0;
+
+	nb = _sort_gallop_left(state, a[na-1], b, nb, nb - 1);
+	if (nb <= 0) return nb;
+
+	return (na <= nb) ? _sort_merge_lo(state, a, na, b, nb) : _sort_merge_hi(state, a, na, b, nb);
 }
 
+/* Merge until the run lengths on the stack satisfy the Timsort invariants. */
+static int _sort_merge_collapse(struct SortState * state, struct SortItem * items) {
+	while (state->runCount > 1) {
+		int n = state->runCount - 2;
+		if ((n > 0 && state->runs[n-1].len <= state->runs[n].len + state->runs[n+1].len) ||
+		    (n > 1 && state->runs[n-2].len <= state->runs[n-1].len + state->runs[n].len)) {
+			if (state->runs[n-1].len < state->runs[n+1].len) --n;
+		} else if (state->runs[n].len > state->runs[n+1].len) {
+			break;
+		}
+		if (_sort_merge_at(state, items, n) < 0) return -1;
+	}
+	return 0;
+}
+
+static int _sort_merge_force(struct SortState * state, struct SortItem * items) {
+	while (state->runCount > 1) {
+		int n = state->runCount - 2;
+		if (n > 0 && state->runs[n-1].len < state->runs[n+1].len) --n;
+		if (_sort_merge_at(state, items, n) < 0) return -1;
+	}
+	return 0;
+}
+
+static ssize_t _sort_min_run(ssize_t n) {
+	ssize_t r = 0;
+	while (n >= 64) {
+		r |= n & 1;
+		n >>= 1;
+	}
+	return n + r;
+}
+
+static int _sort_items(struct SortItem * items, ssize_t count) {
+	struct SortState _state = {_sort_pick_lt(items, count), NULL, 0, SORT_MIN_GALLOP, 0, {{0,0}}};
+	struct SortState * state = &_state;
+	ssize_t minRun = _sort_min_run(count);
+	ssize_t lo = 0;
+	int result = 0;
+
+	while (lo < count) {
+		ssize_t n = _sort_count_run(state, items + lo, items + count);
+		if (n < 0) goto _fail;
+		if (n < minRun) {
+			ssize_t force = (count - lo) < minRun ? (count - lo) : minRun;
+			if (_sort_binary(state, items + lo, items + lo + force, items + lo + n) < 0) goto _fail;
+			n = force;
+		}
+		state->runs[state->runCount].base = lo;
+		state->runs[state->runCount].len = n;
+		state->runCount++;
+		if (_sort_merge_collapse(state, items) < 0) goto _fail;
+		lo += n;
+	}
+	if (_sort_merge_force(state, items) < 0) goto _fail;
+
+_done:
+	free(state->tmp);
+	return result;
+_fail:
+	result = -1;
+	goto _done;
+}
+
+#undef IFLT
+#undef ISLT
+
 KRK_METHOD(list,sort,{
 	METHOD_TAKES_NONE();
+	KrkValue key = NONE_VAL();
+	KrkValue reverse = BOOLEAN_VAL(0);
+	if (hasKw) {
+		KrkTable * kwargs = AS_DICT(argv[argc]);
+		for (size_t i = 0; i < kwargs->capacity; ++i) {
+			KrkValue name = kwargs->entries[i].key;
+			if (IS_KWARGS(name)) continue;
+			if (!IS_STRING(name) || (strcmp(AS_CSTRING(name), "key") && strcmp(AS_CSTRING(name), "reverse"))) {
+				return krk_runtimeError(vm.exceptions->typeError, "sort() got an unexpected keyword argument '%s'",
+					IS_STRING(name) ? AS_CSTRING(name) : krk_typeName(name));
+			}
+		}
+		krk_tableGet(kwargs, OBJECT_VAL(S("key")), &key);
+		krk_tableGet(kwargs, OBJECT_VAL(S("reverse")), &reverse);
+	}
 
+	/* Detach the contents while we sort, so that key functions and comparisons
+	 * that call back into managed code can't pull values out from under us. */
+	KrkValue holder = krk_list_of(0,NULL);
+	krk_push(holder);
 	pthread_rwlock_wrlock(&self->rwlock);
-	qsort(self->values.values, self->values.count, sizeof(KrkValue), _list_sorter);
+	KrkValueArray values = self->values;
+	self->values = *AS_LIST(holder);
+	*AS_LIST(holder) = values;
 	pthread_rwlock_unlock(&self->rwlock);
+
+	ssize_t count = values.count;
+	struct SortItem * items = NULL;
+	KrkValue keys = NONE_VAL();
+
+	if (count > 1) {
+		items = malloc(count * sizeof(struct SortItem));
+		if (!IS_NONE(key)) {
+			/* Decorate: keep the computed keys alive in a list while we sort */
+			keys = krk_list_of(0,NULL);
+			krk_push(keys);
+			for (ssize_t i = 0; i < count; ++i) {
+				krk_push(key);
+				krk_push(values.values[i]);
+				KrkValue result = krk_callSimple(key, 1, 1);
+				if (krk_currentThread.flags & KRK_HAS_EXCEPTION) goto _cleanup;
+				krk_writeValueArray(AS_LIST(keys), result);
+				items[i].key = result;
+				items[i].value = values.values[i];
+			}
+		} else {
+			for (ssize_t i = 0; i < count; ++i) {
+				items[i].key = values.values[i];
+				items[i].value = values.values[i];
+			}
+		}
+
+		/* Reversing before and after keeps equal elements in their original order */
+		if (!krk_isFalsey(reverse)) _sort_reverse(items, items + count);
+		if (_sort_items(items, count) < 0) goto _cleanup;
+		if (!krk_isFalsey(reverse)) _sort_reverse(items, items + count);
+
+		for (ssize_t i = 0; i < count; ++i) {
+			AS_LIST(holder)->values[i] = items[i].value;
+		}
+	}
+
+_cleanup:
+	free(items);
+	if (!IS_NONE(keys)) krk_pop();
+
+	pthread_rwlock_wrlock(&self->rwlock);
+	int modified = self->values.count != 0;
+	values = self->values;
+	self->values = *AS_LIST(holder);
+	*AS_LIST(holder) = values;
+	pthread_rwlock_unlock(&self->rwlock);
+	krk_pop();
+
+	if (modified && !(krk_currentThread.flags & KRK_HAS_EXCEPTION)) {
+		return krk_runtimeError(vm.exceptions->valueError, "list modified during sort");
+	}
 })
 
 KRK_METHOD(list,__add__,{
@@ -425,6 +941,39 @@ KRK_METHOD(list,__add__,{
 	return outList;
 })
 
+KRK_METHOD(list,__iadd__,{
+	METHOD_TAKES_EXACTLY(1);
+	FUNC_NAME(list,extend)(2,(KrkValue[]){argv[0],argv[1]},0);
+	return argv[0];
+})
+
+KRK_METHOD(list,__imul__,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_ARG(1,int,krk_integer_type,howMany);
+	pthread_rwlock_wrlock(&self->rwlock);
+	size_t count = self->values.count;
+	if (howMany <= 0) {
+		self->values.count = 0;
+	} else if (count) {
+		if ((size_t)howMany > SIZE_MAX / sizeof(KrkValue) / count) {
+			pthread_rwlock_unlock(&self->rwlock);
+			return krk_runtimeError(vm.exceptions->memoryError, "list is too large to repeat %ld times", (long)howMany);
+		}
+		size_t total = count * howMany;
+		if (total > self->values.capacity) {
+			size_t old = self->values.capacity;
+			self->values.capacity = total;
+			self->values.values = GROW_ARRAY(KrkValue, self->values.values, old, total);
+		}
+		for (krk_integer_type i = 1; i < howMany; ++i) {
+			memcpy(&self->values.values[i * count], self->values.values, sizeof(KrkValue) * count);
+		}
+		self->values.count = total;
+	}
+	pthread_rwlock_unlock(&self->rwlock);
+	return argv[0];
+})
+
 FUNC_SIG(listiterator,__init__);
 
 KRK_METHOD(list,__iter__,{
@@ -439,43 +988,26 @@ KRK_METHOD(list,__iter__,{
 })
 
 #undef CURRENT_CTYPE
-#define CURRENT_CTYPE KrkInstance*
+#define CURRENT_CTYPE struct ListIterator *
+
+static void _listiterator_gcscan(KrkInstance * self) {
+	krk_markValue(((struct ListIterator*)self)->l);
+}
 
 KRK_METHOD(listiterator,__init__,{
 	METHOD_TAKES_EXACTLY(1);
 	CHECK_ARG(1,list,KrkList*,list);
-
-	krk_push(argv[0]);
-	krk_attachNamedValue(&self->fields, "l", OBJECT_VAL(list));
-	krk_attachNamedValue(&self->fields, "i", INTEGER_VAL(0));
-	krk_pop();
-
+	self->l = argv[1];
+	self->i = 0;
 	return argv[0];
 })
 
 KRK_METHOD(listiterator,__call__,{
-	KrkValue _list;
-	KrkValue _counter;
-	const char * errorStr = NULL;
-
-	if (!krk_tableGet(&self->fields, OBJECT_VAL(S("l")), &_list)) {
-		errorStr = "no list pointer";
-		goto _corrupt;
-	}
-	if (!krk_tableGet(&self->fields, OBJECT_VAL(S("i")), &_counter)) {
-		errorStr = "no index";
-		goto _corrupt;
-	}
-
-	if ((size_t)AS_INTEGER(_counter) >= AS_LIST(_list)->count) {
+	if (self->i >= AS_LIST(self->l)->count) {
 		return argv[0];
 	} else {
-		krk_attachNamedValue(&self->fields, "i", INTEGER_VAL(AS_INTEGER(_counter)+1));
-		return AS_LIST(_list)->values[AS_INTEGER(_counter)];
+		return AS_LIST(self->l)->values[self->i++];
 	}
-
-_corrupt:
-	return krk_runtimeError(vm.exceptions->typeError, "Corrupt list iterator: %s", errorStr);
 })
 
 
@@ -485,7 +1017,7 @@ static KrkValue _sorted(int argc, KrkValue argv[], int hasKw) {
 	krk_push(listOut);
 	FUNC_NAME(list,extend)(2,(KrkValue[]){listOut,argv[0]},0);
 	if (!IS_NONE(krk_currentThread.currentException)) return NONE_VAL();
-	FUNC_NAME(list,sort)(1,&listOut,0);
+	FUNC_NAME(list,sort)(1,(KrkValue[]){listOut,hasKw ? argv[argc] : NONE_VAL()},hasKw);
 	if (!IS_NONE(krk_currentThread.currentException)) return NONE_VAL();
 	return krk_pop();
 }
@@ -508,6 +1040,8 @@ void _createAndBind_listClass(void) {
 	BIND_METHOD(list,__iter__);
 	BIND_METHOD(list,__mul__);
 	BIND_METHOD(list,__add__);
+	BIND_METHOD(list,__iadd__);
+	BIND_METHOD(list,__imul__);
 	BIND_METHOD(list,append);
 	BIND_METHOD(list,extend);
 	BIND_METHOD(list,pop);
@@ -528,6 +1062,8 @@ void _createAndBind_listClass(void) {
 	BUILTIN_FUNCTION("sorted", _sorted, "Return a sorted representation of an iterable.");
 
 	KrkClass * listiterator = ADD_BASE_CLASS(vm.baseClasses->listiteratorClass, "listiterator", vm.baseClasses->objectClass);
+	listiterator->allocSize = sizeof(struct ListIterator);
+	listiterator->_ongcscan = _listiterator_gcscan;
 	BIND_METHOD(listiterator,__init__);
 	BIND_METHOD(listiterator,__call__);
 	krk_finalizeClass(listiterator);
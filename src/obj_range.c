@@ -4,12 +4,6 @@
 #include "memory.h"
 #include "util.h"
 
-struct Range {
-	KrkInstance inst;
-	krk_integer_type min;
-	krk_integer_type max;
-};
-
 static KrkValue _range_init(int argc, KrkValue argv[]) {
 	KrkInstance * self = AS_INSTANCE(argv[0]);
 	if (argc < 2 || argc > 3) {
@@ -48,12 +42,6 @@ static KrkValue _range_repr(int argc, KrkValue argv[]) {
 	return output;
 }
 
-struct RangeIterator {
-	KrkInstance inst;
-	krk_integer_type i;
-	krk_integer_type max;
-};
-
 static KrkValue _rangeiterator_init(int argc, KrkValue argv[]) {
 	KrkInstance * self = AS_INSTANCE(argv[0]);
 
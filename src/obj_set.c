@@ -164,6 +164,30 @@ KRK_METHOD(set,__or__,{
 	return krk_pop();
 })
 
+KRK_METHOD(set,__ior__,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_ARG(1,set,struct Set*,them);
+	krk_tableAddAll(&them->entries, &self->entries);
+	return argv[0];
+})
+
+KRK_METHOD(set,__iand__,{
+	METHOD_TAKES_EXACTLY(1);
+	CHECK_ARG(1,set,struct Set*,them);
+	/* Rebuild rather than delete, so the table doesn't fill with tombstones */
+	KrkTable kept;
+	KrkValue unused;
+	krk_initTable(&kept);
+	for (size_t i = 0; i < self->entries.capacity; ++i) {
+		KrkTableEntry * entry = &self->entries.entries[i];
+		if (IS_KWARGS(entry->key)) continue;
+		if (krk_tableGet(&them->entries, entry->key, &unused)) krk_tableSet(&kept, entry->key, BOOLEAN_VAL(1));
+	}
+	krk_freeTable(&self->entries);
+	self->entries = kept;
+	return argv[0];
+})
+
 KRK_METHOD(set,__len__,{
 	METHOD_TAKES_NONE();
 	return INTEGER_VAL(self->entries.count);
@@ -176,8 +200,10 @@ KRK_METHOD(set,add,{
 
 KRK_METHOD(set,remove,{
 	METHOD_TAKES_EXACTLY(1);
-	if (!krk_tableDelete(&self->entries, argv[1]))
+	if (!krk_tableDelete(&self->entries, argv[1])) {
+		if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return NONE_VAL();
 		return krk_runtimeError(vm.exceptions->keyError, "key error");
+	}
 })
 
 KRK_METHOD(set,discard,{
@@ -238,6 +264,15 @@ KrkValue krk_set_of(int argc, KrkValue argv[]) {
 	return krk_pop();
 }
 
+int krk_set_add_fast(KrkValue outSet, KrkValue value) {
+	if (!IS_set(outSet)) {
+		krk_runtimeError(vm.exceptions->typeError, "Expected set, not '%s'", krk_typeName(outSet));
+		return 0;
+	}
+	krk_tableSet(&AS_set(outSet)->entries, value, BOOLEAN_VAL(1));
+	return 1;
+}
+
 _noexport
 void _createAndBind_setClass(void) {
 	krk_makeClass(vm.builtins, &set, "set", vm.baseClasses->objectClass);
@@ -249,6 +284,8 @@ void _createAndBind_setClass(void) {
 	BIND_METHOD(set,__len__);
 	BIND_METHOD(set,__and__);
 	BIND_METHOD(set,__or__);
+	BIND_METHOD(set,__ior__);
+	BIND_METHOD(set,__iand__);
 	BIND_METHOD(set,__contains__);
 	BIND_METHOD(set,__iter__);
 	BIND_METHOD(set,add);
@@ -72,7 +72,7 @@ KRK_METHOD(str,__add__,{
 	memcpy(chars + al, b, bl);
 	chars[length] = '\0';
 
-	KrkString * result = krk_takeString(chars, length);
+	KrkString * result = krk_takeStringUninterned(chars, length);
 	if (needsPop) krk_pop();
 	return OBJECT_VAL(result);
 })
@@ -105,7 +105,7 @@ KRK_METHOD(str,__getslice__,{
 	if (end < start) end = start;
 	long len = end - start;
 	if (self->type == KRK_STRING_ASCII) {
-		return OBJECT_VAL(krk_copyString(self->chars + start, len));
+		return OBJECT_VAL(krk_copyStringUninterned(self->chars + start, len));
 	} else {
 		size_t offset = 0;
 		size_t length = 0;
@@ -119,7 +119,7 @@ KRK_METHOD(str,__getslice__,{
 			uint32_t cp = KRK_STRING_FAST(self,i);
 			length += CODEPOINT_BYTES(cp);
 		}
-		return OBJECT_VAL(krk_copyString(self->chars + offset, length));
+		return OBJECT_VAL(krk_copyStringUninterned(self->chars + offset, length));
 	}
 })
 
@@ -289,7 +289,7 @@ KRK_METHOD(str,format,{
 		}
 	}
 
-	KrkValue out = OBJECT_VAL(krk_copyString(stringBytes, stringLength));
+	KrkValue out = OBJECT_VAL(krk_copyStringUninterned(stringBytes, stringLength));
 	free(workSpace);
 	FREE_ARRAY(char,stringBytes,stringCapacity);
 	return out;
@@ -333,7 +333,9 @@ KRK_METHOD(str,__mul__,{
 	}
 
 	*c = '\0';
-	return OBJECT_VAL(krk_copyString(out, totalLength));
+	KrkString * result = krk_copyStringUninterned(out, totalLength);
+	free(out);
+	return OBJECT_VAL(result);
 })
 
 /* str.join(list) */
@@ -375,10 +377,117 @@ static int isWhitespace(char c) {
 
 static int substringMatch(const char * haystack, size_t haystackLen, const char * needle, size_t needleLength) {
 	if (haystackLen < needleLength) return 0;
-	for (size_t i = 0; i < needleLength; ++i) {
-		if (haystack[i] != needle[i]) return 0;
+	return memcmp(haystack, needle, needleLength) == 0;
+}
+
+/* Needles at least this long are searched with Two-Way instead of memchr+memcmp */
+#define TWO_WAY_THRESHOLD 16
+
+/**
+ * Critical factorization of the needle for the Two-Way algorithm
+ * (Crochemore & Perrin, 1991): compute the maximal suffix under both
+ * the normal and reversed byte orderings and take the later of the two.
+ * Uses wrapping unsigned arithmetic for the initial 'before start' index.
+ */
+static size_t criticalFactorization(const unsigned char * needle, size_t needleLen, size_t * period) {
+	size_t maxSuffix = SIZE_MAX, j = 0, k = 1, p = 1;
+	while (j + k < needleLen) {
+		unsigned char a = needle[j + k];
+		unsigned char b = needle[maxSuffix + k];
+		if (a < b) {
+			j += k; k = 1; p = j - maxSuffix;
+		} else if (a == b) {
+			if (k != p) ++k;
+			else { j += p; k = 1; }
+		} else {
+			maxSuffix = j++; k = p = 1;
+		}
+	}
+	*period = p;
+
+	size_t maxSuffixRev = SIZE_MAX;
+	j = 0; k = 1; p = 1;
+	while (j + k < needleLen) {
+		unsigned char a = needle[j + k];
+		unsigned char b = needle[maxSuffixRev + k];
+		if (b < a) {
+			j += k; k = 1; p = j - maxSuffixRev;
+		} else if (a == b) {
+			if (k != p) ++k;
+			else { j += p; k = 1; }
+		} else {
+			maxSuffixRev = j++; k = p = 1;
+		}
 	}
-	return 1;
+
+	if (maxSuffixRev + 1 < maxSuffix + 1) return maxSuffix + 1;
+	*period = p;
+	return maxSuffixRev + 1;
+}
+
+static const char * twoWaySearch(const unsigned char * haystack, size_t haystackLen, const unsigned char * needle, size_t needleLen) {
+	size_t period;
+	size_t suffix = criticalFactorization(needle, needleLen, &period);
+	size_t i, j = 0;
+
+	if (memcmp(needle, needle + period, suffix) == 0) {
+		/* Periodic needle: remember how much of the left half already matched */
+		size_t memory = 0;
+		while (j <= haystackLen - needleLen) {
+			i = suffix > memory ? suffix : memory;
+			while (i < needleLen && needle[i] == haystack[i + j]) ++i;
+			if (needleLen <= i) {
+				i = suffix - 1;
+				while (memory < i + 1 && needle[i] == haystack[i + j]) --i;
+				if (i + 1 < memory + 1) return (const char *)haystack + j;
+				j += period;
+				memory = needleLen - period;
+			} else {
+				j += i - suffix + 1;
+				memory = 0;
+			}
+		}
+	} else {
+		period = (suffix > needleLen - suffix ? suffix : needleLen - suffix) + 1;
+		while (j <= haystackLen - needleLen) {
+			i = suffix;
+			while (i < needleLen && needle[i] == haystack[i + j]) ++i;
+			if (needleLen <= i) {
+				i = suffix - 1;
+				while (i != SIZE_MAX && needle[i] == haystack[i + j]) --i;
+				if (i == SIZE_MAX) return (const char *)haystack + j;
+				j += period;
+			} else {
+				j += i - suffix + 1;
+			}
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Find the first occurrence of needle in haystack, or NULL.
+ *
+ * Short needles scan for their first byte with memchr and verify with memcmp;
+ * long needles use Two-Way, which is linear in the haystack regardless of
+ * how repetitive the needle is.
+ */
+static const char * findSubstring(const char * haystack, size_t haystackLen, const char * needle, size_t needleLen) {
+	if (needleLen == 0) return haystack;
+	if (needleLen > haystackLen) return NULL;
+	if (needleLen == 1) return memchr(haystack, needle[0], haystackLen);
+	if (needleLen >= TWO_WAY_THRESHOLD) {
+		return twoWaySearch((const unsigned char *)haystack, haystackLen, (const unsigned char *)needle, needleLen);
+	}
+	const char * last = haystack + haystackLen - needleLen;
+	const char * c = haystack;
+	while (c <= last) {
+		c = memchr(c, needle[0], last - c + 1);
+		if (!c) return NULL;
+		if (memcmp(c + 1, needle + 1, needleLen - 1) == 0) return c;
+		c++;
+	}
+	return NULL;
 }
 
 /* str.__contains__ */
@@ -386,12 +495,7 @@ KRK_METHOD(str,__contains__,{
 	METHOD_TAKES_EXACTLY(1);
 	if (IS_NONE(argv[1])) return BOOLEAN_VAL(0);
 	CHECK_ARG(1,str,KrkString*,needle);
-	for (size_t i = 0; i < self->length; ++i) {
-		if (substringMatch(self->chars + i, self->length - i, needle->chars, needle->length)) {
-			return BOOLEAN_VAL(1);
-		}
-	}
-	return BOOLEAN_VAL(0);
+	return BOOLEAN_VAL(findSubstring(self->chars, self->length, needle->chars, needle->length) != NULL);
 })
 
 static int charIn(char c, const char * str) {
@@ -425,7 +529,7 @@ static KrkValue _string_strip_shared(int argc, KrkValue argv[], int which) {
 	}
 	if (which < 2) while (start < end && charIn(AS_CSTRING(argv[0])[start], subset)) start++;
 	if (which != 1) while (end > start && charIn(AS_CSTRING(argv[0])[end-1], subset)) end--;
-	return OBJECT_VAL(krk_copyString(&AS_CSTRING(argv[0])[start], end-start));
+	return OBJECT_VAL(krk_copyStringUninterned(&AS_CSTRING(argv[0])[start], end-start));
 }
 
 KRK_METHOD(str,strip,{
@@ -453,10 +557,9 @@ KRK_METHOD(str,__lt__,{
 	const char * a = AS_CSTRING(argv[0]);
 	const char * b = AS_CSTRING(argv[1]);
 
-	for (size_t i = 0; i < (aLen < bLen) ? aLen : bLen; i++) {
-		if (a[i] < b[i]) return BOOLEAN_VAL(1);
-		if (a[i] > b[i]) return BOOLEAN_VAL(0);
-	}
+	/* Byte order of UTF-8 matches codepoint order */
+	int cmp = memcmp(a, b, aLen < bLen ? aLen : bLen);
+	if (cmp) return BOOLEAN_VAL(cmp < 0);
 
 	return BOOLEAN_VAL((aLen < bLen));
 })
@@ -473,10 +576,9 @@ KRK_METHOD(str,__gt__,{
 	const char * a = AS_CSTRING(argv[0]);
 	const char * b = AS_CSTRING(argv[1]);
 
-	for (size_t i = 0; i < (aLen < bLen) ? aLen : bLen; i++) {
-		if (a[i] < b[i]) return BOOLEAN_VAL(0);
-		if (a[i] > b[i]) return BOOLEAN_VAL(1);
-	}
+	/* Byte order of UTF-8 matches codepoint order */
+	int cmp = memcmp(a, b, aLen < bLen ? aLen : bLen);
+	if (cmp) return BOOLEAN_VAL(cmp > 0);
 
 	return BOOLEAN_VAL((aLen > bLen));
 })
@@ -522,7 +624,7 @@ KRK_METHOD(str,split,{
 					PUSH_CHAR(*c);
 					i++; c++;
 				}
-				KrkValue tmp = OBJECT_VAL(krk_copyString(stringBytes, stringLength));
+				KrkValue tmp = OBJECT_VAL(krk_copyStringUninterned(stringBytes, stringLength));
 				FREE_ARRAY(char,stringBytes,stringCapacity);
 				krk_push(tmp);
 				krk_writeValueArray(AS_LIST(myList), tmp);
@@ -530,33 +632,26 @@ KRK_METHOD(str,split,{
 			}
 		}
 	} else {
+		KrkString * sep = AS_STRING(argv[1]);
+		if (sep->length == 0) {
+			krk_pop();
+			return krk_runtimeError(vm.exceptions->valueError, "Empty separator");
+		}
 		while (i != self->length) {
-			size_t stringCapacity = 0;
-			size_t stringLength   = 0;
-			char * stringBytes    = NULL;
-			while (i != self->length && !substringMatch(c, self->length - i, AS_STRING(argv[1])->chars, AS_STRING(argv[1])->length)) {
-				PUSH_CHAR(*c);
-				i++; c++;
-			}
-			KrkValue tmp = OBJECT_VAL(krk_copyString(stringBytes, stringLength));
-			if (stringBytes) FREE_ARRAY(char,stringBytes,stringCapacity);
+			const char * match = findSubstring(c, self->length - i, sep->chars, sep->length);
+			size_t fieldLength = match ? (size_t)(match - c) : self->length - i;
+			KrkValue tmp = OBJECT_VAL(krk_copyStringUninterned(c, fieldLength));
 			krk_push(tmp);
 			krk_writeValueArray(AS_LIST(myList), tmp);
 			krk_pop();
-			if (substringMatch(c, self->length - i, AS_STRING(argv[1])->chars, AS_STRING(argv[1])->length)) {
-				i += AS_STRING(argv[1])->length;
-				c += AS_STRING(argv[1])->length;
+			i += fieldLength;
+			c += fieldLength;
+			if (match) {
+				i += sep->length;
+				c += sep->length;
 				count++;
 				if (argc > 2 && count == (size_t)AS_INTEGER(argv[2])) {
-					size_t stringCapacity = 0;
-					size_t stringLength   = 0;
-					char * stringBytes    = NULL;
-					while (i != self->length) {
-						PUSH_CHAR(*c);
-						i++; c++;
-					}
-					KrkValue tmp = OBJECT_VAL(krk_copyString(stringBytes, stringLength));
-					if (stringBytes) FREE_ARRAY(char,stringBytes,stringCapacity);
+					KrkValue tmp = OBJECT_VAL(krk_copyStringUninterned(c, self->length - i));
 					krk_push(tmp);
 					krk_writeValueArray(AS_LIST(myList), tmp);
 					krk_pop();
@@ -589,30 +684,64 @@ KRK_METHOD(str,replace,{
 	int replacements = 0;
 	size_t i = 0;
 	char * c = self->chars;
-	while (i < self->length) {
-		if ( substringMatch(c, self->length - i, oldStr->chars, oldStr->length) && (IS_NONE(count) || replacements < AS_INTEGER(count))) {
-			for (char * o = newStr->chars; *o; o++ ){
-				PUSH_CHAR(*o);
-			}
-			if (oldStr->length == 0) {
-				PUSH_CHAR(*c);
-				c++;
-				i++;
+	if (oldStr->length == 0) {
+		while (i < self->length) {
+			if (IS_NONE(count) || replacements < AS_INTEGER(count)) {
+				for (size_t j = 0; j < newStr->length; ++j) {
+					PUSH_CHAR(newStr->chars[j]);
+				}
+				replacements++;
 			}
-			c += oldStr->length;
-			i += oldStr->length;
-			replacements++;
-		} else {
 			PUSH_CHAR(*c);
 			c++;
 			i++;
 		}
+	} else {
+		struct StringBuilder sb = {0};
+		while (i < self->length) {
+			const char * match = (IS_NONE(count) || replacements < AS_INTEGER(count)) ?
+				findSubstring(c, self->length - i, oldStr->chars, oldStr->length) : NULL;
+			size_t skip = match ? (size_t)(match - c) : self->length - i;
+			pushStringBuilderStr(&sb, c, skip);
+			c += skip;
+			i += skip;
+			if (match) {
+				pushStringBuilderStr(&sb, newStr->chars, newStr->length);
+				c += oldStr->length;
+				i += oldStr->length;
+				replacements++;
+			}
+		}
+		return finishStringBuilder(&sb);
 	}
-	KrkValue tmp = OBJECT_VAL(krk_copyString(stringBytes, stringLength));
+	KrkValue tmp = OBJECT_VAL(krk_copyStringUninterned(stringBytes, stringLength));
 	if (stringBytes) FREE_ARRAY(char,stringBytes,stringCapacity);
 	return tmp;
 })
 
+static size_t codepointToByteOffset(KrkString * string, size_t index) {
+	if (string->type == KRK_STRING_ASCII) return index;
+	const unsigned char * c = (const unsigned char *)string->chars;
+	const unsigned char * end = c + string->length;
+	size_t seen = 0;
+	for (; c < end; ++c) {
+		if ((*c & 0xC0) != 0x80) {
+			if (seen == index) break;
+			seen++;
+		}
+	}
+	return (const char *)c - string->chars;
+}
+
+static size_t byteToCodepointOffset(KrkString * string, size_t offset) {
+	if (string->type == KRK_STRING_ASCII) return offset;
+	size_t index = 0;
+	for (size_t i = 0; i < offset; ++i) {
+		if ((string->chars[i] & 0xC0) != 0x80) index++;
+	}
+	return index;
+}
+
 #define WRAP_INDEX(index) \
 	if (index < 0) index += self->codesLength; \
 	if (index < 0) index = 0; \
@@ -645,19 +774,16 @@ KRK_METHOD(str,find,{
 	WRAP_INDEX(start);
 	WRAP_INDEX(end);
 
-	/* Make sure both strings have code representations */
-	krk_unicodeString(self);
-	krk_unicodeString(substr);
+	if (start >= end) return INTEGER_VAL(-1);
+	if (substr->codesLength == 0) return INTEGER_VAL(start);
 
-	for (krk_integer_type i = start; i < end; ++i) {
-		krk_integer_type j;
-		for (j = 0; j < (krk_integer_type)substr->codesLength && (i + j < end); ++j) {
-			if (KRK_STRING_FAST(self,i+j) != KRK_STRING_FAST(substr,j)) break;
-		}
-		if (j == (krk_integer_type)substr->codesLength) return INTEGER_VAL(i);
-	}
-
-	return INTEGER_VAL(-1);
+	/* A match of valid UTF-8 in valid UTF-8 always starts on a codepoint
+	 * boundary, so we can search the raw bytes and convert offsets. */
+	size_t startByte = codepointToByteOffset(self, start);
+	size_t endByte = codepointToByteOffset(self, end);
+	const char * match = findSubstring(self->chars + startByte, endByte - startByte, substr->chars, substr->length);
+	if (!match) return INTEGER_VAL(-1);
+	return INTEGER_VAL(byteToCodepointOffset(self, match - self->chars));
 })
 
 KRK_METHOD(str,index,{
@@ -807,38 +933,111 @@ KRK_METHOD(str,isupper, {
 })
 
 #undef CURRENT_CTYPE
-#define CURRENT_CTYPE KrkInstance *
+#define CURRENT_CTYPE struct StrIterator *
+
+static void _striterator_gcscan(KrkInstance * self) {
+	krk_markValue(((struct StrIterator*)self)->s);
+}
+
 KRK_METHOD(striterator,__init__,{
 	METHOD_TAKES_EXACTLY(1);
 	CHECK_ARG(1,str,KrkString*,base);
-	krk_push(OBJECT_VAL(self));
-	krk_attachNamedObject(&self->fields, "s", (KrkObj*)base);
-	krk_attachNamedValue(&self->fields, "i", INTEGER_VAL(0));
-	return krk_pop();
+	self->s = argv[1];
+	self->i = 0;
+	self->offset = 0;
+	return argv[0];
 })
 
 KRK_METHOD(striterator,__call__,{
 	METHOD_TAKES_NONE();
-	KrkValue _str;
-	KrkValue _counter;
-	const char * errorStr = NULL;
-	if (!krk_tableGet(&self->fields, OBJECT_VAL(S("s")), &_str)) {
-		errorStr = "no str pointer";
-		goto _corrupt;
+	KrkString * str = AS_STRING(self->s);
+	if (self->i >= str->codesLength) {
+		return argv[0];
+	} else if (str->type == KRK_STRING_ASCII) {
+		return OBJECT_VAL(krk_copyString(str->chars + self->i++, 1));
+	} else {
+		/* Track the byte offset alongside the codepoint index so each step is O(1) */
+		krk_unicodeString(str);
+		size_t length = CODEPOINT_BYTES(KRK_STRING_FAST(str,self->i));
+		KrkValue out = OBJECT_VAL(krk_copyString(str->chars + self->offset, length));
+		self->i++;
+		self->offset += length;
+		return out;
 	}
-	if (!krk_tableGet(&self->fields, OBJECT_VAL(S("i")), &_counter)) {
-		errorStr = "no index";
-		goto _corrupt;
+})
+
+/**
+ * StringBuilder collects string fragments in a growable buffer, so that
+ * building a large string piece by piece is linear instead of copying
+ * (and allocating) the whole intermediate result on every `+`.
+ */
+static KrkClass * StringBuilder;
+struct StringBuilderInstance {
+	KrkInstance inst;
+	struct StringBuilder sb;
+	size_t codesLength;
+};
+#define IS_StringBuilder(o) krk_isInstanceOf(o,StringBuilder)
+#define AS_StringBuilder(o) ((struct StringBuilderInstance*)AS_OBJECT(o))
+
+static void _StringBuilder_gcsweep(KrkInstance * self) {
+	discardStringBuilder(&((struct StringBuilderInstance*)self)->sb);
+}
+
+#undef CURRENT_CTYPE
+#define CURRENT_CTYPE struct StringBuilderInstance *
+
+static KrkValue _StringBuilder_push(struct StringBuilderInstance * self, KrkValue value) {
+	if (!IS_STRING(value)) {
+		return krk_runtimeError(vm.exceptions->typeError, "can only append str (not '%s') to StringBuilder", krk_typeName(value));
 	}
+	pushStringBuilderStr(&self->sb, AS_CSTRING(value), AS_STRING(value)->length);
+	self->codesLength += AS_STRING(value)->codesLength;
+	return NONE_VAL();
+}
 
-	if ((size_t)AS_INTEGER(_counter) >= AS_STRING(_str)->codesLength) {
-		return argv[0];
-	} else {
-		krk_attachNamedValue(&self->fields, "i", INTEGER_VAL(AS_INTEGER(_counter)+1));
-		return FUNC_NAME(str,__get__)(2,(KrkValue[]){_str,_counter},3);
+KRK_METHOD(StringBuilder,__init__,{
+	METHOD_TAKES_AT_MOST(1);
+	if (argc > 1) {
+		_StringBuilder_push(self, argv[1]);
 	}
-_corrupt:
-	return krk_runtimeError(vm.exceptions->typeError, "Corrupt str iterator: %s", errorStr);
+	return argv[0];
+})
+
+KRK_METHOD(StringBuilder,append,{
+	METHOD_TAKES_EXACTLY(1);
+	return _StringBuilder_push(self, argv[1]);
+})
+
+KRK_METHOD(StringBuilder,clear,{
+	METHOD_TAKES_NONE();
+	self->sb.length = 0;
+	self->codesLength = 0;
+})
+
+KRK_METHOD(StringBuilder,__len__,{
+	METHOD_TAKES_NONE();
+	return INTEGER_VAL(self->codesLength);
+})
+
+KRK_METHOD(StringBuilder,__str__,{
+	METHOD_TAKES_NONE();
+	return OBJECT_VAL(krk_copyStringUninterned(self->sb.bytes ? self->sb.bytes : "", self->sb.length));
+})
+
+KRK_METHOD(StringBuilder,__repr__,{
+	METHOD_TAKES_NONE();
+	KrkValue asString = FUNC_NAME(StringBuilder,__str__)(1,argv,0);
+	krk_push(asString);
+	KrkValue inner = FUNC_NAME(str,__repr__)(1,&asString,0);
+	krk_pop();
+	krk_push(inner);
+	struct StringBuilder out = {0};
+	pushStringBuilderStr(&out, "StringBuilder(", 14);
+	pushStringBuilderStr(&out, AS_CSTRING(inner), AS_STRING(inner)->length);
+	pushStringBuilder(&out, ')');
+	krk_pop();
+	return finishStringBuilder(&out);
 })
 
 _noexport
@@ -890,9 +1089,23 @@ void _createAndBind_strClass(void) {
 	str->docstring = S("Obtain a string representation of an object.");
 
 	KrkClass * striterator = ADD_BASE_CLASS(vm.baseClasses->striteratorClass, "striterator", vm.baseClasses->objectClass);
+	striterator->allocSize = sizeof(struct StrIterator);
+	striterator->_ongcscan = _striterator_gcscan;
 	BIND_METHOD(striterator,__init__);
 	BIND_METHOD(striterator,__call__);
 	krk_finalizeClass(striterator);
+
+	krk_makeClass(vm.builtins, &StringBuilder, "StringBuilder", vm.baseClasses->objectClass);
+	StringBuilder->allocSize = sizeof(struct StringBuilderInstance);
+	StringBuilder->_ongcsweep = _StringBuilder_gcsweep;
+	BIND_METHOD(StringBuilder,__init__);
+	BIND_METHOD(StringBuilder,append);
+	BIND_METHOD(StringBuilder,clear);
+	BIND_METHOD(StringBuilder,__len__);
+	BIND_METHOD(StringBuilder,__str__);
+	BIND_METHOD(StringBuilder,__repr__);
+	krk_finalizeClass(StringBuilder);
+	StringBuilder->docstring = S("Efficiently build a str from many smaller strings.");
 }
 
 KrkValue krk_string_get(int argc, KrkValue argv[], int hasKw) __attribute__((alias("_str___get__")));
@@ -91,12 +91,6 @@ static KrkValue _tuple_repr(int argc, KrkValue argv[]) {
 	return krk_pop();
 }
 
-struct TupleIter {
-	KrkInstance inst;
-	KrkValue myTuple;
-	int i;
-};
-
 static KrkValue _tuple_iter_init(int argc, KrkValue argv[]) {
 	struct TupleIter * self = (struct TupleIter *)AS_OBJECT(argv[0]);
 	self->myTuple = argv[1];
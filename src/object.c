@@ -2,6 +2,12 @@
 #include <string.h>
 #include <stdlib.h>
 
+#if defined(__AVX2__)
+# include <immintrin.h>
+#elif defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
 #include "memory.h"
 #include "object.h"
 #include "value.h"
@@ -98,12 +104,50 @@ _reject:
 	return *state;
 }
 
+/**
+ * Length of the run of ASCII bytes at the start of [start,end).
+ *
+ * Most strings are entirely or mostly ASCII, so skip over those runs a
+ * vector at a time and only fall back to the decoder for multibyte sequences.
+ */
+static inline size_t asciiRun(const unsigned char * start, const unsigned char * end) {
+	const unsigned char * c = start;
+#if defined(__AVX2__)
+	while (end - c >= 32) {
+		int mask = _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)c));
+		if (mask) return (c - start) + __builtin_ctz(mask);
+		c += 32;
+	}
+#endif
+#if defined(__SSE2__)
+	while (end - c >= 16) {
+		int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)c));
+		if (mask) return (c - start) + __builtin_ctz(mask);
+		c += 16;
+	}
+#endif
+	while (end - c >= 8) {
+		uint64_t word;
+		memcpy(&word, c, sizeof(word));
+		if (word & 0x8080808080808080ULL) break;
+		c += 8;
+	}
+	while (c < end && *c < 0x80) c++;
+	return c - start;
+}
+
 static int checkString(const char * chars, size_t length, size_t *codepointCount) {
 	uint32_t state = 0;
 	uint32_t codepoint = 0;
 	unsigned char * end = (unsigned char *)chars + length;
 	uint32_t maxCodepoint = 0;
 	for (unsigned char * c = (unsigned char *)chars; c < end; ++c) {
+		if (state == UTF8_ACCEPT) {
+			size_t run = asciiRun(c, end);
+			*codepointCount += run;
+			c += run;
+			if (c == end) break;
+		}
 		if (!decode(&state, &codepoint, *c)) {
 			if (codepoint > maxCodepoint) maxCodepoint = codepoint;
 			(*codepointCount)++;
@@ -133,6 +177,12 @@ static int checkString(const char * chars, size_t length, size_t *codepointCount
 		string->codes = malloc(sizeof(type) * string->codesLength); \
 		type *outPtr = (type *)string->codes; \
 		for (unsigned char * c = (unsigned char *)string->chars; c < end; ++c) { \
+			if (state == UTF8_ACCEPT) { \
+				size_t run = asciiRun(c, end); \
+				for (size_t i = 0; i < run; ++i) *(outPtr++) = c[i]; \
+				c += run; \
+				if (c == end) break; \
+			} \
 			if (!decode(&state, &codepoint, *c)) { \
 				*(outPtr++) = (type)codepoint; \
 			} else if (state == UTF8_REJECT) { \
@@ -166,18 +216,21 @@ uint32_t krk_unicodeCodepoint(KrkString * string, size_t index) {
 	return 0;
 }
 
-static KrkString * allocateString(char * chars, size_t length, uint32_t hash) {
+static KrkString * allocateString(char * chars, size_t length, uint32_t hash, int intern) {
 	KrkString * string = ALLOCATE_OBJECT(KrkString, OBJ_STRING);
 	string->length = length;
 	string->chars = chars;
 	string->hash = hash;
+	string->flags = intern ? (KRK_STRING_FLAG_INTERNED | KRK_STRING_FLAG_HASHED) : 0;
 	string->codesLength = 0;
 	string->type = checkString(chars,length,&string->codesLength);
 	string->codes = NULL;
 	if (string->type == KRK_STRING_ASCII) string->codes = string->chars;
-	krk_push(OBJECT_VAL(string));
-	krk_tableSet(&vm.strings, OBJECT_VAL(string), NONE_VAL());
-	krk_pop();
+	if (intern) {
+		krk_push(OBJECT_VAL(string));
+		krk_tableSet(&vm.strings, OBJECT_VAL(string), NONE_VAL());
+		krk_pop();
+	}
 	return string;
 }
 
@@ -191,6 +244,15 @@ static uint32_t hashString(const char * key, size_t length) {
 	return hash;
 }
 
+/**
+ * Strings that were not interned have their hash calculated on first use,
+ * so that strings that never end up as keys never pay for it.
+ */
+void krk_stringUpdateHash(KrkString * string) {
+	string->hash = hashString(string->chars, string->length);
+	string->flags |= KRK_STRING_FLAG_HASHED;
+}
+
 KrkString * krk_takeString(char * chars, size_t length) {
 	uint32_t hash = hashString(chars, length);
 	_obtain_lock(_stringLock);
@@ -200,7 +262,7 @@ KrkString * krk_takeString(char * chars, size_t length) {
 		_release_lock(_stringLock);
 		return interned;
 	}
-	KrkString * result = allocateString(chars, length, hash);
+	KrkString * result = allocateString(chars, length, hash, 1);
 	_release_lock(_stringLock);
 	return result;
 }
@@ -216,11 +278,43 @@ KrkString * krk_copyString(const char * chars, size_t length) {
 	char * heapChars = ALLOCATE(char, length + 1);
 	memcpy(heapChars, chars, length);
 	heapChars[length] = '\0';
-	KrkString * result = allocateString(heapChars, length, hash);
+	KrkString * result = allocateString(heapChars, length, hash, 1);
 	_release_lock(_stringLock);
 	return result;
 }
 
+/**
+ * The uninterned variants are for strings built at runtime (concatenation
+ * results, slices, file contents...) which are unlikely to be looked up
+ * again by content; they skip both hashing and the string table.
+ */
+KrkString * krk_takeStringUninterned(char * chars, size_t length) {
+	return allocateString(chars, length, 0, 0);
+}
+
+KrkString * krk_copyStringUninterned(const char * chars, size_t length) {
+	char * heapChars = ALLOCATE(char, length + 1);
+	memcpy(heapChars, chars, length);
+	heapChars[length] = '\0';
+	return allocateString(heapChars, length, 0, 0);
+}
+
+KrkString * krk_internString(KrkString * string) {
+	if (string->flags & KRK_STRING_FLAG_INTERNED) return string;
+	if (!(string->flags & KRK_STRING_FLAG_HASHED)) krk_stringUpdateHash(string);
+	_obtain_lock(_stringLock);
+	KrkString * interned = krk_tableFindString(&vm.strings, string->chars, string->length, string->hash);
+	if (!interned) {
+		string->flags |= KRK_STRING_FLAG_INTERNED;
+		krk_push(OBJECT_VAL(string));
+		krk_tableSet(&vm.strings, OBJECT_VAL(string), NONE_VAL());
+		krk_pop();
+		interned = string;
+	}
+	_release_lock(_stringLock);
+	return interned;
+}
+
 KrkFunction * krk_newFunction(void) {
 	KrkFunction * function = ALLOCATE_OBJECT(KrkFunction, OBJ_FUNCTION);
 	function->requiredArgs = 0;
@@ -321,6 +415,7 @@ KrkTuple * krk_newTuple(size_t length) {
 	krk_initValueArray(&tuple->values);
 	krk_push(OBJECT_VAL(tuple));
 	tuple->values.capacity = length;
+	tuple->hash = -1;
 	tuple->values.values = GROW_ARRAY(KrkValue,NULL,0,length);
 	krk_pop();
 	return tuple;
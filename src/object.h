@@ -65,10 +65,14 @@ typedef enum {
 	KRK_STRING_UCS4  = 4,
 } KrkStringType;
 
+#define KRK_STRING_FLAG_INTERNED 0x01
+#define KRK_STRING_FLAG_HASHED   0x02
+
 struct ObjString {
 	KrkObj obj;
 	KrkStringType type;
 	uint32_t hash;
+	uint32_t flags;
 	size_t length;
 	size_t codesLength;
 	char * chars;
@@ -113,6 +117,7 @@ typedef struct {
 	KrkLocalEntry * localNames;
 	unsigned char collectsArguments:1;
 	unsigned char collectsKeywords:1;
+	unsigned char isGenerator:1;
 	struct KrkInstance * globalsContext;
 } KrkFunction;
 
@@ -155,6 +160,8 @@ typedef struct KrkClass {
 	KrkObj * _dir;
 	KrkObj * _setslice;
 	KrkObj * _delslice;
+	KrkObj * _hash;
+	KrkObj * _missing;
 } KrkClass;
 
 typedef struct KrkInstance {
@@ -182,6 +189,7 @@ typedef struct {
 typedef struct {
 	KrkObj obj;
 	KrkValueArray values;
+	uint32_t hash;
 } KrkTuple;
 
 typedef struct {
@@ -202,6 +210,37 @@ typedef struct {
 	KrkTable entries;
 } KrkDict;
 
+struct ListIterator {
+	KrkInstance inst;
+	KrkValue l;
+	size_t i;
+};
+
+struct TupleIter {
+	KrkInstance inst;
+	KrkValue myTuple;
+	int i;
+};
+
+struct Range {
+	KrkInstance inst;
+	krk_integer_type min;
+	krk_integer_type max;
+};
+
+struct RangeIterator {
+	KrkInstance inst;
+	krk_integer_type i;
+	krk_integer_type max;
+};
+
+struct StrIterator {
+	KrkInstance inst;
+	KrkValue s;
+	size_t i;
+	size_t offset; /* Byte offset of codepoint i, so non-ASCII iteration stays linear */
+};
+
 struct DictItems {
 	KrkInstance inst;
 	KrkValue dict;
@@ -223,6 +262,10 @@ static inline int isObjType(KrkValue value, ObjType type) {
 
 extern KrkString * krk_takeString(char * chars, size_t length);
 extern KrkString * krk_copyString(const char * chars, size_t length);
+extern KrkString * krk_takeStringUninterned(char * chars, size_t length);
+extern KrkString * krk_copyStringUninterned(const char * chars, size_t length);
+extern KrkString * krk_internString(KrkString * string);
+extern void krk_stringUpdateHash(KrkString * string);
 extern KrkFunction *    krk_newFunction(void);
 extern KrkNative * krk_newNative(NativeFn function, const char * name, int type);
 extern KrkClosure *     krk_newClosure(KrkFunction * function);
@@ -0,0 +1,622 @@
+/**
+ * Bytecode optimizer.
+ *
+ * Each function's chunk is rewritten after it has been compiled. The chunk
+ * is decoded into a list of instructions with jumps referring to other
+ * instructions rather than offsets, a few passes run over that list until
+ * nothing changes, and the result is encoded back into the chunk with fresh
+ * jump offsets, line map and local variable lifetimes.
+ *
+ * When enabled with -O, the passes are:
+ *   - folding arithmetic, comparisons and string concatenation on constants
+ *   - folding constant conditions and `not` into the jumps that test them
+ *   - threading jumps that land on other jumps
+ *   - removing instructions that can't be reached
+ *
+ * Superinstructions are always fused, as they are a pure win at runtime.
+ * The set was chosen from the opcode pair counts reported by a build with
+ * KRK_ENABLE_OPCODE_STATS=1, run over the test suite and benchmarks:
+ *   SET_LOCAL POP                    -> SET_LOCAL_POP
+ *   GET_LOCAL GET_LOCAL              -> GET_LOCAL_PAIR
+ *   GET_LOCAL CONSTANT               -> GET_LOCAL_CONSTANT
+ *   JUMP_IF_FALSE POP, target is POP -> POP_JUMP_IF_FALSE
+ *   JUMP_IF_TRUE POP, target is POP  -> POP_JUMP_IF_TRUE
+ *
+ * Instructions are only ever merged into the first instruction of a pattern,
+ * and only when no jump lands in the middle of it.
+ */
+#include <string.h>
+#include <stdlib.h>
+
+#include "vm.h"
+#include "debug.h"
+#include "memory.h"
+#include "util.h"
+
+typedef struct {
+	size_t offset;        /* Where this instruction started in the original chunk */
+	size_t line;
+	size_t size;          /* Encoded size in bytes */
+	const uint8_t * from; /* Original encoding, or NULL if rewritten into `code` */
+	uint8_t code[5];
+	size_t target;        /* Instruction index, for jumps */
+	int isTarget;
+	int live;
+} Instruction;
+
+typedef struct {
+	KrkFunction * function;
+	size_t count;
+	Instruction * instructions;
+	size_t * handlers;    /* Instruction indexes of each handler's start, end and target */
+} Optimizer;
+
+static inline uint8_t opcodeOf(Instruction * in) {
+	return in->from ? in->from[0] : in->code[0];
+}
+
+static inline const uint8_t * bytesOf(Instruction * in) {
+	return in->from ? in->from : in->code;
+}
+
+static int isJump(uint8_t opcode) {
+	switch (opcode) {
+		case OP_JUMP:
+		case OP_JUMP_IF_FALSE:
+		case OP_JUMP_IF_TRUE:
+		case OP_LOOP:
+		case OP_PUSH_WITH:
+		case OP_FOR_ITER:
+		case OP_POP_JUMP_IF_FALSE:
+		case OP_POP_JUMP_IF_TRUE:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+/* Size of the instruction at offset, or 0 if we don't know how to decode it. */
+static size_t instructionSize(KrkChunk * chunk, size_t offset) {
+	uint8_t opcode = chunk->code[offset];
+	switch (opcode) {
+		case OP_DUP:
+		case OP_EXPAND_ARGS:
+			return 2;
+		case OP_JUMP:
+		case OP_JUMP_IF_FALSE:
+		case OP_JUMP_IF_TRUE:
+		case OP_LOOP:
+		case OP_PUSH_WITH:
+		case OP_FOR_ITER:
+		case OP_COMP_ENTER:
+		case OP_COMP_EXIT:
+		case OP_GET_LOCAL_PAIR:
+		case OP_GET_LOCAL_CONSTANT:
+		case OP_POP_JUMP_IF_FALSE:
+		case OP_POP_JUMP_IF_TRUE:
+			return 3;
+		case OP_CALL_BUILTIN:
+			return 4;
+		case OP_COMP_ENTER_LONG:
+		case OP_COMP_EXIT_LONG:
+			return 5;
+		case OP_CLOSURE:
+		case OP_CLOSURE_LONG: {
+			size_t width = (opcode == OP_CLOSURE) ? 1 : 3;
+			size_t index = chunk->code[offset + 1];
+			if (width == 3) index = (index << 16) | (chunk->code[offset + 2] << 8) | chunk->code[offset + 3];
+			KrkFunction * function = AS_FUNCTION(chunk->constants.values[index]);
+			size_t size = 1 + width;
+			for (size_t i = 0; i < function->upvalueCount; ++i) {
+				size += 1 + ((i > 255) ? 3 : 1);
+			}
+			return size;
+		}
+		case OP_CONSTANT: case OP_DEFINE_GLOBAL: case OP_GET_GLOBAL: case OP_SET_GLOBAL:
+		case OP_DEL_GLOBAL: case OP_CLASS: case OP_GET_PROPERTY: case OP_SET_PROPERTY:
+		case OP_DEL_PROPERTY: case OP_METHOD: case OP_IMPORT: case OP_IMPORT_FROM:
+		case OP_GET_SUPER: case OP_KWARGS: case OP_SET_LOCAL: case OP_GET_LOCAL:
+		case OP_SET_UPVALUE: case OP_GET_UPVALUE: case OP_CALL: case OP_INC:
+		case OP_TUPLE: case OP_UNPACK: case OP_LIST_APPEND: case OP_DICT_SET:
+		case OP_SET_ADD: case OP_LIST_RESERVE: case OP_SET_LOCAL_POP: case OP_TAIL_CALL:
+			return 2;
+		default:
+			if (opcode > OP_TAIL_CALL_LONG) return 0;
+			if (opcode & (1 << 7)) return 4;
+			if (opcode > OP_TAIL_CALL) return 0;
+			return 1;
+	}
+}
+
+static int decode(Optimizer * self) {
+	KrkChunk * chunk = &self->function->chunk;
+	self->instructions = malloc(sizeof(Instruction) * (chunk->count + 1));
+	size_t * indexAt = calloc(chunk->count + 1, sizeof(size_t));
+	self->count = 0;
+	size_t line = 0, nextLine = 0;
+	for (size_t offset = 0; offset < chunk->count;) {
+		size_t size = instructionSize(chunk, offset);
+		if (!size || offset + size > chunk->count) {
+			free(indexAt);
+			return 0;
+		}
+		while (nextLine < chunk->linesCount && chunk->lines[nextLine].startOffset <= offset) {
+			line = chunk->lines[nextLine++].line;
+		}
+		indexAt[offset] = self->count;
+		self->instructions[self->count++] = (Instruction){offset, line, size, &chunk->code[offset], {0}, 0, 0, 1};
+		offset += size;
+	}
+	indexAt[chunk->count] = self->count;
+
+	/* Resolve jump offsets to instruction indexes */
+	for (size_t i = 0; i < self->count; ++i) {
+		Instruction * in = &self->instructions[i];
+		uint8_t opcode = opcodeOf(in);
+		if (!isJump(opcode)) continue;
+		size_t distance = (in->from[1] << 8) | in->from[2];
+		size_t after = in->offset + 3;
+		if (opcode == OP_LOOP ? distance > after : after + distance > chunk->count) {
+			free(indexAt);
+			return 0;
+		}
+		size_t targetOffset = opcode == OP_LOOP ? after - distance : after + distance;
+		/* A jump into the middle of an instruction means something we don't understand. */
+		if (targetOffset != chunk->count && (targetOffset >= chunk->count || !chunk->code[targetOffset]
+		    || self->instructions[indexAt[targetOffset]].offset != targetOffset)) {
+			free(indexAt);
+			return 0;
+		}
+		in->target = indexAt[targetOffset];
+	}
+
+	/* Try blocks are only found through the handler table, so it has to line up with instructions too. */
+	self->handlers = malloc(sizeof(size_t) * 3 * (chunk->handlersCount + 1));
+	for (size_t i = 0; i < chunk->handlersCount; ++i) {
+		size_t offsets[3] = {chunk->handlers[i].startOffset, chunk->handlers[i].endOffset, chunk->handlers[i].target};
+		for (int j = 0; j < 3; ++j) {
+			if (offsets[j] > chunk->count || (offsets[j] < chunk->count && self->instructions[indexAt[offsets[j]]].offset != offsets[j])) {
+				free(indexAt);
+				return 0;
+			}
+			self->handlers[i * 3 + j] = indexAt[offsets[j]];
+		}
+	}
+	free(indexAt);
+	return 1;
+}
+
+static size_t nextLive(Optimizer * self, size_t i) {
+	for (i = i + 1; i < self->count && !self->instructions[i].live; ++i);
+	return i;
+}
+
+static void markTargets(Optimizer * self) {
+	for (size_t i = 0; i < self->count; ++i) self->instructions[i].isTarget = 0;
+	for (size_t i = 0; i < self->count; ++i) {
+		Instruction * in = &self->instructions[i];
+		if (in->live && isJump(opcodeOf(in)) && in->target < self->count) {
+			self->instructions[in->target].isTarget = 1;
+		}
+	}
+	/* Nothing may be merged across the edges of a try block or into its except branch. */
+	for (size_t i = 0; i < self->function->chunk.handlersCount * 3; ++i) {
+		if (self->handlers[i] < self->count) self->instructions[self->handlers[i]].isTarget = 1;
+	}
+}
+
+/* Replace an instruction with a new encoding, keeping its position and line. */
+static void rewrite(Instruction * in, size_t size, uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+	in->from = NULL;
+	in->size = size;
+	in->code[0] = a;
+	in->code[1] = b;
+	in->code[2] = c;
+	in->code[3] = d;
+}
+
+static void rewriteJump(Instruction * in, uint8_t opcode, size_t target) {
+	rewrite(in, 3, opcode, 0, 0, 0);
+	in->target = target;
+}
+
+static void rewriteConstant(Optimizer * self, Instruction * in, KrkValue value) {
+	KrkChunk * chunk = &self->function->chunk;
+	if (IS_BOOLEAN(value)) {
+		rewrite(in, 1, AS_BOOLEAN(value) ? OP_TRUE : OP_FALSE, 0, 0, 0);
+		return;
+	}
+	size_t index;
+	for (index = 0; index < chunk->constants.count; ++index) {
+		KrkValue existing = chunk->constants.values[index];
+		if (existing.type != value.type) continue;
+		/* Compare floats bitwise so 0.0 and -0.0 stay distinct. */
+		if (IS_FLOATING(value) ? !memcmp(&AS_FLOATING(existing), &AS_FLOATING(value), sizeof(double)) : krk_valuesSame(existing, value)) break;
+	}
+	if (index == chunk->constants.count) index = krk_addConstant(chunk, value);
+	if (index < 256) {
+		rewrite(in, 2, OP_CONSTANT, index, 0, 0);
+	} else {
+		rewrite(in, 4, OP_CONSTANT_LONG, index >> 16, index >> 8, index);
+	}
+}
+
+/* The value an instruction pushes, if it is a literal we know how to fold. */
+static int constantValue(Optimizer * self, Instruction * in, KrkValue * out) {
+	const uint8_t * bytes = bytesOf(in);
+	KrkValueArray * constants = &self->function->chunk.constants;
+	switch (bytes[0]) {
+		case OP_TRUE:  *out = BOOLEAN_VAL(1); return 1;
+		case OP_FALSE: *out = BOOLEAN_VAL(0); return 1;
+		case OP_NONE:  *out = NONE_VAL(); return 1;
+		case OP_CONSTANT: *out = constants->values[bytes[1]]; break;
+		case OP_CONSTANT_LONG: *out = constants->values[(bytes[1] << 16) | (bytes[2] << 8) | bytes[3]]; break;
+		default: return 0;
+	}
+	return IS_INTEGER(*out) || IS_FLOATING(*out) || IS_STRING(*out);
+}
+
+#define IS_NUMBER(v) (IS_INTEGER(v) || IS_FLOATING(v))
+
+/*
+ * Evaluate a binary operator on two constants the same way the VM would.
+ * Only cases that can't raise or run managed code are folded.
+ */
+static int foldBinary(uint8_t opcode, KrkValue a, KrkValue b, KrkValue * out) {
+	if (IS_STRING(a) && IS_STRING(b)) {
+		if (opcode != OP_ADD) return 0;
+		size_t length = AS_STRING(a)->length + AS_STRING(b)->length;
+		char * chars = malloc(length + 1);
+		memcpy(chars, AS_CSTRING(a), AS_STRING(a)->length);
+		memcpy(chars + AS_STRING(a)->length, AS_CSTRING(b), AS_STRING(b)->length);
+		chars[length] = '\0';
+		/* Concatenation at runtime doesn't intern its result, so neither do we. */
+		*out = OBJECT_VAL(krk_takeStringUninterned(chars, length));
+		return 1;
+	}
+	if (!IS_NUMBER(a) || !IS_NUMBER(b)) return 0;
+	int ints = IS_INTEGER(a) && IS_INTEGER(b);
+	switch (opcode) {
+		case OP_ADD: *out = krk_operator_add(a,b); return 1;
+		case OP_SUBTRACT: *out = krk_operator_sub(a,b); return 1;
+		case OP_MULTIPLY: *out = krk_operator_mul(a,b); return 1;
+		case OP_LESS: *out = krk_operator_lt(a,b); return 1;
+		case OP_GREATER: *out = krk_operator_gt(a,b); return 1;
+		case OP_DIVIDE:
+		case OP_MODULO:
+			if ((IS_INTEGER(b) && AS_INTEGER(b) == 0) || (IS_FLOATING(b) && AS_FLOATING(b) == 0.0)) return 0;
+			if (opcode == OP_DIVIDE) {
+				if (ints && AS_INTEGER(b) == -1) return 0; /* Overflows for the smallest int */
+				*out = krk_operator_div(a,b);
+				return 1;
+			}
+			if (!ints || AS_INTEGER(b) == -1) return 0;
+			*out = krk_operator_mod(a,b);
+			return 1;
+		case OP_BITOR: if (!ints) return 0; *out = krk_operator_or(a,b); return 1;
+		case OP_BITXOR: if (!ints) return 0; *out = krk_operator_xor(a,b); return 1;
+		case OP_BITAND: if (!ints) return 0; *out = krk_operator_and(a,b); return 1;
+		case OP_SHIFTLEFT:
+		case OP_SHIFTRIGHT:
+			if (!ints || AS_INTEGER(b) < 0 || AS_INTEGER(b) > 62) return 0;
+			*out = opcode == OP_SHIFTLEFT ? krk_operator_lshift(a,b) : krk_operator_rshift(a,b);
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+/* CONST CONST BINOP -> CONST, CONST NEGATE -> CONST, CONST NOT -> TRUE/FALSE */
+static int foldConstants(Optimizer * self, size_t i) {
+	Instruction * first = &self->instructions[i];
+	KrkValue a, b, result;
+	if (!constantValue(self, first, &a)) return 0;
+	size_t j = nextLive(self, i);
+	if (j >= self->count || self->instructions[j].isTarget) return 0;
+	Instruction * second = &self->instructions[j];
+
+	if (opcodeOf(second) == OP_NEGATE && IS_NUMBER(a)) {
+		result = IS_INTEGER(a) ? INTEGER_VAL(-AS_INTEGER(a)) : FLOATING_VAL(-AS_FLOATING(a));
+		rewriteConstant(self, first, result);
+		second->live = 0;
+		return 1;
+	}
+
+	if (opcodeOf(second) == OP_NOT) {
+		rewriteConstant(self, first, BOOLEAN_VAL(krk_isFalsey(a)));
+		second->live = 0;
+		return 1;
+	}
+
+	if (!constantValue(self, second, &b)) return 0;
+	size_t k = nextLive(self, j);
+	if (k >= self->count || self->instructions[k].isTarget) return 0;
+	Instruction * third = &self->instructions[k];
+	if (!foldBinary(opcodeOf(third), a, b, &result)) return 0;
+	krk_push(result);
+	rewriteConstant(self, first, result);
+	krk_pop();
+	second->live = 0;
+	third->live = 0;
+	return 1;
+}
+
+static int isPop(Optimizer * self, size_t i) {
+	return i < self->count && self->instructions[i].live && opcodeOf(&self->instructions[i]) == OP_POP;
+}
+
+/*
+ * Conditional jumps leave their condition on the stack. In `if` and `while`
+ * both paths start by popping it, so the value itself doesn't matter and
+ * only its truthiness does:
+ *   CONST JUMP_IF_x POP  ->  JUMP past the target's POP, or nothing
+ *   NOT JUMP_IF_x        ->  JUMP_IF_!x
+ */
+static int foldCondition(Optimizer * self, size_t i) {
+	Instruction * first = &self->instructions[i];
+	size_t j = nextLive(self, i);
+	if (j >= self->count || self->instructions[j].isTarget) return 0;
+	Instruction * jump = &self->instructions[j];
+	uint8_t opcode = opcodeOf(jump);
+	if (opcode != OP_JUMP_IF_FALSE && opcode != OP_JUMP_IF_TRUE) return 0;
+	size_t k = nextLive(self, j);
+	if (!isPop(self, k) || !isPop(self, jump->target)) return 0;
+
+	KrkValue value;
+	if (opcodeOf(first) == OP_NOT) {
+		rewriteJump(first, opcode == OP_JUMP_IF_FALSE ? OP_JUMP_IF_TRUE : OP_JUMP_IF_FALSE, jump->target);
+		jump->live = 0;
+		return 1;
+	} else if (constantValue(self, first, &value)) {
+		int taken = krk_isFalsey(value) == (opcode == OP_JUMP_IF_FALSE);
+		if (taken) {
+			size_t after = nextLive(self, jump->target);
+			rewriteJump(first, OP_JUMP, after);
+			if (after < self->count) self->instructions[after].isTarget = 1;
+			jump->live = 0;
+		} else {
+			if (self->instructions[k].isTarget) return 0;
+			first->live = 0;
+			jump->live = 0;
+			self->instructions[k].live = 0;
+		}
+		return 1;
+	}
+	return 0;
+}
+
+/* Point jumps that land on other jumps at their final destination. */
+static int threadJump(Optimizer * self, size_t i) {
+	Instruction * in = &self->instructions[i];
+	uint8_t opcode = opcodeOf(in);
+	int conditional = (opcode == OP_JUMP_IF_FALSE || opcode == OP_JUMP_IF_TRUE);
+	int popping = (opcode == OP_POP_JUMP_IF_FALSE || opcode == OP_POP_JUMP_IF_TRUE);
+	if (opcode != OP_JUMP && opcode != OP_LOOP && !conditional && !popping) return 0;
+
+	size_t target = in->target;
+	for (int hops = 0; hops < 16 && target < self->count; ++hops) {
+		Instruction * next = &self->instructions[target];
+		uint8_t nextOp = opcodeOf(next);
+		size_t follow;
+		if (nextOp == OP_JUMP || nextOp == OP_LOOP) {
+			follow = next->target;
+		} else if (conditional && nextOp == opcode) {
+			/* The same test on the same value will jump again. */
+			follow = next->target;
+		} else if (conditional && (nextOp == OP_JUMP_IF_FALSE || nextOp == OP_JUMP_IF_TRUE)) {
+			/* The opposite test on the same value will fall through. */
+			follow = nextLive(self, target);
+		} else {
+			break;
+		}
+		if (follow == target || follow == i) break;
+		/* Conditional jumps can only go forward. */
+		if ((conditional || popping) && follow <= i) break;
+		target = follow;
+	}
+
+	if (opcode == OP_JUMP && target == nextLive(self, i)) {
+		/* Jumping to the next instruction is a no-op; anything that jumped here goes on to it. */
+		for (size_t j = 0; j < self->count; ++j) {
+			if (self->instructions[j].live && isJump(opcodeOf(&self->instructions[j])) && self->instructions[j].target == i) {
+				self->instructions[j].target = target;
+			}
+		}
+		in->live = 0;
+		return 1;
+	}
+
+	if (target == in->target) return 0;
+	in->target = target;
+	if (target < self->count) self->instructions[target].isTarget = 1;
+	return 1;
+}
+
+/* Remove anything not reachable from the start of the function. */
+static int removeUnreachable(Optimizer * self) {
+	char * reached = calloc(self->count + 1, 1);
+	size_t * work = malloc(sizeof(size_t) * (self->count + 1 + self->function->chunk.handlersCount));
+	size_t pending = 0;
+	work[pending++] = nextLive(self, (size_t)-1);
+	for (size_t i = 0; i < self->function->chunk.handlersCount; ++i) {
+		work[pending++] = self->handlers[i * 3 + 2];
+	}
+	while (pending) {
+		size_t i = work[--pending];
+		while (i < self->count && !reached[i]) {
+			reached[i] = 1;
+			Instruction * in = &self->instructions[i];
+			uint8_t opcode = opcodeOf(in);
+			if (isJump(opcode) && in->target < self->count && !reached[in->target]) {
+				work[pending++] = in->target;
+			}
+			if (opcode == OP_JUMP || opcode == OP_LOOP || opcode == OP_RETURN || opcode == OP_RAISE) break;
+			i = nextLive(self, i);
+		}
+	}
+	int changed = 0;
+	for (size_t i = 0; i < self->count; ++i) {
+		if (self->instructions[i].live && !reached[i]) {
+			self->instructions[i].live = 0;
+			changed = 1;
+		}
+	}
+	free(work);
+	free(reached);
+	return changed;
+}
+
+/* Replace common instruction pairs with superinstructions. */
+static void fuseInstructions(Optimizer * self) {
+	for (size_t i = 0; i < self->count; ++i) {
+		Instruction * in = &self->instructions[i];
+		if (!in->live) continue;
+		size_t j = nextLive(self, i);
+		if (j >= self->count || self->instructions[j].isTarget) continue;
+		Instruction * next = &self->instructions[j];
+		/* Keep the line map as precise as it was. */
+		if (next->line != in->line) continue;
+		const uint8_t * a = bytesOf(in);
+		const uint8_t * b = bytesOf(next);
+		if ((a[0] == OP_SET_LOCAL || a[0] == OP_SET_LOCAL_LONG) && b[0] == OP_POP) {
+			rewrite(in, in->size, a[0] == OP_SET_LOCAL ? OP_SET_LOCAL_POP : OP_SET_LOCAL_POP_LONG, a[1], a[2], a[3]);
+			next->live = 0;
+		} else if (a[0] == OP_GET_LOCAL && b[0] == OP_GET_LOCAL) {
+			rewrite(in, 3, OP_GET_LOCAL_PAIR, a[1], b[1], 0);
+			next->live = 0;
+		} else if (a[0] == OP_GET_LOCAL && b[0] == OP_CONSTANT) {
+			rewrite(in, 3, OP_GET_LOCAL_CONSTANT, a[1], b[1], 0);
+			next->live = 0;
+		} else if ((a[0] == OP_JUMP_IF_FALSE || a[0] == OP_JUMP_IF_TRUE) && b[0] == OP_POP
+		           && in->target != j && isPop(self, in->target)) {
+			/* Both paths pop the condition, so pop it first and skip the target's POP. */
+			rewriteJump(in, a[0] == OP_JUMP_IF_FALSE ? OP_POP_JUMP_IF_FALSE : OP_POP_JUMP_IF_TRUE,
+				nextLive(self, in->target));
+			next->live = 0;
+		}
+	}
+}
+
+/* Write the instructions back into the chunk; returns 0 if a jump no longer fits. */
+static int encode(Optimizer * self) {
+	KrkChunk * chunk = &self->function->chunk;
+	size_t * newOffset = malloc(sizeof(size_t) * (self->count + 1));
+	size_t size = 0;
+	for (size_t i = 0; i < self->count; ++i) {
+		newOffset[i] = size;
+		if (self->instructions[i].live) size += self->instructions[i].size;
+	}
+	newOffset[self->count] = size;
+
+	uint8_t * code = malloc(size ? size : 1);
+	KrkLineMap * lines = malloc(sizeof(KrkLineMap) * (self->count + 1));
+	size_t linesCount = 0;
+	for (size_t i = 0; i < self->count; ++i) {
+		Instruction * in = &self->instructions[i];
+		if (!in->live) continue;
+		uint8_t * out = &code[newOffset[i]];
+		memcpy(out, bytesOf(in), in->size);
+		uint8_t opcode = out[0];
+		if (isJump(opcode)) {
+			size_t from = newOffset[i] + 3;
+			size_t to = newOffset[in->target];
+			size_t distance;
+			if (to >= from) {
+				if (opcode == OP_LOOP) out[0] = OP_JUMP;
+				distance = to - from;
+			} else if (opcode == OP_JUMP || opcode == OP_LOOP) {
+				out[0] = OP_LOOP;
+				distance = from - to;
+			} else {
+				distance = 0x10000;
+			}
+			if (distance > 0xFFFF) {
+				free(newOffset);
+				free(code);
+				free(lines);
+				return 0;
+			}
+			out[1] = distance >> 8;
+			out[2] = distance;
+		}
+		if (!linesCount || lines[linesCount-1].line != in->line) {
+			lines[linesCount++] = (KrkLineMap){newOffset[i], in->line};
+		}
+	}
+
+	/* Local names and handlers refer to offsets; anything removed maps to what followed it. */
+	size_t * remap = malloc(sizeof(size_t) * (chunk->count + 1));
+	size_t mapped = self->count;
+	size_t at = chunk->count;
+	remap[at] = size;
+	for (size_t i = self->count; i > 0; --i) {
+		Instruction * in = &self->instructions[i-1];
+		if (in->live) mapped = i - 1;
+		size_t value = mapped == self->count ? size : newOffset[mapped];
+		while (at > in->offset) remap[--at] = value;
+	}
+	for (size_t i = 0; i < self->function->localNameCount; ++i) {
+		KrkLocalEntry * entry = &self->function->localNames[i];
+		if (entry->birthday <= chunk->count) entry->birthday = remap[entry->birthday];
+		if (entry->deathday <= chunk->count) entry->deathday = remap[entry->deathday];
+	}
+	for (size_t i = 0; i < chunk->handlersCount; ++i) {
+		KrkExceptionHandler * handler = &chunk->handlers[i];
+		handler->startOffset = remap[handler->startOffset];
+		handler->endOffset = remap[handler->endOffset];
+		handler->target = remap[handler->target];
+	}
+	free(remap);
+
+	if (size > chunk->capacity) {
+		chunk->code = GROW_ARRAY(uint8_t, chunk->code, chunk->capacity, size);
+		chunk->capacity = size;
+	}
+	memcpy(chunk->code, code, size);
+	chunk->count = size;
+	if (linesCount > chunk->linesCapacity) {
+		chunk->lines = GROW_ARRAY(KrkLineMap, chunk->lines, chunk->linesCapacity, linesCount);
+		chunk->linesCapacity = linesCount;
+	}
+	memcpy(chunk->lines, lines, sizeof(KrkLineMap) * linesCount);
+	chunk->linesCount = linesCount;
+
+	free(lines);
+	free(code);
+	free(newOffset);
+	return 1;
+}
+
+void krk_optimizeFunction(KrkFunction * function) {
+	Optimizer self = {function, 0, NULL, NULL};
+	if (!decode(&self)) goto _done;
+
+	int changed;
+	int rounds = 0;
+	if (vm.globalFlags & KRK_ENABLE_OPTIMIZER) do {
+		changed = 0;
+		markTargets(&self);
+		for (size_t i = 0; i < self.count; ++i) {
+			if (!self.instructions[i].live) continue;
+			changed |= foldConstants(&self, i);
+			changed |= foldCondition(&self, i);
+			if (self.instructions[i].live) changed |= threadJump(&self, i);
+		}
+		changed |= removeUnreachable(&self);
+	} while (changed && ++rounds < 8);
+
+	markTargets(&self);
+	fuseInstructions(&self);
+
+	/* Fused jumps skip their target's POP, which may no longer be reachable. */
+	removeUnreachable(&self);
+	for (size_t i = 0; i < self.count; ++i) {
+		if (self.instructions[i].live && opcodeOf(&self.instructions[i]) == OP_JUMP) threadJump(&self, i);
+	}
+
+	encode(&self);
+
+_done:
+	free(self.instructions);
+	free(self.handlers);
+}
@@ -543,7 +543,7 @@ char * syn_krk_keywords[] = {
 	"and","class","def","else","for","if","in","import","del",
 	"let","not","or","return","while","try","except","raise",
 	"continue","break","as","from","elif","lambda","with","is",
-	"pass",
+	"pass","yield",
 	NULL
 };
 
@@ -567,7 +567,7 @@ char * syn_krk_special[] = {
 char * syn_krk_exception[] = {
 	"TypeError","ArgumentError","IndexError","KeyError","AttributeError",
 	"NameError","ImportError","IOError","ValueError","KeyboardInterrupt",
-	"ZeroDivisionError","SyntaxError","Exception",
+	"ZeroDivisionError","SyntaxError","MemoryError","Exception",
 	NULL
 };
 
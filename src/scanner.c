@@ -5,9 +5,46 @@
 #include "kuroko.h"
 #include "scanner.h"
 
-static KrkScanner scanner;
-
-void krk_initScanner(const char * src) {
+/*
+ * Character classes, indexed by byte. The scanner's loops over runs of
+ * spaces, digits and identifier characters test one table entry per byte,
+ * and the terminating NUL has no class, so they stop at the end of the
+ * source without checking for it separately. Bytes above 0x7F are taken
+ * to be parts of UTF-8 identifiers.
+ */
+#define CHAR_SPACE 0x01
+#define CHAR_DIGIT 0x02
+#define CHAR_ALPHA 0x04
+#define CHAR_HEX   0x08
+#define SP CHAR_SPACE
+#define DH (CHAR_DIGIT | CHAR_HEX)
+#define AL CHAR_ALPHA
+#define AH (CHAR_ALPHA | CHAR_HEX)
+static const unsigned char charClass[256] = {
+	 0,  0,  0,  0,  0,  0,  0,  0,  0, SP,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	SP,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	DH, DH, DH, DH, DH, DH, DH, DH, DH, DH,  0,  0,  0,  0,  0,  0,
+	 0, AH, AH, AH, AH, AH, AH, AL, AL, AL, AL, AL, AL, AL, AL, AL,
+	AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL,  0,  0,  0,  0, AL,
+	 0, AH, AH, AH, AH, AH, AH, AL, AL, AL, AL, AL, AL, AL, AL, AL,
+	AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL,  0,  0,  0,  0,  0,
+	AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL,
+	AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL,
+	AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL,
+	AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL,
+	AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL,
+	AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL,
+	AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL,
+	AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL, AL,
+};
+#undef SP
+#undef DH
+#undef AL
+#undef AH
+
+KrkScanner krk_initScanner(const char * src) {
+	KrkScanner scanner;
 	scanner.start = src;
 	scanner.cur   = src;
 	scanner.line  = 1;
@@ -15,350 +52,345 @@ void krk_initScanner(const char * src) {
 	scanner.startOfLine = 1;
 	scanner.hasUnget = 0;
 	/* file, etc. ? */
+	return scanner;
 }
 
-static int isAtEnd() {
-	return *scanner.cur == '\0';
+static int isAtEnd(KrkScanner * scanner) {
+	return *scanner->cur == '\0';
 }
 
-static void nextLine() {
-	scanner.line++;
-	scanner.linePtr = scanner.cur;
+static void nextLine(KrkScanner * scanner) {
+	scanner->line++;
+	scanner->linePtr = scanner->cur;
 }
 
-static KrkToken makeToken(KrkTokenType type) {
+static KrkToken makeToken(KrkScanner * scanner, KrkTokenType type) {
 	return (KrkToken){
 		.type = type,
-		.start = scanner.start,
-		.length = (type == TOKEN_EOL) ? 0 : (size_t)(scanner.cur - scanner.start),
-		.line = scanner.line,
-		.linePtr = scanner.linePtr,
-		.literalWidth = (type == TOKEN_EOL) ? 0 : (size_t)(scanner.cur - scanner.start),
-		.col = (scanner.start - scanner.linePtr) + 1,
+		.start = scanner->start,
+		.length = (type == TOKEN_EOL) ? 0 : (size_t)(scanner->cur - scanner->start),
+		.line = scanner->line,
+		.linePtr = scanner->linePtr,
+		.literalWidth = (type == TOKEN_EOL) ? 0 : (size_t)(scanner->cur - scanner->start),
+		.col = (scanner->start - scanner->linePtr) + 1,
 	};
 }
 
-static KrkToken errorToken(const char * errorStr) {
-	ssize_t column = (scanner.linePtr < scanner.start) ? scanner.start - scanner.linePtr : 0;
-	ssize_t width  = (scanner.start   < scanner.cur)   ? scanner.cur - scanner.start : 0;
+static KrkToken errorToken(KrkScanner * scanner, const char * errorStr) {
+	ssize_t column = (scanner->linePtr < scanner->start) ? scanner->start - scanner->linePtr : 0;
+	ssize_t width  = (scanner->start   < scanner->cur)   ? scanner->cur - scanner->start : 0;
 	return (KrkToken){
 		.type = TOKEN_ERROR,
 		.start = errorStr,
 		.length = strlen(errorStr),
-		.line = scanner.line,
-		.linePtr = scanner.linePtr,
+		.line = scanner->line,
+		.linePtr = scanner->linePtr,
 		.literalWidth = (size_t)(width),
 		.col = column + 1,
 	};
 }
 
-static char advance() {
-	return (*scanner.cur == '\0') ? '\0' : *(scanner.cur++);
+static char advance(KrkScanner * scanner) {
+	return (*scanner->cur == '\0') ? '\0' : *(scanner->cur++);
 }
 
-static int match(char expected) {
-	if (isAtEnd()) return 0;
-	if (*scanner.cur != expected) return 0;
-	scanner.cur++;
+static int match(KrkScanner * scanner, char expected) {
+	if (isAtEnd(scanner)) return 0;
+	if (*scanner->cur != expected) return 0;
+	scanner->cur++;
 	return 1;
 }
 
-static char peek() {
-	return *scanner.cur;
+static char peek(KrkScanner * scanner) {
+	return *scanner->cur;
 }
 
-static char peekNext(int n) {
-	if (isAtEnd()) return '\0';
-	for (int i = 0; i < n; ++i) if (scanner.cur[i] == '\0') return '\0';
-	return scanner.cur[n];
+static char peekNext(KrkScanner * scanner, int n) {
+	if (isAtEnd(scanner)) return '\0';
+	for (int i = 0; i < n; ++i) if (scanner->cur[i] == '\0') return '\0';
+	return scanner->cur[n];
 }
 
-static void skipWhitespace() {
-	for (;;) {
-		char c = peek();
-		switch (c) {
-			case ' ':
-			case '\t':
-				advance();
-				break;
-			default:
-				return;
-		}
-	}
+static void skipWhitespace(KrkScanner * scanner) {
+	const char * cur = scanner->cur;
+	while (charClass[(unsigned char)*cur] & CHAR_SPACE) cur++;
+	scanner->cur = cur;
 }
 
-static KrkToken makeIndentation() {
-	char reject = (peek() == ' ') ? '\t' : ' ';
-	while (!isAtEnd() && (peek() == ' ' || peek() == '\t')) advance();
-	if (isAtEnd()) return makeToken(TOKEN_EOF);
-	for (const char * start = scanner.start; start < scanner.cur; start++) {
-		if (*start == reject) return errorToken("Invalid mix of indentation.");
+/* Move to the end of the line, leaving the line feed. */
+static void skipToLineEnd(KrkScanner * scanner) {
+	const char * cur = scanner->cur;
+	while (*cur && *cur != '\n') cur++;
+	scanner->cur = cur;
+}
+
+static KrkToken makeIndentation(KrkScanner * scanner) {
+	char reject = (peek(scanner) == ' ') ? '\t' : ' ';
+	skipWhitespace(scanner);
+	if (isAtEnd(scanner)) return makeToken(scanner, TOKEN_EOF);
+	for (const char * start = scanner->start; start < scanner->cur; start++) {
+		if (*start == reject) return errorToken(scanner, "Invalid mix of indentation.");
 	}
-	KrkToken out = makeToken(TOKEN_INDENTATION);
+	KrkToken out = makeToken(scanner, TOKEN_INDENTATION);
 	if (reject == ' ') out.length *= 8;
-	if (peek() == '#') {
+	if (peek(scanner) == '#') {
 		/* Skip the entirety of the comment but not the line feed */
-		while (!isAtEnd() && peek() != '\n') advance();
+		skipToLineEnd(scanner);
 	}
 	return out;
 }
 
-static KrkToken string(char quoteMark) {
-	if (peek() == quoteMark && peekNext(1) == quoteMark) {
-		advance(); advance();
+static KrkToken string(KrkScanner * scanner, char quoteMark) {
+	if (peek(scanner) == quoteMark && peekNext(scanner, 1) == quoteMark) {
+		advance(scanner); advance(scanner);
 		/* Big string */
-		while (!isAtEnd()) {
-			if (peek() == quoteMark && peekNext(1) == quoteMark && peekNext(2) == quoteMark) {
-				advance();
-				advance();
-				advance();
-				return makeToken(TOKEN_BIG_STRING);
+		while (!isAtEnd(scanner)) {
+			if (peek(scanner) == quoteMark && peekNext(scanner, 1) == quoteMark && peekNext(scanner, 2) == quoteMark) {
+				advance(scanner);
+				advance(scanner);
+				advance(scanner);
+				return makeToken(scanner, TOKEN_BIG_STRING);
 			}
 
-			if (peek() == '\\') advance();
-			if (peek() == '\n') {
-				advance();
-				nextLine();
+			if (peek(scanner) == '\\') advance(scanner);
+			if (peek(scanner) == '\n') {
+				advance(scanner);
+				nextLine(scanner);
 			}
-			else advance();
+			else advance(scanner);
 		}
-		if (isAtEnd()) return errorToken("Unterminated string?");
+		if (isAtEnd(scanner)) return errorToken(scanner, "Unterminated string?");
 	}
-	while (peek() != quoteMark && !isAtEnd()) {
-		if (peek() == '\n') return errorToken("Unterminated string.");
-		if (peek() == '\\') advance();
-		if (peek() == '\n') {
-			advance();
-			nextLine();
+	while (peek(scanner) != quoteMark && !isAtEnd(scanner)) {
+		if (peek(scanner) == '\n') return errorToken(scanner, "Unterminated string.");
+		if (peek(scanner) == '\\') advance(scanner);
+		if (peek(scanner) == '\n') {
+			advance(scanner);
+			nextLine(scanner);
 		}
-		else advance();
+		else advance(scanner);
 	}
 
-	if (isAtEnd()) return errorToken("Unterminated string.");
+	if (isAtEnd(scanner)) return errorToken(scanner, "Unterminated string.");
 
-	assert(peek() == quoteMark);
-	advance();
+	assert(peek(scanner) == quoteMark);
+	advance(scanner);
 
-	return makeToken(TOKEN_STRING);
+	return makeToken(scanner, TOKEN_STRING);
 }
 
 static int isDigit(char c) {
-	return c >= '0' && c <= '9';
+	return charClass[(unsigned char)c] & CHAR_DIGIT;
 }
 
-static KrkToken number(char c) {
+static int isHexDigit(char c) {
+	return charClass[(unsigned char)c] & CHAR_HEX;
+}
+
+static KrkToken number(KrkScanner * scanner, char c) {
 	if (c == '0') {
-		if (peek() == 'x' || peek() == 'X') {
+		if (peek(scanner) == 'x' || peek(scanner) == 'X') {
 			/* Hexadecimal */
-			advance();
-			while (isDigit(peek()) || (peek() >= 'a' && peek() <= 'f') ||
-			       (peek() >= 'A' && peek() <= 'F')) advance();
-			return makeToken(TOKEN_NUMBER);
-		} else if (peek() == 'b' || peek() == 'B') {
+			advance(scanner);
+			while (isHexDigit(peek(scanner))) advance(scanner);
+			return makeToken(scanner, TOKEN_NUMBER);
+		} else if (peek(scanner) == 'b' || peek(scanner) == 'B') {
 			/* Binary */
-			advance();
-			while (peek() == '0' || peek() == '1') advance();
-			return makeToken(TOKEN_NUMBER);
-		} if (peek() == 'o' || peek() == 'O') {
+			advance(scanner);
+			while (peek(scanner) == '0' || peek(scanner) == '1') advance(scanner);
+			return makeToken(scanner, TOKEN_NUMBER);
+		} if (peek(scanner) == 'o' || peek(scanner) == 'O') {
 			/* Octal - must be 0o, none of those silly 0123 things */
-			advance();
-			while (peek() >= '0' && peek() <= '7') advance();
-			return makeToken(TOKEN_NUMBER);
+			advance(scanner);
+			while (peek(scanner) >= '0' && peek(scanner) <= '7') advance(scanner);
+			return makeToken(scanner, TOKEN_NUMBER);
 		}
 		/* Otherwise, decimal and maybe 0.123 floating */
 	}
 
 	/* Decimal */
-	while (isDigit(peek())) advance();
+	while (isDigit(peek(scanner))) advance(scanner);
 
 	/* Floating point */
-	if (peek() == '.' && isDigit(peekNext(1))) {
-		advance();
-		while (isDigit(peek())) advance();
+	if (peek(scanner) == '.' && isDigit(peekNext(scanner, 1))) {
+		advance(scanner);
+		while (isDigit(peek(scanner))) advance(scanner);
 	}
 
-	return makeToken(TOKEN_NUMBER);
+	return makeToken(scanner, TOKEN_NUMBER);
 }
 
 static int isAlpha(char c) {
-	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c == '_');
-}
-
-static int checkKeyword(size_t start, const char * rest, KrkTokenType type) {
-	size_t length = strlen(rest);
-	if ((size_t)(scanner.cur - scanner.start) == start + length &&
-		memcmp(scanner.start + start, rest, length) == 0) return type;
-	return TOKEN_IDENTIFIER;
+	return charClass[(unsigned char)c] & CHAR_ALPHA;
 }
 
-static KrkTokenType identifierType() {
-#define MORE(i) (scanner.cur - scanner.start > i)
-	switch (*scanner.start) {
-		case 'a': if (MORE(1)) switch(scanner.start[1]) {
-			case 'n': return checkKeyword(2, "d", TOKEN_AND);
-			case 's': return checkKeyword(2, "", TOKEN_AS);
-		} break;
-		case 'b': if (MORE(1)) return checkKeyword(1, "reak", TOKEN_BREAK);
-			else if (scanner.start[1] == '\'' || scanner.start[1] == '"') return TOKEN_PREFIX_B;
-			break;
-		case 'c': if (MORE(1)) switch(scanner.start[1]) {
-			case 'l': return checkKeyword(2, "ass", TOKEN_CLASS);
-			case 'o': return checkKeyword(2, "ntinue", TOKEN_CONTINUE);
-		} break;
-		case 'd': if (MORE(1)) switch(scanner.start[1]) {
-			case 'e': if (MORE(2)) switch (scanner.start[2]) {
-				case 'f': return checkKeyword(3, "", TOKEN_DEF);
-				case 'l': return checkKeyword(3, "", TOKEN_DEL);
-			} break;
-		} break;
-		case 'e': if (MORE(1)) switch(scanner.start[1]) {
-			case 'l': if (MORE(2)) switch(scanner.start[2]) {
-				case 's': return checkKeyword(3,"e", TOKEN_ELSE);
-				case 'i': return checkKeyword(3,"f", TOKEN_ELIF);
-			} break;
-			case 'x': return checkKeyword(2, "cept", TOKEN_EXCEPT);
-		} break;
-		case 'f': if (MORE(1)) switch(scanner.start[1]) {
-			case 'o': return checkKeyword(2, "r", TOKEN_FOR);
-			case 'r': return checkKeyword(2, "om", TOKEN_FROM);
-		} else if (scanner.start[1] == '\'' || scanner.start[1] == '"') return TOKEN_PREFIX_F;
-		break;
-		case 'F': return checkKeyword(1, "alse", TOKEN_FALSE);
-		case 'i': if (MORE(1)) switch (scanner.start[1]) {
-			case 'f': return checkKeyword(2, "", TOKEN_IF);
-			case 'n': return checkKeyword(2, "", TOKEN_IN);
-			case 'm': return checkKeyword(2, "port", TOKEN_IMPORT);
-			case 's': return checkKeyword(2, "", TOKEN_IS);
-		} break;
-		case 'l': if (MORE(1)) switch (scanner.start[1]) {
-			case 'a': return checkKeyword(2, "mbda", TOKEN_LAMBDA);
-			case 'e': return checkKeyword(2, "t", TOKEN_LET);
-		} break;
-		case 'n': return checkKeyword(1, "ot", TOKEN_NOT);
-		case 'N': return checkKeyword(1, "one", TOKEN_NONE);
-		case 'o': return checkKeyword(1, "r", TOKEN_OR);
-		case 'p': return checkKeyword(1, "ass", TOKEN_PASS);
-		case 'r': if (MORE(1)) switch (scanner.start[1]) {
-			case 'e': return checkKeyword(2, "turn", TOKEN_RETURN);
-			case 'a': return checkKeyword(2, "ise", TOKEN_RAISE);
-		} break;
-		case 's': if (MORE(1)) switch(scanner.start[1]) {
-			case 'e': return checkKeyword(2, "lf", TOKEN_SELF);
-			case 'u': return checkKeyword(2, "per", TOKEN_SUPER);
-		} break;
-		case 't': return checkKeyword(1, "ry", TOKEN_TRY);
-		case 'T': return checkKeyword(1, "rue", TOKEN_TRUE);
-		case 'w': if (MORE(1)) switch(scanner.start[1]) {
-			case 'h': return checkKeyword(2, "ile", TOKEN_WHILE);
-			case 'i': return checkKeyword(2, "th", TOKEN_WITH);
-		} break;
+/*
+ * Keywords, in a perfect hash table: every keyword lands in its own slot
+ * under KEYWORD_HASH, so an identifier is checked against at most one of
+ * them. All keywords are between two and eight characters long. If the
+ * list changes, search for new multipliers that keep the slots distinct.
+ */
+#define KEYWORD_HASH(s,l) (((unsigned char)(s)[0] * 41 + (unsigned char)(s)[1] * 38 + (unsigned char)(s)[(l)-1] + (l)) & 63)
+static const struct {
+	const char * name;
+	size_t length;
+	KrkTokenType type;
+} keywords[64] = {
+	[0] = {"super", 5, TOKEN_SUPER},
+	[1] = {"let", 3, TOKEN_LET},
+	[2] = {"continue", 8, TOKEN_CONTINUE},
+	[4] = {"and", 3, TOKEN_AND},
+	[5] = {"for", 3, TOKEN_FOR},
+	[6] = {"False", 5, TOKEN_FALSE},
+	[9] = {"True", 4, TOKEN_TRUE},
+	[13] = {"pass", 4, TOKEN_PASS},
+	[14] = {"break", 5, TOKEN_BREAK},
+	[15] = {"not", 3, TOKEN_NOT},
+	[16] = {"as", 2, TOKEN_AS},
+	[17] = {"with", 4, TOKEN_WITH},
+	[18] = {"raise", 5, TOKEN_RAISE},
+	[19] = {"self", 4, TOKEN_SELF},
+	[21] = {"in", 2, TOKEN_IN},
+	[24] = {"is", 2, TOKEN_IS},
+	[25] = {"lambda", 6, TOKEN_LAMBDA},
+	[27] = {"class", 5, TOKEN_CLASS},
+	[29] = {"if", 2, TOKEN_IF},
+	[30] = {"else", 4, TOKEN_ELSE},
+	[31] = {"elif", 4, TOKEN_ELIF},
+	[32] = {"yield", 5, TOKEN_YIELD},
+	[33] = {"None", 4, TOKEN_NONE},
+	[39] = {"or", 2, TOKEN_OR},
+	[41] = {"while", 5, TOKEN_WHILE},
+	[43] = {"def", 3, TOKEN_DEF},
+	[49] = {"del", 3, TOKEN_DEL},
+	[51] = {"from", 4, TOKEN_FROM},
+	[52] = {"return", 6, TOKEN_RETURN},
+	[55] = {"except", 6, TOKEN_EXCEPT},
+	[57] = {"import", 6, TOKEN_IMPORT},
+	[60] = {"try", 3, TOKEN_TRY},
+};
+
+static KrkTokenType identifierType(KrkScanner * scanner) {
+	size_t length = scanner->cur - scanner->start;
+	if (length == 1) {
+		/* String prefixes; the quote is the next character, not part of the token */
+		if (*scanner->cur == '\'' || *scanner->cur == '"') {
+			if (*scanner->start == 'b') return TOKEN_PREFIX_B;
+			if (*scanner->start == 'f') return TOKEN_PREFIX_F;
+		}
+		return TOKEN_IDENTIFIER;
 	}
+	if (length > 8) return TOKEN_IDENTIFIER;
+	unsigned int slot = KEYWORD_HASH(scanner->start, length);
+	if (keywords[slot].length == length && !memcmp(keywords[slot].name, scanner->start, length)) return keywords[slot].type;
 	return TOKEN_IDENTIFIER;
 }
 
-static KrkToken identifier() {
-	while (isAlpha(peek()) || isDigit(peek()) || (unsigned char)peek() > 0x7F) advance();
+static KrkToken identifier(KrkScanner * scanner) {
+	const char * cur = scanner->cur;
+	while (charClass[(unsigned char)*cur] & (CHAR_ALPHA | CHAR_DIGIT)) cur++;
+	scanner->cur = cur;
 
-	return makeToken(identifierType());
+	return makeToken(scanner, identifierType(scanner));
 }
 
-void krk_ungetToken(KrkToken token) {
-	if (scanner.hasUnget) {
+void krk_ungetToken(KrkScanner * scanner, KrkToken token) {
+	if (scanner->hasUnget) {
 		fprintf(stderr, "(internal error) Tried to unget multiple times, this is not valid.\n");
 		exit(1);
 	}
-	scanner.hasUnget = 1;
-	scanner.unget = token;
+	scanner->hasUnget = 1;
+	scanner->unget = token;
 }
 
-void krk_rewindScanner(KrkScanner to) {
-	scanner = to;
+void krk_rewindScanner(KrkScanner * scanner, KrkScanner to) {
+	*scanner = to;
 }
 
-KrkScanner krk_tellScanner(void) {
-	return scanner;
+KrkScanner krk_tellScanner(KrkScanner * scanner) {
+	return *scanner;
 }
 
-KrkToken krk_scanToken() {
+KrkToken krk_scanToken(KrkScanner * scanner) {
 
-	if (scanner.hasUnget) {
-		scanner.hasUnget = 0;
-		return scanner.unget;
+	if (scanner->hasUnget) {
+		scanner->hasUnget = 0;
+		return scanner->unget;
 	}
 
 	/* If at start of line, do thing */
-	if (scanner.startOfLine && (peek() == ' ' || peek() == '\t')) {
-		scanner.start = scanner.cur;
-		scanner.startOfLine = 0;
-		return makeIndentation();
+	if (scanner->startOfLine && (peek(scanner) == ' ' || peek(scanner) == '\t')) {
+		scanner->start = scanner->cur;
+		scanner->startOfLine = 0;
+		return makeIndentation(scanner);
 	}
 
 	/* Eat whitespace */
-	skipWhitespace();
+	skipWhitespace(scanner);
 
 	/* Skip comments */
-	if (peek() == '#') while (peek() != '\n' && !isAtEnd()) advance();
+	if (peek(scanner) == '#') skipToLineEnd(scanner);
 
-	scanner.start = scanner.cur;
-	if (isAtEnd()) return makeToken(TOKEN_EOF);
+	scanner->start = scanner->cur;
+	if (isAtEnd(scanner)) return makeToken(scanner, TOKEN_EOF);
 
-	char c = advance();
+	char c = advance(scanner);
 
 	if (c == '\n') {
 		KrkToken out;
-		if (scanner.startOfLine) {
+		if (scanner->startOfLine) {
 			/* Ignore completely blank lines */
-			out = makeToken(TOKEN_RETRY);
+			out = makeToken(scanner, TOKEN_RETRY);
 		} else {
-			scanner.startOfLine = 1;
-			out = makeToken(TOKEN_EOL);
+			scanner->startOfLine = 1;
+			out = makeToken(scanner, TOKEN_EOL);
 		}
-		nextLine();
+		nextLine(scanner);
 		return out;
 	}
 
-	if (c == '\\' && peek() == '\n') {
-		advance();
-		nextLine();
-		return makeToken(TOKEN_RETRY);
+	if (c == '\\' && peek(scanner) == '\n') {
+		advance(scanner);
+		nextLine(scanner);
+		return makeToken(scanner, TOKEN_RETRY);
 	}
 
 	/* Not indentation, not a linefeed on an empty line, must be not be start of line any more */
-	scanner.startOfLine = 0;
+	scanner->startOfLine = 0;
 
-	if (isAlpha(c) || (unsigned char)c > 0x7F) return identifier();
-	if (isDigit(c)) return number(c);
+	if (isAlpha(c)) return identifier(scanner);
+	if (isDigit(c)) return number(scanner, c);
 
 	switch (c) {
-		case '(': return makeToken(TOKEN_LEFT_PAREN);
-		case ')': return makeToken(TOKEN_RIGHT_PAREN);
-		case '{': return makeToken(TOKEN_LEFT_BRACE);
-		case '}': return makeToken(TOKEN_RIGHT_BRACE);
-		case '[': return makeToken(TOKEN_LEFT_SQUARE);
-		case ']': return makeToken(TOKEN_RIGHT_SQUARE);
-		case ':': return makeToken(TOKEN_COLON);
-		case ',': return makeToken(TOKEN_COMMA);
-		case '.': return makeToken(TOKEN_DOT);
-		case ';': return makeToken(TOKEN_SEMICOLON);
-		case '@': return makeToken(TOKEN_AT);
-		case '~': return makeToken(TOKEN_TILDE);
-
-		case '!': return makeToken(match('=') ? TOKEN_BANG_EQUAL    : TOKEN_BANG);
-		case '=': return makeToken(match('=') ? TOKEN_EQUAL_EQUAL   : TOKEN_EQUAL);
-		case '<': return makeToken(match('=') ? TOKEN_LESS_EQUAL    : (match('<') ? (match('=') ? TOKEN_LSHIFT_EQUAL : TOKEN_LEFT_SHIFT) :  TOKEN_LESS));
-		case '>': return makeToken(match('=') ? TOKEN_GREATER_EQUAL : (match('>') ? (match('=') ? TOKEN_RSHIFT_EQUAL : TOKEN_RIGHT_SHIFT) : TOKEN_GREATER));
-		case '-': return makeToken(match('=') ? TOKEN_MINUS_EQUAL   : (match('-') ? TOKEN_MINUS_MINUS : TOKEN_MINUS));
-		case '+': return makeToken(match('=') ? TOKEN_PLUS_EQUAL    : (match('+') ? TOKEN_PLUS_PLUS   : TOKEN_PLUS));
-		case '^': return makeToken(match('=') ? TOKEN_CARET_EQUAL   : TOKEN_CARET);
-		case '|': return makeToken(match('=') ? TOKEN_PIPE_EQUAL    : TOKEN_PIPE);
-		case '&': return makeToken(match('=') ? TOKEN_AMP_EQUAL     : TOKEN_AMPERSAND);
-		case '/': return makeToken(match('=') ? TOKEN_SOLIDUS_EQUAL : TOKEN_SOLIDUS);
-		case '*': return makeToken(match('=') ? TOKEN_ASTERISK_EQUAL: (match('*') ? (match('=') ? TOKEN_POW_EQUAL : TOKEN_POW) : TOKEN_ASTERISK));
-		case '%': return makeToken(match('=') ? TOKEN_MODULO_EQUAL  : TOKEN_MODULO);
-
-		case '"': return string('"');
-		case '\'': return string('\'');
+		case '(': return makeToken(scanner, TOKEN_LEFT_PAREN);
+		case ')': return makeToken(scanner, TOKEN_RIGHT_PAREN);
+		case '{': return makeToken(scanner, TOKEN_LEFT_BRACE);
+		case '}': return makeToken(scanner, TOKEN_RIGHT_BRACE);
+		case '[': return makeToken(scanner, TOKEN_LEFT_SQUARE);
+		case ']': return makeToken(scanner, TOKEN_RIGHT_SQUARE);
+		case ':': return makeToken(scanner, TOKEN_COLON);
+		case ',': return makeToken(scanner, TOKEN_COMMA);
+		case '.': return makeToken(scanner, TOKEN_DOT);
+		case ';': return makeToken(scanner, TOKEN_SEMICOLON);
+		case '@': return makeToken(scanner, TOKEN_AT);
+		case '~': return makeToken(scanner, TOKEN_TILDE);
+
+		case '!': return makeToken(scanner, match(scanner, '=') ? TOKEN_BANG_EQUAL    : TOKEN_BANG);
+		case '=': return makeToken(scanner, match(scanner, '=') ? TOKEN_EQUAL_EQUAL   : TOKEN_EQUAL);
+		case '<': return makeToken(scanner, match(scanner, '=') ? TOKEN_LESS_EQUAL    : (match(scanner, '<') ? (match(scanner, '=') ? TOKEN_LSHIFT_EQUAL : TOKEN_LEFT_SHIFT) :  TOKEN_LESS));
+		case '>': return makeToken(scanner, match(scanner, '=') ? TOKEN_GREATER_EQUAL : (match(scanner, '>') ? (match(scanner, '=') ? TOKEN_RSHIFT_EQUAL : TOKEN_RIGHT_SHIFT) : TOKEN_GREATER));
+		case '-': return makeToken(scanner, match(scanner, '=') ? TOKEN_MINUS_EQUAL   : (match(scanner, '-') ? TOKEN_MINUS_MINUS : TOKEN_MINUS));
+		case '+': return makeToken(scanner, match(scanner, '=') ? TOKEN_PLUS_EQUAL    : (match(scanner, '+') ? TOKEN_PLUS_PLUS   : TOKEN_PLUS));
+		case '^': return makeToken(scanner, match(scanner, '=') ? TOKEN_CARET_EQUAL   : TOKEN_CARET);
+		case '|': return makeToken(scanner, match(scanner, '=') ? TOKEN_PIPE_EQUAL    : TOKEN_PIPE);
+		case '&': return makeToken(scanner, match(scanner, '=') ? TOKEN_AMP_EQUAL     : TOKEN_AMPERSAND);
+		case '/': return makeToken(scanner, match(scanner, '=') ? TOKEN_SOLIDUS_EQUAL : TOKEN_SOLIDUS);
+		case '*': return makeToken(scanner, match(scanner, '=') ? TOKEN_ASTERISK_EQUAL: (match(scanner, '*') ? (match(scanner, '=') ? TOKEN_POW_EQUAL : TOKEN_POW) : TOKEN_ASTERISK));
+		case '%': return makeToken(scanner, match(scanner, '=') ? TOKEN_MODULO_EQUAL  : TOKEN_MODULO);
+
+		case '"': return string(scanner, '"');
+		case '\'': return string(scanner, '\'');
 	}
 
-	return errorToken("Unexpected character.");
+	return errorToken(scanner, "Unexpected character.");
 }
@@ -87,6 +87,7 @@ typedef enum {
 	TOKEN_FROM,
 	TOKEN_LAMBDA,
 	TOKEN_WITH,
+	TOKEN_YIELD,
 
 	TOKEN_PREFIX_B,
 	TOKEN_PREFIX_F,
@@ -119,8 +120,8 @@ typedef struct {
 	KrkToken unget;
 } KrkScanner;
 
-extern void krk_initScanner(const char * src);
-extern KrkToken krk_scanToken(void);
-extern void krk_ungetToken(KrkToken token);
-extern void krk_rewindScanner(KrkScanner to);
-extern KrkScanner krk_tellScanner(void);
+extern KrkScanner krk_initScanner(const char * src);
+extern KrkToken krk_scanToken(KrkScanner * scanner);
+extern void krk_ungetToken(KrkScanner * scanner, KrkToken token);
+extern void krk_rewindScanner(KrkScanner * scanner, KrkScanner to);
+extern KrkScanner krk_tellScanner(KrkScanner * scanner);
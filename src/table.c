@@ -6,6 +6,7 @@
 #include "memory.h"
 #include "table.h"
 #include "vm.h"
+#include "util.h"
 
 #define TABLE_MAX_LOAD 0.75
 
@@ -22,27 +23,72 @@ void krk_freeTable(KrkTable * table) {
 
 static uint32_t hashTupleValues(KrkTuple *tuple);
 
-static uint32_t hashValue(KrkValue value) {
-	if (IS_STRING(value)) return (AS_STRING(value))->hash;
+/**
+ * Instances of classes that provide __hash__ are hashed by calling it;
+ * tuples cache their hash on first use, as they can not change afterwards.
+ * Anything else that isn't a value type is hashed by identity.
+ */
+uint32_t krk_hashValue(KrkValue value) {
+	if (IS_STRING(value)) {
+		KrkString * string = AS_STRING(value);
+		if (!(string->flags & KRK_STRING_FLAG_HASHED)) krk_stringUpdateHash(string);
+		return string->hash;
+	}
 	if (IS_INTEGER(value)) return (uint32_t)(AS_INTEGER(value));
 	if (IS_FLOATING(value)) return (uint32_t)(AS_FLOATING(value) * 1000); /* arbitrary; what's a good way to hash floats? */
 	if (IS_BOOLEAN(value)) return (uint32_t)(AS_BOOLEAN(value));
 	if (IS_NONE(value)) return 0;
 	if (IS_BYTES(value)) return (AS_BYTES(value))->hash; /* Same as strings, but we don't have an interning table */
-	if (IS_TUPLE(value)) return hashTupleValues(AS_TUPLE(value));
+	if (IS_TUPLE(value)) {
+		KrkTuple * tuple = AS_TUPLE(value);
+		if (tuple->hash != (uint32_t)-1) return tuple->hash;
+		uint32_t hash = hashTupleValues(tuple);
+		/* Don't keep a hash if one of the elements failed to produce one. */
+		if (!(krk_currentThread.flags & KRK_HAS_EXCEPTION)) tuple->hash = hash;
+		return hash;
+	}
+	if (IS_INSTANCE(value) && AS_INSTANCE(value)->_class->_hash) {
+		krk_push(value);
+		KrkValue result = krk_callSimple(OBJECT_VAL(AS_INSTANCE(value)->_class->_hash), 1, 0);
+		if (IS_INTEGER(result)) return (uint32_t)AS_INTEGER(result);
+		if (!(krk_currentThread.flags & KRK_HAS_EXCEPTION)) {
+			krk_runtimeError(vm.exceptions->typeError, "__hash__ method should return an integer, not '%s'", krk_typeName(result));
+		}
+		return 0;
+	}
 	return (((uint32_t)(intptr_t)AS_OBJECT(value)) >> 4)| (((uint32_t)(intptr_t)AS_OBJECT(value)) << 28);
 }
 
 static uint32_t hashTupleValues(KrkTuple *tuple) {
 	uint32_t hash = 0;
 	for (size_t i = 0; i < tuple->values.count; ++i) {
-		hash += hashValue(tuple->values.values[i]);
+		hash += krk_hashValue(tuple->values.values[i]);
+		if (unlikely(krk_currentThread.flags & KRK_HAS_EXCEPTION)) return 0;
 	}
 	return hash;
 }
 
-KrkTableEntry * krk_findEntry(KrkTableEntry * entries, size_t capacity, KrkValue key) {
-	uint32_t index = hashValue(key) % capacity;
+/* Only tuples and instances with __hash__ can raise while being hashed. */
+static inline int hashCanRaise(KrkValue key) {
+	return IS_TUPLE(key) || (IS_INSTANCE(key) && AS_INSTANCE(key)->_class->_hash);
+}
+
+/*
+ * Hash a key before anything is read from a table: __hash__ can run managed
+ * code, and that code could change the table. Returns 0 if it raised.
+ */
+static inline int hashKey(KrkValue key, uint32_t * hash) {
+	*hash = krk_hashValue(key);
+	return !(hashCanRaise(key) && (krk_currentThread.flags & KRK_HAS_EXCEPTION));
+}
+
+/**
+ * Find the entry for a key with the given hash, or where it would go.
+ * Entries remember their key's hash, so keys are only compared for
+ * equality when the hashes match.
+ */
+KrkTableEntry * krk_findEntry(KrkTableEntry * entries, size_t capacity, KrkValue key, uint32_t hash) {
+	uint32_t index = hash % capacity;
 	KrkTableEntry * tombstone = NULL;
 	for (;;) {
 		KrkTableEntry * entry = &entries[index];
@@ -52,27 +98,29 @@ KrkTableEntry * krk_findEntry(KrkTableEntry * entries, size_t capacity, KrkValue
 			} else {
 				if (tombstone == NULL) tombstone = entry;
 			}
-		} else if (krk_valuesEqual(entry->key, key)) {
+		} else if (entry->hash == hash && krk_valuesEqual(entry->key, key)) {
 			return entry;
 		}
 		index = (index + 1) % capacity;
 	}
 }
 
+/* Keys are moved with their stored hashes, so nothing is rehashed or compared. */
 static void adjustCapacity(KrkTable * table, size_t capacity) {
 	KrkTableEntry * entries = ALLOCATE(KrkTableEntry, capacity);
 	for (size_t i = 0; i < capacity; ++i) {
 		entries[i].key = KWARGS_VAL(0);
 		entries[i].value = NONE_VAL();
+		entries[i].hash = 0;
 	}
 
 	table->count = 0;
 	for (size_t i = 0; i < table->capacity; ++i) {
 		KrkTableEntry * entry = &table->entries[i];
 		if (entry->key.type == VAL_KWARGS) continue;
-		KrkTableEntry * dest = krk_findEntry(entries, capacity, entry->key);
-		dest->key = entry->key;
-		dest->value = entry->value;
+		uint32_t index = entry->hash % capacity;
+		while (entries[index].key.type != VAL_KWARGS) index = (index + 1) % capacity;
+		entries[index] = *entry;
 		table->count++;
 	}
 
@@ -81,39 +129,54 @@ static void adjustCapacity(KrkTable * table, size_t capacity) {
 	table->capacity = capacity;
 }
 
-int krk_tableSet(KrkTable * table, KrkValue key, KrkValue value) {
+static int tableSetHashed(KrkTable * table, KrkValue key, uint32_t hash, KrkValue value) {
 	if (table->count + 1 > table->capacity * TABLE_MAX_LOAD) {
 		size_t capacity = GROW_CAPACITY(table->capacity);
 		adjustCapacity(table, capacity);
 	}
-	KrkTableEntry * entry = krk_findEntry(table->entries, table->capacity, key);
+	KrkTableEntry * entry = krk_findEntry(table->entries, table->capacity, key, hash);
 	int isNewKey = entry->key.type == VAL_KWARGS;
 	if (isNewKey && IS_NONE(entry->value)) table->count++;
 	entry->key = key;
 	entry->value = value;
+	entry->hash = hash;
 	return isNewKey;
 }
 
+/**
+ * Set a key; returns 1 if it was not already in the table. Returns 0
+ * without changing anything if hashing the key raised an exception.
+ */
+int krk_tableSet(KrkTable * table, KrkValue key, KrkValue value) {
+	uint32_t hash;
+	if (unlikely(!hashKey(key, &hash))) return 0;
+	return tableSetHashed(table, key, hash, value);
+}
+
 void krk_tableAddAll(KrkTable * from, KrkTable * to) {
 	for (size_t i = 0; i < from->capacity; ++i) {
 		KrkTableEntry * entry = &from->entries[i];
 		if (entry->key.type != VAL_KWARGS) {
-			krk_tableSet(to, entry->key, entry->value);
+			tableSetHashed(to, entry->key, entry->hash, entry->value);
 		}
 	}
 }
 
 int krk_tableGet(KrkTable * table, KrkValue key, KrkValue * value) {
+	uint32_t hash;
+	if (unlikely(!hashKey(key, &hash))) return 0;
 	if (table->count == 0) return 0;
-	KrkTableEntry * entry = krk_findEntry(table->entries, table->capacity, key);
+	KrkTableEntry * entry = krk_findEntry(table->entries, table->capacity, key, hash);
 	if (entry->key.type == VAL_KWARGS) return 0;
 	*value = entry->value;
 	return 1;
 }
 
 int krk_tableDelete(KrkTable * table, KrkValue key) {
+	uint32_t hash;
+	if (unlikely(!hashKey(key, &hash))) return 0;
 	if (table->count == 0) return 0;
-	KrkTableEntry * entry = krk_findEntry(table->entries, table->capacity, key);
+	KrkTableEntry * entry = krk_findEntry(table->entries, table->capacity, key, hash);
 	if (entry->key.type == VAL_KWARGS) return 0;
 	entry->key = KWARGS_VAL(0);
 	entry->value = BOOLEAN_VAL(1);
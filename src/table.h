@@ -14,6 +14,7 @@
 typedef struct {
 	KrkValue key;
 	KrkValue value;
+	uint32_t hash;
 } KrkTableEntry;
 
 typedef struct {
@@ -29,4 +30,5 @@ extern KrkString * krk_tableFindString(KrkTable * table, const char * chars, siz
 extern int krk_tableSet(KrkTable * table, KrkValue key, KrkValue value);
 extern int krk_tableGet(KrkTable * table, KrkValue key, KrkValue * value);
 extern int krk_tableDelete(KrkTable * table, KrkValue key);
-extern KrkTableEntry * krk_findEntry(KrkTableEntry * entries, size_t capacity, KrkValue key);
+extern KrkTableEntry * krk_findEntry(KrkTableEntry * entries, size_t capacity, KrkValue key, uint32_t hash);
+extern uint32_t krk_hashValue(KrkValue value);
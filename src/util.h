@@ -7,6 +7,8 @@
  */
 #pragma once
 
+#include <string.h>
+
 #include "object.h"
 #include "vm.h"
 #include "memory.h"
@@ -114,7 +116,7 @@ static inline void pushStringBuilderStr(struct StringBuilder * sb, char *str, si
 	while (sb->capacity < sb->length + len) {
 		size_t old = sb->capacity;
 		sb->capacity = GROW_CAPACITY(old);
-		sb->bytes = realloc(sb->bytes, sb->capacity);
+		sb->bytes = GROW_ARRAY(char, sb->bytes, old, sb->capacity);
 	}
 	for (size_t i = 0; i < len; ++i) {
 		sb->bytes[sb->length++] = *(str++);
@@ -122,7 +124,7 @@ static inline void pushStringBuilderStr(struct StringBuilder * sb, char *str, si
 }
 
 static inline KrkValue finishStringBuilder(struct StringBuilder * sb) {
-	KrkValue out = OBJECT_VAL(krk_copyString(sb->bytes, sb->length));
+	KrkValue out = OBJECT_VAL(krk_copyStringUninterned(sb->bytes, sb->length));
 	FREE_ARRAY(char,sb->bytes, sb->capacity);
 	return out;
 }
@@ -132,6 +134,23 @@ static inline KrkValue discardStringBuilder(struct StringBuilder * sb) {
 	return NONE_VAL();
 }
 
+/**
+ * Compare two ints, two floats or two strings without going through
+ * krk_operator_lt. Returns 0 or 1, or -1 if the values need the full
+ * comparison (which may call into managed code).
+ */
+static inline int fastLessThan(KrkValue a, KrkValue b) {
+	if (IS_INTEGER(a) && IS_INTEGER(b)) return AS_INTEGER(a) < AS_INTEGER(b);
+	if (IS_FLOATING(a) && IS_FLOATING(b)) return AS_FLOATING(a) < AS_FLOATING(b);
+	if (IS_STRING(a) && IS_STRING(b)) {
+		size_t aLen = AS_STRING(a)->length;
+		size_t bLen = AS_STRING(b)->length;
+		int cmp = memcmp(AS_CSTRING(a), AS_CSTRING(b), aLen < bLen ? aLen : bLen);
+		return cmp < 0 || (cmp == 0 && aLen < bLen);
+	}
+	return -1;
+}
+
 #define IS_int(o)     (IS_INTEGER(o))
 #define AS_int(o)     (AS_INTEGER(o))
 
@@ -145,13 +164,13 @@ static inline KrkValue discardStringBuilder(struct StringBuilder * sb) {
 #define AS_list(o)    (KrkList*)AS_OBJECT(o)
 
 #define IS_listiterator(o) krk_isInstanceOf(o,vm.baseClasses->listiteratorClass)
-#define AS_listiterator(o) AS_INSTANCE(o)
+#define AS_listiterator(o) ((struct ListIterator*)AS_OBJECT(o))
 
 #define IS_str(o)     (IS_STRING(o)||krk_isInstanceOf(o,vm.baseClasses->strClass))
 #define AS_str(o)     (KrkString*)AS_OBJECT(o)
 
 #define IS_striterator(o) (krk_isInstanceOf(o,vm.baseClasses->striteratorClass))
-#define AS_striterator(o) (AS_INSTANCE(o))
+#define AS_striterator(o) ((struct StrIterator*)AS_OBJECT(o))
 
 #define IS_dict(o)    krk_isInstanceOf(o,vm.baseClasses->dictClass)
 #define AS_dict(o)    (KrkDict*)AS_OBJECT(o)
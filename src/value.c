@@ -34,7 +34,7 @@ void krk_printValue(FILE * f, KrkValue printable) {
 			case VAL_BOOLEAN:  fprintf(f, "%s", AS_BOOLEAN(printable) ? "True" : "False"); break;
 			case VAL_FLOATING: fprintf(f, "%g", AS_FLOATING(printable)); break;
 			case VAL_NONE:     fprintf(f, "None"); break;
-			case VAL_HANDLER:  fprintf(f, "{%s->%d}", AS_HANDLER(printable).type == OP_PUSH_TRY ? "try" : "with", (int)AS_HANDLER(printable).target); break;
+			case VAL_HANDLER:  fprintf(f, "{with->%d}", (int)AS_HANDLER(printable).target); break;
 			case VAL_KWARGS: {
 				if (AS_INTEGER(printable) == LONG_MAX) {
 					fprintf(f, "{unpack single}");
@@ -117,6 +117,15 @@ int krk_valuesEqual(KrkValue a, KrkValue b) {
 			case VAL_HANDLER:  krk_runtimeError(vm.exceptions->valueError,"Invalid value"); return 0;
 			case VAL_OBJECT: {
 				if (AS_OBJECT(a) == AS_OBJECT(b)) return 1;
+				if (IS_STRING(a) && IS_STRING(b)) {
+					KrkString * x = AS_STRING(a);
+					KrkString * y = AS_STRING(b);
+					/* Two distinct interned strings can never be equal. */
+					if ((x->flags & y->flags) & KRK_STRING_FLAG_INTERNED) return 0;
+					if (x->length != y->length) return 0;
+					if (((x->flags & y->flags) & KRK_STRING_FLAG_HASHED) && x->hash != y->hash) return 0;
+					return memcmp(x->chars, y->chars, x->length) == 0;
+				}
 			} break;
 			default: break;
 		}
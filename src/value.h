@@ -55,7 +55,6 @@ typedef struct {
 #define IS_OBJECT(value)    ((value).type == VAL_OBJECT)
 #define IS_KWARGS(value)    ((value).type == VAL_KWARGS)
 
-#define IS_TRY_HANDLER(value)  (IS_HANDLER(value) && AS_HANDLER(value).type == OP_PUSH_TRY)
 #define IS_WITH_HANDLER(value) (IS_HANDLER(value) && AS_HANDLER(value).type == OP_PUSH_WITH)
 
 typedef struct {
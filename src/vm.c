@@ -91,6 +91,14 @@ static struct Exceptions _exceptions = {NULL};
 static struct BaseClasses _baseClasses = {NULL};
 static KrkValue _specialMethodNames[METHOD__MAX];
 
+const char * krk_inlineBuiltinNames[BUILTIN__MAX] = {
+	[BUILTIN_LEN] = "len",
+	[BUILTIN_ISINSTANCE] = "isinstance",
+	[BUILTIN_TYPE] = "type",
+	[BUILTIN_STR] = "str",
+	[BUILTIN_PRINT] = "print",
+};
+
 /**
  * Reset the stack pointers, frame, upvalue list,
  * clear the exception flag and current exception;
@@ -207,16 +215,22 @@ void krk_dumpTraceback() {
 	}
 
 	if (!krk_valuesEqual(krk_currentThread.currentException,NONE_VAL())) {
-		krk_push(krk_currentThread.currentException);
-		KrkValue result = krk_callSimple(OBJECT_VAL(krk_getType(krk_currentThread.currentException)->_reprer), 1, 0);
-		fprintf(stderr, "%s\n", AS_CSTRING(result));
+		KrkValue exception = krk_currentThread.currentException;
+		krk_push(exception);
+		KrkValue result = krk_callSimple(OBJECT_VAL(krk_getType(exception)->_reprer), 1, 0);
+		/* Building the message can itself fail, such as when a key's __repr__ raises. */
+		if (IS_STRING(result)) {
+			fprintf(stderr, "%s\n", AS_CSTRING(result));
+		} else {
+			fprintf(stderr, "%s\n", krk_getType(exception)->name->chars);
+		}
 	}
 }
 
 /**
  * Raise an exception. Creates an exception object of the requested type
- * and formats a message string to attach to it. Exception classes are
- * found in vm.exceptions and are initialized on startup.
+ * and formats a message for it, which becomes its `arg` when first used.
+ * Exception classes are found in vm.exceptions and are initialized on startup.
  */
 KrkValue krk_runtimeError(KrkClass * type, const char * fmt, ...) {
 	char buf[1024] = {0};
@@ -224,17 +238,14 @@ KrkValue krk_runtimeError(KrkClass * type, const char * fmt, ...) {
 	va_start(args, fmt);
 	size_t len = vsnprintf(buf, 1024, fmt, args);
 	va_end(args);
+	if (len >= sizeof(buf)) len = sizeof(buf) - 1;
 	krk_currentThread.flags |= KRK_HAS_EXCEPTION;
 
 	/* Allocate an exception object of the requested type. */
 	KrkInstance * exceptionObject = krk_newInstance(type);
 	krk_push(OBJECT_VAL(exceptionObject));
-	krk_push(OBJECT_VAL(S("arg")));
-	krk_push(OBJECT_VAL(krk_copyString(buf, len)));
-	/* Attach its argument */
-	krk_tableSet(&exceptionObject->fields, krk_peek(1), krk_peek(0));
-	krk_pop();
-	krk_pop();
+	/* Attach its argument; exception classes hold on to the text until `arg` is asked for. */
+	_exception_setMessage(exceptionObject, buf, len);
 	krk_pop();
 
 	/* Set the current exception to be picked up by handleException */
@@ -392,6 +403,8 @@ void krk_finalizeClass(KrkClass * _class) {
 		{&_class->_iter, METHOD_ITER},
 		{&_class->_getattr, METHOD_GETATTR},
 		{&_class->_dir, METHOD_DIR},
+		{&_class->_hash, METHOD_HASH},
+		{&_class->_missing, METHOD_MISSING},
 		{NULL, 0},
 	};
 
@@ -757,6 +770,13 @@ _finishKwarg:
 		krk_push(KWARGS_VAL(0));
 		argCount++;
 	}
+	if (closure->function->isGenerator) {
+		/* Don't run anything yet; the generator starts the frame when it is first called. */
+		KrkInstance * generator = krk_buildGenerator(closure, argCount);
+		krk_currentThread.stackTop -= argCount + extra;
+		krk_push(OBJECT_VAL(generator));
+		return 2;
+	}
 	if (krk_currentThread.frameCount == FRAMES_MAX) {
 		krk_runtimeError(vm.exceptions->baseException, "Too many call frames.");
 		return 0;
@@ -787,6 +807,9 @@ _errorAfterKeywords:
  *   to get the result. If an exception is thrown during a native method call,
  *   callValue will return 0 and the VM should be allowed to handle the exception.
  *
+ *   Calls to generator functions also complete immediately, returning
+ *   2 with a new generator object on the stack.
+ *
  *   For managed code, the VM needs to be resumed. Returns 1 to indicate this.
  *   If you want a result in a native method, call `krk_runNext()` and the
  *   result will be returned directly from that function.
@@ -1080,6 +1103,17 @@ static KrkValue krk_setclean(int argc, KrkValue argv[]) {
 	return NONE_VAL();
 }
 
+/**
+ * kuroko.intern(str)
+ *
+ * Strings built at runtime are not interned; this returns the canonical
+ * interned copy of a string so it can be compared and looked up by identity.
+ */
+static KrkValue krk_intern(int argc, KrkValue argv[]) {
+	if (argc != 1 || !IS_STRING(argv[0])) return krk_runtimeError(vm.exceptions->typeError, "intern() expects one str argument");
+	return OBJECT_VAL(krk_internString(AS_STRING(argv[0])));
+}
+
 void krk_initVM(int flags) {
 	vm.globalFlags = flags & 0xFF00;
 
@@ -1092,6 +1126,10 @@ void krk_initVM(int flags) {
 	vm.threads = &krk_currentThread;
 	vm.threads->next = NULL;
 
+#ifdef ENABLE_OPCODE_STATS
+	atexit(krk_dumpOpcodeStats);
+#endif
+
 	/* GC state */
 	vm.objects = NULL;
 	vm.bytesAllocated = 0;
@@ -1132,6 +1170,19 @@ void krk_initVM(int flags) {
 		_(METHOD_GETSLICE, "__getslice__"),
 		_(METHOD_SETSLICE, "__setslice__"),
 		_(METHOD_DELSLICE, "__delslice__"),
+		_(METHOD_HASH, "__hash__"),
+		_(METHOD_MISSING, "__missing__"),
+		_(METHOD_IADD, "__iadd__"),
+		_(METHOD_ISUB, "__isub__"),
+		_(METHOD_IMUL, "__imul__"),
+		_(METHOD_IDIV, "__idiv__"),
+		_(METHOD_IMOD, "__imod__"),
+		_(METHOD_IPOW, "__ipow__"),
+		_(METHOD_IOR, "__ior__"),
+		_(METHOD_IXOR, "__ixor__"),
+		_(METHOD_IAND, "__iand__"),
+		_(METHOD_ILSHIFT, "__ilshift__"),
+		_(METHOD_IRSHIFT, "__irshift__"),
 		_(METHOD_LIST_INT, "__list"),
 		_(METHOD_DICT_INT, "__dict"),
 		_(METHOD_INREPR, "__inrepr"),
@@ -1160,12 +1211,20 @@ void krk_initVM(int flags) {
 	_createAndBind_functionClass();
 	_createAndBind_rangeClass();
 	_createAndBind_setClass();
+	_createAndBind_iterClasses();
+	_createAndBind_generatorClass();
 	_createAndBind_exceptions();
 	_createAndBind_gcMod();
 #ifdef ENABLE_THREADING
 	_createAndBind_threadsMod();
 #endif
 
+	for (size_t i = 0; i < BUILTIN__MAX; ++i) {
+		KrkValue builtin = NONE_VAL();
+		krk_tableGet(&vm.builtins->fields, OBJECT_VAL(krk_copyString(krk_inlineBuiltinNames[i], strlen(krk_inlineBuiltinNames[i]))), &builtin);
+		vm.inlineBuiltins[i] = IS_OBJECT(builtin) ? AS_OBJECT(builtin) : NULL;
+	}
+
 	/**
 	 * kuroko = module()
 	 *
@@ -1184,6 +1243,7 @@ void krk_initVM(int flags) {
 	krk_defineNative(&vm.system->fields, "getsizeof", krk_getsize);
 	krk_defineNative(&vm.system->fields, "set_clean_output", krk_setclean);
 	krk_defineNative(&vm.system->fields, "set_tracing", krk_set_tracing)->doc = "Toggle debugging modes.";
+	krk_defineNative(&vm.system->fields, "intern", krk_intern)->doc = "Return the interned copy of a string.";
 	krk_attachNamedObject(&vm.system->fields, "path_sep", (KrkObj*)S(PATH_SEP));
 	KrkValue module_paths = krk_list_of(0,NULL);
 	krk_attachNamedValue(&vm.system->fields, "module_paths", module_paths);
@@ -1226,6 +1286,7 @@ void krk_freeVM() {
 	krk_freeTable(&vm.strings);
 	krk_freeTable(&vm.modules);
 	memset(_specialMethodNames,0,sizeof(_specialMethodNames));
+	memset(vm.inlineBuiltins,0,sizeof(vm.inlineBuiltins));
 	krk_freeObjects();
 
 	/* for thread in threads... */
@@ -1311,7 +1372,7 @@ MAKE_BIT_OP(mod,%) /* not a bit op, but doesn't work on floating point */
 			if (IS_INTEGER(b)) return BOOLEAN_VAL(AS_FLOATING(a) operator AS_INTEGER(b)); \
 			else if (IS_FLOATING(b)) return BOOLEAN_VAL(AS_FLOATING(a) operator AS_FLOATING(b)); \
 		} else if (IS_FLOATING(b)) { \
-			if (IS_INTEGER(a)) return BOOLEAN_VAL(AS_INTEGER(a) operator AS_INTEGER(b)); \
+			if (IS_INTEGER(a)) return BOOLEAN_VAL(AS_INTEGER(a) operator AS_FLOATING(b)); \
 		} \
 		return tryBind("__" #name "__", a, b, "'" #operator "' not supported between instances of '%s' and '%s'"); \
 	}
@@ -1319,55 +1380,88 @@ MAKE_BIT_OP(mod,%) /* not a bit op, but doesn't work on floating point */
 MAKE_COMPARATOR(lt, <)
 MAKE_COMPARATOR(gt, >)
 
+/**
+ * In-place operators for augmented assignment. If the left operand's type
+ * has the in-place method (such as __iadd__ for +=) it is called, and is
+ * expected to update the object and return it; otherwise this is the
+ * same as the regular operator and produces a new value.
+ */
+#define MAKE_INPLACE_OP(name,method) \
+	KrkValue krk_operator_i ## name (KrkValue a, KrkValue b) { \
+		if (IS_OBJECT(a)) { \
+			KrkValue inplace; \
+			if (krk_tableGet(&krk_getType(a)->methods, vm.specialMethodNames[method], &inplace)) { \
+				krk_push(a); \
+				krk_push(b); \
+				return krk_callSimple(inplace, 2, 0); \
+			} \
+		} \
+		return krk_operator_ ## name (a,b); \
+	}
+
+MAKE_INPLACE_OP(add,METHOD_IADD)
+MAKE_INPLACE_OP(sub,METHOD_ISUB)
+MAKE_INPLACE_OP(mul,METHOD_IMUL)
+MAKE_INPLACE_OP(div,METHOD_IDIV)
+MAKE_INPLACE_OP(mod,METHOD_IMOD)
+MAKE_INPLACE_OP(pow,METHOD_IPOW)
+MAKE_INPLACE_OP(or,METHOD_IOR)
+MAKE_INPLACE_OP(xor,METHOD_IXOR)
+MAKE_INPLACE_OP(and,METHOD_IAND)
+MAKE_INPLACE_OP(lshift,METHOD_ILSHIFT)
+MAKE_INPLACE_OP(rshift,METHOD_IRSHIFT)
+
 /**
  * At the end of each instruction cycle, we check the exception flag to see
  * if an error was raised during execution. If there is an exception, this
- * function is called to scan up the stack to see if there is an exception
- * handler value. Handlers live on the stack at the point where it should be
- * reset to and keep an offset to the except branch of a try/except statement
- * pair (or the exit point of the try, if there is no except branch). These
- * objects can't be built by (text) user code, but erroneous bytecode / module
- * stack manipulation could result in a handler being in the wrong place,
- * at which point there's no guarantees about what happens.
+ * function is called to walk down the call frames looking for a try block
+ * that covers where each frame stopped. Try blocks are recorded in their
+ * chunk's handler table rather than on the stack, so entering one is free
+ * and finding one is a lookup by instruction offset. When one is found the
+ * frames and stack above it are unwound and the frame is left at the except
+ * branch (or the exit point of the try, if there is no except branch), with
+ * the caller expected to push the exception.
  */
 static int handleException() {
-	int stackOffset, frameOffset;
-	int exitSlot = (krk_currentThread.exitOnFrame >= 0) ? krk_currentThread.frames[krk_currentThread.exitOnFrame].outSlots : 0;
-	for (stackOffset = (int)(krk_currentThread.stackTop - krk_currentThread.stack - 1); stackOffset >= exitSlot && !IS_TRY_HANDLER(krk_currentThread.stack[stackOffset]); stackOffset--);
-	if (stackOffset < exitSlot) {
-		if (exitSlot == 0) {
-			/*
-			 * No exception was found and we have reached the top of the call stack.
-			 * Call dumpTraceback to present the exception to the user and reset the
-			 * VM stack state. It should still be safe to execute more code after
-			 * this reset, so the repl can throw errors and keep accepting new lines.
-			 */
-			krk_dumpTraceback();
-			krk_resetStack();
-			krk_currentThread.frameCount = 0;
+	ssize_t lowestFrame = (krk_currentThread.exitOnFrame >= 0) ? krk_currentThread.exitOnFrame : 0;
+	for (ssize_t frameOffset = (ssize_t)krk_currentThread.frameCount - 1; frameOffset >= lowestFrame; frameOffset--) {
+		CallFrame * frame = &krk_currentThread.frames[frameOffset];
+		KrkChunk * chunk = &frame->closure->function->chunk;
+		/* ip has moved past the instruction that raised, or past the call that did. */
+		size_t offset = frame->ip - chunk->code - 1;
+		for (size_t i = 0; i < chunk->handlersCount; ++i) {
+			KrkExceptionHandler * handler = &chunk->handlers[i];
+			if (offset < handler->startOffset || offset >= handler->endOffset) continue;
+
+			/* We found an exception handler and can reset the VM to its call frame. */
+			size_t stackOffset = frame->slots + handler->stackDepth;
+			closeUpvalues(stackOffset);
+			krk_currentThread.stackTop = krk_currentThread.stack + stackOffset;
+			krk_currentThread.frameCount = frameOffset + 1;
+			frame->ip = chunk->code + handler->target;
+
+			/* Clear the exception flag so we can continue executing from the handler. */
+			krk_currentThread.flags &= ~KRK_HAS_EXCEPTION;
+			return 0;
 		}
-		/* If exitSlot was not 0, there was an exception during a call to runNext();
-		 * this is likely to be raised higher up the stack as an exception in the outer
-		 * call, but we don't want to print the traceback here. */
-		return 1;
 	}
 
-	/* Find the call frame that owns this stack slot */
-	for (frameOffset = krk_currentThread.frameCount - 1; frameOffset >= 0 && (int)krk_currentThread.frames[frameOffset].slots > stackOffset; frameOffset--);
-	if (frameOffset == -1) {
-		fprintf(stderr, "Internal error: Call stack is corrupted - unable to find\n");
-		fprintf(stderr, "                call frame that owns exception handler.\n");
-		exit(1);
+	int exitSlot = (krk_currentThread.exitOnFrame >= 0) ? krk_currentThread.frames[krk_currentThread.exitOnFrame].outSlots : 0;
+	if (exitSlot == 0) {
+		/*
+		 * No exception was found and we have reached the top of the call stack.
+		 * Call dumpTraceback to present the exception to the user and reset the
+		 * VM stack state. It should still be safe to execute more code after
+		 * this reset, so the repl can throw errors and keep accepting new lines.
+		 */
+		krk_dumpTraceback();
+		krk_resetStack();
+		krk_currentThread.frameCount = 0;
 	}
-
-	/* We found an exception handler and can reset the VM to its call frame. */
-	closeUpvalues(stackOffset);
-	krk_currentThread.stackTop = krk_currentThread.stack + stackOffset + 1;
-	krk_currentThread.frameCount = frameOffset + 1;
-
-	/* Clear the exception flag so we can continue executing from the handler. */
-	krk_currentThread.flags &= ~KRK_HAS_EXCEPTION;
-	return 0;
+	/* If exitSlot was not 0, there was an exception during a call to runNext();
+	 * this is likely to be raised higher up the stack as an exception in the outer
+	 * call, but we don't want to print the traceback here. */
+	return 1;
 }
 
 /**
@@ -1379,11 +1473,29 @@ static int handleException() {
  * a later search path has a krk source and an earlier search path has a shared
  * object module, the later search path will still win.
  */
+#ifdef ENABLE_THREADING
+static volatile int _modulesLock = 0;
+#endif
+
+/* Threads can import at the same time, so the module cache is only touched under a lock. */
+static int getModule(KrkString * name, KrkValue * moduleOut) {
+	_obtain_lock(_modulesLock);
+	int found = krk_tableGet(&vm.modules, OBJECT_VAL(name), moduleOut);
+	_release_lock(_modulesLock);
+	return found;
+}
+
+static void setModule(KrkString * name, KrkValue module) {
+	_obtain_lock(_modulesLock);
+	krk_tableSet(&vm.modules, OBJECT_VAL(name), module);
+	_release_lock(_modulesLock);
+}
+
 int krk_loadModule(KrkString * path, KrkValue * moduleOut, KrkString * runAs) {
 	KrkValue modulePaths;
 
 	/* See if the module is already loaded */
-	if (krk_tableGet(&vm.modules, OBJECT_VAL(runAs), moduleOut)) {
+	if (getModule(runAs, moduleOut)) {
 		krk_push(*moduleOut);
 		return 1;
 	}
@@ -1451,7 +1563,7 @@ int krk_loadModule(KrkString * path, KrkValue * moduleOut, KrkString * runAs) {
 
 		krk_pop(); /* concatenated filename on stack */
 		krk_push(*moduleOut);
-		krk_tableSet(&vm.modules, OBJECT_VAL(runAs), *moduleOut);
+		setModule(runAs, *moduleOut);
 		/* Was this a package? */
 		if (isPackage) {
 			krk_attachNamedValue(&AS_INSTANCE(*moduleOut)->fields,"__ispackage__",BOOLEAN_VAL(1));
@@ -1519,7 +1631,7 @@ int krk_loadModule(KrkString * path, KrkValue * moduleOut, KrkString * runAs) {
 		krk_attachNamedValue(&AS_INSTANCE(*moduleOut)->fields, "__file__", krk_peek(0));
 
 		krk_pop(); /* filename */
-		krk_tableSet(&vm.modules, OBJECT_VAL(runAs), *moduleOut);
+		setModule(runAs, *moduleOut);
 		return 1;
 	}
 #endif
@@ -1721,6 +1833,181 @@ static inline size_t readBytes(CallFrame * frame, int num) {
 	return out;
 }
 
+/**
+ * Advance an iterator for OP_FOR_ITER.
+ *
+ * The built-in iterators are stepped inline without going through a call.
+ * Anything else is called as with OP_CALL and signals exhaustion by
+ * returning itself, which we check by identity rather than with __eq__.
+ * Returns 1 and sets *out on a new value, 0 when exhausted, -1 on error.
+ */
+static inline int iterNext(KrkValue iterator, KrkValue * out) {
+	if (IS_INSTANCE(iterator)) {
+		KrkInstance * self = AS_INSTANCE(iterator);
+		KrkClass * _class = self->_class;
+		if (_class == vm.baseClasses->rangeiteratorClass) {
+			struct RangeIterator * it = (struct RangeIterator*)self;
+			if (it->i >= it->max) return 0;
+			*out = INTEGER_VAL(it->i++);
+			return 1;
+		} else if (_class == vm.baseClasses->listiteratorClass) {
+			struct ListIterator * it = (struct ListIterator*)self;
+			if (it->i >= AS_LIST(it->l)->count) return 0;
+			*out = AS_LIST(it->l)->values[it->i++];
+			return 1;
+		} else if (_class == vm.baseClasses->tupleiteratorClass) {
+			struct TupleIter * it = (struct TupleIter*)self;
+			if (it->i >= (int)AS_TUPLE(it->myTuple)->values.count) return 0;
+			*out = AS_TUPLE(it->myTuple)->values.values[it->i++];
+			return 1;
+		} else if (_class == vm.baseClasses->dictkeysClass) {
+			struct DictKeys * it = (struct DictKeys*)self;
+			KrkTable * table = AS_DICT(it->dict);
+			while (it->i < table->capacity) {
+				KrkTableEntry * entry = &table->entries[it->i++];
+				if (IS_KWARGS(entry->key)) continue;
+				*out = entry->key;
+				return 1;
+			}
+			return 0;
+		} else if (_class->_call && _class->_call->type == OBJ_NATIVE) {
+			/* Native iterators (str, dict items, ...) skip the argument copy in krk_callValue */
+			KrkValue result = ((NativeFnKw)((KrkNative*)_class->_call)->function)(1, (KrkValue[]){iterator}, 0);
+			if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return -1;
+			if (krk_valuesSame(result, iterator)) return 0;
+			*out = result;
+			return 1;
+		}
+	}
+
+	krk_push(iterator);
+	KrkValue result = krk_callSimple(iterator, 0, 1);
+	if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return -1;
+	if (krk_valuesSame(result, iterator)) return 0;
+	*out = result;
+	return 1;
+}
+
+/**
+ * Get an iterator for an iterable, as with iter(); raises TypeError and
+ * returns None if the value is not iterable.
+ */
+KrkValue krk_getIterator(KrkValue iterable) {
+	KrkClass * type = krk_getType(iterable);
+	if (!type->_iter) return krk_runtimeError(vm.exceptions->typeError, "'%s' object is not iterable", krk_typeName(iterable));
+	krk_push(iterable);
+	return krk_callSimple(OBJECT_VAL(type->_iter), 1, 0);
+}
+
+/**
+ * Exported form of iterNext for native code that consumes iterators.
+ */
+int krk_iterNext(KrkValue iterator, KrkValue * out) {
+	return iterNext(iterator, out);
+}
+
+/**
+ * Length hint for OP_LIST_RESERVE: the number of values iterating over
+ * a built-in collection will produce, or 0 if that isn't known cheaply.
+ */
+static size_t lengthHint(KrkValue iterable) {
+	if (IS_TUPLE(iterable)) return AS_TUPLE(iterable)->values.count;
+	if (IS_STRING(iterable)) return AS_STRING(iterable)->codesLength;
+	if (IS_BYTES(iterable)) return AS_BYTES(iterable)->length;
+	if (IS_INSTANCE(iterable)) {
+		KrkClass * _class = AS_INSTANCE(iterable)->_class;
+		if (_class == vm.baseClasses->listClass) return AS_LIST(iterable)->count;
+		if (_class == vm.baseClasses->dictClass) return AS_DICT(iterable)->count;
+		if (_class == vm.baseClasses->rangeClass) {
+			struct Range * range = (struct Range*)AS_INSTANCE(iterable);
+			return range->max > range->min ? (size_t)(range->max - range->min) : 0;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Feed each value produced by an iterable to a callback. Tuples are passed
+ * as a single block; anything else is fed one value at a time, with the
+ * built-in iterators stepped inline as with OP_FOR_ITER. The callback returns
+ * nonzero to stop iteration, usually because it raised an exception.
+ * Returns nonzero if iteration stopped early or an exception was raised.
+ */
+int krk_unpackIterable(KrkValue iterable, void * context, int callback(void *, const KrkValue *, size_t)) {
+	if (IS_TUPLE(iterable)) {
+		return callback(context, AS_TUPLE(iterable)->values.values, AS_TUPLE(iterable)->values.count);
+	} else if (IS_INSTANCE(iterable) && AS_INSTANCE(iterable)->_class == vm.baseClasses->listClass) {
+		/* The callback may call managed code that modifies the list */
+		for (size_t i = 0; i < AS_LIST(iterable)->count; ++i) {
+			if (callback(context, &AS_LIST(iterable)->values[i], 1)) return 1;
+		}
+		return 0;
+	}
+
+	KrkValue iterator = krk_getIterator(iterable);
+	if (krk_currentThread.flags & KRK_HAS_EXCEPTION) return 1;
+	krk_push(iterator);
+
+	KrkValue value;
+	int status;
+	while ((status = iterNext(iterator, &value)) == 1) {
+		krk_push(value);
+		if (callback(context, &value, 1)) {
+			status = -1;
+			krk_pop();
+			break;
+		}
+		krk_pop();
+	}
+	krk_pop(); /* iterator */
+	return status < 0;
+}
+
+/**
+ * Inline versions of the builtins the compiler calls with OP_CALL_BUILTIN.
+ * Only cases that can't raise or run managed code are handled here; for
+ * anything else this returns 0 and the builtin is called normally.
+ */
+static int inlineBuiltin(int which, int argCount, KrkValue * result) {
+	KrkValue * argv = krk_currentThread.stackTop - argCount;
+	switch (which) {
+		case BUILTIN_LEN: {
+			if (argCount != 1) return 0;
+			if (IS_STRING(argv[0])) *result = INTEGER_VAL(AS_STRING(argv[0])->codesLength);
+			else if (IS_TUPLE(argv[0])) *result = INTEGER_VAL(AS_TUPLE(argv[0])->values.count);
+			else if (krk_getType(argv[0]) == vm.baseClasses->listClass) *result = INTEGER_VAL(AS_LIST(argv[0])->count);
+			else if (krk_getType(argv[0]) == vm.baseClasses->dictClass) *result = INTEGER_VAL(AS_DICT(argv[0])->count);
+			else return 0;
+			return 1;
+		}
+		case BUILTIN_ISINSTANCE:
+			if (argCount != 2 || !IS_CLASS(argv[1])) return 0;
+			*result = BOOLEAN_VAL(krk_isInstanceOf(argv[0], AS_CLASS(argv[1])));
+			return 1;
+		case BUILTIN_TYPE:
+			if (argCount != 1) return 0;
+			*result = OBJECT_VAL(krk_getType(argv[0]));
+			return 1;
+		case BUILTIN_STR:
+			if (argCount != 1 || !IS_STRING(argv[0])) return 0;
+			*result = argv[0];
+			return 1;
+		case BUILTIN_PRINT:
+			/* Strings and plain values only; keyword arguments or anything with a repr go through print() */
+			for (int i = 0; i < argCount; ++i) {
+				if (IS_OBJECT(argv[i]) ? !IS_STRING(argv[i]) : (IS_KWARGS(argv[i]) || IS_HANDLER(argv[i]))) return 0;
+			}
+			for (int i = 0; i < argCount; ++i) {
+				if (IS_STRING(argv[i])) fwrite(AS_CSTRING(argv[i]), 1, AS_STRING(argv[i])->length, stdout);
+				else krk_printValue(stdout, argv[i]);
+				fputc(i == argCount - 1 ? '\n' : ' ', stdout);
+			}
+			*result = NONE_VAL();
+			return 1;
+	}
+	return 0;
+}
+
 /**
  * VM main loop.
  */
@@ -1752,6 +2039,10 @@ static KrkValue run() {
 
 		uint8_t opcode = READ_BYTE();
 
+#ifdef ENABLE_OPCODE_STATS
+		krk_countOpcode(opcode);
+#endif
+
 		/* We split the instruction opcode table in half and use the top bit
 		 * to mark instructions as "long" as we can quickly determine operand
 		 * widths. The standard opereand width is 1 byte. If operands need
@@ -1801,6 +2092,11 @@ static KrkValue run() {
 				frame = &krk_currentThread.frames[krk_currentThread.frameCount - 1];
 				break;
 			}
+			/* Suspend a generator. The frame and its stack are left for the generator
+			 * object that resumed us, which is always the exit frame, to save. */
+			case OP_YIELD: {
+				return krk_peek(0);
+			}
 			case OP_EQUAL: {
 				KrkValue b = krk_pop();
 				KrkValue a = krk_pop();
@@ -1829,6 +2125,20 @@ static KrkValue run() {
 			case OP_SHIFTLEFT: BINARY_OP(lshift)
 			case OP_SHIFTRIGHT: BINARY_OP(rshift)
 			case OP_POW: BINARY_OP(pow)
+			case OP_INPLACE_ADD:
+				if (IS_STRING(krk_peek(1))) krk_addObjects();
+				else BINARY_OP(iadd)
+				break;
+			case OP_INPLACE_SUBTRACT: BINARY_OP(isub)
+			case OP_INPLACE_MULTIPLY: BINARY_OP(imul)
+			case OP_INPLACE_DIVIDE: BINARY_OP_CHECK_ZERO(idiv)
+			case OP_INPLACE_MODULO: BINARY_OP_CHECK_ZERO(imod)
+			case OP_INPLACE_POW: BINARY_OP(ipow)
+			case OP_INPLACE_BITOR: BINARY_OP(ior)
+			case OP_INPLACE_BITXOR: BINARY_OP(ixor)
+			case OP_INPLACE_BITAND: BINARY_OP(iand)
+			case OP_INPLACE_SHIFTLEFT: BINARY_OP(ilshift)
+			case OP_INPLACE_SHIFTRIGHT: BINARY_OP(irshift)
 			case OP_BITNEGATE: {
 				KrkValue value = krk_pop();
 				if (IS_INTEGER(value)) krk_push(INTEGER_VAL(~AS_INTEGER(value)));
@@ -1913,6 +2223,25 @@ static KrkValue run() {
 				krk_currentThread.stack[frame->slots + slot] = krk_peek(0);
 				break;
 			}
+			case OP_SET_LOCAL_POP_LONG:
+			case OP_SET_LOCAL_POP: {
+				uint32_t slot = readBytes(frame, operandWidth);
+				krk_currentThread.stack[frame->slots + slot] = krk_pop();
+				break;
+			}
+			case OP_GET_LOCAL_PAIR: {
+				uint8_t first = readBytes(frame, 1);
+				uint8_t second = readBytes(frame, 1);
+				krk_push(krk_currentThread.stack[frame->slots + first]);
+				krk_push(krk_currentThread.stack[frame->slots + second]);
+				break;
+			}
+			case OP_GET_LOCAL_CONSTANT: {
+				uint8_t slot = readBytes(frame, 1);
+				krk_push(krk_currentThread.stack[frame->slots + slot]);
+				krk_push(READ_CONSTANT(1));
+				break;
+			}
 			case OP_JUMP_IF_FALSE: {
 				uint16_t offset = readBytes(frame, 2);
 				if (krk_isFalsey(krk_peek(0))) frame->ip += offset;
@@ -1923,6 +2252,18 @@ static KrkValue run() {
 				if (!krk_isFalsey(krk_peek(0))) frame->ip += offset;
 				break;
 			}
+			case OP_POP_JUMP_IF_FALSE: {
+				uint16_t offset = readBytes(frame, 2);
+				if (krk_isFalsey(krk_peek(0))) frame->ip += offset;
+				krk_pop();
+				break;
+			}
+			case OP_POP_JUMP_IF_TRUE: {
+				uint16_t offset = readBytes(frame, 2);
+				if (!krk_isFalsey(krk_peek(0))) frame->ip += offset;
+				krk_pop();
+				break;
+			}
 			case OP_JUMP: {
 				frame->ip += readBytes(frame, 2);
 				break;
@@ -1932,10 +2273,98 @@ static KrkValue run() {
 				frame->ip -= offset;
 				break;
 			}
-			case OP_PUSH_TRY: {
-				uint16_t tryTarget = readBytes(frame, 2) + (frame->ip - frame->closure->function->chunk.code);
-				KrkValue handler = HANDLER_VAL(OP_PUSH_TRY, tryTarget);
-				krk_push(handler);
+			case OP_FOR_ITER: {
+				uint16_t offset = readBytes(frame, 2);
+				KrkValue value;
+				int status = iterNext(krk_peek(0), &value);
+				if (unlikely(status < 0)) goto _finishException;
+				frame = &krk_currentThread.frames[krk_currentThread.frameCount - 1];
+				if (status) {
+					krk_currentThread.stackTop[-1] = value;
+				} else {
+					krk_pop();
+					frame->ip += offset;
+				}
+				break;
+			}
+			/* Comprehensions run inline in the enclosing function, but may start in the
+			 * middle of an expression with temporaries on the stack where their locals
+			 * belong. OP_COMP_ENTER slides those temporaries up to make room for the
+			 * comprehension's locals, remembering the original stack height in the last
+			 * of them; OP_COMP_EXIT slides them back and leaves the result on top. */
+			case OP_COMP_ENTER_LONG:
+			case OP_COMP_ENTER: {
+				size_t region = frame->slots + readBytes(frame, operandWidth);
+				size_t reserved = READ_BYTE();
+				size_t height = krk_currentThread.stackTop - krk_currentThread.stack;
+				size_t temporaries = height > region ? height - region : 0;
+				while ((size_t)(krk_currentThread.stackTop - krk_currentThread.stack) < region + reserved + temporaries) {
+					krk_push(NONE_VAL());
+				}
+				KrkValue * start = &krk_currentThread.stack[region];
+				memmove(start + reserved, start, temporaries * sizeof(KrkValue));
+				for (size_t i = 0; i < reserved; ++i) start[i] = NONE_VAL();
+				start[reserved-1] = INTEGER_VAL(height);
+				break;
+			}
+			case OP_COMP_EXIT_LONG:
+			case OP_COMP_EXIT: {
+				size_t region = frame->slots + readBytes(frame, operandWidth);
+				size_t reserved = READ_BYTE();
+				KrkValue result = krk_pop();
+				closeUpvalues(region);
+				KrkValue * start = &krk_currentThread.stack[region];
+				size_t height = AS_INTEGER(start[reserved-1]);
+				size_t temporaries = height > region ? height - region : 0;
+				memmove(start, start + reserved, temporaries * sizeof(KrkValue));
+				krk_currentThread.stackTop = krk_currentThread.stack + height;
+				krk_push(result);
+				break;
+			}
+			/* Comprehensions store each value directly into their result collection,
+			 * which lives in a hidden local slot of the enclosing function. */
+			case OP_LIST_APPEND_LONG:
+			case OP_LIST_APPEND: {
+				uint32_t slot = readBytes(frame, operandWidth);
+				KrkValue list = krk_currentThread.stack[frame->slots + slot];
+				if (unlikely(!krk_isInstanceOf(list, vm.baseClasses->listClass))) {
+					krk_runtimeError(vm.exceptions->typeError, "Expected list, not '%s'", krk_typeName(list));
+					goto _finishException;
+				}
+				krk_writeValueArray(AS_LIST(list), krk_peek(0));
+				krk_pop();
+				break;
+			}
+			case OP_DICT_SET_LONG:
+			case OP_DICT_SET: {
+				uint32_t slot = readBytes(frame, operandWidth);
+				KrkValue dict = krk_currentThread.stack[frame->slots + slot];
+				if (unlikely(!krk_isInstanceOf(dict, vm.baseClasses->dictClass))) {
+					krk_runtimeError(vm.exceptions->typeError, "Expected dict, not '%s'", krk_typeName(dict));
+					goto _finishException;
+				}
+				krk_tableSet(AS_DICT(dict), krk_peek(1), krk_peek(0));
+				krk_pop();
+				krk_pop();
+				break;
+			}
+			case OP_SET_ADD_LONG:
+			case OP_SET_ADD: {
+				uint32_t slot = readBytes(frame, operandWidth);
+				if (unlikely(!krk_set_add_fast(krk_currentThread.stack[frame->slots + slot], krk_peek(0)))) goto _finishException;
+				krk_pop();
+				break;
+			}
+			case OP_LIST_RESERVE_LONG:
+			case OP_LIST_RESERVE: {
+				uint32_t slot = readBytes(frame, operandWidth);
+				KrkValue list = krk_currentThread.stack[frame->slots + slot];
+				size_t hint = lengthHint(krk_peek(0));
+				if (hint && krk_isInstanceOf(list, vm.baseClasses->listClass) && AS_LIST(list)->capacity < hint) {
+					KrkValueArray * values = AS_LIST(list);
+					values->values = GROW_ARRAY(KrkValue, values->values, values->capacity, hint);
+					values->capacity = hint;
+				}
 				break;
 			}
 			case OP_RAISE: {
@@ -1957,6 +2386,58 @@ static KrkValue run() {
 				frame = &krk_currentThread.frames[krk_currentThread.frameCount - 1];
 				break;
 			}
+			/* A call whose result is returned straight away. If it pushed a frame for
+			 * managed code, slide that frame down over this one so recursion in tail
+			 * position runs in constant frame and stack space. The compiler doesn't
+			 * emit this inside try or with blocks, which need this frame to stay. */
+			case OP_TAIL_CALL_LONG:
+			case OP_TAIL_CALL: {
+				int argCount = readBytes(frame, operandWidth);
+				size_t frameIndex = krk_currentThread.frameCount - 1;
+				if (unlikely(!krk_callValue(krk_peek(argCount), argCount, 1))) goto _finishException;
+				if (krk_currentThread.frameCount > frameIndex + 1 && !frame->closure->function->isGenerator) {
+					CallFrame * callee = &krk_currentThread.frames[frameIndex + 1];
+					closeUpvalues(frame->slots);
+					size_t shift = callee->outSlots - frame->outSlots;
+					memmove(&krk_currentThread.stack[frame->outSlots], &krk_currentThread.stack[callee->outSlots],
+						sizeof(KrkValue) * (krk_currentThread.stackTop - &krk_currentThread.stack[callee->outSlots]));
+					krk_currentThread.stackTop -= shift;
+					frame->closure = callee->closure;
+					frame->ip = callee->ip;
+					frame->slots = callee->slots - shift;
+					frame->globals = callee->globals;
+					krk_currentThread.frameCount--;
+				}
+				frame = &krk_currentThread.frames[krk_currentThread.frameCount - 1];
+				break;
+			}
+			/* Calls to some builtins are compiled to this instead of GET_GLOBAL, args, CALL.
+			 * The name is still looked up, so if it has been shadowed we call whatever
+			 * it is now; otherwise common cases are handled without a call at all. */
+			case OP_CALL_BUILTIN: {
+				int which = READ_BYTE();
+				KrkString * name = READ_STRING(1);
+				int argCount = READ_BYTE();
+				KrkValue callee, result;
+				if (!krk_tableGet(frame->globals, OBJECT_VAL(name), &callee)) {
+					if (!krk_tableGet(&vm.builtins->fields, OBJECT_VAL(name), &callee)) {
+						krk_runtimeError(vm.exceptions->nameError, "Undefined variable '%s'.", name->chars);
+						goto _finishException;
+					}
+				}
+				if (IS_OBJECT(callee) && AS_OBJECT(callee) == vm.inlineBuiltins[which] && inlineBuiltin(which, argCount, &result)) {
+					krk_currentThread.stackTop -= argCount;
+					krk_push(result);
+					break;
+				}
+				krk_push(NONE_VAL());
+				KrkValue * args = krk_currentThread.stackTop - argCount - 1;
+				memmove(args + 1, args, sizeof(KrkValue) * argCount);
+				args[0] = callee;
+				if (unlikely(!krk_callValue(callee, argCount, 1))) goto _finishException;
+				frame = &krk_currentThread.frames[krk_currentThread.frameCount - 1];
+				break;
+			}
 			/* This version of the call instruction takes its arity from the
 			 * top of the stack, so we don't have to calculate arity at compile time. */
 			case OP_CALL_STACK: {
@@ -2302,9 +2783,7 @@ static KrkValue run() {
 _finishException:
 		if (!handleException()) {
 			frame = &krk_currentThread.frames[krk_currentThread.frameCount - 1];
-			frame->ip = frame->closure->function->chunk.code + AS_HANDLER(krk_peek(0)).target;
-			/* Replace the exception handler with the exception */
-			krk_pop();
+			/* The exception becomes the except branch's `exception` local */
 			krk_push(krk_currentThread.currentException);
 			krk_currentThread.currentException = NONE_VAL();
 		} else {
@@ -47,10 +47,37 @@ typedef enum {
 	METHOD_DIR,
 	METHOD_SETSLICE,
 	METHOD_DELSLICE,
+	METHOD_HASH,
+	METHOD_MISSING,
+
+	METHOD_IADD,
+	METHOD_ISUB,
+	METHOD_IMUL,
+	METHOD_IDIV,
+	METHOD_IMOD,
+	METHOD_IPOW,
+	METHOD_IOR,
+	METHOD_IXOR,
+	METHOD_IAND,
+	METHOD_ILSHIFT,
+	METHOD_IRSHIFT,
 
 	METHOD__MAX,
 } KrkSpecialMethods;
 
+/* Builtins the compiler calls with OP_CALL_BUILTIN */
+typedef enum {
+	BUILTIN_LEN,
+	BUILTIN_ISINSTANCE,
+	BUILTIN_TYPE,
+	BUILTIN_STR,
+	BUILTIN_PRINT,
+
+	BUILTIN__MAX,
+} KrkInlineBuiltins;
+
+extern const char * krk_inlineBuiltinNames[BUILTIN__MAX];
+
 struct Exceptions {
 	KrkClass * baseException;
 	KrkClass * typeError;
@@ -66,6 +93,7 @@ struct Exceptions {
 	KrkClass * zeroDivisionError;
 	KrkClass * notImplementedError;
 	KrkClass * syntaxError;
+	KrkClass * memoryError;
 };
 
 /**
@@ -118,6 +146,7 @@ typedef struct ThreadState {
 	KrkValue currentException;
 	int flags;
 	long watchdog;
+	struct GlobalState * compilerState; /* Innermost compile running on this thread, for the GC */
 
 #define THREAD_SCRATCH_SIZE 3
 	KrkValue scratchSpace[THREAD_SCRATCH_SIZE];
@@ -133,6 +162,7 @@ typedef struct {
 	KrkValue * specialMethodNames;     /* Cached strings of important method and function names */
 	struct BaseClasses * baseClasses; /* Pointer to a (static) namespacing struct for the KrkClass*'s of built-in object types */
 	struct Exceptions * exceptions;   /* Pointer to a (static) namespacing struct for the KrkClass*'s of basic exception types */
+	KrkObj * inlineBuiltins[BUILTIN__MAX]; /* What OP_CALL_BUILTIN expects to find for each inlined builtin */
 
 	/* Garbage collector state */
 	KrkObj * objects;                 /* Linked list of all objects in the GC */
@@ -155,6 +185,7 @@ typedef struct {
 #define KRK_ENABLE_STRESS_GC    (1 << 8)
 #define KRK_GC_PAUSED           (1 << 9)
 #define KRK_CLEAN_OUTPUT        (1 << 10)
+#define KRK_ENABLE_OPTIMIZER    (1 << 11)
 
 #ifdef ENABLE_THREADING
 #define krk_currentThread (*(krk_getCurrentThread()))
@@ -181,6 +212,7 @@ extern KrkProperty * krk_defineNativeProperty(KrkTable * table, const char * nam
 extern void krk_attachNamedObject(KrkTable * table, const char name[], KrkObj * obj);
 extern void krk_attachNamedValue(KrkTable * table, const char name[], KrkValue obj);
 extern KrkValue krk_runtimeError(KrkClass * type, const char * fmt, ...);
+extern KrkValue krk_keyError(KrkValue key);
 extern KrkThreadState * krk_getCurrentThread(void);
 
 extern KrkInstance * krk_dictCreate(void);
@@ -193,6 +225,9 @@ extern int krk_callValue(KrkValue callee, int argCount, int extra);
 extern KrkValue krk_list_of(int argc, KrkValue argv[]);
 extern KrkValue krk_dict_of(int argc, KrkValue argv[]);
 extern KrkValue krk_callSimple(KrkValue value, int argCount, int isMethod);
+extern int krk_unpackIterable(KrkValue iterable, void * context, int callback(void *, const KrkValue *, size_t));
+extern KrkValue krk_getIterator(KrkValue iterable);
+extern int krk_iterNext(KrkValue iterator, KrkValue * out);
 extern KrkClass * krk_makeClass(KrkInstance * module, KrkClass ** _class, const char * name, KrkClass * base);
 extern void krk_finalizeClass(KrkClass * _class);
 extern void krk_dumpTraceback();
@@ -211,8 +246,14 @@ extern KrkValue krk_string_format(int argc, KrkValue argv[], int hasKw);
 /* obj_dict.h */
 extern KrkValue krk_dict_nth_key_fast(size_t capacity, KrkTableEntry * entries, size_t index);
 
+/* obj_set.h */
+extern int krk_set_add_fast(KrkValue set, KrkValue value);
+
 extern KrkValue krk_tuple_of(int argc, KrkValue argv[]);
 
+/* obj_gen.h */
+extern KrkInstance * krk_buildGenerator(KrkClosure * closure, size_t argc);
+
 extern int krk_isFalsey(KrkValue value);
 
 extern void _createAndBind_numericClasses(void);
@@ -224,15 +265,29 @@ extern void _createAndBind_dictClass(void);
 extern void _createAndBind_functionClass(void);
 extern void _createAndBind_rangeClass(void);
 extern void _createAndBind_setClass(void);
+extern void _createAndBind_iterClasses(void);
+extern void _createAndBind_generatorClass(void);
 extern void _createAndBind_builtins(void);
 extern void _createAndBind_type(void);
 extern void _createAndBind_exceptions(void);
+extern void _exception_setMessage(KrkInstance * self, const char * message, size_t length);
 extern void _createAndBind_gcMod(void);
 
 extern int krk_doRecursiveModuleLoad(KrkString * name);
 
+extern KrkValue krk_operator_add(KrkValue,KrkValue);
+extern KrkValue krk_operator_sub(KrkValue,KrkValue);
+extern KrkValue krk_operator_mul(KrkValue,KrkValue);
+extern KrkValue krk_operator_div(KrkValue,KrkValue);
+extern KrkValue krk_operator_mod(KrkValue,KrkValue);
+extern KrkValue krk_operator_or(KrkValue,KrkValue);
+extern KrkValue krk_operator_xor(KrkValue,KrkValue);
+extern KrkValue krk_operator_and(KrkValue,KrkValue);
+extern KrkValue krk_operator_lshift(KrkValue,KrkValue);
+extern KrkValue krk_operator_rshift(KrkValue,KrkValue);
 extern KrkValue krk_operator_lt(KrkValue,KrkValue);
 extern KrkValue krk_operator_gt(KrkValue,KrkValue);
+extern KrkValue krk_operator_iadd(KrkValue,KrkValue);
 
 #ifdef ENABLE_THREADING
 #include <sched.h>